@@ -6,6 +6,9 @@
 #include <vulkan/vulkan.h>
 
 VkInstance instance;
+// Start with --no-validation to create the instance without the validation layers, the benchmark runner uses this so it
+// times the sample rather than the layers
+bool validation = true;
 
 // Compare the required layers to the available layers on the system
 bool CheckLayersSupport(const char** layers, int count)
@@ -45,11 +48,19 @@ bool CheckLayersSupport(const char** layers, int count)
 
 int main(int argc, char **argv)
 {
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--no-validation") == 0) validation = false;
+	}
+
 	const char *instance_layers[] = { "VK_LAYER_LUNARG_standard_validation" };
 	const char *instance_extensions[] = { "VK_EXT_debug_report" };
+	// The debug report extension is only needed to hear back from the validation layers
+	const uint32_t layer_count = validation ? 1 : 0;
+	const uint32_t extension_count = validation ? 1 : 0;
 
 	// Check to see if we have the layer requirments
-	assert(CheckLayersSupport(instance_layers, 1) && "Unsupported Layers Found");
+	assert(CheckLayersSupport(instance_layers, layer_count) && "Unsupported Layers Found");
 
 	VkApplicationInfo app_info = {};
 	app_info.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
@@ -64,9 +75,9 @@ int main(int argc, char **argv)
 	VkInstanceCreateInfo create_info = {};
 	create_info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
 	create_info.pApplicationInfo = &app_info;                    // Pointer to the application information created
-	create_info.enabledExtensionCount = 1;                       // The amount of extensions we wish to enable
+	create_info.enabledExtensionCount = extension_count;         // The amount of extensions we wish to enable
 	create_info.ppEnabledExtensionNames = instance_extensions;   // The raw data of the extensions to enable
-	create_info.enabledLayerCount = 1;                           // The amount of layers we wish to enable
+	create_info.enabledLayerCount = layer_count;                 // The amount of layers we wish to enable
 	create_info.ppEnabledLayerNames = instance_layers;           // The raw data of the layers to enable
 
 
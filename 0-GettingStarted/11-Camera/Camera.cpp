@@ -1,11 +1,16 @@
 
+// The window surface is only hooked up for Windows, anywhere else the sample can still be run with --headless
+#ifdef _WIN32
 #define VK_USE_PLATFORM_WIN32_KHR
+#endif
 #include <assert.h>
 #include <stdio.h>
 #include <string.h>
 #include <memory>
 #include <stdexcept>
 #include <iostream>
+#include <chrono>
+#include <algorithm>
 
 
 #define GLM_ENABLE_EXPERIMENTAL
@@ -25,6 +30,20 @@
 
 #include <VkInitializers.hpp>
 #include <VkCore.hpp>
+#include <VkDispatch.hpp>
+#include <VkPipelineCache.hpp>
+#include <VkRingBuffer.hpp>
+#include <VkMeshCache.hpp>
+#include <VkMipmaps.hpp>
+#include <VkKtx.hpp>
+#include <VkFrameLoop.hpp>
+#include <VkTextureHeap.hpp>
+#include <VkDescriptorAllocator.hpp>
+#include <VkCommandRecorder.hpp>
+#include <VkHeadless.hpp>
+#include <VkGpuProfiler.hpp>
+#include <VkCpuProfiler.hpp>
+#include <VkBenchmark.hpp>
 
 struct SBuffer
 {
@@ -36,6 +55,8 @@ struct SBuffer
 	VkMemoryPropertyFlags buffer_memory_properties;
 	// Raw pointer that will point to GPU memory
 	void* mapped_buffer_memory = nullptr;
+	// Region of the allocators memory the buffer is bound to
+	VkHelper::Allocation allocation;
 };
 
 struct STexture
@@ -43,13 +64,23 @@ struct STexture
 	SBuffer transfer_buffer;
 	unsigned int width;
 	unsigned int height;
+	uint32_t mip_levels;
 	VkFormat format;
 
 	VkImage image;
-	VkDeviceMemory memory;
+	// Region of the allocators memory the image is bound to
+	VkHelper::Allocation allocation;
 	VkImageView view;
 	VkImageLayout layout;
 	VkSampler sampler;
+	// Where the texture sits in the bindless texture heap, materials refer to it by this index
+	uint32_t heap_index;
+};
+
+// One entry of the material table the fragment shader reads with the vertices matID
+struct SMaterial
+{
+	uint32_t albedo_texture;                // Index into the texture heap
 };
 
 struct SCamera
@@ -76,6 +107,7 @@ struct ModelInstance
 	unsigned int index_offset = 0;
 	unsigned int vertex_count = 0;
 	unsigned int index_count = 0;
+	unsigned int material_offset = 0;       // Where the models materials start in the material table
 };
 
 ModelInstance pbrboy_model;
@@ -106,9 +138,13 @@ VkPhysicalDeviceFeatures physical_device_features;
 VkPhysicalDeviceMemoryProperties physical_device_mem_properties;
 
 VkDevice device = VK_NULL_HANDLE;
+// The devices own functions, the commands recorded every frame are called through this rather than the loader
+const VkHelper::DeviceDispatch* device_dispatch = nullptr;
 VkQueue graphics_queue = VK_NULL_HANDLE;
 VkQueue present_queue = VK_NULL_HANDLE;
 VkCommandPool command_pool;
+// Sub allocates buffer and image memory out of large blocks
+VkHelper::Allocator allocator;
 
 
 
@@ -132,17 +168,42 @@ VkRenderPass renderpass = VK_NULL_HANDLE;
 std::unique_ptr<VkFramebuffer> framebuffers = nullptr;
 std::unique_ptr<VkHelper::VulkanAttachments> framebuffer_attachments = nullptr;
 
-uint32_t current_frame_index = 0; // What frame are we currently using
-std::unique_ptr<VkFence> fences = nullptr;
+// How many frames the CPU is allowed to get ahead of the GPU
+const uint32_t frames_in_flight = 2;
+VkHelper::FrameLoop frame_loop;
+
+// Start with --headless [frame count] to render a fixed number of frames into offscreen images, with no window
+VkHelper::HeadlessOptions headless;
+VkHelper::HeadlessSwapchain headless_swapchain;
 
-VkSemaphore image_available_semaphore;
-VkSemaphore render_finished_semaphore;
-VkSubmitInfo render_submission_info = {};
-VkPresentInfoKHR present_info = {};
-VkPipelineStageFlags wait_stages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+// Start with --gpu-profile to time the draw on the GPU, the timings are printed when the sample closes
+bool gpu_profile = false;
+VkHelper::GpuProfiler gpu_profiler;
+uint32_t draw_gpu_scope = 0;
+
+// Started by the benchmark runner with --benchmark <output path> [--warmup frame count]. Records the startup phases,
+// frame times and GPU timings, and writes them out when the sample closes
+VkHelper::BenchmarkRecorder benchmark;
+
+// Builds the mip chain of the textures after they are copied to the GPU
+VkHelper::MipmapGenerator mipmap_generator;
 
 std::unique_ptr<VkCommandBuffer> graphics_command_buffers = nullptr;
 
+// Records the contents of the render pass as secondary command buffers across all the CPU cores, each swapchain image
+// has its own command pool per thread
+VkHelper::CommandRecorder command_recorder;
+// The secondary command buffers of every swapchain image, the primaries execute their range of these
+std::vector<VkCommandBuffer> secondary_command_buffers;
+// Every model that is drawn. The list is split into jobs of draws_per_record_job, so large scenes are recorded in parallel
+std::vector<ModelInstance*> draw_list;
+const uint32_t draws_per_record_job = 256;
+
+// Start with --dynamic-recording to record the frames commands from scratch every frame rather than prerecording them
+bool dynamic_recording = false;
+// The transient command pools dynamic recording records into, along with how long each frame took to record
+VkHelper::FrameCommands frame_commands;
+
 const unsigned int shader_stage_count = 2;
 std::unique_ptr<VkShaderModule> graphics_shader_modules;
 VkPipeline graphics_pipeline = VK_NULL_HANDLE;
@@ -152,25 +213,31 @@ VkShaderModule fragment_shader_module = VK_NULL_HANDLE;
 
 
 VkBuffer particle_vertex_buffer = VK_NULL_HANDLE;
-VkDeviceMemory particle_vertex_buffer_memory = VK_NULL_HANDLE;
+// Region of the allocators memory the vertex buffer is bound to
+VkHelper::Allocation particle_vertex_buffer_allocation;
 // Raw pointer that will point to GPU memory
 void* particle_vertex_mapped_buffer_memory = nullptr;
 
 
 VkBuffer index_buffer = VK_NULL_HANDLE;
-VkDeviceMemory index_buffer_memory = VK_NULL_HANDLE;
+// Region of the allocators memory the index buffer is bound to
+VkHelper::Allocation index_buffer_allocation;
 // Raw pointer that will point to GPU memory
 void* index_mapped_buffer_memory = nullptr;
 
 SCamera camera;
-SBuffer camera_buffer;
-VkDescriptorPool camera_descriptor_pool;
+// The camera is pushed into a ring buffer, each swapchain image reads it from its own region
+VkHelper::RingBuffer uniform_buffer;
 VkDescriptorSetLayout camera_descriptor_set_layout;
 VkDescriptorSet camera_descriptor_set;
 
-VkDescriptorPool texture_descriptor_pool;
-VkDescriptorSetLayout texture_descriptor_set_layout;
-VkDescriptorSet texture_descriptor_set;
+// Every texture is in one descriptor array that is bound once, shaders pick the texture through the material table
+VkHelper::TextureHeap texture_heap;
+// The camera set comes from here rather than a pool sized by hand
+VkHelper::DescriptorAllocator descriptor_allocator;
+// The materials of every loaded model, the vertices matID indexes this
+std::vector<SMaterial> materials;
+SBuffer material_buffer;
 
 
 // Create a new sdl window
@@ -198,6 +265,7 @@ void WindowSetup(const char* title, int width, int height)
 
 void BuildCamera()
 {
+	VK_HELPER_CPU_ZONE("BuildCamera");
 	camera.camera_position = glm::mat4(1.0f);
 	camera.camera_position = glm::translate(camera.camera_position, glm::vec3( 0.0f, -0.07f, -0.2f ));
 
@@ -209,10 +277,35 @@ void BuildCamera()
 	);
 	// Flip the cameras prospective upside down as glm assumes that the renderer we are using renders top to bottom, vulkan is the opposite
 	camera.projection[1][1] *= -1.0f;
+}
 
-	// Transfer data over to the texture buffer
+// Push this frames uniform data into its region of the ring buffer
+void UpdateUniforms(uint32_t frame_index)
+{
+	VK_HELPER_CPU_ZONE("UpdateUniforms");
+	// Wait till the last submit that used this region is done before we write into it
+	VkHelper::BeginRingBufferFrame(
+		device,
+		uniform_buffer,
+		frame_index,
+		VkHelper::CurrentFrameFence(frame_loop)
+	);
+
+	uint32_t camera_offset = 0;
+	void* camera_memory = nullptr;
+	bool allocated = VkHelper::RingBufferAllocate(
+		uniform_buffer,                             // What ring buffer are we allocating from
+		sizeof(SCamera),                            // How much memory do we need
+		camera_offset,                              // The dynamic offset of the data
+		camera_memory                               // Where we can write the data
+	);
+	// The camera is always the first thing we push each frame, so it sits at the start of the frames region.
+	// This is the dynamic offset the command buffers were recorded with
+	assert(allocated && camera_offset == VkHelper::RingBufferRegionOffset(uniform_buffer, frame_index));
+
+	// Transfer data over to the uniform buffer
 	memcpy(
-		camera_buffer.mapped_buffer_memory,         // The destination for our memory (GPU)
+		camera_memory,                              // The destination for our memory (GPU)
 		&camera,                                    // Source for the memory (CPU-Ram)
 		sizeof(SCamera)                             // How much data we are transferring
 	);
@@ -221,6 +314,7 @@ void BuildCamera()
 // Check for window updates and process them
 void PollWindow()
 {
+	VK_HELPER_CPU_ZONE("PollWindow");
 
 	// Poll Window
 	SDL_Event event;
@@ -258,6 +352,7 @@ void DestroyWindow()
 // Create windows surface for sdl to interface with
 void CreateSurface()
 {
+#ifdef VK_USE_PLATFORM_WIN32_KHR
 	auto CreateWin32SurfaceKHR = (PFN_vkCreateWin32SurfaceKHR)vkGetInstanceProcAddr(instance, "vkCreateWin32SurfaceKHR");
 
 	VkWin32SurfaceCreateInfoKHR createInfo = {};
@@ -269,6 +364,9 @@ void CreateSurface()
 	{
 		throw std::runtime_error("failed to create window surface!");
 	}
+#else
+	throw std::runtime_error("window surfaces are only supported on windows, run with --headless instead");
+#endif
 }
 
 // Everything within the Setup is from previous tutorials
@@ -284,18 +382,36 @@ void CreateSurface()
 // - Renderpass
 void Setup()
 {
+	VK_HELPER_CPU_ZONE("Setup");
 
-	WindowSetup("Vulkan", 1080, 720);
+	if (headless.enabled)
+	{
+		// No window, the offscreen images are the size the window would have been
+		window_width = 1080;
+		window_height = 720;
+		window_open = true;
+	}
+	else
+	{
+		WindowSetup("Vulkan", 1080, 720);
+	}
 
 
 	// Define what Layers and Extensions we require
-	const uint32_t extention_count = 3;
-	const char *instance_extensions[extention_count] = { "VK_EXT_debug_report" ,VK_KHR_SURFACE_EXTENSION_NAME,VK_KHR_WIN32_SURFACE_EXTENSION_NAME };
-	const uint32_t layer_count = 1;
-	const char *instance_layers[layer_count] = { "VK_LAYER_LUNARG_standard_validation" };
+#ifdef VK_USE_PLATFORM_WIN32_KHR
+	const uint32_t window_extention_count = 3;
+	const char *instance_extensions[window_extention_count] = { "VK_EXT_debug_report" ,VK_KHR_SURFACE_EXTENSION_NAME,VK_KHR_WIN32_SURFACE_EXTENSION_NAME };
+#else
+	const uint32_t window_extention_count = 1;
+	const char *instance_extensions[window_extention_count] = { "VK_EXT_debug_report" };
+#endif
+	const char *instance_layers[1] = { "VK_LAYER_LUNARG_standard_validation" };
+	// A headless run needs no surface, and is left without the validation layers as they would be most of what it times
+	const uint32_t extention_count = headless.enabled ? 0 : window_extention_count;
+	const uint32_t layer_count = headless.enabled ? 0 : 1;
 
 	// Check to see if we have the layer requirments
-	assert(VkHelper::CheckLayersSupport(instance_layers, 1) && "Unsupported Layers Found");
+	assert(VkHelper::CheckLayersSupport(instance_layers, layer_count) && "Unsupported Layers Found");
 
 	// Create the Vulkan Instance
 	instance = VkHelper::CreateInstance(
@@ -307,18 +423,20 @@ void Setup()
 
 	// Attach a debugger to the application to give us validation feedback.
 	// This is useful as it tells us about any issues without application
-	debugger = VkHelper::CreateDebugger(instance);
+	if (!headless.enabled) debugger = VkHelper::CreateDebugger(instance);
 
 	// Define what Device Extensions we require
-	const uint32_t physical_device_extention_count = 1;
+	const uint32_t physical_device_extention_count = 2;
 	// Note that this extension list is different from the instance on as we are telling the system what device settings we need.
-	const char *physical_device_extensions[physical_device_extention_count] = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
+	// The swapchain extension is still needed headless, the render pass leaves its images in the present layout
+	// Descriptor indexing lets all of the textures live in one bindless array
+	const char *physical_device_extensions[physical_device_extention_count] = { VK_KHR_SWAPCHAIN_EXTENSION_NAME, VkHelper::TextureHeapExtension() };
 
 
 
 	// The surface creation is added here as it needs to happen before the physical device creation and after we have said to the instance that we need a surface
 	// The surface is the reference back to the OS window
-	CreateSurface();
+	if (!headless.enabled) CreateSurface();
 
 
 
@@ -339,6 +457,10 @@ void Setup()
 	// Make sure we found a physical device
 	assert(foundPhysicalDevice);
 
+	// Make sure the device can index a partially bound texture array that is updated after it is bound
+	assert(VkHelper::SupportsTextureHeap(physical_device));
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT texture_heap_features = VkHelper::TextureHeapFeatures();
+
 	// Define how many queues we will need in our project, for now, we will just create a single queue
 	static const float queue_priority = 1.0f;
 	VkDeviceQueueCreateInfo queue_create_info = VkHelper::DeviceQueueCreateInfo(
@@ -355,9 +477,12 @@ void Setup()
 		1,                                                     // How many queues are in the list
 		physical_device_features,                              // What features do you want enabled on the device
 		physical_device_extensions,                            // What extensions do you want on the device
-		physical_device_extention_count                        // How many extensions are there
+		physical_device_extention_count,                       // How many extensions are there
+		&texture_heap_features                                 // Turn on the descriptor indexing features the texture heap uses
 	);
 
+	device_dispatch = &VkHelper::GetDeviceDispatch(device);
+
 	vkGetDeviceQueue(
 		device,
 		physical_devices_queue_family,
@@ -372,23 +497,83 @@ void Setup()
 		&present_queue
 	);
 
+	// Create the allocator that our buffers and images will get their memory from
+	VkHelper::CreateAllocator(
+		device,
+		physical_device_properties,
+		physical_device_mem_properties,
+		allocator
+	);
+
+	// Load the pipeline cache from the last run, all pipelines created through Vk-Helper will use it
+	VkHelper::LoadPipelineCache(
+		device,
+		physical_device_properties,                            // Used to check the cache was made by this GPU and driver
+		"Camera.pipelinecache"                                 // Where the cache is stored between runs
+	);
+
 	command_pool = VkHelper::CreateCommandPool(
 		device,
 		physical_devices_queue_family,                         // What queue family we are wanting to use to send commands to the GPU
 		VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT        // Allows any commands we create, the ability to be reset. This is helpful as we wont need to
 	);                                                         // keep allocating new commands, we can reuse them
 
+	// The compute shader is only loaded if a texture format can't be blitted
+	VkHelper::CreateMipmapGenerator(
+		device,
+		physical_device,
+		"../../../Data/Shaders/Mipmaps/Downsample/comp.spv",
+		mipmap_generator
+	);
 
 	CreateRenderResources();
 
 
 
-	// Create the fences required for the swap chain rendering 
-	VkHelper::CreateFence(device, fences, swapchain_image_count);
+	// Create the per frame semaphores, fences and command buffers for the frames in flight
+	VkHelper::CreateFrameLoop(
+		device,
+		command_pool,
+		swapchain_image_count,                                 // How many images the frames will be rendering into
+		frames_in_flight,                                      // How many frames can be worked on at once
+		frame_loop
+	);
+	// Acquire and present from the offscreen images rather than a swapchain
+	if (headless.enabled) frame_loop.headless_swapchain = &headless_swapchain;
+
+	// Both the prerecorded and the dynamically recorded commands only reuse an images queries once the last frame to
+	// render to it has finished, so each image gets a slot
+	if (gpu_profile)
+	{
+		bool gpu_profiler_created = VkHelper::CreateGpuProfiler(
+			physical_device,
+			device,
+			physical_devices_queue_family,
+			swapchain_image_count,                             // A slot for each image, grown if a resize hands back more images
+			1,                                                 // The draw
+			0,                                                 // No trace is written
+			gpu_profiler
+		);
+		if (!gpu_profiler_created) std::cout << "The graphics queue can't write timestamps, GPU profiling is off" << std::endl;
+	}
+	draw_gpu_scope = VkHelper::RegisterGpuScope(gpu_profiler, "Draw");
+
+	// Create the transient command pools for recording every frame from scratch
+	VkHelper::CreateFrameCommands(
+		device,
+		physical_devices_queue_family,
+		frames_in_flight,
+		frame_commands
+	);
 
-	// Create the image available and finished semaphore
-	VkHelper::CreateVkSemaphore(device, image_available_semaphore);
-	VkHelper::CreateVkSemaphore(device, render_finished_semaphore);
+	// Create the per thread command pools for each swapchain image
+	VkHelper::CreateCommandRecorder(
+		device,
+		physical_devices_queue_family,                         // The secondary command buffers run on the graphics queue
+		swapchain_image_count,                                 // A set of pools for each command buffer we prerecord
+		0,                                                     // Use every CPU core
+		command_recorder
+	);
 
 	VkCommandBufferAllocateInfo command_buffer_allocate_info = VkHelper::CommandBufferAllocateInfo(
 		command_pool,
@@ -404,17 +589,13 @@ void Setup()
 	);
 	assert(allocate_command_buffer_resut == VK_SUCCESS);
 
-	render_submission_info = VkHelper::SubmitInfo(1, &image_available_semaphore, 1, &render_finished_semaphore, wait_stages);
-
-	present_info = VkHelper::PresentInfoKHR(1, &render_finished_semaphore, swap_chain);
-
 	// Create the models vertex buffer
 	VkHelper::CreateBuffer(
 		device,                                                          // What device are we going to use to create the buffer
-		physical_device_mem_properties,                                  // What memory properties are available on the device
-		particle_vertex_buffer,                                                   // What buffer are we going to be creating
-		particle_vertex_buffer_memory,                                            // The output for the buffer memory
-		particle_vertex_buffer_size,                                              // How much memory we wish to allocate on the GPU
+		allocator,                                                       // What allocator are we getting the memory from
+		particle_vertex_buffer,                                          // What buffer are we going to be creating
+		particle_vertex_buffer_allocation,                               // The output for the buffer allocation
+		particle_vertex_buffer_size,                                     // How much memory we wish to allocate on the GPU
 		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,                               // What type of buffer do we want. Buffers can have multiple types, for example, uniform & vertex buffer.
 																		 // for now we want to keep the buffer specialized to one type as this will allow vulkan to optimize the data.
 		VK_SHARING_MODE_EXCLUSIVE,                                       // There are two modes, exclusive and concurrent. Defines if it can concurrently be used by multiple queue
@@ -422,25 +603,15 @@ void Setup()
 		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT                              // What properties do we require of our memory
 	);
 
-	// Get the pointer to the GPU memory
-	VkResult vertex_mapped_memory_result = vkMapMemory(
-		device,                                                         // The device that the memory is on
-		particle_vertex_buffer_memory,                                           // The device memory instance
-		0,                                                              // Offset from the memory starts that we are accessing
-		particle_vertex_buffer_size,                                             // How much memory are we accessing
-		0,                                                              // Flags (we don't need this for basic buffers)
-		&particle_vertex_mapped_buffer_memory                                    // The return for the memory pointer
-	);
-
-	// Could we map the GPU memory to our CPU accessible pointer
-	assert(vertex_mapped_memory_result == VK_SUCCESS);
+	// The allocator keeps host visible blocks mapped, so we can just take the pointer
+	particle_vertex_mapped_buffer_memory = particle_vertex_buffer_allocation.mapped_memory;
 
 	// Create the models Index buffer
 	VkHelper::CreateBuffer(
 		device,                                                          // What device are we going to use to create the buffer
-		physical_device_mem_properties,                                  // What memory properties are available on the device
+		allocator,                                                       // What allocator are we getting the memory from
 		index_buffer,                                                    // What buffer are we going to be creating
-		index_buffer_memory,                                             // The output for the buffer memory
+		index_buffer_allocation,                                         // The output for the buffer allocation
 		index_buffer_size,                                               // How much memory we wish to allocate on the GPU
 		VK_BUFFER_USAGE_INDEX_BUFFER_BIT,                                // What type of buffer do we want. Buffers can have multiple types, for example, uniform & vertex buffer.
 																		 // for now we want to keep the buffer specialized to one type as this will allow vulkan to optimize the data.
@@ -449,120 +620,60 @@ void Setup()
 		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT                              // What properties do we require of our memory
 	);
 
-	// Get the pointer to the GPU memory
-	VkResult index_mapped_memory_result = vkMapMemory(
-		device,                                                         // The device that the memory is on
-		index_buffer_memory,                                            // The device memory instance
-		0,                                                              // Offset from the memory starts that we are accessing
-		index_buffer_size,                                              // How much memory are we accessing
-		0,                                                              // Flags (we don't need this for basic buffers)
-		&index_mapped_buffer_memory                                     // The return for the memory pointer
-	);
-
-	// Could we map the GPU memory to our CPU accessible pointer
-	assert(index_mapped_memory_result == VK_SUCCESS);
-
-
-
-	// Define how many descriptor pools we will need
-	const uint32_t descriptor_pool_size_count = 1;
+	// The allocator keeps host visible blocks mapped, so we can just take the pointer
+	index_mapped_buffer_memory = index_buffer_allocation.mapped_memory;
 
-	// Define that the new descriptor pool will be taking a combined image sampler
-	VkDescriptorPoolSize texture_pool_size[descriptor_pool_size_count] = {
-		VkHelper::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1)
-	};
-
-	// Create the new descriptor pool with the defined settings
-	texture_descriptor_pool = VkHelper::CreateDescriptorPool(
-		device,
-		texture_pool_size,
-		descriptor_pool_size_count,
-		1															// How many descriptor sets do will we need
-																	// Since we are only rendering one image, just 1
-	);
 
-	// Define at what stage of the rendering pipeline the texture is coming into as well as what shader and what location
-	VkDescriptorSetLayoutBinding layout_bindings[descriptor_pool_size_count] = {
-		VkHelper::DescriptorSetLayoutBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT)
-	};
-
-	// Create the new texture set layout
-	texture_descriptor_set_layout = VkHelper::CreateDescriptorSetLayout(
-		device,
-		layout_bindings,
-		descriptor_pool_size_count
-	);
 
-	// Allocate a new texture descriptor set from the pool
-	texture_descriptor_set = VkHelper::AllocateDescriptorSet(
+	// Create the bindless texture heap. Textures are added to it as they are created and stay there until they are
+	// destroyed, so the set is bound once and never rebuilt
+	VkHelper::CreateTextureHeap(
 		device,
-		texture_descriptor_pool,
-		texture_descriptor_set_layout,
-		1
+		physical_device,
+		1024,                                                           // How many textures it can hold
+		VK_SHADER_STAGE_FRAGMENT_BIT,                                   // Only the fragment shader samples them
+		texture_heap
 	);
 
 
 
 
-	camera_buffer.buffer_size = sizeof(SCamera);
-	camera_buffer.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
-	camera_buffer.sharing_mode = VK_SHARING_MODE_EXCLUSIVE;
-	camera_buffer.buffer_memory_properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-
-	// Create a temp buffer to store the image in before we transfer it over to the image
-	VkHelper::CreateBuffer(
-		device,								   // What device are we going to use to create the buffer
-		physical_device_mem_properties,		   // What memory properties are available on the device
-		camera_buffer.buffer,                  // What buffer are we going to be creating
-		camera_buffer.buffer_memory,           // The output for the buffer memory
-		camera_buffer.buffer_size,             // How much memory we wish to allocate on the GPU
-		camera_buffer.usage,                   // What type of buffer do we want. Buffers can have multiple types, for example, uniform & vertex buffer.
-											   // for now we want to keep the buffer specialized to one type as this will allow vulkan to optimize the data.
-		camera_buffer.sharing_mode,            // There are two modes, exclusive and concurrent. Defines if it can concurrently be used by multiple queue
-											   // families at the same time
-		camera_buffer.buffer_memory_properties // What properties do we require of our memory
-	);
-
-	// Get the pointer to the GPU memory
-	VkResult mapped_memory_result = vkMapMemory(
-		device,                                        // The device that the memory is on
-		camera_buffer.buffer_memory,                   // The device memory instance
-		0,                                             // Offset from the memory starts that we are accessing
-		camera_buffer.buffer_size,                     // How much memory are we accessing
-		0,                                             // Flags (we don't need this for basic buffers)
-		&camera_buffer.mapped_buffer_memory            // The return for the memory pointer
+	// Create the ring buffer the camera will be pushed into every frame
+	VkHelper::CreateRingBuffer(
+		device,                                // What device are we going to use to create the buffer
+		allocator,                             // What allocator are we getting the memory from
+		physical_device_properties,            // Used to find the dynamic offset alignment
+		64 * 1024,                             // How much data can each frame push
+		swapchain_image_count,                 // One region for each image, the command buffers are recorded per image
+		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,    // The ranges will be bound as dynamic uniform buffers
+		uniform_buffer                         // The output ring buffer
 	);
 
-	// Could we map the GPU memory to our CPU accessible pointer
-	assert(mapped_memory_result == VK_SUCCESS);
-
 
 
 	BuildCamera();
 	
 
 
-	// Define how many descriptor pools we will need
-	const uint32_t camera_descriptor_pool_size_count = 1;
-
-	// Define that the new descriptor pool will be taking a combined image sampler
-	VkDescriptorPoolSize camera_pool_size[camera_descriptor_pool_size_count] = {
-		VkHelper::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1)
-	};
-
-
-	// Create the new descriptor pool with the defined settings
-	camera_descriptor_pool = VkHelper::CreateDescriptorPool(
+	// Create the descriptor allocator, pools are made the first time a set is allocated from it
+	std::vector<VkHelper::DescriptorPoolRatio> descriptor_pool_ratios = VkHelper::DefaultDescriptorPoolRatios();
+	VkHelper::CreateDescriptorAllocator(
 		device,
-		camera_pool_size,
-		camera_descriptor_pool_size_count,
-		1															// How many descriptor sets do will we need
-																	// Since we are only rendering one image, just 1
+		descriptor_pool_ratios.data(),
+		static_cast<uint32_t>(descriptor_pool_ratios.size()),
+		16,                                                             // How many sets the first pool holds, later pools are larger
+		0,                                                              // The sets are freed together when the allocator is destroyed
+		descriptor_allocator
 	);
 
+	// Define how many bindings the camera set has, the camera and the material table
+	const uint32_t camera_descriptor_binding_count = 2;
+
 	// Define at what stage of the rendering pipeline the texture is coming into as well as what shader and what location
-	VkDescriptorSetLayoutBinding camera_layout_bindings[camera_descriptor_pool_size_count] = {
-		VkHelper::DescriptorSetLayoutBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT)
+	VkDescriptorSetLayoutBinding camera_layout_bindings[camera_descriptor_binding_count] = {
+		VkHelper::DescriptorSetLayoutBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1, VK_SHADER_STAGE_VERTEX_BIT),
+		// The material table, written once the models have been loaded
+		VkHelper::DescriptorSetLayoutBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_FRAGMENT_BIT)
 	};
 
 
@@ -570,26 +681,26 @@ void Setup()
 	camera_descriptor_set_layout = VkHelper::CreateDescriptorSetLayout(
 		device,
 		camera_layout_bindings,
-		camera_descriptor_pool_size_count
+		camera_descriptor_binding_count
 	);
 
-	// Allocate a new texture descriptor set from the pool
-	camera_descriptor_set = VkHelper::AllocateDescriptorSet(
-		device,
-		camera_descriptor_pool,
+	// Allocate the camera descriptor set, the allocator finds it a pool with room
+	bool camera_set_allocated = VkHelper::AllocateDescriptorSet(
+		descriptor_allocator,
 		camera_descriptor_set_layout,
-		1
+		camera_descriptor_set
 	);
+	assert(camera_set_allocated);
 
 
 
 	VkDescriptorBufferInfo descriptorImageInfo = VkHelper::DescriptorBufferInfo(
-		camera_buffer.buffer,
-		camera_buffer.buffer_size,
-		0
+		uniform_buffer.buffer,
+		sizeof(SCamera),
+		0                                      // The images region is selected with a dynamic offset when binding
 	);
 
-	VkWriteDescriptorSet descriptorWrite = VkHelper::WriteDescriptorSet(camera_descriptor_set,VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, descriptorImageInfo, 0);
+	VkWriteDescriptorSet descriptorWrite = VkHelper::WriteDescriptorSet(camera_descriptor_set, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, descriptorImageInfo, 0);
 
 	// Update the descriptor with the texture data
 	vkUpdateDescriptorSets(
@@ -617,25 +728,11 @@ void Destroy()
 	DestroyRenderResources();
 
 
-	// Clean up descriptor set layout
-	vkDestroyDescriptorSetLayout(
-		device,
-		texture_descriptor_set_layout,
-		nullptr
-	);
-
-	// Clean up descriptor pool
-	vkDestroyDescriptorPool(
-		device,
-		texture_descriptor_pool,
-		nullptr
-	);
+	// Clean up the texture heap, the textures in it have already been destroyed
+	VkHelper::DestroyTextureHeap(texture_heap);
 
-	vkDestroyDescriptorPool(
-		device,
-		camera_descriptor_pool,
-		nullptr
-	);
+	// Destroying the allocators pools frees every set that came from them
+	VkHelper::DestroyDescriptorAllocator(descriptor_allocator);
 
 	vkDestroyDescriptorSetLayout(
 		device,
@@ -645,68 +742,49 @@ void Destroy()
 
 
 
-	// Now we unmap the data
-	vkUnmapMemory(
-		device,
-		particle_vertex_buffer_memory
-	);
-
-	// Clean up the buffer data
-	vkDestroyBuffer(
+	// Clean up the buffer and give its memory back to the allocator
+	VkHelper::DestroyBuffer(
 		device,
+		allocator,
 		particle_vertex_buffer,
-		nullptr
-	);
-
-	// Free the memory that was allocated for the buffer
-	vkFreeMemory(
-		device,
-		particle_vertex_buffer_memory,
-		nullptr
+		particle_vertex_buffer_allocation
 	);
 
 
-	// Now we unmap the data
-	vkUnmapMemory(
-		device,
-		index_buffer_memory
-	);
-
-	// Clean up the buffer data
-	vkDestroyBuffer(
+	// Clean up the buffer and give its memory back to the allocator
+	VkHelper::DestroyBuffer(
 		device,
+		allocator,
 		index_buffer,
-		nullptr
+		index_buffer_allocation
 	);
 
-	// Free the memory that was allocated for the buffer
-	vkFreeMemory(
+	VkHelper::DestroyFrameLoop(
 		device,
-		index_buffer_memory,
-		nullptr
+		command_pool,
+		frame_loop
 	);
 
-	for (uint32_t i = 0; i < swapchain_image_count; i++)
-	{
-		vkDestroyFence(
-			device,
-			fences.get()[i],
-			nullptr
-		);
-	}
+	// Stop the recording threads and free their command pools
+	VkHelper::DestroyCommandRecorder(command_recorder);
 
-	vkDestroySemaphore(
+	VkHelper::DestroyFrameCommands(
 		device,
-		image_available_semaphore,
-		nullptr
+		frame_commands
 	);
 
-	vkDestroySemaphore(
+
+	VkHelper::DestroyMipmapGenerator(mipmap_generator);
+
+	// Clean up the uniform ring buffer
+	VkHelper::DestroyRingBuffer(
 		device,
-		render_finished_semaphore,
-		nullptr
+		allocator,
+		uniform_buffer
 	);
 
+	// Now all buffers and images are gone, give the allocators blocks back
+	VkHelper::DestroyAllocator(allocator);
 
 	// Clean up the command pool
 	vkDestroyCommandPool(
@@ -715,6 +793,15 @@ void Destroy()
 		nullptr
 	);
 
+	// Write the pipeline cache out so the next run can skip compiling the shaders
+	VkHelper::DestroyPipelineCache(device);
+
+	// Any samplers the textures and attachments didn't give back are still held by the cache, they go before the device
+	VkHelper::DestroySamplerCache(device);
+
+	// The device is going away, free its dispatch table so a later device given the same handle loads its own
+	VkHelper::UnregisterDeviceDispatch(device);
+
 	// Clean up the device now that the project is stopping
 	vkDestroyDevice(
 		device,
@@ -723,10 +810,13 @@ void Destroy()
 
 	// Destroy the debug callback
 	// We cant directly call vkDestroyDebugReportCallbackEXT as we need to find the pointer within the Vulkan DLL, See function implementation for details.
-	VkHelper::DestroyDebugger(
-		instance, 
-		debugger
-	);
+	if (!headless.enabled)
+	{
+		VkHelper::DestroyDebugger(
+			instance, 
+			debugger
+		);
+	}
 
 	// Clean up the vulkan instance
 	vkDestroyInstance(
@@ -734,13 +824,14 @@ void Destroy()
 		NULL
 	);
 
-	DestroyWindow();
+	if (!headless.enabled) DestroyWindow();
 }
 
 void CreateGraphicsPipeline()
 {
+	VK_HELPER_CPU_ZONE("CreateGraphicsPipeline");
 
-	const uint32_t vertex_input_attribute_description_count = 4;
+	const uint32_t vertex_input_attribute_description_count = 5;
 	std::unique_ptr<VkVertexInputAttributeDescription> vertex_input_attribute_descriptions =
 		std::unique_ptr<VkVertexInputAttributeDescription>(new VkVertexInputAttributeDescription[vertex_input_attribute_description_count]);
 
@@ -768,6 +859,12 @@ void CreateGraphicsPipeline()
 	vertex_input_attribute_descriptions.get()[3].format = VK_FORMAT_R32G32_SFLOAT;	    	// What format is the data coming in as
 	vertex_input_attribute_descriptions.get()[3].offset = offsetof(SVertexData, texCoord);	// Within the whole structure of the data packet, where dose it start in memory
 
+	// Used to store the material of the vertex, the fragment shader looks its textures up in the material table
+	vertex_input_attribute_descriptions.get()[4].binding = 0;								// What vertex input binding are we talking about
+	vertex_input_attribute_descriptions.get()[4].location = 4;								// Inside the binding what is its location id
+	vertex_input_attribute_descriptions.get()[4].format = VK_FORMAT_R32_UINT;				// What format is the data coming in as
+	vertex_input_attribute_descriptions.get()[4].offset = offsetof(SVertexData, matID);		// Within the whole structure of the data packet, where dose it start in memory
+
 
 
 
@@ -803,7 +900,7 @@ void CreateGraphicsPipeline()
 
 	VkDescriptorSetLayout descriptor_set_layout[descriptor_set_layout_count] = {
 		camera_descriptor_set_layout,
-		texture_descriptor_set_layout
+		texture_heap.descriptor_set_layout
 	};
 
 	graphics_pipeline = VkHelper::CreateGraphicsPipeline(
@@ -829,19 +926,40 @@ void CreateGraphicsPipeline()
 
 void CreateRenderResources()
 {
-	swap_chain = VkHelper::CreateSwapchain(
-		physical_device,
-		device,
-		surface,
-		surface_capabilities,
-		surface_format,
-		present_mode,
-		window_width,
-		window_height,
-		swapchain_image_count,
-		swapchain_images,
-		swapchain_image_views
-	);
+	if (headless.enabled)
+	{
+		// Three images, the same as a triple buffered swapchain
+		surface_format.format = VK_FORMAT_B8G8R8A8_UNORM;
+		swap_chain = VK_NULL_HANDLE;
+		VkHelper::CreateHeadlessSwapchain(
+			device,
+			physical_device_mem_properties,
+			surface_format.format,
+			window_width,
+			window_height,
+			3,
+			headless_swapchain,
+			swapchain_image_count,
+			swapchain_images,
+			swapchain_image_views
+		);
+	}
+	else
+	{
+		swap_chain = VkHelper::CreateSwapchain(
+			physical_device,
+			device,
+			surface,
+			surface_capabilities,
+			surface_format,
+			present_mode,
+			window_width,
+			window_height,
+			swapchain_image_count,
+			swapchain_images,
+			swapchain_image_views
+		);
+	}
 
 
 	const VkFormat colorFormat = VK_FORMAT_R8G8B8A8_UNORM;
@@ -887,8 +1005,165 @@ void DestroyGraphicsPipeline()
 	}
 }
 
+// Create a texture from a KTX2 file, its mip levels are copied to the GPU as they are
+STexture CreateTexture(const VkHelper::KtxTexture& ktx_texture)
+{
+	STexture texture;
+	texture.width = ktx_texture.width;
+	texture.height = ktx_texture.height;
+	texture.mip_levels = static_cast<uint32_t>(ktx_texture.levels.size());
+	texture.format = ktx_texture.format;
+	texture.layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+	// The whole file goes into the transfer buffer, the levels are already aligned to their block size inside it
+	texture.transfer_buffer.buffer_size = static_cast<VkDeviceSize>(ktx_texture.data.size());
+	texture.transfer_buffer.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	texture.transfer_buffer.sharing_mode = VK_SHARING_MODE_EXCLUSIVE;
+	texture.transfer_buffer.buffer_memory_properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+	VkHelper::CreateBuffer(
+		device,
+		allocator,
+		texture.transfer_buffer.buffer,
+		texture.transfer_buffer.allocation,
+		texture.transfer_buffer.buffer_size,
+		texture.transfer_buffer.usage,
+		texture.transfer_buffer.sharing_mode,
+		texture.transfer_buffer.buffer_memory_properties
+	);
+
+	// The allocator keeps host visible blocks mapped, so we can just take the pointer
+	texture.transfer_buffer.mapped_buffer_memory = texture.transfer_buffer.allocation.mapped_memory;
+
+	memcpy(
+		texture.transfer_buffer.mapped_buffer_memory,
+		ktx_texture.data.data(),
+		ktx_texture.data.size()
+	);
+
+	VkHelper::CreateImage(
+		device,
+		allocator,
+		texture.width,
+		texture.height,
+		texture.format,
+		VK_IMAGE_TILING_OPTIMAL,
+		VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		texture.image,
+		texture.allocation,
+		VK_IMAGE_LAYOUT_UNDEFINED,
+		texture.mip_levels
+	);
+
+	VkCommandBuffer copy_cmd = VkHelper::BeginSingleTimeCommands(device, command_pool);
+
+	// Every level is copied into at once
+	VkImageSubresourceRange subresourceRange = {};
+	subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	subresourceRange.baseMipLevel = 0;
+	subresourceRange.levelCount = texture.mip_levels;
+	subresourceRange.layerCount = 1;
+
+	VkHelper::SetImageLayout(
+		copy_cmd,
+		texture.image,
+		VK_IMAGE_LAYOUT_UNDEFINED,
+		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		subresourceRange
+	);
+
+	// One copy region per level, each reading from where the level sits in the file
+	std::vector<VkBufferImageCopy> buffer_copy_regions(texture.mip_levels);
+	for (uint32_t level = 0; level < texture.mip_levels; level++)
+	{
+		VkBufferImageCopy& region = buffer_copy_regions[level];
+		region = {};
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.mipLevel = level;
+		region.imageSubresource.baseArrayLayer = 0;
+		region.imageSubresource.layerCount = 1;
+		region.imageExtent.width = ktx_texture.levels[level].width;
+		region.imageExtent.height = ktx_texture.levels[level].height;
+		region.imageExtent.depth = 1;
+		region.bufferOffset = ktx_texture.levels[level].offset;
+	}
+
+	vkCmdCopyBufferToImage(
+		copy_cmd,
+		texture.transfer_buffer.buffer,
+		texture.image,
+		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		texture.mip_levels,
+		buffer_copy_regions.data()
+	);
+
+	VkHelper::SetImageLayout(
+		copy_cmd,
+		texture.image,
+		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		texture.layout,
+		subresourceRange
+	);
+
+	VkHelper::EndSingleTimeCommands(
+		device,
+		graphics_queue,
+		copy_cmd,
+		command_pool
+	);
+
+	vkFreeCommandBuffers(
+		device,
+		command_pool,
+		1,
+		&copy_cmd
+	);
+
+	// The copy has finished, so the buffer is no longer needed and its memory can go back to the allocator
+	VkHelper::DestroyBuffer(
+		device,
+		allocator,
+		texture.transfer_buffer.buffer,
+		texture.transfer_buffer.allocation
+	);
+
+	VkHelper::CreateImageSampler(
+		device,
+		texture.image,
+		texture.format,
+		texture.view,
+		texture.sampler,
+		texture.mip_levels
+	);
+
+	// Put the texture in the bindless heap, materials reference it by this index
+	texture.heap_index = VkHelper::AddHeapTexture(
+		texture_heap,
+		texture.sampler,
+		texture.view,
+		texture.layout
+	);
+
+	return texture;
+}
+
 STexture CreateTexture(const char* path)
 {
+	VK_HELPER_CPU_ZONE("CreateTexture");
+	// Prefer the block compressed copy made by the KtxEncoder tool. It sits next to the png with a .ktx2 extension
+	// and already has every mip level, so there is nothing to decode or generate at startup
+	std::string ktx_path = path;
+	ktx_path = ktx_path.substr(0, ktx_path.find_last_of('.')) + ".ktx2";
+
+	VkHelper::KtxTexture ktx_texture;
+	if (VkHelper::LoadKtx2(ktx_path.c_str(), ktx_texture) && VkHelper::SupportsSampledFormat(physical_device, ktx_texture.format))
+	{
+		std::cout << "Loaded " << ktx_path << std::endl;
+		return CreateTexture(ktx_texture);
+	}
+
+	// There is no usable KTX2 file, so fall back to the png
 	STexture texture;
 	// Used to store the raw image data
 	std::vector<unsigned char> image_data;
@@ -919,9 +1194,9 @@ STexture CreateTexture(const char* path)
 	// Create a temp buffer to store the image in before we transfer it over to the image
 	VkHelper::CreateBuffer(
 		device,											 // What device are we going to use to create the buffer
-		physical_device_mem_properties,					 // What memory properties are available on the device
+		allocator,										 // What allocator are we getting the memory from
 		texture.transfer_buffer.buffer,                  // What buffer are we going to be creating
-		texture.transfer_buffer.buffer_memory,           // The output for the buffer memory
+		texture.transfer_buffer.allocation,              // The output for the buffer allocation
 		texture.transfer_buffer.buffer_size,             // How much memory we wish to allocate on the GPU
 		texture.transfer_buffer.usage,                   // What type of buffer do we want. Buffers can have multiple types, for example, uniform & vertex buffer.
 														 // for now we want to keep the buffer specialized to one type as this will allow vulkan to optimize the data.
@@ -930,18 +1205,8 @@ STexture CreateTexture(const char* path)
 		texture.transfer_buffer.buffer_memory_properties // What properties do we require of our memory
 	);
 
-	// Get the pointer to the GPU memory
-	VkResult mapped_memory_result = vkMapMemory(
-		device,                                                  // The device that the memory is on
-		texture.transfer_buffer.buffer_memory,                   // The device memory instance
-		0,                                                       // Offset from the memory starts that we are accessing
-		texture.transfer_buffer.buffer_size,                     // How much memory are we accessing
-		0,                                                       // Flags (we don't need this for basic buffers)
-		&texture.transfer_buffer.mapped_buffer_memory            // The return for the memory pointer
-	);
-
-	// Could we map the GPU memory to our CPU accessible pointer
-	assert(mapped_memory_result == VK_SUCCESS);
+	// The allocator keeps host visible blocks mapped, so we can just take the pointer
+	texture.transfer_buffer.mapped_buffer_memory = texture.transfer_buffer.allocation.mapped_memory;
 
 
 	// Transfer data over to the texture buffer
@@ -952,32 +1217,29 @@ STexture CreateTexture(const char* path)
 	);
 
 
-	// Now that the texture data is on the graphics card, we can unmap it
-	vkUnmapMemory(
-		device,
-		texture.transfer_buffer.buffer_memory
-	);
-
 
 
 	texture.layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;		// Define that the the image is read only
 																	// This makes image reads from the shader faster
 	texture.format = VK_FORMAT_R8G8B8A8_UNORM;						// What is the format of the image, in this case, 4 bytes RGBA
+	texture.mip_levels = VkHelper::MipLevelCount(texture.width, texture.height);	// Generate every level down to 1x1
 
 
 	// Create the image we will be rendering
 	VkHelper::CreateImage(
 		device,
-		physical_device_mem_properties,
+		allocator,
 		texture.width,
 		texture.height,
 		texture.format,
 		VK_IMAGE_TILING_OPTIMAL,
-		VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+		VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT |
+		VkHelper::MipmapImageUsage(mipmap_generator, texture.format),	// Blits need the image to be a transfer source, the compute fallback needs storage
 		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 		texture.image,
-		texture.memory,
-		VK_IMAGE_LAYOUT_UNDEFINED										// Here we define the initial layout, later we change its layout to VK_FORMAT_R8G8B8A8_UNORM
+		texture.allocation,
+		VK_IMAGE_LAYOUT_UNDEFINED,										// Here we define the initial layout, later we change its layout to VK_FORMAT_R8G8B8A8_UNORM
+		texture.mip_levels
 	);
 
 
@@ -994,7 +1256,7 @@ STexture CreateTexture(const char* path)
 	subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 	// Start at first mip level
 	subresourceRange.baseMipLevel = 0;
-	// We will transition on all mip levels
+	// Only the first level is copied into, the rest are generated from it
 	subresourceRange.levelCount = 1;
 	// The 2D texture only has one layer
 	subresourceRange.layerCount = 1;
@@ -1033,21 +1295,19 @@ STexture CreateTexture(const char* path)
 
 
 
-	// Now the data is mapped to the texture, we no longer need the buffer
-	vkDestroyBuffer(
-		device,
-		texture.transfer_buffer.buffer,
-		nullptr
-	);
-
-	// Now change the images layout from VK_IMAGE_LAYOUT_UNDEFINED to VK_FORMAT_R8G8B8A8_UNORM
-	VkHelper::SetImageLayout(
+	// Downsample the first level into the rest of the chain, every level is left in texture.layout
+	VkHelper::RecordGenerateMipmaps(
+		mipmap_generator,
 		copy_cmd,
 		texture.image,
-		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-		texture.layout,							// Set to VK_FORMAT_R8G8B8A8_UNORM
-		subresourceRange
-	);
+		texture.format,
+		texture.width,
+		texture.height,
+		texture.mip_levels,                     // How many levels the image has
+		texture.layout,                         // What layout should every level be left in
+		VK_ACCESS_SHADER_READ_BIT,              // How will the image be used afterwards
+		VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT
+	);
 
 	// Finish the new command and run it
 	VkHelper::EndSingleTimeCommands(
@@ -1057,6 +1317,9 @@ STexture CreateTexture(const char* path)
 		command_pool
 	);
 
+	// EndSingleTimeCommands waited for the GPU, so the compute fallbacks views and descriptors can go
+	VkHelper::ReleaseMipmapResources(mipmap_generator);
+
 	// Clean up after the command buffer
 	vkFreeCommandBuffers(
 		device,
@@ -1065,6 +1328,14 @@ STexture CreateTexture(const char* path)
 		&copy_cmd
 	);
 
+	// Now the data has been copied into the texture, we no longer need the buffer
+	VkHelper::DestroyBuffer(
+		device,
+		allocator,
+		texture.transfer_buffer.buffer,
+		texture.transfer_buffer.allocation
+	);
+
 
 	// Create a new image sampler, this will allow the shaders to sample the texture
 	VkHelper::CreateImageSampler(
@@ -1072,7 +1343,16 @@ STexture CreateTexture(const char* path)
 		texture.image,
 		texture.format,
 		texture.view,
-		texture.sampler
+		texture.sampler,
+		texture.mip_levels
+	);
+
+	// Put the texture in the bindless heap, materials reference it by this index
+	texture.heap_index = VkHelper::AddHeapTexture(
+		texture_heap,
+		texture.sampler,
+		texture.view,
+		texture.layout
 	);
 
 	return texture;
@@ -1080,75 +1360,212 @@ STexture CreateTexture(const char* path)
 
 void DestroyTexture(STexture& texture)
 {
-	// Free the memory that was allocated for the buffer
-	vkFreeMemory(
-		device,
-		texture.transfer_buffer.buffer_memory,
-		nullptr
+	// Free up the textures slot in the heap
+	VkHelper::RemoveHeapTexture(
+		texture_heap,
+		texture.heap_index
 	);
 
 	// Destroy the image sampler now that we are done with that
-	vkDestroySampler(
+	VkHelper::ReleaseSampler(
 		device,
-		texture.sampler,
-		nullptr
+		texture.sampler
 	);
 
-	// Destroy the image we are displaying
-	vkDestroyImage(
+	// Destroy the image we are displaying and give its memory back to the allocator
+	VkHelper::DestroyImage(
 		device,
+		allocator,
 		texture.image,
-		nullptr
+		texture.allocation
 	);
 }
 
-void SetAlbedoTexture(STexture& texture)
+// Copy the material table to the GPU and point the camera sets material binding at it. The fragment shader uses the
+// vertices matID to find its material, and the material holds the heap index of each of its textures
+void CreateMaterialBuffer()
 {
-	VkDescriptorImageInfo descriptorImageInfo = VkHelper::DescriptorImageInfo(
-		texture.sampler,
-		texture.view,
-		texture.layout
+	// A zero sized buffer can't be created, and the shader always reads a material, so make sure there is one
+	if (materials.empty())
+	{
+		SMaterial material;
+		material.albedo_texture = 0;                                     // The first texture in the heap
+		materials.push_back(material);
+	}
+
+	material_buffer.buffer_size = static_cast<unsigned int>(sizeof(SMaterial) * materials.size());
+	material_buffer.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+	material_buffer.sharing_mode = VK_SHARING_MODE_EXCLUSIVE;
+	material_buffer.buffer_memory_properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+	VkHelper::CreateBuffer(
+		device,									// What device are we going to use to create the buffer
+		allocator,								// What allocator are we getting the memory from
+		material_buffer.buffer,					// What buffer are we going to be creating
+		material_buffer.allocation,				// The output for the buffer allocation
+		material_buffer.buffer_size,			// How much memory we wish to allocate on the GPU
+		material_buffer.usage,					// The fragment shader reads it as a storage buffer
+		material_buffer.sharing_mode,			// There are two modes, exclusive and concurrent. Defines if it can concurrently be used by multiple queue
+												// families at the same time
+		material_buffer.buffer_memory_properties	// Small and only written once, so just write it directly
 	);
 
-	VkWriteDescriptorSet descriptorWrite = VkHelper::WriteDescriptorSet(texture_descriptor_set, descriptorImageInfo, 0);
+	// The allocator keeps host visible blocks mapped, so we can just take the pointer
+	material_buffer.mapped_buffer_memory = material_buffer.allocation.mapped_memory;
+
+	memcpy(
+		material_buffer.mapped_buffer_memory,          // The destination for our memory (GPU)
+		materials.data(),                              // Source for the memory (CPU-Ram)
+		material_buffer.buffer_size                    // How much data we are transferring
+	);
+
+	VkDescriptorBufferInfo descriptor_buffer_info = VkHelper::DescriptorBufferInfo(
+		material_buffer.buffer,
+		material_buffer.buffer_size,
+		0
+	);
+
+	VkWriteDescriptorSet descriptor_write = VkHelper::WriteDescriptorSet(camera_descriptor_set, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, descriptor_buffer_info, 1);
 
-	// Update the descriptor with the texture data
 	vkUpdateDescriptorSets(
 		device,
 		1,
-		&descriptorWrite,
+		&descriptor_write,
 		0,
 		NULL
 	);
 }
 
-void CreateModel(const char* path, ModelInstance& model_instance)
+void DestroyMaterialBuffer()
 {
+	// Clean up the buffer and give its memory back to the allocator
+	VkHelper::DestroyBuffer(
+		device,
+		allocator,
+		material_buffer.buffer,
+		material_buffer.allocation
+	);
+}
+
+// default_albedo is the heap index used for materials that don't have an albedo texture of their own
+void CreateModel(const char* path, ModelInstance& model_instance, uint32_t default_albedo)
+{
+	VK_HELPER_CPU_ZONE("CreateModel");
+	std::chrono::high_resolution_clock::time_point load_start = std::chrono::high_resolution_clock::now();
+
+	// A binary copy of the model is kept next to the .obj. Once it exists the model is mapped straight
+	// from the file and copied to the GPU, without parsing the .obj again
+	std::string cache_path = std::string(path) + ".meshcache";
+
+	VkHelper::MeshCache mesh_cache;
+	bool loaded_from_cache = VkHelper::OpenMeshCache(
+		cache_path.c_str(),
+		path,                                                               // The cache is thrown away if this file has changed
+		sizeof(SVertexData),                                                // Or if it was written with a different vertex layout
+		sizeof(MatrialObj),                                                 // Or material layout
+		mesh_cache
+	);
 
 	ObjLoader<SVertexData> loader;
-	loader.loadModel(path);
+	const void* vertices = nullptr;
+	const uint32_t* indices = nullptr;
+	uint32_t model_material_count = 0;
+	VkHelper::MeshBounds bounds;
+
+	if (loaded_from_cache)
+	{
+		model_instance.vertex_count = mesh_cache.header->vertex_count;
+		model_instance.index_count = mesh_cache.header->index_count;
+		vertices = mesh_cache.vertices;
+		indices = mesh_cache.indices;
+		model_material_count = mesh_cache.header->material_count;
+		bounds = mesh_cache.header->bounds;
+	}
+	else
+	{
+		// Merge the vertices that are shared between triangles so the index buffer can reuse them
+		loader.loadModel(path, true);
+		std::cout << path << ": " << loader.m_sourceVertexCount << " vertices before deduplication, " << loader.m_vertices.size() << " after" << std::endl;
+
+		model_instance.vertex_count = loader.m_vertices.size();
+		model_instance.index_count = loader.m_indices.size();
+		vertices = loader.m_vertices.data();
+		indices = loader.m_indices.data();
+		model_material_count = static_cast<uint32_t>(loader.m_materials.size());
+		bounds = VkHelper::ComputeMeshBounds(
+			vertices,
+			model_instance.vertex_count,
+			sizeof(SVertexData),
+			offsetof(SVertexData, pos)                                      // Where the position is within the vertex
+		);
+
+		// Save the model for the next run
+		bool cache_written = VkHelper::WriteMeshCache(
+			cache_path.c_str(),
+			path,
+			vertices,
+			model_instance.vertex_count,
+			sizeof(SVertexData),
+			indices,
+			model_instance.index_count,
+			loader.m_materials.data(),
+			static_cast<uint32_t>(loader.m_materials.size()),
+			sizeof(MatrialObj),
+			bounds
+		);
+		if (!cache_written)
+		{
+			std::cout << "Failed to write mesh cache " << cache_path << std::endl;
+		}
+	}
 
 	model_instance.vertex_offset = used_verticies;
 	model_instance.index_offset = used_index;
-	model_instance.vertex_count = loader.m_vertices.size();
-	model_instance.index_count = loader.m_indices.size();
-
 
 
 	// First we copy the example data to the GPU
 	memcpy(
 		index_mapped_buffer_memory,                                         // The destination for our memory (GPU)
-		loader.m_indices.data(),                                            // Source for the memory (CPU-Ram)
+		indices,                                                            // Source for the memory (CPU-Ram or the mapped cache file)
 		model_instance.index_count * sizeof(uint32_t)                       // How much data we are transferring
 	);
 
 	// First we copy the example data to the GPU
 	memcpy(
 		particle_vertex_mapped_buffer_memory,                                         // The destination for our memory (GPU)
-		loader.m_vertices.data(),                                            // Source for the memory (CPU-Ram)
+		vertices,                                                            // Source for the memory (CPU-Ram or the mapped cache file)
 		model_instance.vertex_count * sizeof(SVertexData)                     // How much data we are transferring
 	);
 
+	// Add the models materials to the material table. The models own textures are not loaded, so every material
+	// samples the albedo we were given
+	model_instance.material_offset = static_cast<unsigned int>(materials.size());
+	// A model without any materials still has matIDs of 0, so it gets one material for them to point at
+	uint32_t material_count = std::max(model_material_count, 1u);
+	for (uint32_t i = 0; i < material_count; i++)
+	{
+		SMaterial material;
+		material.albedo_texture = default_albedo;
+		materials.push_back(material);
+	}
+
+	// The matIDs in the model start from 0, move them along to where the models materials sit in the table
+	if (model_instance.material_offset > 0)
+	{
+		SVertexData* gpu_vertices = static_cast<SVertexData*>(particle_vertex_mapped_buffer_memory);
+		for (unsigned int i = 0; i < model_instance.vertex_count; i++)
+		{
+			gpu_vertices[i].matID += model_instance.material_offset;
+		}
+	}
+
+	// The data has been copied, so the file can be unmapped
+	VkHelper::CloseMeshCache(mesh_cache);
+
+	std::chrono::high_resolution_clock::time_point load_end = std::chrono::high_resolution_clock::now();
+	std::cout << "Loaded " << path << " from " << (loaded_from_cache ? "the mesh cache" : "the .obj") << " in "
+		<< std::chrono::duration_cast<std::chrono::microseconds>(load_end - load_start).count() / 1000.0f << "ms" << std::endl;
+
 
 	used_verticies += model_instance.vertex_count;
 	used_index += model_instance.index_count;
@@ -1162,11 +1579,21 @@ void DestroyRenderResources()
 		nullptr
 	);
 
-	vkDestroySwapchainKHR(
-		device,
-		swap_chain,
-		nullptr
-	);
+	if (headless.enabled)
+	{
+		VkHelper::DestroyHeadlessSwapchain(
+			device,
+			headless_swapchain
+		);
+	}
+	else
+	{
+		vkDestroySwapchainKHR(
+			device,
+			swap_chain,
+			nullptr
+		);
+	}
 
 	for (uint32_t i = 0; i < swapchain_image_count; i++)
 	{
@@ -1198,10 +1625,9 @@ void DestroyRenderResources()
 			framebuffer_attachments.get()[i].color.memory,
 			nullptr
 		);
-		vkDestroySampler(
+		VkHelper::ReleaseSampler(
 			device,
-			framebuffer_attachments.get()[i].color.sampler,
-			nullptr
+			framebuffer_attachments.get()[i].color.sampler
 		);
 		vkDestroyImageView(
 			device,
@@ -1218,53 +1644,295 @@ void DestroyRenderResources()
 			framebuffer_attachments.get()[i].depth.memory,
 			nullptr
 		);
-		vkDestroySampler(
+		VkHelper::ReleaseSampler(
 			device,
-			framebuffer_attachments.get()[i].depth.sampler,
-			nullptr
+			framebuffer_attachments.get()[i].depth.sampler
 		);
 	}
 }
 
 void RebuildRenderResources()
 {
-	// Wait for the device to finish
-	VkResult device_idle_result = vkDeviceWaitIdle(device);
-	assert(device_idle_result == VK_SUCCESS);
-	// Destroy and rebuild the render resources
-	DestroyRenderResources();
-	CreateRenderResources();
-	BuildCommandBuffers(graphics_command_buffers, swapchain_image_count);
+	// Only the window can go out of date, the headless images stay the same size
+	assert(!headless.enabled);
+
+	// Frames that are still in flight are rendering with the old swapchain and framebuffers, so hand them over to the
+	// frame loop to destroy once those frames are done, rather than waiting for the device to go idle
+	VkSwapchainKHR old_swap_chain = swap_chain;
+	uint32_t old_swapchain_image_count = swapchain_image_count;
+	VkImageView* old_swapchain_image_views = swapchain_image_views.release();
+	VkFramebuffer* old_framebuffers = framebuffers.release();
+	VkHelper::VulkanAttachments* old_framebuffer_attachments = framebuffer_attachments.release();
+	VkFormat old_surface_format = surface_format.format;
+
+	// Passing the old swapchain lets the presentation engine hand its resources over to the new one
+	swap_chain = VkHelper::CreateSwapchain(
+		physical_device,
+		device,
+		surface,
+		surface_capabilities,
+		surface_format,
+		present_mode,
+		window_width,
+		window_height,
+		swapchain_image_count,
+		swapchain_images,
+		swapchain_image_views,
+		old_swap_chain
+	);
+
+	VkHelper::RetireResource(frame_loop, [old_swap_chain, old_swapchain_image_count, old_swapchain_image_views, old_framebuffers, old_framebuffer_attachments]()
+	{
+		VkHelper::DestroyFramebuffers(
+			device,
+			old_swapchain_image_count,
+			old_framebuffers,
+			old_framebuffer_attachments,
+			old_swapchain_image_views
+		);
+
+		// The old swapchain has been retired by the new one, its images can't be acquired any more
+		vkDestroySwapchainKHR(
+			device,
+			old_swap_chain,
+			nullptr
+		);
+
+		delete[] old_swapchain_image_views;
+		delete[] old_framebuffers;
+		delete[] old_framebuffer_attachments;
+	});
+
+	const VkFormat colorFormat = VK_FORMAT_R8G8B8A8_UNORM;
+
+	// There are still a few cases where the frames in flight have to finish first:
+	// - The render pass and graphics pipeline depend on the surface format, which almost never changes on a resize
+	// - The recorder has a set of pools per image, a different image count means a new recorder
+	// - Prerecording resets every images pools, and the old command buffers in flight execute secondaries from them
+	bool format_changed = surface_format.format != old_surface_format;
+	bool image_count_changed = swapchain_image_count != command_recorder.frame_count;
+	if (format_changed || image_count_changed || !dynamic_recording)
+	{
+		VkResult device_idle_result = vkDeviceWaitIdle(device);
+		assert(device_idle_result == VK_SUCCESS);
+	}
+
+	if (format_changed)
+	{
+		vkDestroyRenderPass(
+			device,
+			renderpass,
+			nullptr
+		);
+
+		renderpass = VkHelper::CreateRenderPass(
+			physical_device,
+			device,
+			surface_format.format,
+			colorFormat
+		);
+
+		DestroyGraphicsPipeline();
+		CreateGraphicsPipeline();
+	}
+
+	VkHelper::CreateFramebuffers(
+		physical_device,
+		device,
+		renderpass,
+		colorFormat,
+		swapchain_image_count,
+		physical_device_mem_properties,
+		physical_device_features,
+		physical_device_properties,
+		command_pool,
+		graphics_queue,
+		window_width,
+		window_height,
+		framebuffers,
+		framebuffer_attachments,
+		swapchain_image_views
+	);
+
+	// Each image index keeps waiting on the frame that last used it, which covers the recorder pools we keep per image index
+	VkHelper::ResetFrameLoopImages(frame_loop, swapchain_image_count);
+
+	// The recorder has a set of pools per image and there is a prerecorded command buffer per image, so remake them both
+	// for the new count. The device is idle, so nothing is using them
+	if (image_count_changed)
+	{
+		vkFreeCommandBuffers(
+			device,
+			command_pool,
+			command_recorder.frame_count,                      // The command buffers were allocated for the old image count
+			graphics_command_buffers.get()
+		);
+
+		VkHelper::DestroyCommandRecorder(command_recorder);
+		VkHelper::CreateCommandRecorder(
+			device,
+			physical_devices_queue_family,
+			swapchain_image_count,
+			0,
+			command_recorder
+		);
+
+		VkCommandBufferAllocateInfo command_buffer_allocate_info = VkHelper::CommandBufferAllocateInfo(
+			command_pool,
+			swapchain_image_count
+		);
+
+		graphics_command_buffers = std::unique_ptr<VkCommandBuffer>(new VkCommandBuffer[swapchain_image_count]);
+
+		VkResult allocate_command_buffer_resut = vkAllocateCommandBuffers(
+			device,
+			&command_buffer_allocate_info,
+			graphics_command_buffers.get()
+		);
+		assert(allocate_command_buffer_resut == VK_SUCCESS);
+
+		// The profiler has a slot per image as well. Nothing is in flight, so the old query pool can go straight away
+		VkQueryPool old_query_pool = VkHelper::GrowGpuProfiler(gpu_profiler, swapchain_image_count);
+		if (old_query_pool != VK_NULL_HANDLE)
+		{
+			vkDestroyQueryPool(
+				device,
+				old_query_pool,
+				nullptr
+			);
+		}
+
+		// The camera ring buffer has a region per image, so a larger swapchain needs a larger ring buffer
+		if (swapchain_image_count > uniform_buffer.region_count)
+		{
+			VkDeviceSize region_size = uniform_buffer.region_size;
+			VkHelper::DestroyRingBuffer(
+				device,
+				allocator,
+				uniform_buffer
+			);
+
+			VkHelper::CreateRingBuffer(
+				device,
+				allocator,
+				physical_device_properties,
+				region_size,                                       // Each frame pushes the same amount as before
+				swapchain_image_count,                             // One region for each image of the new swapchain
+				VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+				uniform_buffer
+			);
+
+			// Nothing is using the camera set either, so it can point straight at the new buffer
+			VkDescriptorBufferInfo camera_buffer_info = VkHelper::DescriptorBufferInfo(
+				uniform_buffer.buffer,
+				sizeof(SCamera),
+				0
+			);
+
+			VkWriteDescriptorSet camera_write = VkHelper::WriteDescriptorSet(camera_descriptor_set, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, camera_buffer_info, 0);
+
+			vkUpdateDescriptorSets(
+				device,
+				1,
+				&camera_write,
+				0,
+				NULL
+			);
+		}
+	}
+
+	// Dynamic recording picks the new swapchain up on the next frame, there is nothing to rebuild
+	if (!dynamic_recording) BuildCommandBuffers(graphics_command_buffers, swapchain_image_count);
 }
 
-void BuildCommandBuffers(std::unique_ptr<VkCommandBuffer>& command_buffers, const uint32_t buffer_count)
+// Record the draws from first_draw to first_draw + draw_count into a secondary command buffer. Nothing is inherited
+// from the primary apart from the render pass, so each secondary binds all of its own state
+void RecordDraws(VkCommandBuffer command_buffer, const VkViewport& viewport, const VkRect2D& scissor, uint32_t camera_dynamic_offset, uint32_t first_draw, uint32_t draw_count)
 {
-	// Define how we will start the command buffer recording
-	VkCommandBufferBeginInfo command_buffer_begin_info = VkHelper::CommandBufferBeginInfo(VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT);
+	// Set the viewport
+	device_dispatch->vkCmdSetViewport(
+		command_buffer,
+		0,
+		1,
+		&viewport
+	);
 
-	// Define the clear color of the screen
-	const float clear_color[4] = { 0.2f,0.2f,0.2f,1.0f };
+	// Set the scissor region
+	device_dispatch->vkCmdSetScissor(
+		command_buffer,
+		0,
+		1,
+		&scissor
+	);
 
-	VkClearValue clear_values[3]{};
+	// Bind the graphics pipeline
+	device_dispatch->vkCmdBindPipeline(
+		command_buffer,
+		VK_PIPELINE_BIND_POINT_GRAPHICS,
+		graphics_pipeline
+	);
 
-	// Copy over the clear color values to the clear color structure
-	std::copy(std::begin(clear_color), std::end(clear_color), std::begin(clear_values[0].color.float32)); // Present
-	std::copy(std::begin(clear_color), std::end(clear_color), std::begin(clear_values[1].color.float32)); // Color Image
-	clear_values[2].depthStencil = { 1.0f, 0 };                                                           // Depth Image
+	VkDeviceSize offsets[] = { 0 };
+	// Bind the models vertex buffer
+	device_dispatch->vkCmdBindVertexBuffers(
+		command_buffer,
+		0,
+		1,
+		&particle_vertex_buffer,
+		offsets
+	);
 
+	// Bind the position to the pipeline
+	device_dispatch->vkCmdBindDescriptorSets(
+		command_buffer,
+		VK_PIPELINE_BIND_POINT_GRAPHICS,
+		graphics_pipeline_layout,
+		0,
+		1,
+		&camera_descriptor_set,
+		1,
+		&camera_dynamic_offset                      // Where the images camera sits in the ring buffer
+	);
 
-	// Define the render pass begin code
-	VkRenderPassBeginInfo render_pass_info = VkHelper::RenderPassBeginInfo(
-		renderpass,
-		{ 0,0 },
-		{ window_width, window_height }
+	// Bind the texture heap to the pipeline. It holds every texture, so every material is drawn without rebinding anything
+	device_dispatch->vkCmdBindDescriptorSets(
+		command_buffer,
+		VK_PIPELINE_BIND_POINT_GRAPHICS,
+		graphics_pipeline_layout,
+		1,
+		1,
+		&texture_heap.descriptor_set,
+		0,
+		NULL
 	);
 
-	render_pass_info.clearValueCount = 3;
-	render_pass_info.pClearValues = clear_values;
+	for (uint32_t i = first_draw; i < first_draw + draw_count; i++)
+	{
+		const ModelInstance& model = *draw_list[i];
 
-	VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		// Bind the models index buffer
+		device_dispatch->vkCmdBindIndexBuffer(
+			command_buffer,
+			index_buffer,
+			model.index_offset,
+			VK_INDEX_TYPE_UINT32
+		);
+
+		// Draw the model
+		device_dispatch->vkCmdDrawIndexed(
+			command_buffer,
+			model.index_count,
+			1,							// Draw once model
+			0,
+			model.vertex_offset,
+			0
+		);
+	}
+}
 
+// Add the jobs that record the render pass contents of a swapchain image, the draw list is split between them
+void AddRecordJobs(uint32_t image_index, VkCommandBufferUsageFlags usage_flags, std::vector<VkHelper::SecondaryRecordJob>& record_jobs)
+{
 	// Define the size of the viewport we are rendering too
 	VkViewport viewport = VkHelper::Viewport(
 		window_width,
@@ -1283,115 +1951,139 @@ void BuildCommandBuffers(std::unique_ptr<VkCommandBuffer>& command_buffers, cons
 		0
 	);
 
+	// The camera is read from the images region of the ring buffer
+	const uint32_t camera_dynamic_offset = static_cast<uint32_t>(VkHelper::RingBufferRegionOffset(uniform_buffer, image_index));
 
-	// Loop through for the swapchain buffers
-	for (unsigned int i = 0; i < buffer_count; i++)
+	const uint32_t draw_count = static_cast<uint32_t>(draw_list.size());
+	for (uint32_t first_draw = 0; first_draw < draw_count; first_draw += draws_per_record_job)
 	{
-		// Reset the command buffers
-		VkResult reset_command_buffer_result = vkResetCommandBuffer(
-			command_buffers.get()[i],
-			0
-		);
-		assert(reset_command_buffer_result == VK_SUCCESS);
+		const uint32_t job_draw_count = std::min(draws_per_record_job, draw_count - first_draw);
+
+		VkHelper::SecondaryRecordJob job;
+		job.frame_index = image_index;
+		job.inheritance.renderPass = renderpass;                     // The secondary runs inside the render pass
+		job.inheritance.subpass = 0;
+		job.inheritance.framebuffer = framebuffers.get()[image_index]; // Optional, but lets the driver know what it is drawing to
+		job.usage_flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | usage_flags;
+		job.record = [viewport, scissor, camera_dynamic_offset, first_draw, job_draw_count](VkCommandBuffer command_buffer)
+		{
+			RecordDraws(command_buffer, viewport, scissor, camera_dynamic_offset, first_draw, job_draw_count);
+		};
+		record_jobs.push_back(job);
+	}
+}
 
-		// Define the frame buffer we want to use
-		render_pass_info.framebuffer = framebuffers.get()[i];
+// Record the render pass for a swapchain image into a primary command buffer, its contents come from the secondaries
+void RecordRenderPass(VkCommandBuffer command_buffer, uint32_t image_index, const VkCommandBuffer* secondaries, uint32_t secondary_count)
+{
+	// Define the clear color of the screen
+	const float clear_color[4] = { 0.2f,0.2f,0.2f,1.0f };
 
-		// Begin the new command buffer
-		VkResult begin_command_buffer_result = vkBeginCommandBuffer(
-			command_buffers.get()[i],
-			&command_buffer_begin_info
-		);
-		// check to see if the command buffer was created
-		assert(begin_command_buffer_result == VK_SUCCESS);
+	VkClearValue clear_values[3]{};
 
-		// Define that we will be starting a new render pass
-		vkCmdBeginRenderPass(
-			command_buffers.get()[i],
-			&render_pass_info,
-			VK_SUBPASS_CONTENTS_INLINE
-		);
+	// Copy over the clear color values to the clear color structure
+	std::copy(std::begin(clear_color), std::end(clear_color), std::begin(clear_values[0].color.float32)); // Present
+	std::copy(std::begin(clear_color), std::end(clear_color), std::begin(clear_values[1].color.float32)); // Color Image
+	clear_values[2].depthStencil = { 1.0f, 0 };                                                           // Depth Image
 
-		// Set the viewport
-		vkCmdSetViewport(
-			command_buffers.get()[i],
-			0,
-			1,
-			&viewport
-		);
 
-		// Set the scissor region
-		vkCmdSetScissor(
-			command_buffers.get()[i],
-			0,
-			1,
-			&scissor
-		);
+	// Define the render pass begin code
+	VkRenderPassBeginInfo render_pass_info = VkHelper::RenderPassBeginInfo(
+		renderpass,
+		{ 0,0 },
+		{ window_width, window_height }
+	);
 
-		// Bind the graphics pipeline
-		vkCmdBindPipeline(
-			command_buffers.get()[i],
-			VK_PIPELINE_BIND_POINT_GRAPHICS,
-			graphics_pipeline
-		);
-		
-		VkDeviceSize offsets[] = { 0 };
-		// Bind the models vertex buffer
-		vkCmdBindVertexBuffers(
-			command_buffers.get()[i],
-			0,
-			1,
-			&particle_vertex_buffer,
-			offsets
-		);
+	render_pass_info.clearValueCount = 3;
+	render_pass_info.pClearValues = clear_values;
 
-		// Bind the models index buffer
-		vkCmdBindIndexBuffer(
-			command_buffers.get()[i],
-			index_buffer,
-			pbrboy_model.index_offset,
-			VK_INDEX_TYPE_UINT32
-		);
+	// Define the frame buffer we want to use
+	render_pass_info.framebuffer = framebuffers.get()[image_index];
 
+	// The queries have to be reset outside of the render pass
+	VkHelper::ResetGpuProfilerSlot(command_buffer, gpu_profiler, image_index);
+	VkHelper::BeginGpuScope(command_buffer, gpu_profiler, image_index, draw_gpu_scope);
 
-		// Bind the position to the pipeline
-		vkCmdBindDescriptorSets(
-			command_buffers.get()[i],
-			VK_PIPELINE_BIND_POINT_GRAPHICS,
-			graphics_pipeline_layout,
-			0,
-			1,
-			&camera_descriptor_set,
-			0,
-			NULL
-		);
+	// Define that we will be starting a new render pass, its contents all come from secondary command buffers
+	device_dispatch->vkCmdBeginRenderPass(
+		command_buffer,
+		&render_pass_info,
+		VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+	);
 
-		// Bind the texture to the pipeline
-		vkCmdBindDescriptorSets(
-			command_buffers.get()[i],
-			VK_PIPELINE_BIND_POINT_GRAPHICS,
-			graphics_pipeline_layout,
-			1,
-			1,
-			&texture_descriptor_set,
-			0,
-			NULL
+	if (secondary_count > 0)
+	{
+		device_dispatch->vkCmdExecuteCommands(
+			command_buffer,
+			secondary_count,
+			secondaries
 		);
+	}
 
-		// Draw the model
-		vkCmdDrawIndexed(
+	// End the rendering
+	device_dispatch->vkCmdEndRenderPass(
+		command_buffer
+	);
+
+	VkHelper::EndGpuScope(command_buffer, gpu_profiler, image_index, draw_gpu_scope);
+}
+
+void BuildCommandBuffers(std::unique_ptr<VkCommandBuffer>& command_buffers, const uint32_t buffer_count)
+{
+	VK_HELPER_CPU_ZONE("BuildCommandBuffers");
+	// The recorder has a set of command pools per swapchain image
+	assert(buffer_count <= command_recorder.frame_count);
+
+	std::chrono::high_resolution_clock::time_point record_start = std::chrono::high_resolution_clock::now();
+
+	// Define how we will start the command buffer recording
+	VkCommandBufferBeginInfo command_buffer_begin_info = VkHelper::CommandBufferBeginInfo(VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT);
+
+	// Every swapchain image gets the same set of jobs
+	std::vector<VkHelper::SecondaryRecordJob> record_jobs;
+	for (unsigned int i = 0; i < buffer_count; i++)
+	{
+		// Nothing is in flight while the command buffers are being rebuilt, so the images pools can be reset
+		VkHelper::BeginRecorderFrame(command_recorder, i);
+
+		// The primaries are simultaneous use, so the secondaries must be too
+		AddRecordJobs(i, VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT, record_jobs);
+	}
+	const uint32_t jobs_per_image = static_cast<uint32_t>(record_jobs.size()) / buffer_count;
+
+	// Record every images secondaries at once across the worker threads
+	secondary_command_buffers.resize(record_jobs.size());
+	VkHelper::RecordSecondaryCommandBuffers(
+		command_recorder,
+		record_jobs.data(),
+		static_cast<uint32_t>(record_jobs.size()),
+		secondary_command_buffers.data()
+	);
+
+
+	// Loop through for the swapchain buffers, all that is left is to stitch the secondaries into the primaries
+	for (unsigned int i = 0; i < buffer_count; i++)
+	{
+		// Reset the command buffers
+		VkResult reset_command_buffer_result = vkResetCommandBuffer(
 			command_buffers.get()[i],
-			pbrboy_model.index_count,	// The model consists of 6 verticies, 2 that are shared between both triangles
-			1,							// Draw once model
-			0,
-			pbrboy_model.vertex_offset,
 			0
 		);
+		assert(reset_command_buffer_result == VK_SUCCESS);
 
+		// Begin the new command buffer
+		VkResult begin_command_buffer_result = vkBeginCommandBuffer(
+			command_buffers.get()[i],
+			&command_buffer_begin_info
+		);
+		// check to see if the command buffer was created
+		assert(begin_command_buffer_result == VK_SUCCESS);
 
-		// End the rendering
-		vkCmdEndRenderPass(
-			command_buffers.get()[i]
+		RecordRenderPass(
+			command_buffers.get()[i],
+			i,
+			&secondary_command_buffers[i * jobs_per_image],
+			jobs_per_image
 		);
 
 		// End the current rendering command
@@ -1400,105 +2092,206 @@ void BuildCommandBuffers(std::unique_ptr<VkCommandBuffer>& command_buffers, cons
 		);
 		assert(end_command_buffer_result == VK_SUCCESS);
 	}
+
+	// Compare this with the per frame cost reported by dynamic recording, prerecording pays it once per rebuild
+	std::chrono::high_resolution_clock::time_point record_end = std::chrono::high_resolution_clock::now();
+	std::cout << "Prerecording " << buffer_count << " command buffers took "
+		<< std::chrono::duration_cast<std::chrono::microseconds>(record_end - record_start).count() / 1000.0f << "ms" << std::endl;
 }
 
-void Render()
+// Record this frames commands from scratch into the frames transient command pool. Anything about the scene can change
+// from one frame to the next without rebuilding anything
+VkCommandBuffer RecordFrameCommands()
 {
-	// Find next image
-	VkResult wait_for_fences = vkWaitForFences(
+	VK_HELPER_CPU_ZONE("RecordFrameCommands");
+	VkCommandBuffer command_buffer = VkHelper::BeginFrameCommands(
 		device,
-		1,
-		&fences.get()[current_frame_index],
-		VK_TRUE,
-		UINT32_MAX
+		frame_loop,
+		frame_commands
 	);
-	assert(wait_for_fences == VK_SUCCESS);
 
-	VkResult acquire_next_image_result = vkAcquireNextImageKHR(
-		device,
-		swap_chain,
-		UINT64_MAX,
-		image_available_semaphore,
-		VK_NULL_HANDLE,
-		&current_frame_index
+	// BeginFrame waited on the last frame to render to this image, so the images secondaries are free to be reset
+	VkHelper::BeginRecorderFrame(command_recorder, frame_loop.image_index);
+
+	std::vector<VkHelper::SecondaryRecordJob> record_jobs;
+	AddRecordJobs(frame_loop.image_index, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, record_jobs);
+
+	secondary_command_buffers.resize(record_jobs.size());
+	VkHelper::RecordSecondaryCommandBuffers(
+		command_recorder,
+		record_jobs.data(),
+		static_cast<uint32_t>(record_jobs.size()),
+		secondary_command_buffers.data()
 	);
-	assert(acquire_next_image_result == VK_SUCCESS);
 
-	// Reset and wait
-	VkResult queue_idle_result = vkQueueWaitIdle(
-		graphics_queue
+	RecordRenderPass(
+		command_buffer,
+		frame_loop.image_index,
+		secondary_command_buffers.data(),
+		static_cast<uint32_t>(secondary_command_buffers.size())
 	);
-	assert(queue_idle_result == VK_SUCCESS);
 
-	VkResult reset_fences_result = vkResetFences(
-		device,
-		1,
-		&fences.get()[current_frame_index]
+	VkHelper::EndFrameCommands(
+		frame_loop,
+		frame_commands
 	);
-	assert(reset_fences_result == VK_SUCCESS);
 
-	render_submission_info.pCommandBuffers = &graphics_command_buffers.get()[current_frame_index];
+	// Report the recording cost every few hundred frames
+	if (frame_commands.recorded_frames == 300)
+	{
+		VkHelper::FrameRecordingStats stats = VkHelper::TakeFrameRecordingStats(frame_commands);
+		std::cout << "Dynamic recording: " << stats.average_ms << "ms average, " << stats.max_ms << "ms worst over " << stats.frames << " frames" << std::endl;
+	}
 
-	VkResult queue_submit_result = vkQueueSubmit(
-		graphics_queue,
-		1,
-		&render_submission_info,
-		fences.get()[current_frame_index]
+	return command_buffer;
+}
+
+void Render()
+{
+	VK_HELPER_CPU_ZONE("Render");
+	// Wait for the oldest frame in flight to finish and find the next image
+	VkResult begin_frame_result = VkHelper::BeginFrame(
+		device,
+		swap_chain,
+		frame_loop
 	);
-	assert(queue_submit_result == VK_SUCCESS);
+	// The swapchain no longer matches the window, rebuild it and pick the frame up next time round
+	if (begin_frame_result == VK_ERROR_OUT_OF_DATE_KHR)
+	{
+		RebuildRenderResources();
+		return;
+	}
 
-	present_info.pImageIndices = &current_frame_index;
+	// Now we know what image we are rendering, write its uniforms
+	UpdateUniforms(frame_loop.image_index);
 
-	VkResult queue_present_result = vkQueuePresentKHR(
+	// The last frame to render to this image has finished, so its timings are ready
+	VkHelper::CollectGpuTimings(gpu_profiler, frame_loop.image_index);
+
+	// Either record the frame now, or use the command buffer prerecorded for this image
+	VkCommandBuffer command_buffer = dynamic_recording ? RecordFrameCommands() : graphics_command_buffers.get()[frame_loop.image_index];
+
+	// Submit the commands recorded for this image and present it. We don't wait for the GPU here, the CPU carries
+	// straight on with the next frame while this one is being rendered
+	VkResult end_frame_result = VkHelper::EndFrame(
+		device,
+		graphics_queue,
 		present_queue,
-		&present_info
+		swap_chain,
+		frame_loop,
+		&command_buffer,                                           // The command buffer that renders to this image
+		1,
+		VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT              // Only the colour output needs to wait for the image
 	);
 	// If the window was resized or something else made the current render invalid, we need to rebuild all the
 	// render resources
-	if (queue_present_result == VK_ERROR_OUT_OF_DATE_KHR)
+	if (end_frame_result == VK_ERROR_OUT_OF_DATE_KHR)
 	{
 		RebuildRenderResources();
 	}
-
-	assert(queue_present_result == VK_SUCCESS || queue_present_result == VK_ERROR_OUT_OF_DATE_KHR);
-
-
-	VkResult device_idle_result = vkDeviceWaitIdle(device);
-	assert(device_idle_result == VK_SUCCESS);
 }
 
 int main(int argc, char **argv)
 {
+	VK_HELPER_CPU_THREAD_NAME("Main");
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--dynamic-recording") == 0) dynamic_recording = true;
+		if (strcmp(argv[i], "--gpu-profile") == 0) gpu_profile = true;
+	}
+	headless = VkHelper::ParseHeadlessOptions(argc, argv);
+	VkHelper::StartBenchmark(VkHelper::ParseBenchmarkOptions(argc, argv), "Camera", benchmark);
+	// The benchmark reports the GPU timings as well
+	if (benchmark.enabled) gpu_profile = true;
 
 	Setup();
 
+	// The buffers and textures all come from the allocator, only the framebuffer attachments are allocated directly
+	benchmark.allocator = &allocator;
+	benchmark.gpu_profiler = &gpu_profiler;
+	VkHelper::MarkBenchmarkPhase(benchmark, "Setup");
+
+	// Time how long the driver takes to build the pipelines, compare the first run (cold cache) with later runs (warm cache)
+	std::chrono::high_resolution_clock::time_point pipeline_build_start = std::chrono::high_resolution_clock::now();
+
 	CreateGraphicsPipeline();
+	VkHelper::MarkBenchmarkPhase(benchmark, "Pipelines");
+
+	std::chrono::high_resolution_clock::time_point pipeline_build_end = std::chrono::high_resolution_clock::now();
+	std::cout << "Pipeline creation took " << std::chrono::duration_cast<std::chrono::microseconds>(pipeline_build_end - pipeline_build_start).count() / 1000.0f
+		<< "ms (" << (VkHelper::PipelineCacheLoadedFromDisk() ? "warm" : "cold") << " pipeline cache)" << std::endl;
 
 	// Create albedo texture for the model
 	STexture metal_texture = CreateTexture("../../../Data/Images/futuristic-panels1-bl/futuristic-panels1-albedo.png");
+	VkHelper::MarkBenchmarkPhase(benchmark, "Textures");
 
-	// Set the albedo texture
-	SetAlbedoTexture(metal_texture);
+	// Load the new model, its materials use the albedo texture
+	CreateModel("../../../Data/Models/PBRBoy.obj", pbrboy_model, metal_texture.heap_index);
 
-	// Load the new model
-	CreateModel("../../../Data/Models/PBRBoy.obj", pbrboy_model);
+	// Now every model has added its materials, send the table to the GPU
+	CreateMaterialBuffer();
+	VkHelper::MarkBenchmarkPhase(benchmark, "Model");
 
-	// Regenerate the command buffers
-	BuildCommandBuffers(graphics_command_buffers, swapchain_image_count);
+	draw_list.push_back(&pbrboy_model);
+
+	// Regenerate the command buffers, unless they are going to be recorded every frame
+	if (!dynamic_recording) BuildCommandBuffers(graphics_command_buffers, swapchain_image_count);
+	VkHelper::MarkBenchmarkPhase(benchmark, "Command buffers");
+
+	std::chrono::high_resolution_clock::time_point render_start = std::chrono::high_resolution_clock::now();
 
 	while (window_open)
 	{
-		PollWindow();
+		if (!headless.enabled) PollWindow();
 
 		Render();
+
+		VkHelper::RecordBenchmarkFrame(benchmark);
+
+		// A headless run stops after a fixed number of frames so runs can be compared
+		if (headless.enabled && headless.frame_count > 0 && frame_loop.frame_number >= headless.frame_count) window_open = false;
 	}
 
+	// Let the frames that are still in flight finish before we start cleaning up
+	VkResult device_idle_result = vkDeviceWaitIdle(device);
+	assert(device_idle_result == VK_SUCCESS);
+
+	if (headless.enabled)
+	{
+		std::chrono::high_resolution_clock::time_point render_end = std::chrono::high_resolution_clock::now();
+		float render_ms = std::chrono::duration_cast<std::chrono::microseconds>(render_end - render_start).count() / 1000.0f;
+		std::cout << "Rendered " << frame_loop.frame_number << " headless frames in " << render_ms << "ms, "
+			<< render_ms / frame_loop.frame_number << "ms per frame" << std::endl;
+	}
+
+	if (benchmark.enabled)
+	{
+		if (VkHelper::WriteBenchmarkResults(benchmark)) std::cout << "Benchmark results written to " << benchmark.output_path << std::endl;
+		else std::cout << "Unable to write the benchmark results to " << benchmark.output_path << std::endl;
+	}
+
+	if (gpu_profile)
+	{
+		for (const VkHelper::GpuScopeStats& stats : VkHelper::GetGpuScopeStats(gpu_profiler))
+		{
+			std::cout << stats.name << ": " << stats.average_ms << "ms average, " << stats.p50_ms << "ms p50, " << stats.p95_ms << "ms p95, "
+				<< stats.p99_ms << "ms p99, " << stats.max_ms << "ms worst over " << stats.samples << " frames" << std::endl;
+		}
+	}
+	VkHelper::DestroyGpuProfiler(gpu_profiler);
+
+	// Does nothing unless Vk-Helper was built with VK_HELPER_CPU_PROFILE
+	VK_HELPER_CPU_WRITE_TRACE("Camera.cputrace.json");
+
 	////////////////////
 	///// Clean Up ///// 
 	////////////////////
 
 	DestroyTexture(metal_texture);
 
+	DestroyMaterialBuffer();
+
 	DestroyGraphicsPipeline();
 	// Finish previous projects cleanups
 	Destroy();
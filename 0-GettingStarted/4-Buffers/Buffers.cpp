@@ -6,9 +6,13 @@
 #include <vulkan/vulkan.h>
 #include <VkInitializers.hpp>
 #include <VkCore.hpp>
+#include <VkDispatch.hpp>
 
 VkInstance instance;
 VkDebugReportCallbackEXT debugger;
+// Start with --no-validation to leave out the validation layers and the debugger, the benchmark runner uses this so it
+// times the sample rather than the layers
+bool validation = true;
 VkPhysicalDevice physical_device = VK_NULL_HANDLE;
 
 
@@ -37,19 +41,19 @@ void Setup()
 	const char *instance_layers[layer_count] = { "VK_LAYER_LUNARG_standard_validation" };
 
 	// Check to see if we have the layer requirments
-	assert(VkHelper::CheckLayersSupport(instance_layers, 1) && "Unsupported Layers Found");
+	assert(VkHelper::CheckLayersSupport(instance_layers, validation ? layer_count : 0) && "Unsupported Layers Found");
 
 	// Create the Vulkan Instance
 	instance = VkHelper::CreateInstance(
-		instance_extensions, extention_count,
-		instance_layers, layer_count,
+		instance_extensions, validation ? extention_count : 0,    // Without validation there is no debug report to hook up
+		instance_layers, validation ? layer_count : 0,
 		"Buffers", VK_MAKE_VERSION(1, 0, 0),
 		"Vulkan", VK_MAKE_VERSION(1, 0, 0),
 		VK_MAKE_VERSION(1, 1, 108));
 
 	// Attach a debugger to the application to give us validation feedback.
 	// This is usefull as it tells us about any issues without application
-	debugger = VkHelper::CreateDebugger(instance);
+	if (validation) debugger = VkHelper::CreateDebugger(instance);
 
 	// Define what Device Extentions we require
 	const uint32_t physical_device_extention_count = 1;
@@ -114,6 +118,9 @@ void Destroy()
 		nullptr
 	);
 
+	// The device is going away, free its dispatch table so a later device given the same handle loads its own
+	VkHelper::UnregisterDeviceDispatch(device);
+
 	// Clean up the device now that the project is stopping
 	vkDestroyDevice(
 		device,
@@ -122,10 +129,13 @@ void Destroy()
 
 	// Destroy the debug callback
 	// We cant directly call vkDestroyDebugReportCallbackEXT as we need to find the pointer within the Vulkan DLL, See function inplmentation for details.
-	VkHelper::DestroyDebugger(
-		instance, 
-		debugger
-	);
+	if (validation)
+	{
+		VkHelper::DestroyDebugger(
+			instance,
+			debugger
+		);
+	}
 
 	// Clean up the vulkan instance
 	vkDestroyInstance(
@@ -152,6 +162,11 @@ uint32_t FindMemoryType(uint32_t type_filter, VkMemoryPropertyFlags properties)
 
 int main(int argc, char **argv)
 {
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--no-validation") == 0) validation = false;
+	}
+
 	// Setup the components from the previous projects
 	Setup();
 
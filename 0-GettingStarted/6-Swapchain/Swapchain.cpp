@@ -1,5 +1,8 @@
 
+// The window surface is only hooked up for Windows, so the sample is only built there
+#ifdef _WIN32
 #define VK_USE_PLATFORM_WIN32_KHR
+#endif
 #include <assert.h>
 #include <stdio.h>
 #include <string.h>
@@ -11,6 +14,7 @@
 #include <vulkan/vulkan.h>
 #include <VkInitializers.hpp>
 #include <VkCore.hpp>
+#include <VkDispatch.hpp>
 
 VkInstance instance;
 VkDebugReportCallbackEXT debugger;
@@ -105,6 +109,7 @@ void DestroyWindow()
 // Create windows surface for sdl to interface with
 void CreateSurface()
 {
+#ifdef VK_USE_PLATFORM_WIN32_KHR
 	auto CreateWin32SurfaceKHR = (PFN_vkCreateWin32SurfaceKHR)vkGetInstanceProcAddr(instance, "vkCreateWin32SurfaceKHR");
 
 	VkWin32SurfaceCreateInfoKHR createInfo = {};
@@ -116,6 +121,9 @@ void CreateSurface()
 	{
 		throw std::runtime_error("failed to create window surface!");
 	}
+#else
+	throw std::runtime_error("window surfaces are only supported on windows");
+#endif
 }
 
 // Everything within the Setup is from previous tuturials
@@ -130,8 +138,13 @@ void CreateSurface()
 void Setup()
 {
 	// Define what Layers and Extentions we require
+#ifdef VK_USE_PLATFORM_WIN32_KHR
 	const uint32_t extention_count = 3;
 	const char *instance_extensions[extention_count] = { "VK_EXT_debug_report" ,VK_KHR_SURFACE_EXTENSION_NAME,VK_KHR_WIN32_SURFACE_EXTENSION_NAME };
+#else
+	const uint32_t extention_count = 1;
+	const char *instance_extensions[extention_count] = { "VK_EXT_debug_report" };
+#endif
 	const uint32_t layer_count = 1;
 	const char *instance_layers[layer_count] = { "VK_LAYER_LUNARG_standard_validation" };
 
@@ -334,6 +347,9 @@ void Destroy()
 		nullptr
 	);
 
+	// The device is going away, free its dispatch table so a later device given the same handle loads its own
+	VkHelper::UnregisterDeviceDispatch(device);
+
 	// Clean up the device now that the project is stopping
 	vkDestroyDevice(
 		device,
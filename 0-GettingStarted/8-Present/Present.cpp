@@ -1,16 +1,24 @@
 
+// The window surface is only hooked up for Windows, anywhere else the sample can still be run with --headless
+#ifdef _WIN32
 #define VK_USE_PLATFORM_WIN32_KHR
+#endif
 #include <assert.h>
 #include <stdio.h>
 #include <string.h>
 #include <memory>
 #include <stdexcept>
+#include <iostream>
+#include <chrono>
 
 #include <SDL.h>
 #include <SDL_syswm.h>
 #include <vulkan/vulkan.h>
 #include <VkInitializers.hpp>
 #include <VkCore.hpp>
+#include <VkDispatch.hpp>
+#include <VkFrameLoop.hpp>
+#include <VkHeadless.hpp>
 
 void CreateRenderResources();
 void DestroyRenderResources();
@@ -28,6 +36,8 @@ VkPhysicalDeviceFeatures physical_device_features;
 VkPhysicalDeviceMemoryProperties physical_device_mem_properties;
 
 VkDevice device = VK_NULL_HANDLE;
+// The devices own functions, the commands recorded every frame are called through this rather than the loader
+const VkHelper::DeviceDispatch* device_dispatch = nullptr;
 VkQueue graphics_queue = VK_NULL_HANDLE;
 VkQueue present_queue = VK_NULL_HANDLE;
 VkCommandPool command_pool;
@@ -54,9 +64,13 @@ std::unique_ptr<VkFramebuffer> framebuffers = nullptr;
 std::unique_ptr<VkHelper::VulkanAttachments> framebuffer_attachments = nullptr; 
 
 
-VkPipelineStageFlags wait_stages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-VkPresentInfoKHR present_info = {};
-VkSubmitInfo render_submission_info = {};
+// How many frames the CPU is allowed to get ahead of the GPU
+const uint32_t frames_in_flight = 2;
+VkHelper::FrameLoop frame_loop;
+
+// Start with --headless [frame count] to render a fixed number of frames into offscreen images, with no window
+VkHelper::HeadlessOptions headless;
+VkHelper::HeadlessSwapchain headless_swapchain;
 std::unique_ptr<VkCommandBuffer> graphics_command_buffers = nullptr;
 
 
@@ -110,6 +124,7 @@ void DestroyWindow()
 // Create windows surface for sdl to interface with
 void CreateSurface()
 {
+#ifdef VK_USE_PLATFORM_WIN32_KHR
 	auto CreateWin32SurfaceKHR = (PFN_vkCreateWin32SurfaceKHR)vkGetInstanceProcAddr(instance, "vkCreateWin32SurfaceKHR");
 
 	VkWin32SurfaceCreateInfoKHR createInfo = {};
@@ -121,6 +136,9 @@ void CreateSurface()
 	{
 		throw std::runtime_error("failed to create window surface!");
 	}
+#else
+	throw std::runtime_error("window surfaces are only supported on windows, run with --headless instead");
+#endif
 }
 
 // Everything within the Setup is from previous tuturials
@@ -137,17 +155,34 @@ void CreateSurface()
 void Setup()
 {
 
-	WindowSetup("Vulkan", 1080, 720);
+	if (headless.enabled)
+	{
+		// No window, the offscreen images are the size the window would have been
+		window_width = 1080;
+		window_height = 720;
+		window_open = true;
+	}
+	else
+	{
+		WindowSetup("Vulkan", 1080, 720);
+	}
 
 
 	// Define what Layers and Extentions we require
-	const uint32_t extention_count = 3;
-	const char *instance_extensions[extention_count] = { "VK_EXT_debug_report" ,VK_KHR_SURFACE_EXTENSION_NAME,VK_KHR_WIN32_SURFACE_EXTENSION_NAME };
-	const uint32_t layer_count = 1;
-	const char *instance_layers[layer_count] = { "VK_LAYER_LUNARG_standard_validation" };
+#ifdef VK_USE_PLATFORM_WIN32_KHR
+	const uint32_t window_extention_count = 3;
+	const char *instance_extensions[window_extention_count] = { "VK_EXT_debug_report" ,VK_KHR_SURFACE_EXTENSION_NAME,VK_KHR_WIN32_SURFACE_EXTENSION_NAME };
+#else
+	const uint32_t window_extention_count = 1;
+	const char *instance_extensions[window_extention_count] = { "VK_EXT_debug_report" };
+#endif
+	const char *instance_layers[1] = { "VK_LAYER_LUNARG_standard_validation" };
+	// A headless run needs no surface, and is left without the validation layers as they would be most of what it times
+	const uint32_t extention_count = headless.enabled ? 0 : window_extention_count;
+	const uint32_t layer_count = headless.enabled ? 0 : 1;
 
 	// Check to see if we have the layer requirments
-	assert(VkHelper::CheckLayersSupport(instance_layers, 1) && "Unsupported Layers Found");
+	assert(VkHelper::CheckLayersSupport(instance_layers, layer_count) && "Unsupported Layers Found");
 
 	// Create the Vulkan Instance
 	instance = VkHelper::CreateInstance(
@@ -159,9 +194,10 @@ void Setup()
 
 	// Attach a debugger to the application to give us validation feedback.
 	// This is usefull as it tells us about any issues without application
-	debugger = VkHelper::CreateDebugger(instance);
+	if (!headless.enabled) debugger = VkHelper::CreateDebugger(instance);
 
 	// Define what Device Extentions we require
+	// The swapchain extension is still needed headless, the frames leave their images in the present layout
 	const uint32_t physical_device_extention_count = 1;
 	// Note that this extention list is diffrent from the instance on as we are telling the system what device settings we need.
 	const char *physical_device_extensions[physical_device_extention_count] = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
@@ -170,7 +206,7 @@ void Setup()
 
 	// The surface creation is added here as it needs to happen before the physical device creation and after we have said to the instance that we need a surface
 	// The surface is the refrence back to the OS window
-	CreateSurface();
+	if (!headless.enabled) CreateSurface();
 
 
 
@@ -210,6 +246,8 @@ void Setup()
 		physical_device_extention_count                        // How many extentions are there
 	);
 
+	device_dispatch = &VkHelper::GetDeviceDispatch(device);
+
 	vkGetDeviceQueue(
 		device,
 		physical_devices_queue_family,
@@ -257,6 +295,12 @@ void Destroy()
 		nullptr
 	);
 
+	// Any samplers the textures and attachments didn't give back are still held by the cache, they go before the device
+	VkHelper::DestroySamplerCache(device);
+
+	// The device is going away, free its dispatch table so a later device given the same handle loads its own
+	VkHelper::UnregisterDeviceDispatch(device);
+
 	// Clean up the device now that the project is stopping
 	vkDestroyDevice(
 		device,
@@ -265,10 +309,13 @@ void Destroy()
 
 	// Destroy the debug callback
 	// We cant directly call vkDestroyDebugReportCallbackEXT as we need to find the pointer within the Vulkan DLL, See function inplmentation for details.
-	VkHelper::DestroyDebugger(
-		instance, 
-		debugger
-	);
+	if (!headless.enabled)
+	{
+		VkHelper::DestroyDebugger(
+			instance, 
+			debugger
+		);
+	}
 
 	// Clean up the vulkan instance
 	vkDestroyInstance(
@@ -276,7 +323,7 @@ void Destroy()
 		NULL
 	);
 
-	DestroyWindow();
+	if (!headless.enabled) DestroyWindow();
 }
 
 
@@ -284,19 +331,40 @@ void Destroy()
 void CreateRenderResources()
 {
 
-	swap_chain = VkHelper::CreateSwapchain(
-		physical_device,
-		device,
-		surface,
-		surface_capabilities,
-		surface_format,
-		present_mode,
-		window_width,
-		window_height,
-		swapchain_image_count,
-		swapchain_images,
-		swapchain_image_views
-	);
+	if (headless.enabled)
+	{
+		// Three images, the same as a triple buffered swapchain
+		surface_format.format = VK_FORMAT_B8G8R8A8_UNORM;
+		swap_chain = VK_NULL_HANDLE;
+		VkHelper::CreateHeadlessSwapchain(
+			device,
+			physical_device_mem_properties,
+			surface_format.format,
+			window_width,
+			window_height,
+			3,
+			headless_swapchain,
+			swapchain_image_count,
+			swapchain_images,
+			swapchain_image_views
+		);
+	}
+	else
+	{
+		swap_chain = VkHelper::CreateSwapchain(
+			physical_device,
+			device,
+			surface,
+			surface_capabilities,
+			surface_format,
+			present_mode,
+			window_width,
+			window_height,
+			swapchain_image_count,
+			swapchain_images,
+			swapchain_image_views
+		);
+	}
 
 
 	const VkFormat colorFormat = VK_FORMAT_R8G8B8A8_UNORM;
@@ -318,23 +386,6 @@ void CreateRenderResources()
 		swapchain_image_views
 	);
 
-	render_submission_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	render_submission_info.waitSemaphoreCount = 1;
-	render_submission_info.pWaitDstStageMask = &wait_stages;
-	render_submission_info.commandBufferCount = 1;
-	render_submission_info.signalSemaphoreCount = 1;
-
-
-	present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-	present_info.waitSemaphoreCount = 1;
-	present_info.swapchainCount = 1;
-	present_info.pSwapchains = &swap_chain;
-	present_info.pResults = nullptr;
-
-	// All three semaphores are defined in the main as they are a part of the tuturial on how to create them
-	//sumbit_info.pSignalSemaphores = nullptr;
-	//sumbit_info.pWaitSemaphores = nullptr;
-	//present_info.pWaitSemaphores = nullptr;
 }
 
 void DestroyRenderResources()
@@ -346,11 +397,21 @@ void DestroyRenderResources()
 		nullptr
 	);
 
-	vkDestroySwapchainKHR(
-		device,
-		swap_chain,
-		nullptr
-	);
+	if (headless.enabled)
+	{
+		VkHelper::DestroyHeadlessSwapchain(
+			device,
+			headless_swapchain
+		);
+	}
+	else
+	{
+		vkDestroySwapchainKHR(
+			device,
+			swap_chain,
+			nullptr
+		);
+	}
 
 	for (int i = 0; i < swapchain_image_count; i++)
 	{
@@ -380,10 +441,9 @@ void DestroyRenderResources()
 			framebuffer_attachments.get()[i].color.memory,
 			nullptr
 		);
-		vkDestroySampler(
+		VkHelper::ReleaseSampler(
 			device,
-			framebuffer_attachments.get()[i].color.sampler,
-			nullptr
+			framebuffer_attachments.get()[i].color.sampler
 		);
 		vkDestroyImageView(
 			device,
@@ -400,10 +460,9 @@ void DestroyRenderResources()
 			framebuffer_attachments.get()[i].depth.memory,
 			nullptr
 		);
-		vkDestroySampler(
+		VkHelper::ReleaseSampler(
 			device,
-			framebuffer_attachments.get()[i].depth.sampler,
-			nullptr
+			framebuffer_attachments.get()[i].depth.sampler
 		);
 	}
 
@@ -412,12 +471,17 @@ void DestroyRenderResources()
 
 void RebuildRenderResources()
 {
+	// Only the window can go out of date, the headless images stay the same size
+	assert(!headless.enabled);
+
 	// Wait for the device to finish
 	VkResult device_idle_result = vkDeviceWaitIdle(device);
 	assert(device_idle_result == VK_SUCCESS);
 	// Destroy and rebuild the render resources
 	DestroyRenderResources();
 	CreateRenderResources();
+	// The old swapchain images are gone, so forget which frames were using them
+	VkHelper::ResetFrameLoopImages(frame_loop, swapchain_image_count);
 	BuildCommandBuffers(graphics_command_buffers, swapchain_image_count);
 }
 
@@ -488,14 +552,14 @@ void BuildCommandBuffers(std::unique_ptr<VkCommandBuffer>& command_buffers, cons
 		assert(begin_command_buffer_result == VK_SUCCESS);
 
 		// Define that we will be starting a new render pass
-		vkCmdBeginRenderPass(
+		device_dispatch->vkCmdBeginRenderPass(
 			command_buffers.get()[i],
 			&render_pass_info,
 			VK_SUBPASS_CONTENTS_INLINE
 		);
 
 		// Set the viewport
-		vkCmdSetViewport(
+		device_dispatch->vkCmdSetViewport(
 			command_buffers.get()[i],
 			0,
 			1,
@@ -503,7 +567,7 @@ void BuildCommandBuffers(std::unique_ptr<VkCommandBuffer>& command_buffers, cons
 		);
 
 		// Set the scissor region
-		vkCmdSetScissor(
+		device_dispatch->vkCmdSetScissor(
 			command_buffers.get()[i],
 			0,
 			1,
@@ -519,7 +583,7 @@ void BuildCommandBuffers(std::unique_ptr<VkCommandBuffer>& command_buffers, cons
 
 
 		// End the rendering
-		vkCmdEndRenderPass(
+		device_dispatch->vkCmdEndRenderPass(
 			command_buffers.get()[i]
 		);
 
@@ -536,52 +600,25 @@ void BuildCommandBuffers(std::unique_ptr<VkCommandBuffer>& command_buffers, cons
 int main(int argc, char **argv)
 {
 
+	headless = VkHelper::ParseHeadlessOptions(argc, argv);
 	Setup();
 
-	uint32_t current_frame_index = 0; // What frame are we currently using
-
-	// Create a new pointer array for the fences
-	std::unique_ptr<VkFence> fences = std::unique_ptr<VkFence>(new VkFence[swapchain_image_count]);
-	// Loop through for the amount of swapchain images
-	for (unsigned int i = 0; i < swapchain_image_count; i++)
-	{
-		// Define the fence create info
-		VkFenceCreateInfo info = {};
-		info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-		info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-		// Create the new fence
-		VkResult create_fence_result = vkCreateFence(
-			device,
-			&info,
-			nullptr,
-			&fences.get()[i]
-		);
-		// Validate the fence
-		assert(create_fence_result == VK_SUCCESS);
-	}
-
-	VkSemaphore image_available_semaphore;
-	VkSemaphore render_finished_semaphore;
-
-	VkSemaphoreCreateInfo semaphore_create_info = {};
-	semaphore_create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-	// Create new signal semaphore for image avaliability
-	VkResult create_semaphore_result = vkCreateSemaphore(device,
-		&semaphore_create_info,
-		nullptr,
-		&image_available_semaphore
-	);
-	// Was the semaphore created
-	assert(create_semaphore_result == VK_SUCCESS);
-
-	// Create new signal semaphore for render finishing
-	create_semaphore_result = vkCreateSemaphore(device,
-		&semaphore_create_info,
-		nullptr,
-		&render_finished_semaphore
+	// Rather than waiting for the GPU to finish every frame before starting the next, we let the CPU work on up to
+	// frames_in_flight frames at once. Each frame in flight needs its own set of sync objects:
+	// - A semaphore that is signaled when the swapchain image we acquired can be rendered to
+	// - A semaphore that is signaled when rendering is done, so the present knows when it can show the image
+	// - A fence so the CPU knows when the GPU has finished with the frame and it can be reused
+	// The frame loop also keeps track of what frame last rendered to each swapchain image, as the swapchain
+	// can give us back images out of order
+	VkHelper::CreateFrameLoop(
+		device,
+		command_pool,
+		swapchain_image_count,                                 // How many images the frames will be rendering into
+		frames_in_flight,                                      // How many frames can be worked on at once
+		frame_loop
 	);
-	// Was the semaphore created
-	assert(create_semaphore_result == VK_SUCCESS);
+	// Acquire and present from the offscreen images rather than a swapchain
+	if (headless.enabled) frame_loop.headless_swapchain = &headless_swapchain;
 
 	// Create pointer array to the graphics commands
 	graphics_command_buffers = std::unique_ptr<VkCommandBuffer>(new VkCommandBuffer[swapchain_image_count]);
@@ -605,14 +642,6 @@ int main(int argc, char **argv)
 	// record the new command buffers
 	BuildCommandBuffers(graphics_command_buffers, swapchain_image_count);
 
-	// sumbit_info and present_info are defined within CreateRenderResources as they need to get the
-	// newly created swapchain instance
-
-	// We need to attach our demaphores to the pre defined structures from before
-	render_submission_info.pSignalSemaphores = &render_finished_semaphore;
-	render_submission_info.pWaitSemaphores = &image_available_semaphore;
-
-	present_info.pWaitSemaphores = &render_finished_semaphore;
 
 
 
@@ -623,101 +652,70 @@ int main(int argc, char **argv)
 
 
 
+	std::chrono::high_resolution_clock::time_point render_start = std::chrono::high_resolution_clock::now();
+
 	while (window_open)
 	{
-		PollWindow();
-
+		if (!headless.enabled) PollWindow();
 
-		// Find next image
 
-
-		vkWaitForFences(
-			device,
-			1,
-			&fences.get()[current_frame_index],
-			VK_TRUE,
-			UINT32_MAX
-		);
-		VkResult acquire_next_image_result = vkAcquireNextImageKHR(
+		// Wait for the oldest frame in flight to be finished with and find the next image
+		VkResult begin_frame_result = VkHelper::BeginFrame(
 			device,
 			swap_chain,
-			UINT64_MAX,
-			image_available_semaphore,
-			VK_NULL_HANDLE,
-			&current_frame_index
-		);
-		assert(acquire_next_image_result == VK_SUCCESS);
-
-		// Reset and wait
-		VkResult queue_idle_result = vkQueueWaitIdle(
-			graphics_queue
+			frame_loop
 		);
-		assert(queue_idle_result == VK_SUCCESS);
+		// The swapchain no longer matches the window, rebuild it and pick the frame up next time round
+		if (begin_frame_result == VK_ERROR_OUT_OF_DATE_KHR)
+		{
+			RebuildRenderResources();
+			continue;
+		}
 
-		VkResult reset_fences_result = vkResetFences(
+		// Submit the command buffer for the image we were given and present it. The submit waits on the image being
+		// available and signals the render finished semaphore that the present waits on. We don't wait for the GPU
+		// to finish here, the CPU carries straight on with the next frame
+		VkResult end_frame_result = VkHelper::EndFrame(
 			device,
-			1,
-			&fences.get()[current_frame_index]
-		);
-		assert(reset_fences_result == VK_SUCCESS);
-
-
-
-		render_submission_info.pCommandBuffers = &graphics_command_buffers.get()[current_frame_index];
-
-		VkResult queue_submit_result = vkQueueSubmit(
 			graphics_queue,
-			1,
-			&render_submission_info,
-			fences.get()[current_frame_index]
-		);
-		assert(queue_submit_result == VK_SUCCESS);
-
-
-
-		present_info.pImageIndices = &current_frame_index;
-
-
-		VkResult queue_present_result = vkQueuePresentKHR(
 			present_queue,
-			&present_info
+			swap_chain,
+			frame_loop,
+			&graphics_command_buffers.get()[frame_loop.image_index],  // The command buffer that renders to this image
+			1,
+			VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT              // Only the colour output needs to wait for the image
 		);
 		// If the window was resized or something else made the current render invalid, we need to rebuild all the
 		// render resources
-		if (queue_present_result == VK_ERROR_OUT_OF_DATE_KHR)
+		if (end_frame_result == VK_ERROR_OUT_OF_DATE_KHR)
 		{
 			RebuildRenderResources();
 		}
 
-		assert(queue_present_result == VK_SUCCESS || queue_present_result == VK_ERROR_OUT_OF_DATE_KHR);
-
-		VkResult device_idle_result = vkDeviceWaitIdle(device);
-		assert(device_idle_result == VK_SUCCESS);
+		// A headless run stops after a fixed number of frames so runs can be compared
+		if (headless.enabled && headless.frame_count > 0 && frame_loop.frame_number >= headless.frame_count) window_open = false;
 	}
 
+	// Let the frames that are still in flight finish before we start cleaning up
+	VkResult device_idle_result = vkDeviceWaitIdle(device);
+	assert(device_idle_result == VK_SUCCESS);
 
+	if (headless.enabled)
+	{
+		std::chrono::high_resolution_clock::time_point render_end = std::chrono::high_resolution_clock::now();
+		float render_ms = std::chrono::duration_cast<std::chrono::microseconds>(render_end - render_start).count() / 1000.0f;
+		std::cout << "Rendered " << frame_loop.frame_number << " headless frames in " << render_ms << "ms, "
+			<< render_ms / frame_loop.frame_number << "ms per frame" << std::endl;
+	}
 
-	vkDestroySemaphore(
-		device,
-		image_available_semaphore,
-		nullptr
-	);
 
-	vkDestroySemaphore(
+
+	VkHelper::DestroyFrameLoop(
 		device,
-		render_finished_semaphore,
-		nullptr
+		command_pool,
+		frame_loop
 	);
 
-	for (unsigned int i = 0; i < swapchain_image_count; i++)
-	{
-		vkDestroyFence(
-			device,
-			fences.get()[i],
-			nullptr
-		);
-	}
-
 
 
 	// Finish previous projects cleanups
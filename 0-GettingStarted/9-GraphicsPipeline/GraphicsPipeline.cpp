@@ -1,16 +1,25 @@
 
+// The window surface is only hooked up for Windows, anywhere else the sample can still be run with --headless
+#ifdef _WIN32
 #define VK_USE_PLATFORM_WIN32_KHR
+#endif
 #include <assert.h>
 #include <stdio.h>
 #include <string.h>
 #include <memory>
 #include <stdexcept>
+#include <iostream>
+#include <chrono>
 
 #include <SDL.h>
 #include <SDL_syswm.h>
 #include <vulkan/vulkan.h>
 #include <VkInitializers.hpp>
 #include <VkCore.hpp>
+#include <VkDispatch.hpp>
+#include <VkPipelineCache.hpp>
+#include <VkFrameLoop.hpp>
+#include <VkHeadless.hpp>
 
 
 struct SVertexData
@@ -50,6 +59,8 @@ VkPhysicalDeviceFeatures physical_device_features;
 VkPhysicalDeviceMemoryProperties physical_device_mem_properties;
 
 VkDevice device = VK_NULL_HANDLE;
+// The devices own functions, the commands recorded every frame are called through this rather than the loader
+const VkHelper::DeviceDispatch* device_dispatch = nullptr;
 VkQueue graphics_queue = VK_NULL_HANDLE;
 VkQueue present_queue = VK_NULL_HANDLE;
 VkCommandPool command_pool;
@@ -76,14 +87,13 @@ VkRenderPass renderpass = VK_NULL_HANDLE;
 std::unique_ptr<VkFramebuffer> framebuffers = nullptr;
 std::unique_ptr<VkHelper::VulkanAttachments> framebuffer_attachments = nullptr;
 
-uint32_t current_frame_index = 0; // What frame are we currently using
-std::unique_ptr<VkFence> fences = nullptr;
+// How many frames the CPU is allowed to get ahead of the GPU
+const uint32_t frames_in_flight = 2;
+VkHelper::FrameLoop frame_loop;
 
-VkSemaphore image_available_semaphore;
-VkSemaphore render_finished_semaphore;
-VkSubmitInfo render_submission_info = {};
-VkPresentInfoKHR present_info = {};
-VkPipelineStageFlags wait_stages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+// Start with --headless [frame count] to render a fixed number of frames into offscreen images, with no window
+VkHelper::HeadlessOptions headless;
+VkHelper::HeadlessSwapchain headless_swapchain;
 
 std::unique_ptr<VkCommandBuffer> graphics_command_buffers = nullptr;
 
@@ -168,6 +178,7 @@ void DestroyWindow()
 // Create windows surface for sdl to interface with
 void CreateSurface()
 {
+#ifdef VK_USE_PLATFORM_WIN32_KHR
 	auto CreateWin32SurfaceKHR = (PFN_vkCreateWin32SurfaceKHR)vkGetInstanceProcAddr(instance, "vkCreateWin32SurfaceKHR");
 
 	VkWin32SurfaceCreateInfoKHR createInfo = {};
@@ -179,6 +190,9 @@ void CreateSurface()
 	{
 		throw std::runtime_error("failed to create window surface!");
 	}
+#else
+	throw std::runtime_error("window surfaces are only supported on windows, run with --headless instead");
+#endif
 }
 
 // Everything within the Setup is from previous tuturials
@@ -195,17 +209,34 @@ void CreateSurface()
 void Setup()
 {
 
-	WindowSetup("Vulkan", 1080, 720);
+	if (headless.enabled)
+	{
+		// No window, the offscreen images are the size the window would have been
+		window_width = 1080;
+		window_height = 720;
+		window_open = true;
+	}
+	else
+	{
+		WindowSetup("Vulkan", 1080, 720);
+	}
 
 
 	// Define what Layers and Extentions we require
-	const uint32_t extention_count = 3;
-	const char *instance_extensions[extention_count] = { "VK_EXT_debug_report" ,VK_KHR_SURFACE_EXTENSION_NAME,VK_KHR_WIN32_SURFACE_EXTENSION_NAME };
-	const uint32_t layer_count = 1;
-	const char *instance_layers[layer_count] = { "VK_LAYER_LUNARG_standard_validation" };
+#ifdef VK_USE_PLATFORM_WIN32_KHR
+	const uint32_t window_extention_count = 3;
+	const char *instance_extensions[window_extention_count] = { "VK_EXT_debug_report" ,VK_KHR_SURFACE_EXTENSION_NAME,VK_KHR_WIN32_SURFACE_EXTENSION_NAME };
+#else
+	const uint32_t window_extention_count = 1;
+	const char *instance_extensions[window_extention_count] = { "VK_EXT_debug_report" };
+#endif
+	const char *instance_layers[1] = { "VK_LAYER_LUNARG_standard_validation" };
+	// A headless run needs no surface, and is left without the validation layers as they would be most of what it times
+	const uint32_t extention_count = headless.enabled ? 0 : window_extention_count;
+	const uint32_t layer_count = headless.enabled ? 0 : 1;
 
 	// Check to see if we have the layer requirments
-	assert(VkHelper::CheckLayersSupport(instance_layers, 1) && "Unsupported Layers Found");
+	assert(VkHelper::CheckLayersSupport(instance_layers, layer_count) && "Unsupported Layers Found");
 
 	// Create the Vulkan Instance
 	instance = VkHelper::CreateInstance(
@@ -217,9 +248,10 @@ void Setup()
 
 	// Attach a debugger to the application to give us validation feedback.
 	// This is usefull as it tells us about any issues without application
-	debugger = VkHelper::CreateDebugger(instance);
+	if (!headless.enabled) debugger = VkHelper::CreateDebugger(instance);
 
 	// Define what Device Extentions we require
+	// The swapchain extension is still needed headless, the frames leave their images in the present layout
 	const uint32_t physical_device_extention_count = 1;
 	// Note that this extention list is diffrent from the instance on as we are telling the system what device settings we need.
 	const char *physical_device_extensions[physical_device_extention_count] = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
@@ -228,7 +260,7 @@ void Setup()
 
 	// The surface creation is added here as it needs to happen before the physical device creation and after we have said to the instance that we need a surface
 	// The surface is the refrence back to the OS window
-	CreateSurface();
+	if (!headless.enabled) CreateSurface();
 
 
 
@@ -268,6 +300,8 @@ void Setup()
 		physical_device_extention_count                        // How many extentions are there
 	);
 
+	device_dispatch = &VkHelper::GetDeviceDispatch(device);
+
 	vkGetDeviceQueue(
 		device,
 		physical_devices_queue_family,
@@ -282,6 +316,13 @@ void Setup()
 		&present_queue
 	);
 
+	// Load the pipeline cache from the last run, all pipelines created through Vk-Helper will use it
+	VkHelper::LoadPipelineCache(
+		device,
+		physical_device_properties,                            // Used to check the cache was made by this GPU and driver
+		"GraphicsPipeline.pipelinecache"                       // Where the cache is stored between runs
+	);
+
 	command_pool = VkHelper::CreateCommandPool(
 		device,
 		physical_devices_queue_family,                         // What queue family we are wanting to use to send commands to the GPU
@@ -293,12 +334,16 @@ void Setup()
 
 
 
-	// Create the fences required for the swapchain rendering 
-	VkHelper::CreateFence(device, fences, swapchain_image_count);
-
-	// Create the image avaliable and finished semaphore
-	VkHelper::CreateVkSemaphore(device, image_available_semaphore);
-	VkHelper::CreateVkSemaphore(device, render_finished_semaphore);
+	// Create the per frame semaphores, fences and command buffers for the frames in flight
+	VkHelper::CreateFrameLoop(
+		device,
+		command_pool,
+		swapchain_image_count,                                 // How many images the frames will be rendering into
+		frames_in_flight,                                      // How many frames can be worked on at once
+		frame_loop
+	);
+	// Acquire and present from the offscreen images rather than a swapchain
+	if (headless.enabled) frame_loop.headless_swapchain = &headless_swapchain;
 
 	VkCommandBufferAllocateInfo command_buffer_allocate_info = VkHelper::CommandBufferAllocateInfo(
 		command_pool,
@@ -314,10 +359,6 @@ void Setup()
 	);
 	assert(allocate_command_buffer_resut == VK_SUCCESS);
 
-	render_submission_info = VkHelper::SubmitInfo(1, &image_available_semaphore, 1, &render_finished_semaphore, wait_stages);
-
-	present_info = VkHelper::PresentInfoKHR(1, &render_finished_semaphore, swap_chain);
-
 }
 
 // Everything within the Destroy is from previous tuturials
@@ -334,25 +375,10 @@ void Destroy()
 {
 	DestroyRenderResources();
 
-	for (uint32_t i = 0; i < swapchain_image_count; i++)
-	{
-		vkDestroyFence(
-			device,
-			fences.get()[i],
-			nullptr
-		);
-	}
-
-	vkDestroySemaphore(
-		device,
-		image_available_semaphore,
-		nullptr
-	);
-
-	vkDestroySemaphore(
+	VkHelper::DestroyFrameLoop(
 		device,
-		render_finished_semaphore,
-		nullptr
+		command_pool,
+		frame_loop
 	);
 
 
@@ -363,6 +389,15 @@ void Destroy()
 		nullptr
 	);
 
+	// Write the pipeline cache out so the next run can skip compiling the shaders
+	VkHelper::DestroyPipelineCache(device);
+
+	// Any samplers the textures and attachments didn't give back are still held by the cache, they go before the device
+	VkHelper::DestroySamplerCache(device);
+
+	// The device is going away, free its dispatch table so a later device given the same handle loads its own
+	VkHelper::UnregisterDeviceDispatch(device);
+
 	// Clean up the device now that the project is stopping
 	vkDestroyDevice(
 		device,
@@ -371,10 +406,13 @@ void Destroy()
 
 	// Destroy the debug callback
 	// We cant directly call vkDestroyDebugReportCallbackEXT as we need to find the pointer within the Vulkan DLL, See function inplmentation for details.
-	VkHelper::DestroyDebugger(
-		instance, 
-		debugger
-	);
+	if (!headless.enabled)
+	{
+		VkHelper::DestroyDebugger(
+			instance, 
+			debugger
+		);
+	}
 
 	// Clean up the vulkan instance
 	vkDestroyInstance(
@@ -382,25 +420,46 @@ void Destroy()
 		NULL
 	);
 
-	DestroyWindow();
+	if (!headless.enabled) DestroyWindow();
 }
 
 
 void CreateRenderResources()
 {
-	swap_chain = VkHelper::CreateSwapchain(
-		physical_device,
-		device,
-		surface,
-		surface_capabilities,
-		surface_format,
-		present_mode,
-		window_width,
-		window_height,
-		swapchain_image_count,
-		swapchain_images,
-		swapchain_image_views
-	);
+	if (headless.enabled)
+	{
+		// Three images, the same as a triple buffered swapchain
+		surface_format.format = VK_FORMAT_B8G8R8A8_UNORM;
+		swap_chain = VK_NULL_HANDLE;
+		VkHelper::CreateHeadlessSwapchain(
+			device,
+			physical_device_mem_properties,
+			surface_format.format,
+			window_width,
+			window_height,
+			3,
+			headless_swapchain,
+			swapchain_image_count,
+			swapchain_images,
+			swapchain_image_views
+		);
+	}
+	else
+	{
+		swap_chain = VkHelper::CreateSwapchain(
+			physical_device,
+			device,
+			surface,
+			surface_capabilities,
+			surface_format,
+			present_mode,
+			window_width,
+			window_height,
+			swapchain_image_count,
+			swapchain_images,
+			swapchain_image_views
+		);
+	}
 
 
 	const VkFormat colorFormat = VK_FORMAT_R8G8B8A8_UNORM;
@@ -432,11 +491,21 @@ void DestroyRenderResources()
 		nullptr
 	);
 
-	vkDestroySwapchainKHR(
-		device,
-		swap_chain,
-		nullptr
-	);
+	if (headless.enabled)
+	{
+		VkHelper::DestroyHeadlessSwapchain(
+			device,
+			headless_swapchain
+		);
+	}
+	else
+	{
+		vkDestroySwapchainKHR(
+			device,
+			swap_chain,
+			nullptr
+		);
+	}
 
 	for (uint32_t i = 0; i < swapchain_image_count; i++)
 	{
@@ -468,10 +537,9 @@ void DestroyRenderResources()
 			framebuffer_attachments.get()[i].color.memory,
 			nullptr
 		);
-		vkDestroySampler(
+		VkHelper::ReleaseSampler(
 			device,
-			framebuffer_attachments.get()[i].color.sampler,
-			nullptr
+			framebuffer_attachments.get()[i].color.sampler
 		);
 		vkDestroyImageView(
 			device,
@@ -488,22 +556,26 @@ void DestroyRenderResources()
 			framebuffer_attachments.get()[i].depth.memory,
 			nullptr
 		);
-		vkDestroySampler(
+		VkHelper::ReleaseSampler(
 			device,
-			framebuffer_attachments.get()[i].depth.sampler,
-			nullptr
+			framebuffer_attachments.get()[i].depth.sampler
 		);
 	}
 }
 
 void RebuildRenderResources()
 {
+	// Only the window can go out of date, the headless images stay the same size
+	assert(!headless.enabled);
+
 	// Wait for the device to finish
 	VkResult device_idle_result = vkDeviceWaitIdle(device);
 	assert(device_idle_result == VK_SUCCESS);
 	// Destroy and rebuild the render resources
 	DestroyRenderResources();
 	CreateRenderResources();
+	// The old swapchain images are gone, so forget which frames were using them
+	VkHelper::ResetFrameLoopImages(frame_loop, swapchain_image_count);
 	BuildCommandBuffers(graphics_command_buffers, swapchain_image_count);
 }
 
@@ -577,14 +649,14 @@ void BuildCommandBuffers(std::unique_ptr<VkCommandBuffer>& command_buffers, cons
 		assert(begin_command_buffer_result == VK_SUCCESS);
 
 		// Define that we will be starting a new render pass
-		vkCmdBeginRenderPass(
+		device_dispatch->vkCmdBeginRenderPass(
 			command_buffers.get()[i],
 			&render_pass_info,
 			VK_SUBPASS_CONTENTS_INLINE
 		);
 
 		// Set the viewport
-		vkCmdSetViewport(
+		device_dispatch->vkCmdSetViewport(
 			command_buffers.get()[i],
 			0,
 			1,
@@ -592,7 +664,7 @@ void BuildCommandBuffers(std::unique_ptr<VkCommandBuffer>& command_buffers, cons
 		);
 
 		// Set the scissor region
-		vkCmdSetScissor(
+		device_dispatch->vkCmdSetScissor(
 			command_buffers.get()[i],
 			0,
 			1,
@@ -600,14 +672,14 @@ void BuildCommandBuffers(std::unique_ptr<VkCommandBuffer>& command_buffers, cons
 		);
 
 		// Bind the graphics pipeline
-		vkCmdBindPipeline(
+		device_dispatch->vkCmdBindPipeline(
 			command_buffers.get()[i],
 			VK_PIPELINE_BIND_POINT_GRAPHICS,
 			graphics_pipeline
 		);
 
 		// Bind the models vertex buffer
-		vkCmdBindVertexBuffers(
+		device_dispatch->vkCmdBindVertexBuffers(
 			command_buffers.get()[i],
 			0,
 			1,
@@ -616,7 +688,7 @@ void BuildCommandBuffers(std::unique_ptr<VkCommandBuffer>& command_buffers, cons
 		);
 
 		// Bind the models index buffer
-		vkCmdBindIndexBuffer(
+		device_dispatch->vkCmdBindIndexBuffer(
 			command_buffers.get()[i],
 			index_buffer,
 			0,
@@ -624,7 +696,7 @@ void BuildCommandBuffers(std::unique_ptr<VkCommandBuffer>& command_buffers, cons
 		);
 
 		// Draw the model
-		vkCmdDrawIndexed(
+		device_dispatch->vkCmdDrawIndexed(
 			command_buffers.get()[i],
 			3,							// The model consists of 3 verticies
 			1,							// Draw once model
@@ -635,7 +707,7 @@ void BuildCommandBuffers(std::unique_ptr<VkCommandBuffer>& command_buffers, cons
 
 
 		// End the rendering
-		vkCmdEndRenderPass(
+		device_dispatch->vkCmdEndRenderPass(
 			command_buffers.get()[i]
 		);
 
@@ -649,72 +721,43 @@ void BuildCommandBuffers(std::unique_ptr<VkCommandBuffer>& command_buffers, cons
 
 void Render()
 {
-	// Find next image
-	VkResult wait_for_fences = vkWaitForFences(
-		device,
-		1,
-		&fences.get()[current_frame_index],
-		VK_TRUE,
-		UINT32_MAX
-	);
-	assert(wait_for_fences == VK_SUCCESS);
-
-	VkResult acquire_next_image_result = vkAcquireNextImageKHR(
+	// Wait for the oldest frame in flight to finish and find the next image
+	VkResult begin_frame_result = VkHelper::BeginFrame(
 		device,
 		swap_chain,
-		UINT64_MAX,
-		image_available_semaphore,
-		VK_NULL_HANDLE,
-		&current_frame_index
-	);
-	assert(acquire_next_image_result == VK_SUCCESS);
-
-	// Reset and wait
-	VkResult queue_idle_result = vkQueueWaitIdle(
-		graphics_queue
+		frame_loop
 	);
-	assert(queue_idle_result == VK_SUCCESS);
+	// The swapchain no longer matches the window, rebuild it and pick the frame up next time round
+	if (begin_frame_result == VK_ERROR_OUT_OF_DATE_KHR)
+	{
+		RebuildRenderResources();
+		return;
+	}
 
-	VkResult reset_fences_result = vkResetFences(
+	// Submit the commands recorded for this image and present it. We don't wait for the GPU here, the CPU carries
+	// straight on with the next frame while this one is being rendered
+	VkResult end_frame_result = VkHelper::EndFrame(
 		device,
-		1,
-		&fences.get()[current_frame_index]
-	);
-	assert(reset_fences_result == VK_SUCCESS);
-
-	render_submission_info.pCommandBuffers = &graphics_command_buffers.get()[current_frame_index];
-
-	VkResult queue_submit_result = vkQueueSubmit(
 		graphics_queue,
-		1,
-		&render_submission_info,
-		fences.get()[current_frame_index]
-	);
-	assert(queue_submit_result == VK_SUCCESS);
-
-	present_info.pImageIndices = &current_frame_index;
-
-	VkResult queue_present_result = vkQueuePresentKHR(
 		present_queue,
-		&present_info
+		swap_chain,
+		frame_loop,
+		&graphics_command_buffers.get()[frame_loop.image_index],  // The command buffer that renders to this image
+		1,
+		VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT              // Only the colour output needs to wait for the image
 	);
 	// If the window was resized or something else made the current render invalid, we need to rebuild all the
 	// render resources
-	if (queue_present_result == VK_ERROR_OUT_OF_DATE_KHR)
+	if (end_frame_result == VK_ERROR_OUT_OF_DATE_KHR)
 	{
 		RebuildRenderResources();
 	}
-
-	assert(queue_present_result == VK_SUCCESS || queue_present_result == VK_ERROR_OUT_OF_DATE_KHR);
-
-
-	VkResult device_idle_result = vkDeviceWaitIdle(device);
-	assert(device_idle_result == VK_SUCCESS);
 }
 
 int main(int argc, char **argv)
 {
 
+	headless = VkHelper::ParseHeadlessOptions(argc, argv);
 	Setup();
 
 	// Create a peipeline layout, a pipeline layout defines what descriptors to accept
@@ -965,10 +1008,13 @@ int main(int argc, char **argv)
 	pipeline_info.flags = VK_PIPELINE_CREATE_ALLOW_DERIVATIVES_BIT;
 
 
+	// Time how long the driver takes to build the pipelines, compare the first run (cold cache) with later runs (warm cache)
+	std::chrono::high_resolution_clock::time_point pipeline_build_start = std::chrono::high_resolution_clock::now();
+
 	// Create the pipeline
 	VkResult create_graphics_pipeline_result = vkCreateGraphicsPipelines(
 		device,
-		VK_NULL_HANDLE,
+		VkHelper::GetPipelineCache(),                          // Reuse any shaders compiled on a previous run
 		1,
 		&pipeline_info,
 		nullptr,
@@ -977,6 +1023,10 @@ int main(int argc, char **argv)
 	// Was the pipeline created okay
 	assert(create_graphics_pipeline_result == VK_SUCCESS);
 
+	std::chrono::high_resolution_clock::time_point pipeline_build_end = std::chrono::high_resolution_clock::now();
+	std::cout << "Pipeline creation took " << std::chrono::duration_cast<std::chrono::microseconds>(pipeline_build_end - pipeline_build_start).count() / 1000.0f
+		<< "ms (" << (VkHelper::PipelineCacheLoadedFromDisk() ? "warm" : "cold") << " pipeline cache)" << std::endl;
+
 
 	// Create the models vertex buffer
 	VkHelper::CreateBuffer(
@@ -1063,11 +1113,28 @@ int main(int argc, char **argv)
 
 
 
+	std::chrono::high_resolution_clock::time_point render_start = std::chrono::high_resolution_clock::now();
+
 	while (window_open)
 	{
-		PollWindow();
+		if (!headless.enabled) PollWindow();
 
 		Render();
+
+		// A headless run stops after a fixed number of frames so runs can be compared
+		if (headless.enabled && headless.frame_count > 0 && frame_loop.frame_number >= headless.frame_count) window_open = false;
+	}
+
+	// Let the frames that are still in flight finish before we start cleaning up
+	VkResult device_idle_result = vkDeviceWaitIdle(device);
+	assert(device_idle_result == VK_SUCCESS);
+
+	if (headless.enabled)
+	{
+		std::chrono::high_resolution_clock::time_point render_end = std::chrono::high_resolution_clock::now();
+		float render_ms = std::chrono::duration_cast<std::chrono::microseconds>(render_end - render_start).count() / 1000.0f;
+		std::cout << "Rendered " << frame_loop.frame_number << " headless frames in " << render_ms << "ms, "
+			<< render_ms / frame_loop.frame_number << "ms per frame" << std::endl;
 	}
 
 	vkDestroyPipeline(
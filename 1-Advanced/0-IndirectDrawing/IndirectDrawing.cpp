@@ -1,11 +1,16 @@
 
+// The window surface is only hooked up for Windows, anywhere else the sample can still be run with --headless
+#ifdef _WIN32
 #define VK_USE_PLATFORM_WIN32_KHR
+#endif
 #include <assert.h>
 #include <stdio.h>
 #include <string.h>
 #include <memory>
 #include <stdexcept>
 #include <iostream>
+#include <chrono>
+#include <algorithm>
 
 
 #define GLM_ENABLE_EXPERIMENTAL
@@ -25,9 +30,30 @@
 
 #include <VkInitializers.hpp>
 #include <VkCore.hpp>
-
-
-#define MODEL_COUNT 25
+#include <VkDispatch.hpp>
+#include <VkPipelineCache.hpp>
+#include <VkMeshCache.hpp>
+#include <VkMipmaps.hpp>
+#include <VkKtx.hpp>
+#include <VkTextureLoader.hpp>
+#include <VkPipelineBuildQueue.hpp>
+#include <VkFrameLoop.hpp>
+#include <VkRingBuffer.hpp>
+#include <VkUploadManager.hpp>
+#include <VkTextureHeap.hpp>
+#include <VkDescriptorAllocator.hpp>
+#include <VkDescriptorTemplate.hpp>
+#include <VkHeadless.hpp>
+#include <VkGpuProfiler.hpp>
+#include <VkCpuProfiler.hpp>
+#include <VkBenchmark.hpp>
+
+
+// Enough octopi that most of them are outside the view, so the culling has something to do
+#define MODEL_COUNT 100000
+// When true a compute pass culls the instances against the camera before they are drawn. Set to false to draw
+// every instance, so the two paths can be compared
+#define GPU_FRUSTUM_CULLING true
 
 struct SBuffer
 {
@@ -39,20 +65,31 @@ struct SBuffer
 	VkMemoryPropertyFlags buffer_memory_properties;
 	// Raw pointer that will point to GPU memory
 	void* mapped_buffer_memory = nullptr;
+	// Region of the allocators memory the buffer is bound to
+	VkHelper::Allocation allocation;
 };
 
 struct STexture
 {
-	SBuffer transfer_buffer;
 	unsigned int width;
 	unsigned int height;
+	uint32_t mip_levels;
 	VkFormat format;
 
 	VkImage image;
-	VkDeviceMemory memory;
+	// Region of the allocators memory the image is bound to
+	VkHelper::Allocation allocation;
 	VkImageView view;
 	VkImageLayout layout;
 	VkSampler sampler;
+	// Where the texture sits in the bindless texture heap, materials refer to it by this index
+	uint32_t heap_index;
+};
+
+// One entry of the material table the fragment shader reads with the vertices matID
+struct SMaterial
+{
+	uint32_t albedo_texture;                // Index into the texture heap
 };
 
 struct SCamera
@@ -79,6 +116,24 @@ struct ModelInstance
 	unsigned int index_offset = 0;
 	unsigned int vertex_count = 0;
 	unsigned int index_count = 0;
+	glm::vec4 bounding_sphere;              // xyz is the center of the model, w is its radius
+	unsigned int material_offset = 0;       // Where the models materials start in the material table
+};
+
+// Settings the frustum cull compute shader reads
+struct SCullSettings
+{
+	glm::vec4 bounding_sphere;
+	uint32_t instance_count;
+};
+
+// Everything the cull descriptor set points at, written in one go through the cull descriptor template
+struct SCullDescriptors
+{
+	VkDescriptorBufferInfo instances;           // All the instances
+	VkDescriptorBufferInfo visible_instances;   // The visible instances
+	VkDescriptorBufferInfo indirect_command;    // The indirect command
+	VkDescriptorBufferInfo settings;            // The cull settings
 };
 
 
@@ -106,9 +161,22 @@ VkPhysicalDeviceProperties physical_device_properties;
 VkPhysicalDeviceFeatures physical_device_features;
 VkPhysicalDeviceMemoryProperties physical_device_mem_properties;
 
+// Sub allocates buffer and image memory out of large blocks
+VkHelper::Allocator allocator;
+
+// Batches up texture and buffer uploads into as few submits as possible
+VkHelper::UploadManager upload_manager;
+// Builds the mip chain of the textures as they are uploaded
+VkHelper::MipmapGenerator mipmap_generator;
+
 VkDevice device = VK_NULL_HANDLE;
+// The devices own functions, the commands recorded every frame are called through this rather than the loader
+const VkHelper::DeviceDispatch* device_dispatch = nullptr;
 VkQueue graphics_queue = VK_NULL_HANDLE;
 VkQueue present_queue = VK_NULL_HANDLE;
+// Queue used for uploads, this will be the graphics queue if the GPU has no dedicated transfer queue
+VkQueue transfer_queue = VK_NULL_HANDLE;
+uint32_t transfer_queue_family = 0;
 VkCommandPool command_pool;
 
 
@@ -133,43 +201,62 @@ VkRenderPass renderpass = VK_NULL_HANDLE;
 std::unique_ptr<VkFramebuffer> framebuffers = nullptr;
 std::unique_ptr<VkHelper::VulkanAttachments> framebuffer_attachments = nullptr;
 
-uint32_t current_frame_index = 0; // What frame are we currently using
-std::unique_ptr<VkFence> fences = nullptr;
+// How many frames the CPU is allowed to get ahead of the GPU
+const uint32_t frames_in_flight = 2;
+VkHelper::FrameLoop frame_loop;
+
+// Start with --headless [frame count] to render a fixed number of frames into offscreen images, with no window
+VkHelper::HeadlessOptions headless;
+VkHelper::HeadlessSwapchain headless_swapchain;
+
+// Start with --gpu-profile to time the cull and draw on the GPU. The timings are printed every few hundred frames and
+// written out as a Chrome trace when the sample closes
+bool gpu_profile = false;
+VkHelper::GpuProfiler gpu_profiler;
+uint32_t cull_gpu_scope = 0;
+uint32_t draw_gpu_scope = 0;
+
+// Started by the benchmark runner with --benchmark <output path> [--warmup frame count]. Records the startup phases,
+// frame times, GPU timings and peak memory, and writes them out when the sample closes
+VkHelper::BenchmarkRecorder benchmark;
 
-VkSemaphore image_available_semaphore;
-VkSemaphore render_finished_semaphore;
-VkSubmitInfo render_submission_info = {};
-VkPresentInfoKHR present_info = {};
-VkPipelineStageFlags wait_stages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+VkHelper::PipelineBuildQueue pipeline_build_queue;
 
 std::unique_ptr<VkCommandBuffer> graphics_command_buffers = nullptr;
 
 const unsigned int shader_stage_count = 2;
 std::unique_ptr<VkShaderModule> graphics_shader_modules;
 VkPipeline graphics_pipeline = VK_NULL_HANDLE;
+std::shared_future<VkPipeline> graphics_pipeline_build;
 VkPipelineLayout graphics_pipeline_layout = VK_NULL_HANDLE;
 
 
 VkBuffer particle_vertex_buffer = VK_NULL_HANDLE;
-VkDeviceMemory particle_vertex_buffer_memory = VK_NULL_HANDLE;
+// Region of the allocators memory the vertex buffer is bound to
+VkHelper::Allocation particle_vertex_buffer_allocation;
 // Raw pointer that will point to GPU memory
 void* particle_vertex_mapped_buffer_memory = nullptr;
 
 
 VkBuffer index_buffer = VK_NULL_HANDLE;
-VkDeviceMemory index_buffer_memory = VK_NULL_HANDLE;
+// Region of the allocators memory the index buffer is bound to
+VkHelper::Allocation index_buffer_allocation;
 // Raw pointer that will point to GPU memory
 void* index_mapped_buffer_memory = nullptr;
 
 SCamera camera;
-SBuffer camera_buffer;
-VkDescriptorPool camera_descriptor_pool;
+// Per frame uniform data, each swapchain image has its own region so we never write to memory the GPU is reading
+VkHelper::RingBuffer uniform_buffer;
 VkDescriptorSetLayout camera_descriptor_set_layout;
 VkDescriptorSet camera_descriptor_set;
 
-VkDescriptorPool texture_descriptor_pool;
-VkDescriptorSetLayout texture_descriptor_set_layout;
-VkDescriptorSet texture_descriptor_set;
+// Every texture is in one descriptor array that is bound once, shaders pick the texture through the material table
+VkHelper::TextureHeap texture_heap;
+// Every other descriptor set comes from here, it makes more pools as they fill up rather than each set needing its own
+VkHelper::DescriptorAllocator descriptor_allocator;
+// The materials of every loaded model, the vertices matID indexes this
+std::vector<SMaterial> materials;
+SBuffer material_buffer;
 
 ModelInstance octopus_model;
 
@@ -179,6 +266,19 @@ SBuffer model_position_buffer;
 VkDrawIndexedIndirectCommand indirect_draw_command;
 SBuffer indirect_draw_buffer;
 
+// The instances that survived the frustum cull, this is the buffer the draw reads its model matrices from
+SBuffer visible_model_position_buffer;
+SBuffer cull_settings_buffer;
+
+VkShaderModule cull_shader_module;
+VkPipeline cull_pipeline = VK_NULL_HANDLE;
+std::shared_future<VkPipeline> cull_pipeline_build;
+VkPipelineLayout cull_pipeline_layout = VK_NULL_HANDLE;
+
+// The cull set layout and the update template that writes it
+VkHelper::DescriptorTemplate cull_descriptor_template;
+VkDescriptorSet cull_descriptor_set;
+
 // Create a new sdl window
 void WindowSetup(const char* title, int width, int height)
 {
@@ -204,6 +304,7 @@ void WindowSetup(const char* title, int width, int height)
 
 void BuildCamera()
 {
+	VK_HELPER_CPU_ZONE("BuildCamera");
 	camera.camera_position = glm::mat4(1.0f);
 	camera.camera_position = glm::translate(camera.camera_position, glm::vec3( 0.0f, -2.0f, -10.0f ));
 
@@ -215,10 +316,35 @@ void BuildCamera()
 	);
 	// Flip the cameras prospective upside down as glm assumes that the renderer we are using renders top to bottom, vulkan is the opposite
 	camera.projection[1][1] *= -1.0f;
+}
+
+// Push this frames uniform data into its region of the ring buffer
+void UpdateUniforms(uint32_t frame_index)
+{
+	VK_HELPER_CPU_ZONE("UpdateUniforms");
+	// Wait till the last submit that used this region is done before we write into it
+	VkHelper::BeginRingBufferFrame(
+		device,
+		uniform_buffer,
+		frame_index,
+		VkHelper::CurrentFrameFence(frame_loop)
+	);
 
-	// Transfer data over to the texture buffer
+	uint32_t camera_offset = 0;
+	void* camera_memory = nullptr;
+	bool allocated = VkHelper::RingBufferAllocate(
+		uniform_buffer,                             // What ring buffer are we allocating from
+		sizeof(SCamera),                            // How much memory do we need
+		camera_offset,                              // The dynamic offset of the data
+		camera_memory                               // Where we can write the data
+	);
+	// The camera is always the first thing we push each frame, so it sits at the start of the frames region.
+	// This is the dynamic offset the command buffers were recorded with
+	assert(allocated && camera_offset == VkHelper::RingBufferRegionOffset(uniform_buffer, frame_index));
+
+	// Transfer data over to the uniform buffer
 	memcpy(
-		camera_buffer.mapped_buffer_memory,         // The destination for our memory (GPU)
+		camera_memory,                              // The destination for our memory (GPU)
 		&camera,                                    // Source for the memory (CPU-Ram)
 		sizeof(SCamera)                             // How much data we are transferring
 	);
@@ -227,6 +353,7 @@ void BuildCamera()
 // Check for window updates and process them
 void PollWindow()
 {
+	VK_HELPER_CPU_ZONE("PollWindow");
 
 	// Poll Window
 	SDL_Event event;
@@ -264,6 +391,7 @@ void DestroyWindow()
 // Create windows surface for sdl to interface with
 void CreateSurface()
 {
+#ifdef VK_USE_PLATFORM_WIN32_KHR
 	auto CreateWin32SurfaceKHR = (PFN_vkCreateWin32SurfaceKHR)vkGetInstanceProcAddr(instance, "vkCreateWin32SurfaceKHR");
 
 	VkWin32SurfaceCreateInfoKHR createInfo = {};
@@ -275,6 +403,9 @@ void CreateSurface()
 	{
 		throw std::runtime_error("failed to create window surface!");
 	}
+#else
+	throw std::runtime_error("window surfaces are only supported on windows, run with --headless instead");
+#endif
 }
 
 // Everything within the Setup is from previous tutorials
@@ -290,18 +421,36 @@ void CreateSurface()
 // - Renderpass
 void Setup()
 {
+	VK_HELPER_CPU_ZONE("Setup");
 
-	WindowSetup("Vulkan", 1080, 720);
+	if (headless.enabled)
+	{
+		// No window, the offscreen images are the size the window would have been
+		window_width = 1080;
+		window_height = 720;
+		window_open = true;
+	}
+	else
+	{
+		WindowSetup("Vulkan", 1080, 720);
+	}
 
 
 	// Define what Layers and Extensions we require
-	const uint32_t extention_count = 3;
-	const char *instance_extensions[extention_count] = { "VK_EXT_debug_report" ,VK_KHR_SURFACE_EXTENSION_NAME,VK_KHR_WIN32_SURFACE_EXTENSION_NAME };
-	const uint32_t layer_count = 1;
-	const char *instance_layers[layer_count] = { "VK_LAYER_LUNARG_standard_validation" };
+#ifdef VK_USE_PLATFORM_WIN32_KHR
+	const uint32_t window_extention_count = 3;
+	const char *instance_extensions[window_extention_count] = { "VK_EXT_debug_report" ,VK_KHR_SURFACE_EXTENSION_NAME,VK_KHR_WIN32_SURFACE_EXTENSION_NAME };
+#else
+	const uint32_t window_extention_count = 1;
+	const char *instance_extensions[window_extention_count] = { "VK_EXT_debug_report" };
+#endif
+	const char *instance_layers[1] = { "VK_LAYER_LUNARG_standard_validation" };
+	// A headless run needs no surface, and is left without the validation layers as they would be most of what it times
+	const uint32_t extention_count = headless.enabled ? 0 : window_extention_count;
+	const uint32_t layer_count = headless.enabled ? 0 : 1;
 
 	// Check to see if we have the layer requirments
-	assert(VkHelper::CheckLayersSupport(instance_layers, 1) && "Unsupported Layers Found");
+	assert(VkHelper::CheckLayersSupport(instance_layers, layer_count) && "Unsupported Layers Found");
 
 	// Create the Vulkan Instance
 	instance = VkHelper::CreateInstance(
@@ -313,18 +462,20 @@ void Setup()
 
 	// Attach a debugger to the application to give us validation feedback.
 	// This is useful as it tells us about any issues without application
-	debugger = VkHelper::CreateDebugger(instance);
+	if (!headless.enabled) debugger = VkHelper::CreateDebugger(instance);
 
 	// Define what Device Extensions we require
-	const uint32_t physical_device_extention_count = 1;
+	const uint32_t physical_device_extention_count = 2;
 	// Note that this extension list is different from the instance on as we are telling the system what device settings we need.
-	const char *physical_device_extensions[physical_device_extention_count] = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
+	// The swapchain extension is still needed headless, the render pass leaves its images in the present layout
+	// Descriptor indexing lets all of the textures live in one bindless array
+	const char *physical_device_extensions[physical_device_extention_count] = { VK_KHR_SWAPCHAIN_EXTENSION_NAME, VkHelper::TextureHeapExtension() };
 
 
 
 	// The surface creation is added here as it needs to happen before the physical device creation and after we have said to the instance that we need a surface
 	// The surface is the reference back to the OS window
-	CreateSurface();
+	if (!headless.enabled) CreateSurface();
 
 
 
@@ -345,25 +496,47 @@ void Setup()
 	// Make sure we found a physical device
 	assert(foundPhysicalDevice);
 
-	// Define how many queues we will need in our project, for now, we will just create a single queue
-	static const float queue_priority = 1.0f;
-	VkDeviceQueueCreateInfo queue_create_info = VkHelper::DeviceQueueCreateInfo(
-		&queue_priority,
-		1,
-		physical_devices_queue_family
+	// Make sure the device can index a partially bound texture array that is updated after it is bound
+	assert(VkHelper::SupportsTextureHeap(physical_device));
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT texture_heap_features = VkHelper::TextureHeapFeatures();
+
+	// Look for a dedicated transfer queue family, uploads will run there so they don't hold up rendering
+	bool has_transfer_queue = VkHelper::FindTransferQueueFamily(
+		physical_device,
+		transfer_queue_family
 	);
+	if (!has_transfer_queue) transfer_queue_family = physical_devices_queue_family;
+
+	// Define how many queues we will need in our project, a graphics queue and a transfer queue if there is one
+	static const float queue_priority = 1.0f;
+	const uint32_t queue_create_info_count = has_transfer_queue ? 2 : 1;
+	VkDeviceQueueCreateInfo queue_create_info[2] = {
+		VkHelper::DeviceQueueCreateInfo(
+			&queue_priority,
+			1,
+			physical_devices_queue_family
+		),
+		VkHelper::DeviceQueueCreateInfo(
+			&queue_priority,
+			1,
+			transfer_queue_family
+		)
+	};
 
 
 	// Now we have the physical device, create the device instance
 	device = VkHelper::CreateDevice(                           
 		physical_device,                                       // The physical device we are basic the device from
-		&queue_create_info,                                    // A pointer array, pointing to a list of queues we want to make
-		1,                                                     // How many queues are in the list
+		queue_create_info,                                     // A pointer array, pointing to a list of queues we want to make
+		queue_create_info_count,                               // How many queues are in the list
 		physical_device_features,                              // What features do you want enabled on the device
 		physical_device_extensions,                            // What extensions do you want on the device
-		physical_device_extention_count                        // How many extensions are there
+		physical_device_extention_count,                       // How many extensions are there
+		&texture_heap_features                                 // Turn on the descriptor indexing features the texture heap uses
 	);
 
+	device_dispatch = &VkHelper::GetDeviceDispatch(device);
+
 	vkGetDeviceQueue(
 		device,
 		physical_devices_queue_family,
@@ -371,6 +544,42 @@ void Setup()
 		&graphics_queue
 	);
 
+	// Create the allocator that our buffers and images will get their memory from
+	VkHelper::CreateAllocator(
+		device,
+		physical_device_properties,
+		physical_device_mem_properties,
+		allocator
+	);
+
+	vkGetDeviceQueue(
+		device,
+		transfer_queue_family,
+		0,
+		&transfer_queue
+	);
+
+	// Create the upload manager with a 64MB staging ring
+	VkHelper::CreateUploadManager(
+		device,
+		allocator,
+		transfer_queue,
+		transfer_queue_family,
+		graphics_queue,
+		physical_devices_queue_family,
+		64 * 1024 * 1024,
+		upload_manager
+	);
+
+	// The compute shader is only loaded if a texture format can't be blitted
+	VkHelper::CreateMipmapGenerator(
+		device,
+		physical_device,
+		"../../../Data/Shaders/Mipmaps/Downsample/comp.spv",
+		mipmap_generator
+	);
+	upload_manager.mipmap_generator = &mipmap_generator;
+
 	vkGetDeviceQueue(
 		device,
 		physical_devices_queue_family,
@@ -378,6 +587,20 @@ void Setup()
 		&present_queue
 	);
 
+	// Load the pipeline cache from the last run, all pipelines created through Vk-Helper will use it
+	VkHelper::LoadPipelineCache(
+		device,
+		physical_device_properties,                            // Used to check the cache was made by this GPU and driver
+		"IndirectDrawing.pipelinecache"                        // Where the cache is stored between runs
+	);
+
+	// Start the workers that will compile our pipelines in the background
+	VkHelper::CreatePipelineBuildQueue(
+		device,
+		0,                                                     // Use all but one of the CPU threads
+		pipeline_build_queue
+	);
+
 	command_pool = VkHelper::CreateCommandPool(
 		device,
 		physical_devices_queue_family,                         // What queue family we are wanting to use to send commands to the GPU
@@ -389,12 +612,33 @@ void Setup()
 
 
 
-	// Create the fences required for the swap chain rendering 
-	VkHelper::CreateFence(device, fences, swapchain_image_count);
+	// Create the per frame semaphores, fences and command buffers for the frames in flight
+	VkHelper::CreateFrameLoop(
+		device,
+		command_pool,
+		swapchain_image_count,                                 // How many images the frames will be rendering into
+		frames_in_flight,                                      // How many frames can be worked on at once
+		frame_loop
+	);
+	// Acquire and present from the offscreen images rather than a swapchain
+	if (headless.enabled) frame_loop.headless_swapchain = &headless_swapchain;
 
-	// Create the image available and finished semaphore
-	VkHelper::CreateVkSemaphore(device, image_available_semaphore);
-	VkHelper::CreateVkSemaphore(device, render_finished_semaphore);
+	// Each prerecorded command buffer gets its own slot of timestamp queries, like the camera ring buffer regions
+	if (gpu_profile)
+	{
+		bool gpu_profiler_created = VkHelper::CreateGpuProfiler(
+			physical_device,
+			device,
+			physical_devices_queue_family,
+			swapchain_image_count,                             // A slot for each command buffer
+			2,                                                 // The cull and the draw
+			100000,                                            // How many scopes to keep for the trace
+			gpu_profiler
+		);
+		if (!gpu_profiler_created) std::cout << "The graphics queue can't write timestamps, GPU profiling is off" << std::endl;
+	}
+	cull_gpu_scope = VkHelper::RegisterGpuScope(gpu_profiler, "Frustum cull");
+	draw_gpu_scope = VkHelper::RegisterGpuScope(gpu_profiler, "Indirect draw");
 
 	VkCommandBufferAllocateInfo command_buffer_allocate_info = VkHelper::CommandBufferAllocateInfo(
 		command_pool,
@@ -410,191 +654,119 @@ void Setup()
 	);
 	assert(allocate_command_buffer_resut == VK_SUCCESS);
 
-	render_submission_info = VkHelper::SubmitInfo(1, &image_available_semaphore, 1, &render_finished_semaphore, wait_stages);
-
-	present_info = VkHelper::PresentInfoKHR(1, &render_finished_semaphore, swap_chain);
-
 	// Create the models vertex buffer
 	VkHelper::CreateBuffer(
 		device,                                                          // What device are we going to use to create the buffer
-		physical_device_mem_properties,                                  // What memory properties are available on the device
-		particle_vertex_buffer,                                                   // What buffer are we going to be creating
-		particle_vertex_buffer_memory,                                            // The output for the buffer memory
-		particle_vertex_buffer_size,                                              // How much memory we wish to allocate on the GPU
-		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,                            // What type of buffer do we want. Buffers can have multiple types, for example, uniform & vertex buffer.
+		allocator,                                                       // What allocator are we getting the memory from
+		particle_vertex_buffer,                                          // What buffer are we going to be creating
+		particle_vertex_buffer_allocation,                               // The output for the buffer allocation
+		particle_vertex_buffer_size,                                     // How much memory we wish to allocate on the GPU
+		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,                               // What type of buffer do we want. Buffers can have multiple types, for example, uniform & vertex buffer.
 																		 // for now we want to keep the buffer specialized to one type as this will allow vulkan to optimize the data.
 		VK_SHARING_MODE_EXCLUSIVE,                                       // There are two modes, exclusive and concurrent. Defines if it can concurrently be used by multiple queue
 																		 // families at the same time
 		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT                              // What properties do we require of our memory
 	);
 
-	// Get the pointer to the GPU memory
-	VkResult vertex_mapped_memory_result = vkMapMemory(
-		device,                                                         // The device that the memory is on
-		particle_vertex_buffer_memory,                                           // The device memory instance
-		0,                                                              // Offset from the memory starts that we are accessing
-		particle_vertex_buffer_size,                                             // How much memory are we accessing
-		0,                                                              // Flags (we don't need this for basic buffers)
-		&particle_vertex_mapped_buffer_memory                                    // The return for the memory pointer
-	);
-
-	// Could we map the GPU memory to our CPU accessible pointer
-	assert(vertex_mapped_memory_result == VK_SUCCESS);
+	// The allocator keeps host visible blocks mapped, so we can just take the pointer
+	particle_vertex_mapped_buffer_memory = particle_vertex_buffer_allocation.mapped_memory;
 
 	// Create the models Index buffer
 	VkHelper::CreateBuffer(
 		device,                                                          // What device are we going to use to create the buffer
-		physical_device_mem_properties,                                  // What memory properties are available on the device
+		allocator,                                                       // What allocator are we getting the memory from
 		index_buffer,                                                    // What buffer are we going to be creating
-		index_buffer_memory,                                             // The output for the buffer memory
+		index_buffer_allocation,                                         // The output for the buffer allocation
 		index_buffer_size,                                               // How much memory we wish to allocate on the GPU
-		VK_BUFFER_USAGE_INDEX_BUFFER_BIT,                            // What type of buffer do we want. Buffers can have multiple types, for example, uniform & vertex buffer.
+		VK_BUFFER_USAGE_INDEX_BUFFER_BIT,                                // What type of buffer do we want. Buffers can have multiple types, for example, uniform & vertex buffer.
 																		 // for now we want to keep the buffer specialized to one type as this will allow vulkan to optimize the data.
 		VK_SHARING_MODE_EXCLUSIVE,                                       // There are two modes, exclusive and concurrent. Defines if it can concurrently be used by multiple queue
 																		 // families at the same time
 		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT                              // What properties do we require of our memory
 	);
 
-	// Get the pointer to the GPU memory
-	VkResult index_mapped_memory_result = vkMapMemory(
-		device,                                                         // The device that the memory is on
-		index_buffer_memory,                                            // The device memory instance
-		0,                                                              // Offset from the memory starts that we are accessing
-		index_buffer_size,                                              // How much memory are we accessing
-		0,                                                              // Flags (we don't need this for basic buffers)
-		&index_mapped_buffer_memory                                     // The return for the memory pointer
-	);
-
-	// Could we map the GPU memory to our CPU accessible pointer
-	assert(index_mapped_memory_result == VK_SUCCESS);
-
+	// The allocator keeps host visible blocks mapped, so we can just take the pointer
+	index_mapped_buffer_memory = index_buffer_allocation.mapped_memory;
 
 
-	// Define how many descriptor pools we will need
-	const uint32_t descriptor_pool_size_count = 1;
 
-	// Define that the new descriptor pool will be taking a combined image sampler
-	VkDescriptorPoolSize texture_pool_size[descriptor_pool_size_count] = {
-		VkHelper::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1)
-	};
-
-	// Create the new descriptor pool with the defined settings
-	texture_descriptor_pool = VkHelper::CreateDescriptorPool(
+	// Create the bindless texture heap. Textures are added to it as they are created and stay there until they are
+	// destroyed, so the set is bound once and never rebuilt
+	VkHelper::CreateTextureHeap(
 		device,
-		texture_pool_size,
-		descriptor_pool_size_count,
-		1															// How many descriptor sets do will we need
-																	// Since we are only rendering one image, just 1
+		physical_device,
+		1024,                                                           // How many textures it can hold
+		VK_SHADER_STAGE_FRAGMENT_BIT,                                   // Only the fragment shader samples them
+		texture_heap
 	);
 
-	// Define at what stage of the rendering pipeline the texture is coming into as well as what shader and what location
-	VkDescriptorSetLayoutBinding layout_bindings[descriptor_pool_size_count] = {
-		VkHelper::DescriptorSetLayoutBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT)
-	};
 
-	// Create the new texture set layout
-	texture_descriptor_set_layout = VkHelper::CreateDescriptorSetLayout(
-		device,
-		layout_bindings,
-		descriptor_pool_size_count
-	);
 
-	// Allocate a new texture descriptor set from the pool
-	texture_descriptor_set = VkHelper::AllocateDescriptorSet(
+	// Create the descriptor allocator, pools are made the first time a set is allocated from it
+	std::vector<VkHelper::DescriptorPoolRatio> descriptor_pool_ratios = VkHelper::DefaultDescriptorPoolRatios();
+	VkHelper::CreateDescriptorAllocator(
 		device,
-		texture_descriptor_pool,
-		texture_descriptor_set_layout,
-		1
+		descriptor_pool_ratios.data(),
+		static_cast<uint32_t>(descriptor_pool_ratios.size()),
+		16,                                                             // How many sets the first pool holds, later pools are larger
+		0,                                                              // The sets are freed together when the allocator is destroyed
+		descriptor_allocator
 	);
 
 
 
-
-	camera_buffer.buffer_size = sizeof(SCamera);
-	camera_buffer.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
-	camera_buffer.sharing_mode = VK_SHARING_MODE_EXCLUSIVE;
-	camera_buffer.buffer_memory_properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-
-	// Create a temp buffer to store the image in before we transfer it over to the image
-	VkHelper::CreateBuffer(
-		device,								   // What device are we going to use to create the buffer
-		physical_device_mem_properties,		   // What memory properties are available on the device
-		camera_buffer.buffer,                  // What buffer are we going to be creating
-		camera_buffer.buffer_memory,           // The output for the buffer memory
-		camera_buffer.buffer_size,             // How much memory we wish to allocate on the GPU
-		camera_buffer.usage,                   // What type of buffer do we want. Buffers can have multiple types, for example, uniform & vertex buffer.
-											   // for now we want to keep the buffer specialized to one type as this will allow vulkan to optimize the data.
-		camera_buffer.sharing_mode,            // There are two modes, exclusive and concurrent. Defines if it can concurrently be used by multiple queue
-											   // families at the same time
-		camera_buffer.buffer_memory_properties // What properties do we require of our memory
-	);
-
-	// Get the pointer to the GPU memory
-	VkResult mapped_memory_result = vkMapMemory(
-		device,                                        // The device that the memory is on
-		camera_buffer.buffer_memory,                   // The device memory instance
-		0,                                             // Offset from the memory starts that we are accessing
-		camera_buffer.buffer_size,                     // How much memory are we accessing
-		0,                                             // Flags (we don't need this for basic buffers)
-		&camera_buffer.mapped_buffer_memory            // The return for the memory pointer
+	// Create the ring buffer the camera will be pushed into every frame
+	VkHelper::CreateRingBuffer(
+		device,                                // What device are we going to use to create the buffer
+		allocator,                             // What allocator are we getting the memory from
+		physical_device_properties,            // Used to find the dynamic offset alignment
+		64 * 1024,                             // How much data can each frame push
+		swapchain_image_count,                 // One region for each frame that can be in flight
+		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,    // The ranges will be bound as dynamic uniform buffers
+		uniform_buffer                         // The output ring buffer
 	);
 
-	// Could we map the GPU memory to our CPU accessible pointer
-	assert(mapped_memory_result == VK_SUCCESS);
-
 
 
 	BuildCamera();
 	
 
 
-	// Define how many descriptor pools we will need
-	const uint32_t camera_descriptor_pool_size_count = 1;
-
-	// Define that the new descriptor pool will be taking a combined image sampler
-	VkDescriptorPoolSize camera_pool_size[camera_descriptor_pool_size_count] = {
-		VkHelper::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1)
-	};
-
-
-	// Create the new descriptor pool with the defined settings
-	camera_descriptor_pool = VkHelper::CreateDescriptorPool(
-		device,
-		camera_pool_size,
-		camera_descriptor_pool_size_count,
-		1															// How many descriptor sets do will we need
-																	// Since we are only rendering one image, just 1
-	);
+	// Define how many bindings the camera set has, the camera and the material table
+	const uint32_t camera_descriptor_binding_count = 2;
 
 	// Define at what stage of the rendering pipeline the texture is coming into as well as what shader and what location
-	VkDescriptorSetLayoutBinding camera_layout_bindings[camera_descriptor_pool_size_count] = {
-		VkHelper::DescriptorSetLayoutBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT)
+	VkDescriptorSetLayoutBinding camera_layout_bindings[camera_descriptor_binding_count] = {
+		// The frustum cull compute shader also needs the camera
+		VkHelper::DescriptorSetLayoutBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT),
+		// The material table, written once the models have been loaded
+		VkHelper::DescriptorSetLayoutBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_FRAGMENT_BIT)
 	};
 
 	// Create the new texture set layout
 	camera_descriptor_set_layout = VkHelper::CreateDescriptorSetLayout(
 		device,
 		camera_layout_bindings,
-		camera_descriptor_pool_size_count
+		camera_descriptor_binding_count
 	);
 
-	// Allocate a new texture descriptor set from the pool
-	camera_descriptor_set = VkHelper::AllocateDescriptorSet(
-		device,
-		camera_descriptor_pool,
+	// Allocate the camera descriptor set, the allocator finds it a pool with room
+	bool camera_set_allocated = VkHelper::AllocateDescriptorSet(
+		descriptor_allocator,
 		camera_descriptor_set_layout,
-		1
+		camera_descriptor_set
 	);
+	assert(camera_set_allocated);
 
 
 
 	VkDescriptorBufferInfo descriptorImageInfo = VkHelper::DescriptorBufferInfo(
-		camera_buffer.buffer,
-		camera_buffer.buffer_size,
-		0
+		uniform_buffer.buffer,
+		sizeof(SCamera),
+		0                                      // The frames region is selected with a dynamic offset when binding
 	);
 
-	VkWriteDescriptorSet descriptorWrite = VkHelper::WriteDescriptorSet(camera_descriptor_set, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, descriptorImageInfo, 0);
+	VkWriteDescriptorSet descriptorWrite = VkHelper::WriteDescriptorSet(camera_descriptor_set, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, descriptorImageInfo, 0);
 
 	// Update the descriptor with the texture data
 	vkUpdateDescriptorSets(
@@ -622,25 +794,11 @@ void Destroy()
 	DestroyRenderResources();
 
 
-	// Clean up descriptor set layout
-	vkDestroyDescriptorSetLayout(
-		device,
-		texture_descriptor_set_layout,
-		nullptr
-	);
-
-	// Clean up descriptor pool
-	vkDestroyDescriptorPool(
-		device,
-		texture_descriptor_pool,
-		nullptr
-	);
+	// Clean up the texture heap, the textures in it have already been destroyed
+	VkHelper::DestroyTextureHeap(texture_heap);
 
-	vkDestroyDescriptorPool(
-		device,
-		camera_descriptor_pool,
-		nullptr
-	);
+	// Destroying the allocators pools frees every set that came from them
+	VkHelper::DestroyDescriptorAllocator(descriptor_allocator);
 
 	vkDestroyDescriptorSetLayout(
 		device,
@@ -650,75 +808,67 @@ void Destroy()
 
 
 
-	// Now we unmap the data
-	vkUnmapMemory(
+	// Clean up the buffer and give its memory back to the allocator
+	VkHelper::DestroyBuffer(
 		device,
-		particle_vertex_buffer_memory
+		allocator,
+		particle_vertex_buffer,
+		particle_vertex_buffer_allocation
 	);
 
-	// Clean up the buffer data
-	vkDestroyBuffer(
+
+	// Clean up the buffer and give its memory back to the allocator
+	VkHelper::DestroyBuffer(
 		device,
-		particle_vertex_buffer,
-		nullptr
+		allocator,
+		index_buffer,
+		index_buffer_allocation
 	);
 
-	// Free the memory that was allocated for the buffer
-	vkFreeMemory(
+	VkHelper::DestroyFrameLoop(
 		device,
-		particle_vertex_buffer_memory,
-		nullptr
+		command_pool,
+		frame_loop
 	);
 
 
-	// Now we unmap the data
-	vkUnmapMemory(
+	// Clean up the uniform ring buffer
+	VkHelper::DestroyRingBuffer(
 		device,
-		index_buffer_memory
+		allocator,
+		uniform_buffer
 	);
 
-	// Clean up the buffer data
-	vkDestroyBuffer(
+	// Clean up the command pool
+	vkDestroyCommandPool(
 		device,
-		index_buffer,
+		command_pool,
 		nullptr
 	);
 
-	// Free the memory that was allocated for the buffer
-	vkFreeMemory(
-		device,
-		index_buffer_memory,
-		nullptr
+	// Wait for any outstanding uploads and release the staging ring
+	VkHelper::DestroyUploadManager(
+		allocator,
+		upload_manager
 	);
 
-	for (uint32_t i = 0; i < swapchain_image_count; i++)
-	{
-		vkDestroyFence(
-			device,
-			fences.get()[i],
-			nullptr
-		);
-	}
+	// The upload manager has waited on every upload, so the generator is no longer in use
+	VkHelper::DestroyMipmapGenerator(mipmap_generator);
 
-	vkDestroySemaphore(
-		device,
-		image_available_semaphore,
-		nullptr
-	);
+	// Now all buffers and images are gone, give the allocators blocks back
+	VkHelper::DestroyAllocator(allocator);
 
-	vkDestroySemaphore(
-		device,
-		render_finished_semaphore,
-		nullptr
-	);
+	// Let any pipelines still being built finish before the cache is written
+	VkHelper::DestroyPipelineBuildQueue(pipeline_build_queue);
 
+	// Write the pipeline cache out so the next run can skip compiling the shaders
+	VkHelper::DestroyPipelineCache(device);
 
-	// Clean up the command pool
-	vkDestroyCommandPool(
-		device,
-		command_pool,
-		nullptr
-	);
+	// Any samplers the textures and attachments didn't give back are still held by the cache, they go before the device
+	VkHelper::DestroySamplerCache(device);
+
+	// The device is going away, free its dispatch table so a later device given the same handle loads its own
+	VkHelper::UnregisterDeviceDispatch(device);
 
 	// Clean up the device now that the project is stopping
 	vkDestroyDevice(
@@ -728,10 +878,13 @@ void Destroy()
 
 	// Destroy the debug callback
 	// We cant directly call vkDestroyDebugReportCallbackEXT as we need to find the pointer within the Vulkan DLL, See function implementation for details.
-	VkHelper::DestroyDebugger(
-		instance, 
-		debugger
-	);
+	if (!headless.enabled)
+	{
+		VkHelper::DestroyDebugger(
+			instance, 
+			debugger
+		);
+	}
 
 	// Clean up the vulkan instance
 	vkDestroyInstance(
@@ -739,13 +892,14 @@ void Destroy()
 		NULL
 	);
 
-	DestroyWindow();
+	if (!headless.enabled) DestroyWindow();
 }
 
 void CreateGraphicsPipeline()
 {
+	VK_HELPER_CPU_ZONE("CreateGraphicsPipeline");
 
-	const uint32_t vertex_input_attribute_description_count = 8;
+	const uint32_t vertex_input_attribute_description_count = 9;
 	std::unique_ptr<VkVertexInputAttributeDescription> vertex_input_attribute_descriptions =
 		std::unique_ptr<VkVertexInputAttributeDescription>(new VkVertexInputAttributeDescription[vertex_input_attribute_description_count]);
 
@@ -795,6 +949,12 @@ void CreateGraphicsPipeline()
 	vertex_input_attribute_descriptions.get()[7].format = VK_FORMAT_R32G32B32A32_SFLOAT;	// What format is the data coming in as
 	vertex_input_attribute_descriptions.get()[7].offset = sizeof(glm::vec4) * 3;	        // Within the whole structure of the data packet, where dose it start in memory
 
+	// Used to store the material of the vertex, the fragment shader looks its textures up in the material table
+	vertex_input_attribute_descriptions.get()[8].binding = 0;								// What vertex input binding are we talking about
+	vertex_input_attribute_descriptions.get()[8].location = 8;								// Inside the binding what is its location id
+	vertex_input_attribute_descriptions.get()[8].format = VK_FORMAT_R32_UINT;				// What format is the data coming in as
+	vertex_input_attribute_descriptions.get()[8].offset = offsetof(SVertexData, matID);		// Within the whole structure of the data packet, where dose it start in memory
+
 
 
 
@@ -835,45 +995,66 @@ void CreateGraphicsPipeline()
 
 	VkDescriptorSetLayout descriptor_set_layout[descriptor_set_layout_count] = {
 		camera_descriptor_set_layout,
-		texture_descriptor_set_layout
+		texture_heap.descriptor_set_layout
 	};
 
-	graphics_pipeline = VkHelper::CreateGraphicsPipeline(
-		physical_device,
-		device,
-		renderpass,
-		graphics_pipeline_layout,
-		shader_stage_count,
-		shader_paths,
-		shader_stages_bits,
-		graphics_shader_modules.get(),
-		descriptor_set_layout_count,
-		descriptor_set_layout,
-		vertex_input_attribute_description_count,
-		vertex_input_attribute_descriptions.get(),
-		vertex_input_binding_description_count,
-		vertex_input_binding_descriptions.get(),
-		dynamic_state_count,
-		dynamic_states
+	// Describe the pipeline and hand it over to the build queue, it will be compiled on a worker thread
+	// while the main thread carries on loading the rest of the scene
+	VkHelper::GraphicsPipelineDescription description;
+	description.physical_device = physical_device;
+	description.renderpass = renderpass;
+	description.pipeline_layout = &graphics_pipeline_layout;
+	description.shader_modules = graphics_shader_modules.get();
+	description.shader_paths.assign(shader_paths, shader_paths + shader_stage_count);
+	description.shader_stages.assign(shader_stages_bits, shader_stages_bits + shader_stage_count);
+	description.descriptor_set_layouts.assign(descriptor_set_layout, descriptor_set_layout + descriptor_set_layout_count);
+	description.vertex_input_attribute_descriptions.assign(vertex_input_attribute_descriptions.get(), vertex_input_attribute_descriptions.get() + vertex_input_attribute_description_count);
+	description.vertex_input_binding_descriptions.assign(vertex_input_binding_descriptions.get(), vertex_input_binding_descriptions.get() + vertex_input_binding_description_count);
+	description.dynamic_states.assign(dynamic_states, dynamic_states + dynamic_state_count);
+
+	graphics_pipeline_build = VkHelper::QueueGraphicsPipeline(
+		pipeline_build_queue,
+		description
 	);
 	
 }
 
 void CreateRenderResources()
 {
-	swap_chain = VkHelper::CreateSwapchain(
-		physical_device,
-		device,
-		surface,
-		surface_capabilities,
-		surface_format,
-		present_mode,
-		window_width,
-		window_height,
-		swapchain_image_count,
-		swapchain_images,
-		swapchain_image_views
-	);
+	if (headless.enabled)
+	{
+		// Three images, the same as a triple buffered swapchain
+		surface_format.format = VK_FORMAT_B8G8R8A8_UNORM;
+		swap_chain = VK_NULL_HANDLE;
+		VkHelper::CreateHeadlessSwapchain(
+			device,
+			physical_device_mem_properties,
+			surface_format.format,
+			window_width,
+			window_height,
+			3,
+			headless_swapchain,
+			swapchain_image_count,
+			swapchain_images,
+			swapchain_image_views
+		);
+	}
+	else
+	{
+		swap_chain = VkHelper::CreateSwapchain(
+			physical_device,
+			device,
+			surface,
+			surface_capabilities,
+			surface_format,
+			present_mode,
+			window_width,
+			window_height,
+			swapchain_image_count,
+			swapchain_images,
+			swapchain_image_views
+		);
+	}
 
 
 	const VkFormat colorFormat = VK_FORMAT_R8G8B8A8_UNORM;
@@ -919,88 +1100,108 @@ void DestroyGraphicsPipeline()
 	}
 }
 
-STexture CreateTexture(const char* path)
+void CreateCullPipeline()
 {
-	STexture texture;
-	// Used to store the raw image data
-	std::vector<unsigned char> image_data;
+	VK_HELPER_CPU_ZONE("CreateCullPipeline");
+	const uint32_t cull_layout_binding_count = 4;
+
+	// Each binding is read from its member of SCullDescriptors when the set is updated
+	VkHelper::DescriptorTemplateBinding cull_layout_bindings[cull_layout_binding_count] = {
+		VkHelper::TemplateBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, offsetof(SCullDescriptors, instances)),
+		VkHelper::TemplateBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, offsetof(SCullDescriptors, visible_instances)),
+		VkHelper::TemplateBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, offsetof(SCullDescriptors, indirect_command)),
+		VkHelper::TemplateBinding(3, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, offsetof(SCullDescriptors, settings))
+	};
 
-	// Load using "loadpng" the image from file
-	unsigned error = lodepng::decode(
-		image_data,
-		texture.width,
-		texture.height,
-		path
+	VkHelper::CreateDescriptorTemplate(
+		device,
+		cull_layout_bindings,
+		cull_layout_binding_count,
+		cull_descriptor_template
 	);
-	// Validate that the image could be found and accessed
-	if (error)
-	{
-		std::cout << lodepng_error_text(error) << std::endl;
-		exit(-1);
-	}
-
-	// How big is the texture in bytes? RGBA = 4 bytes * Width * Height
-	const unsigned int texture_size = texture.width * texture.height * 4;
-
 
-	texture.transfer_buffer.buffer_size = texture_size;
-	texture.transfer_buffer.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
-	texture.transfer_buffer.sharing_mode = VK_SHARING_MODE_EXCLUSIVE;
-	texture.transfer_buffer.buffer_memory_properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-
-	// Create a temp buffer to store the image in before we transfer it over to the image
-	VkHelper::CreateBuffer(
-		device,											 // What device are we going to use to create the buffer
-		physical_device_mem_properties,					 // What memory properties are available on the device
-		texture.transfer_buffer.buffer,                  // What buffer are we going to be creating
-		texture.transfer_buffer.buffer_memory,           // The output for the buffer memory
-		texture.transfer_buffer.buffer_size,             // How much memory we wish to allocate on the GPU
-		texture.transfer_buffer.usage,                   // What type of buffer do we want. Buffers can have multiple types, for example, uniform & vertex buffer.
-														 // for now we want to keep the buffer specialized to one type as this will allow vulkan to optimize the data.
-		texture.transfer_buffer.sharing_mode,            // There are two modes, exclusive and concurrent. Defines if it can concurrently be used by multiple queue
-														 // families at the same time
-		texture.transfer_buffer.buffer_memory_properties // What properties do we require of our memory
+	// The cull set shares the allocator with the camera set
+	bool cull_set_allocated = VkHelper::AllocateDescriptorSet(
+		descriptor_allocator,
+		cull_descriptor_template.descriptor_set_layout,
+		cull_descriptor_set
 	);
+	assert(cull_set_allocated);
 
-	// Get the pointer to the GPU memory
-	VkResult mapped_memory_result = vkMapMemory(
-		device,                                                  // The device that the memory is on
-		texture.transfer_buffer.buffer_memory,                   // The device memory instance
-		0,                                                       // Offset from the memory starts that we are accessing
-		texture.transfer_buffer.buffer_size,                     // How much memory are we accessing
-		0,                                                       // Flags (we don't need this for basic buffers)
-		&texture.transfer_buffer.mapped_buffer_memory            // The return for the memory pointer
-	);
+	const uint32_t descriptor_set_layout_count = 2;
 
-	// Could we map the GPU memory to our CPU accessible pointer
-	assert(mapped_memory_result == VK_SUCCESS);
+	// The camera is shared with the graphics pipeline
+	VkDescriptorSetLayout descriptor_set_layout[descriptor_set_layout_count] = {
+		camera_descriptor_set_layout,
+		cull_descriptor_template.descriptor_set_layout
+	};
 
+	// Build the cull pipeline on a worker thread alongside the graphics pipeline
+	VkHelper::ComputePipelineDescription compute_description;
+	compute_description.pipeline_layout = &cull_pipeline_layout;
+	compute_description.shader_module = &cull_shader_module;
+	compute_description.shader_path = "../../../Data/Shaders/12-IndirectDrawing/FrustumCull/comp.spv";
+	compute_description.descriptor_set_layouts.assign(descriptor_set_layout, descriptor_set_layout + descriptor_set_layout_count);
 
-	// Transfer data over to the texture buffer
-	memcpy(
-		texture.transfer_buffer.mapped_buffer_memory,         // The destination for our memory (GPU)
-		image_data.data(),                                    // Source for the memory (CPU-Ram)
-		texture_size                                          // How much data we are transferring
+	cull_pipeline_build = VkHelper::QueueComputePipeline(
+		pipeline_build_queue,
+		compute_description
 	);
+}
 
+// Point the cull descriptor set at the instance, visible instance, indirect and settings buffers
+void UpdateCullDescriptors(uint32_t model_position_buffer_size, uint32_t indirect_buffer_size)
+{
+	SCullDescriptors cull_descriptors;
+	cull_descriptors.instances = VkHelper::DescriptorBufferInfo(model_position_buffer.buffer, model_position_buffer_size, 0);
+	cull_descriptors.visible_instances = VkHelper::DescriptorBufferInfo(visible_model_position_buffer.buffer, model_position_buffer_size, 0);
+	cull_descriptors.indirect_command = VkHelper::DescriptorBufferInfo(indirect_draw_buffer.buffer, indirect_buffer_size, 0);
+	cull_descriptors.settings = VkHelper::DescriptorBufferInfo(cull_settings_buffer.buffer, sizeof(SCullSettings), 0);
+
+	// Update every binding of the set with one call
+	VkHelper::UpdateDescriptorSet(
+		cull_descriptor_template,
+		cull_descriptor_set,
+		&cull_descriptors
+	);
+}
 
-	// Now that the texture data is on the graphics card, we can unmap it
-	vkUnmapMemory(
+void DestroyCullPipeline()
+{
+	vkDestroyPipeline(
 		device,
-		texture.transfer_buffer.buffer_memory
+		cull_pipeline,
+		nullptr
 	);
 
+	vkDestroyPipelineLayout(
+		device,
+		cull_pipeline_layout,
+		nullptr
+	);
 
+	vkDestroyShaderModule(
+		device,
+		cull_shader_module,
+		nullptr
+	);
 
-	texture.layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;		// Define that the the image is read only
-																	// This makes image reads from the shader faster
-	texture.format = VK_FORMAT_R8G8B8A8_UNORM;						// What is the format of the image, in this case, 4 bytes RGBA
+	VkHelper::DestroyDescriptorTemplate(cull_descriptor_template);
+}
 
+// Create a texture from a KTX2 file, its mip levels are copied to the GPU as they are
+STexture CreateTexture(const VkHelper::KtxTexture& ktx_texture)
+{
+	STexture texture;
+	texture.width = ktx_texture.width;
+	texture.height = ktx_texture.height;
+	texture.mip_levels = static_cast<uint32_t>(ktx_texture.levels.size());
+	texture.format = ktx_texture.format;
+	texture.layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
-	// Create the image we will be rendering
 	VkHelper::CreateImage(
 		device,
-		physical_device_mem_properties,
+		allocator,
 		texture.width,
 		texture.height,
 		texture.format,
@@ -1008,179 +1209,383 @@ STexture CreateTexture(const char* path)
 		VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
 		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 		texture.image,
-		texture.memory,
-		VK_IMAGE_LAYOUT_UNDEFINED										// Here we define the initial layout, later we change its layout to VK_FORMAT_R8G8B8A8_UNORM
-	);
-
-
-
-
-
-	// Create a new command that we will run on the GPU, this will be used to change the images settings
-	// and transfer the image data between the buffer and the image
-	VkCommandBuffer copy_cmd = VkHelper::BeginSingleTimeCommands(device, command_pool);
-
-	// The sub resource range describes the regions of the image we will be transition
-	VkImageSubresourceRange subresourceRange = {};
-	// Image only contains color data
-	subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	// Start at first mip level
-	subresourceRange.baseMipLevel = 0;
-	// We will transition on all mip levels
-	subresourceRange.levelCount = 1;
-	// The 2D texture only has one layer
-	subresourceRange.layerCount = 1;
-
-	// Optimal image will be used as destination for the copy, so we must transfer from our
-	// initial undefined image layout to the transfer destination layout
-
-	VkHelper::SetImageLayout(
-		copy_cmd,
-		texture.image,
+		texture.allocation,
 		VK_IMAGE_LAYOUT_UNDEFINED,
-		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-		subresourceRange
-	);
-
-	// Only dealing with one mip level for now
-	VkBufferImageCopy bufferCopyRegion = {};
-	bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	bufferCopyRegion.imageSubresource.mipLevel = 0;
-	bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
-	bufferCopyRegion.imageSubresource.layerCount = 1;
-	bufferCopyRegion.imageExtent.width = static_cast<uint32_t>(texture.width);
-	bufferCopyRegion.imageExtent.height = static_cast<uint32_t>(texture.height);
-	bufferCopyRegion.imageExtent.depth = 1;
-	bufferCopyRegion.bufferOffset = 0;
-
-	// Copy mip levels from staging buffer
-	vkCmdCopyBufferToImage(
-		copy_cmd,
-		texture.transfer_buffer.buffer,
-		texture.image,
-		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-		1,
-		&bufferCopyRegion
+		texture.mip_levels
 	);
 
+	// Point the upload at each level inside the loaded file, the blocks go straight into the staging ring
+	std::vector<VkHelper::ImageLevel> levels(texture.mip_levels);
+	for (uint32_t level = 0; level < texture.mip_levels; level++)
+	{
+		levels[level].data = ktx_texture.data.data() + ktx_texture.levels[level].offset;
+		levels[level].size = ktx_texture.levels[level].size;
+		levels[level].width = ktx_texture.levels[level].width;
+		levels[level].height = ktx_texture.levels[level].height;
+	}
 
-
-	// Now the data is mapped to the texture, we no longer need the buffer
-	vkDestroyBuffer(
-		device,
-		texture.transfer_buffer.buffer,
-		nullptr
-	);
-
-	// Now change the images layout from VK_IMAGE_LAYOUT_UNDEFINED to VK_FORMAT_R8G8B8A8_UNORM
-	VkHelper::SetImageLayout(
-		copy_cmd,
+	VkHelper::UploadImageLevels(
+		upload_manager,
+		levels.data(),
+		texture.mip_levels,
 		texture.image,
-		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-		texture.layout,							// Set to VK_FORMAT_R8G8B8A8_UNORM
-		subresourceRange
-	);
-
-	// Finish the new command and run it
-	VkHelper::EndSingleTimeCommands(
-		device,
-		graphics_queue,
-		copy_cmd,
-		command_pool
-	);
-
-	// Clean up after the command buffer
-	vkFreeCommandBuffers(
-		device,
-		command_pool,
-		1,
-		&copy_cmd
+		texture.layout,
+		VK_ACCESS_SHADER_READ_BIT,
+		VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT
 	);
 
-
-	// Create a new image sampler, this will allow the shaders to sample the texture
 	VkHelper::CreateImageSampler(
 		device,
 		texture.image,
 		texture.format,
 		texture.view,
-		texture.sampler
+		texture.sampler,
+		texture.mip_levels
+	);
+
+	// Put the texture in the bindless heap, materials reference it by this index
+	texture.heap_index = VkHelper::AddHeapTexture(
+		texture_heap,
+		texture.sampler,
+		texture.view,
+		texture.layout
 	);
 
 	return texture;
 }
 
-void DestroyTexture(STexture& texture)
+// Create a texture from a png that has been decoded into RGBA8
+STexture CreateTexture(const VkHelper::DecodedImage& image)
 {
-	// Free the memory that was allocated for the buffer
-	vkFreeMemory(
-		device,
-		texture.transfer_buffer.buffer_memory,
-		nullptr
+	STexture texture;
+	texture.width = image.width;
+	texture.height = image.height;
+	const unsigned char* image_data = image.pixels.data();
+
+	// How big is the texture in bytes? RGBA = 4 bytes * Width * Height
+	const unsigned int texture_size = texture.width * texture.height * 4;
+
+
+	texture.layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;		// Define that the the image is read only
+																	// This makes image reads from the shader faster
+	texture.format = VK_FORMAT_R8G8B8A8_UNORM;						// What is the format of the image, in this case, 4 bytes RGBA
+	texture.mip_levels = VkHelper::MipLevelCount(texture.width, texture.height);	// Generate every level down to 1x1
+
+
+	// Create the image we will be rendering
+	VkHelper::CreateImage(
+		device,
+		allocator,
+		texture.width,
+		texture.height,
+		texture.format,
+		VK_IMAGE_TILING_OPTIMAL,
+		VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT |
+		VkHelper::MipmapImageUsage(mipmap_generator, texture.format),	// Blits need the image to be a transfer source, the compute fallback needs storage
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		texture.image,
+		texture.allocation,
+		VK_IMAGE_LAYOUT_UNDEFINED,										// Here we define the initial layout, the upload moves it to texture.layout
+		texture.mip_levels
 	);
 
-	// Destroy the image sampler now that we are done with that
-	vkDestroySampler(
+
+	// Rather then submitting and waiting for the copy here, the upload manager records it into its current batch.
+	// The image is not usable until the batch returned by SubmitUploads has completed.
+	// Only the first level is copied, the rest are generated from it on the GPU
+	VkHelper::UploadImageMipmapped(
+		upload_manager,
+		image_data,                                                     // Source for the memory (CPU-Ram)
+		texture_size,                                                   // How much data we are transferring
+		texture.image,                                                  // What image are we copying into
+		texture.format,
+		texture.width,
+		texture.height,
+		texture.mip_levels,                                             // How many levels the image has
+		texture.layout,                                                 // What layout should the image be left in
+		VK_ACCESS_SHADER_READ_BIT,                                      // How will the image be used after the upload
+		VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT
+	);
+
+
+	// Create a new image sampler, this will allow the shaders to sample the texture
+	VkHelper::CreateImageSampler(
 		device,
+		texture.image,
+		texture.format,
+		texture.view,
 		texture.sampler,
+		texture.mip_levels
+	);
+
+	// Put the texture in the bindless heap, materials reference it by this index
+	texture.heap_index = VkHelper::AddHeapTexture(
+		texture_heap,
+		texture.sampler,
+		texture.view,
+		texture.layout
+	);
+
+	return texture;
+}
+
+// Load a set of textures at once. KTX2 files are used as they are, the pngs are decoded on worker threads and each one
+// is copied into the staging ring as soon as it has decoded. Everything ends up in the upload managers current batch,
+// so the whole set goes to the GPU with one SubmitUploads
+std::vector<STexture> CreateTextures(const std::vector<std::string>& paths)
+{
+	VK_HELPER_CPU_ZONE("CreateTextures");
+	std::vector<STexture> textures(paths.size());
+
+	std::vector<std::string> png_paths;
+	// Which texture each png is for
+	std::vector<uint32_t> png_textures;
+
+	for (uint32_t i = 0; i < paths.size(); i++)
+	{
+		// Prefer the block compressed copy made by the KtxEncoder tool. It sits next to the png with a .ktx2 extension
+		// and already has every mip level, so there is nothing to decode or generate at startup
+		std::string ktx_path = paths[i].substr(0, paths[i].find_last_of('.')) + ".ktx2";
+
+		VkHelper::KtxTexture ktx_texture;
+		if (VkHelper::LoadKtx2(ktx_path.c_str(), ktx_texture) && VkHelper::SupportsSampledFormat(physical_device, ktx_texture.format))
+		{
+			std::cout << "Loaded " << ktx_path << std::endl;
+			textures[i] = CreateTexture(ktx_texture);
+		}
+		else
+		{
+			// There is no usable KTX2 file, so fall back to the png
+			png_paths.push_back(paths[i]);
+			png_textures.push_back(i);
+		}
+	}
+
+	VkHelper::DecodeImages(
+		png_paths,
+		0,                                                              // Use every core to decode
+		[&](uint32_t index, VkHelper::DecodedImage& image)
+		{
+			// Validate that the image could be found and accessed
+			if (image.error)
+			{
+				std::cout << image.path << ": " << lodepng_error_text(image.error) << std::endl;
+				exit(-1);
+			}
+			textures[png_textures[index]] = CreateTexture(image);
+		}
+	);
+
+	return textures;
+}
+
+void DestroyTexture(STexture& texture)
+{
+	// Free up the textures slot in the heap
+	VkHelper::RemoveHeapTexture(
+		texture_heap,
+		texture.heap_index
+	);
+
+	// Destroy the image sampler now that we are done with that
+	VkHelper::ReleaseSampler(
+		device,
+		texture.sampler
+	);
+
+	vkDestroyImageView(
+		device,
+		texture.view,
 		nullptr
 	);
 
-	// Destroy the image we are displaying
-	vkDestroyImage(
+	// Destroy the image we are displaying and give its memory back to the allocator
+	VkHelper::DestroyImage(
 		device,
+		allocator,
 		texture.image,
-		nullptr
+		texture.allocation
 	);
 }
 
-void SetAlbedoTexture(STexture& texture)
+// Copy the material table to the GPU and point the camera sets material binding at it. The fragment shader uses the
+// vertices matID to find its material, and the material holds the heap index of each of its textures
+void CreateMaterialBuffer()
 {
-	VkDescriptorImageInfo descriptorImageInfo = VkHelper::DescriptorImageInfo(
-		texture.sampler,
-		texture.view,
-		texture.layout
+	// A zero sized buffer can't be created, and the shader always reads a material, so make sure there is one
+	if (materials.empty())
+	{
+		SMaterial material;
+		material.albedo_texture = 0;                                     // The first texture in the heap
+		materials.push_back(material);
+	}
+
+	VkDeviceSize material_buffer_size = sizeof(SMaterial) * materials.size();
+
+	VkHelper::CreateBuffer(
+		device,                                                          // What device are we going to use to create the buffer
+		allocator,                                                       // What allocator are we getting the memory from
+		material_buffer.buffer,                                          // What buffer are we going to be creating
+		material_buffer.allocation,                                      // The output for the buffer allocation
+		material_buffer_size,                                            // How much memory we wish to allocate on the GPU
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,                              // The fragment shader reads it as a storage buffer
+		VK_SHARING_MODE_EXCLUSIVE,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT                              // Small and only written once, so just write it directly
 	);
 
-	VkWriteDescriptorSet descriptorWrite = VkHelper::WriteDescriptorSet(texture_descriptor_set, descriptorImageInfo, 0);
+	// The allocator keeps host visible blocks mapped, so we can just take the pointer
+	material_buffer.mapped_buffer_memory = material_buffer.allocation.mapped_memory;
+
+	memcpy(
+		material_buffer.mapped_buffer_memory,                           // The destination for our memory (GPU)
+		materials.data(),                                               // Source for the memory (CPU-Ram)
+		material_buffer_size                                            // How much data we are transferring
+	);
+
+	VkDescriptorBufferInfo descriptor_buffer_info = VkHelper::DescriptorBufferInfo(
+		material_buffer.buffer,
+		material_buffer_size,
+		0
+	);
+
+	VkWriteDescriptorSet descriptor_write = VkHelper::WriteDescriptorSet(camera_descriptor_set, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, descriptor_buffer_info, 1);
 
-	// Update the descriptor with the texture data
 	vkUpdateDescriptorSets(
 		device,
 		1,
-		&descriptorWrite,
+		&descriptor_write,
 		0,
 		NULL
 	);
 }
 
-void CreateModel(const char* path, ModelInstance& model_instance)
+// default_albedo is the heap index used for materials that don't have an albedo texture of their own
+void CreateModel(const char* path, ModelInstance& model_instance, uint32_t default_albedo)
 {
+	VK_HELPER_CPU_ZONE("CreateModel");
+	std::chrono::high_resolution_clock::time_point load_start = std::chrono::high_resolution_clock::now();
+
+	// A binary copy of the model is kept next to the .obj. Once it exists the model is mapped straight
+	// from the file and copied to the GPU, without parsing the .obj again
+	std::string cache_path = std::string(path) + ".meshcache";
+
+	VkHelper::MeshCache mesh_cache;
+	bool loaded_from_cache = VkHelper::OpenMeshCache(
+		cache_path.c_str(),
+		path,                                                               // The cache is thrown away if this file has changed
+		sizeof(SVertexData),                                                // Or if it was written with a different vertex layout
+		sizeof(MatrialObj),                                                 // Or material layout
+		mesh_cache
+	);
 
 	ObjLoader<SVertexData> loader;
-	loader.loadModel(path);
+	const void* vertices = nullptr;
+	const uint32_t* indices = nullptr;
+	uint32_t model_material_count = 0;
+	VkHelper::MeshBounds bounds;
+
+	if (loaded_from_cache)
+	{
+		model_instance.vertex_count = mesh_cache.header->vertex_count;
+		model_instance.index_count = mesh_cache.header->index_count;
+		vertices = mesh_cache.vertices;
+		indices = mesh_cache.indices;
+		model_material_count = mesh_cache.header->material_count;
+		bounds = mesh_cache.header->bounds;
+	}
+	else
+	{
+		// Merge the vertices that are shared between triangles so the index buffer can reuse them
+		loader.loadModel(path, true);
+		std::cout << path << ": " << loader.m_sourceVertexCount << " vertices before deduplication, " << loader.m_vertices.size() << " after" << std::endl;
+
+		model_instance.vertex_count = loader.m_vertices.size();
+		model_instance.index_count = loader.m_indices.size();
+		vertices = loader.m_vertices.data();
+		indices = loader.m_indices.data();
+		model_material_count = static_cast<uint32_t>(loader.m_materials.size());
+		bounds = VkHelper::ComputeMeshBounds(
+			vertices,
+			model_instance.vertex_count,
+			sizeof(SVertexData),
+			offsetof(SVertexData, pos)                                      // Where the position is within the vertex
+		);
+
+		// Save the model for the next run
+		bool cache_written = VkHelper::WriteMeshCache(
+			cache_path.c_str(),
+			path,
+			vertices,
+			model_instance.vertex_count,
+			sizeof(SVertexData),
+			indices,
+			model_instance.index_count,
+			loader.m_materials.data(),
+			static_cast<uint32_t>(loader.m_materials.size()),
+			sizeof(MatrialObj),
+			bounds
+		);
+		if (!cache_written)
+		{
+			std::cout << "Failed to write mesh cache " << cache_path << std::endl;
+		}
+	}
 
 	model_instance.vertex_offset = used_verticies;
 	model_instance.index_offset = used_index;
-	model_instance.vertex_count = loader.m_vertices.size();
-	model_instance.index_count = loader.m_indices.size();
 
+	// A sphere that contains the whole model, the frustum cull tests this against the camera
+	model_instance.bounding_sphere = glm::vec4(
+		(bounds.min[0] + bounds.max[0]) * 0.5f,
+		(bounds.min[1] + bounds.max[1]) * 0.5f,
+		(bounds.min[2] + bounds.max[2]) * 0.5f,
+		bounds.radius
+	);
 
 
 	// First we copy the example data to the GPU
 	memcpy(
 		index_mapped_buffer_memory,                                         // The destination for our memory (GPU)
-		loader.m_indices.data(),                                            // Source for the memory (CPU-Ram)
+		indices,                                                            // Source for the memory (CPU-Ram or the mapped cache file)
 		model_instance.index_count * sizeof(uint32_t)                       // How much data we are transferring
 	);
 
 	// First we copy the example data to the GPU
 	memcpy(
 		particle_vertex_mapped_buffer_memory,                                         // The destination for our memory (GPU)
-		loader.m_vertices.data(),                                            // Source for the memory (CPU-Ram)
+		vertices,                                                            // Source for the memory (CPU-Ram or the mapped cache file)
 		model_instance.vertex_count * sizeof(SVertexData)                     // How much data we are transferring
 	);
 
+	// Add the models materials to the material table. The models own textures are not loaded, so every material
+	// samples the albedo we were given
+	model_instance.material_offset = static_cast<unsigned int>(materials.size());
+	// A model without any materials still has matIDs of 0, so it gets one material for them to point at
+	uint32_t material_count = std::max(model_material_count, 1u);
+	for (uint32_t i = 0; i < material_count; i++)
+	{
+		SMaterial material;
+		material.albedo_texture = default_albedo;
+		materials.push_back(material);
+	}
+
+	// The matIDs in the model start from 0, move them along to where the models materials sit in the table
+	if (model_instance.material_offset > 0)
+	{
+		SVertexData* gpu_vertices = static_cast<SVertexData*>(particle_vertex_mapped_buffer_memory);
+		for (unsigned int i = 0; i < model_instance.vertex_count; i++)
+		{
+			gpu_vertices[i].matID += model_instance.material_offset;
+		}
+	}
+
+	// The data has been copied, so the file can be unmapped
+	VkHelper::CloseMeshCache(mesh_cache);
+
+	std::chrono::high_resolution_clock::time_point load_end = std::chrono::high_resolution_clock::now();
+	std::cout << "Loaded " << path << " from " << (loaded_from_cache ? "the mesh cache" : "the .obj") << " in "
+		<< std::chrono::duration_cast<std::chrono::microseconds>(load_end - load_start).count() / 1000.0f << "ms" << std::endl;
+
 
 	used_verticies += model_instance.vertex_count;
 	used_index += model_instance.index_count;
@@ -1194,83 +1599,346 @@ void DestroyRenderResources()
 		nullptr
 	);
 
-	vkDestroySwapchainKHR(
+	VkHelper::DestroyFramebuffers(
 		device,
-		swap_chain,
-		nullptr
+		swapchain_image_count,
+		framebuffers.get(),
+		framebuffer_attachments.get(),
+		swapchain_image_views.get()
 	);
 
-	for (uint32_t i = 0; i < swapchain_image_count; i++)
+	if (headless.enabled)
 	{
-		vkDestroyImageView(
+		VkHelper::DestroyHeadlessSwapchain(
 			device,
-			swapchain_image_views.get()[i],
+			headless_swapchain
+		);
+	}
+	else
+	{
+		vkDestroySwapchainKHR(
+			device,
+			swap_chain,
 			nullptr
 		);
+	}
+}
 
+void RebuildRenderResources()
+{
+	// Only the window can go out of date, the headless images stay the same size
+	assert(!headless.enabled);
+
+	// Frames that are still in flight are rendering with the old swapchain, framebuffers and command buffers, so hand them
+	// over to the frame loop to destroy once those frames are done, rather than waiting for the device to go idle
+	VkSwapchainKHR old_swap_chain = swap_chain;
+	uint32_t old_swapchain_image_count = swapchain_image_count;
+	VkImageView* old_swapchain_image_views = swapchain_image_views.release();
+	VkFramebuffer* old_framebuffers = framebuffers.release();
+	VkHelper::VulkanAttachments* old_framebuffer_attachments = framebuffer_attachments.release();
+	VkCommandBuffer* old_graphics_command_buffers = graphics_command_buffers.release();
+	VkFormat old_surface_format = surface_format.format;
+
+	// Passing the old swapchain lets the presentation engine hand its resources over to the new one
+	swap_chain = VkHelper::CreateSwapchain(
+		physical_device,
+		device,
+		surface,
+		surface_capabilities,
+		surface_format,
+		present_mode,
+		window_width,
+		window_height,
+		swapchain_image_count,
+		swapchain_images,
+		swapchain_image_views,
+		old_swap_chain
+	);
 
-		vkDestroyFramebuffer(
+	VkHelper::RetireResource(frame_loop, [old_swap_chain, old_swapchain_image_count, old_swapchain_image_views, old_framebuffers, old_framebuffer_attachments, old_graphics_command_buffers]()
+	{
+		VkHelper::DestroyFramebuffers(
 			device,
-			framebuffers.get()[i],
-			nullptr
+			old_swapchain_image_count,
+			old_framebuffers,
+			old_framebuffer_attachments,
+			old_swapchain_image_views
 		);
 
-		vkDestroyImageView(
+		vkFreeCommandBuffers(
 			device,
-			framebuffer_attachments.get()[i].color.view,
-			nullptr
+			command_pool,
+			old_swapchain_image_count,
+			old_graphics_command_buffers
 		);
-		vkDestroyImage(
+
+		// The old swapchain has been retired by the new one, its images can't be acquired any more
+		vkDestroySwapchainKHR(
 			device,
-			framebuffer_attachments.get()[i].color.image,
+			old_swap_chain,
 			nullptr
 		);
-		vkFreeMemory(
+
+		delete[] old_swapchain_image_views;
+		delete[] old_framebuffers;
+		delete[] old_framebuffer_attachments;
+		delete[] old_graphics_command_buffers;
+	});
+
+	const VkFormat colorFormat = VK_FORMAT_R8G8B8A8_UNORM;
+
+	// The render pass and graphics pipeline only depend on the surface format, which almost never changes on a resize.
+	// If it does, the frames in flight are still using them, so this is the one case where we have to wait
+	if (surface_format.format != old_surface_format)
+	{
+		VkResult device_idle_result = vkDeviceWaitIdle(device);
+		assert(device_idle_result == VK_SUCCESS);
+
+		vkDestroyRenderPass(
 			device,
-			framebuffer_attachments.get()[i].color.memory,
+			renderpass,
 			nullptr
 		);
-		vkDestroySampler(
+
+		renderpass = VkHelper::CreateRenderPass(
+			physical_device,
 			device,
-			framebuffer_attachments.get()[i].color.sampler,
-			nullptr
+			surface_format.format,
+			colorFormat
 		);
-		vkDestroyImageView(
+
+		DestroyGraphicsPipeline();
+		CreateGraphicsPipeline();
+		graphics_pipeline = graphics_pipeline_build.get();
+	}
+
+	VkHelper::CreateFramebuffers(
+		physical_device,
+		device,
+		renderpass,
+		colorFormat,
+		swapchain_image_count,
+		physical_device_mem_properties,
+		physical_device_features,
+		physical_device_properties,
+		command_pool,
+		graphics_queue,
+		window_width,
+		window_height,
+		framebuffers,
+		framebuffer_attachments,
+		swapchain_image_views
+	);
+
+	// The camera ring buffer has a region per image. If the new swapchain has more images than there are regions, move
+	// over to a larger ring buffer and a camera set that points at it. The frames in flight still read the old ones
+	if (swapchain_image_count > uniform_buffer.region_count)
+	{
+		VkHelper::RingBuffer old_uniform_buffer = uniform_buffer;
+		VkDescriptorSet old_camera_descriptor_set = camera_descriptor_set;
+
+		VkHelper::CreateRingBuffer(
 			device,
-			framebuffer_attachments.get()[i].depth.view,
-			nullptr
+			allocator,
+			physical_device_properties,
+			uniform_buffer.region_size,                            // Each frame pushes the same amount as before
+			swapchain_image_count,                                 // One region for each image of the new swapchain
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			uniform_buffer
 		);
-		vkDestroyImage(
-			device,
-			framebuffer_attachments.get()[i].depth.image,
-			nullptr
+
+		// The old set is still bound by the frames in flight, it goes back to the pool along with the allocator
+		bool camera_set_allocated = VkHelper::AllocateDescriptorSet(
+			descriptor_allocator,
+			camera_descriptor_set_layout,
+			camera_descriptor_set
 		);
-		vkFreeMemory(
-			device,
-			framebuffer_attachments.get()[i].depth.memory,
-			nullptr
+		assert(camera_set_allocated);
+
+		VkDescriptorBufferInfo camera_buffer_info = VkHelper::DescriptorBufferInfo(
+			uniform_buffer.buffer,
+			sizeof(SCamera),
+			0
 		);
-		vkDestroySampler(
+
+		VkWriteDescriptorSet camera_write = VkHelper::WriteDescriptorSet(camera_descriptor_set, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, camera_buffer_info, 0);
+
+		// The material table hasn't changed, so copy it across from the old set
+		VkCopyDescriptorSet material_copy = {};
+		material_copy.sType = VK_STRUCTURE_TYPE_COPY_DESCRIPTOR_SET;
+		material_copy.srcSet = old_camera_descriptor_set;
+		material_copy.srcBinding = 1;
+		material_copy.dstSet = camera_descriptor_set;
+		material_copy.dstBinding = 1;
+		material_copy.descriptorCount = 1;
+
+		vkUpdateDescriptorSets(
 			device,
-			framebuffer_attachments.get()[i].depth.sampler,
-			nullptr
+			1,
+			&camera_write,
+			1,
+			&material_copy
 		);
+
+		VkHelper::RetireResource(frame_loop, [old_uniform_buffer]() mutable
+		{
+			VkHelper::DestroyRingBuffer(
+				device,
+				allocator,
+				old_uniform_buffer
+			);
+		});
 	}
+
+	// Each image index keeps waiting on the frame that last used it, which covers the command buffers and ring buffer
+	// regions we keep per image index
+	VkHelper::ResetFrameLoopImages(frame_loop, swapchain_image_count);
+
+	// The profiler has a slot per image as well, so it needs more of them if the image count went up. The frames in flight
+	// are still writing into the old query pool, so it is destroyed along with the rest of their resources
+	VkQueryPool old_query_pool = VkHelper::GrowGpuProfiler(gpu_profiler, swapchain_image_count);
+	if (old_query_pool != VK_NULL_HANDLE)
+	{
+		VkHelper::RetireResource(frame_loop, [old_query_pool]()
+		{
+			vkDestroyQueryPool(
+				device,
+				old_query_pool,
+				nullptr
+			);
+		});
+	}
+
+	// The old command buffers may still be executing, so record into new ones rather than resetting them
+	VkCommandBufferAllocateInfo command_buffer_allocate_info = VkHelper::CommandBufferAllocateInfo(
+		command_pool,
+		swapchain_image_count
+	);
+
+	graphics_command_buffers = std::unique_ptr<VkCommandBuffer>(new VkCommandBuffer[swapchain_image_count]);
+
+	VkResult allocate_command_buffer_resut = vkAllocateCommandBuffers(
+		device,
+		&command_buffer_allocate_info,
+		graphics_command_buffers.get()
+	);
+	assert(allocate_command_buffer_resut == VK_SUCCESS);
+
+	BuildCommandBuffers(graphics_command_buffers, swapchain_image_count);
 }
 
-void RebuildRenderResources()
+// Cull the instances against the camera and write the ones that can be seen into the visible instance buffer.
+// The shader counts the visible instances straight into the indirect commands instanceCount
+void RecordFrustumCull(VkCommandBuffer& command_buffer, uint32_t camera_dynamic_offset)
 {
-	// Wait for the device to finish
-	VkResult device_idle_result = vkDeviceWaitIdle(device);
-	assert(device_idle_result == VK_SUCCESS);
-	// Destroy and rebuild the render resources
-	DestroyRenderResources();
-	CreateRenderResources();
-	BuildCommandBuffers(graphics_command_buffers, swapchain_image_count);
+	// The buffers are shared between the frames in flight, so wait for the earlier frames to stop
+	// drawing from them before we overwrite them
+	VkMemoryBarrier draw_read_barrier = {};
+	draw_read_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	draw_read_barrier.srcAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+	draw_read_barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+	device_dispatch->vkCmdPipelineBarrier(
+		command_buffer,
+		VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,     // Wait for the earlier draws to read the buffers
+		VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,        // Before we clear and refill them
+		0,
+		1,
+		&draw_read_barrier,
+		0,
+		nullptr,
+		0,
+		nullptr
+	);
+
+	// Start the count of visible instances at 0, the rest of the indirect command stays as it is
+	device_dispatch->vkCmdFillBuffer(
+		command_buffer,
+		indirect_draw_buffer.buffer,
+		offsetof(VkDrawIndexedIndirectCommand, instanceCount),
+		sizeof(uint32_t),
+		0
+	);
+
+	// The shader adds to the count, so it has to see the clear
+	VkMemoryBarrier clear_barrier = {};
+	clear_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	clear_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	clear_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+	device_dispatch->vkCmdPipelineBarrier(
+		command_buffer,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		0,
+		1,
+		&clear_barrier,
+		0,
+		nullptr,
+		0,
+		nullptr
+	);
+
+	device_dispatch->vkCmdBindPipeline(
+		command_buffer,
+		VK_PIPELINE_BIND_POINT_COMPUTE,
+		cull_pipeline
+	);
+
+	// Set 0 is the camera, set 1 is the buffers the cull reads and writes
+	device_dispatch->vkCmdBindDescriptorSets(
+		command_buffer,
+		VK_PIPELINE_BIND_POINT_COMPUTE,
+		cull_pipeline_layout,
+		0,
+		1,
+		&camera_descriptor_set,
+		1,
+		&camera_dynamic_offset
+	);
+
+	device_dispatch->vkCmdBindDescriptorSets(
+		command_buffer,
+		VK_PIPELINE_BIND_POINT_COMPUTE,
+		cull_pipeline_layout,
+		1,
+		1,
+		&cull_descriptor_set,
+		0,
+		NULL
+	);
+
+	// One invocation per instance, the shader runs in groups of 128
+	device_dispatch->vkCmdDispatch(
+		command_buffer,
+		(MODEL_COUNT + 127) / 128,				// X axis
+		1,										// Y axis
+		1										// Z axis
+	);
+
+	// Make the visible instances and their count visible to the draw
+	VkMemoryBarrier cull_write_barrier = {};
+	cull_write_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	cull_write_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	cull_write_barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+
+	device_dispatch->vkCmdPipelineBarrier(
+		command_buffer,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+		0,
+		1,
+		&cull_write_barrier,
+		0,
+		nullptr,
+		0,
+		nullptr
+	);
 }
 
 void BuildCommandBuffers(std::unique_ptr<VkCommandBuffer>& command_buffers, const uint32_t buffer_count)
 {
+	VK_HELPER_CPU_ZONE("BuildCommandBuffers");
 	// Define how we will start the command buffer recording
 	VkCommandBufferBeginInfo command_buffer_begin_info = VkHelper::CommandBufferBeginInfo(VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT);
 
@@ -1337,15 +2005,29 @@ void BuildCommandBuffers(std::unique_ptr<VkCommandBuffer>& command_buffers, cons
 		// check to see if the command buffer was created
 		assert(begin_command_buffer_result == VK_SUCCESS);
 
+		// Each frame reads its camera from its own region of the ring buffer
+		uint32_t camera_dynamic_offset = static_cast<uint32_t>(VkHelper::RingBufferRegionOffset(uniform_buffer, i));
+
+		// The timestamp queries have to be reset outside of the render pass
+		VkHelper::ResetGpuProfilerSlot(command_buffers.get()[i], gpu_profiler, i);
+
+		if (GPU_FRUSTUM_CULLING)
+		{
+			VkHelper::GpuScope cull_scope(command_buffers.get()[i], gpu_profiler, i, cull_gpu_scope);
+			RecordFrustumCull(command_buffers.get()[i], camera_dynamic_offset);
+		}
+
+		VkHelper::BeginGpuScope(command_buffers.get()[i], gpu_profiler, i, draw_gpu_scope);
+
 		// Define that we will be starting a new render pass
-		vkCmdBeginRenderPass(
+		device_dispatch->vkCmdBeginRenderPass(
 			command_buffers.get()[i],
 			&render_pass_info,
 			VK_SUBPASS_CONTENTS_INLINE
 		);
 
 		// Set the viewport
-		vkCmdSetViewport(
+		device_dispatch->vkCmdSetViewport(
 			command_buffers.get()[i],
 			0,
 			1,
@@ -1353,7 +2035,7 @@ void BuildCommandBuffers(std::unique_ptr<VkCommandBuffer>& command_buffers, cons
 		);
 
 		// Set the scissor region
-		vkCmdSetScissor(
+		device_dispatch->vkCmdSetScissor(
 			command_buffers.get()[i],
 			0,
 			1,
@@ -1361,7 +2043,7 @@ void BuildCommandBuffers(std::unique_ptr<VkCommandBuffer>& command_buffers, cons
 		);
 
 		// Bind the graphics pipeline
-		vkCmdBindPipeline(
+		device_dispatch->vkCmdBindPipeline(
 			command_buffers.get()[i],
 			VK_PIPELINE_BIND_POINT_GRAPHICS,
 			graphics_pipeline
@@ -1369,7 +2051,7 @@ void BuildCommandBuffers(std::unique_ptr<VkCommandBuffer>& command_buffers, cons
 		
 		VkDeviceSize offsets[] = { 0 };
 		// Bind the models vertex buffer
-		vkCmdBindVertexBuffers(
+		device_dispatch->vkCmdBindVertexBuffers(
 			command_buffers.get()[i],
 			0,
 			1,
@@ -1378,17 +2060,17 @@ void BuildCommandBuffers(std::unique_ptr<VkCommandBuffer>& command_buffers, cons
 		);
 
 
-		// Bind the models position buffer
-		vkCmdBindVertexBuffers(
+		// Bind the models position buffer, when culling this is only the instances that can be seen
+		device_dispatch->vkCmdBindVertexBuffers(
 			command_buffers.get()[i],
 			1,
 			1,
-			&model_position_buffer.buffer,
+			GPU_FRUSTUM_CULLING ? &visible_model_position_buffer.buffer : &model_position_buffer.buffer,
 			offsets
 		);
 
 		// Bind the models index buffer
-		vkCmdBindIndexBuffer(
+		device_dispatch->vkCmdBindIndexBuffer(
 			command_buffers.get()[i],
 			index_buffer,
 			0,
@@ -1397,31 +2079,32 @@ void BuildCommandBuffers(std::unique_ptr<VkCommandBuffer>& command_buffers, cons
 
 
 		// Bind the position to the pipeline
-		vkCmdBindDescriptorSets(
+		device_dispatch->vkCmdBindDescriptorSets(
 			command_buffers.get()[i],
 			VK_PIPELINE_BIND_POINT_GRAPHICS,
 			graphics_pipeline_layout,
 			0,
 			1,
 			&camera_descriptor_set,
-			0,
-			NULL
+			1,
+			&camera_dynamic_offset
 		);
 
-		// Bind the texture to the pipeline
-		vkCmdBindDescriptorSets(
+		// Bind the texture heap to the pipeline. It holds every texture, so no matter which materials the instances
+		// use nothing has to be rebound between draws
+		device_dispatch->vkCmdBindDescriptorSets(
 			command_buffers.get()[i],
 			VK_PIPELINE_BIND_POINT_GRAPHICS,
 			graphics_pipeline_layout,
 			1,
 			1,
-			&texture_descriptor_set,
+			&texture_heap.descriptor_set,
 			0,
 			NULL
 		);
 
 		// Render from the pre made render buffer 
-		vkCmdDrawIndexedIndirect(
+		device_dispatch->vkCmdDrawIndexedIndirect(
 			command_buffers.get()[i],
 			indirect_draw_buffer.buffer,
 			0,
@@ -1431,10 +2114,12 @@ void BuildCommandBuffers(std::unique_ptr<VkCommandBuffer>& command_buffers, cons
 
 
 		// End the rendering
-		vkCmdEndRenderPass(
+		device_dispatch->vkCmdEndRenderPass(
 			command_buffers.get()[i]
 		);
 
+		VkHelper::EndGpuScope(command_buffers.get()[i], gpu_profiler, i, draw_gpu_scope);
+
 		// End the current rendering command
 		VkResult end_command_buffer_result = vkEndCommandBuffer(
 			command_buffers.get()[i]
@@ -1443,86 +2128,108 @@ void BuildCommandBuffers(std::unique_ptr<VkCommandBuffer>& command_buffers, cons
 	}
 }
 
-void Render()
+void PrintGpuTimings()
 {
-	// Find next image
-	VkResult wait_for_fences = vkWaitForFences(
-		device,
-		1,
-		&fences.get()[current_frame_index],
-		VK_TRUE,
-		UINT32_MAX
-	);
-	assert(wait_for_fences == VK_SUCCESS);
+	for (const VkHelper::GpuScopeStats& stats : VkHelper::GetGpuScopeStats(gpu_profiler))
+	{
+		std::cout << stats.name << ": " << stats.average_ms << "ms average, " << stats.p50_ms << "ms p50, " << stats.p95_ms << "ms p95, "
+			<< stats.p99_ms << "ms p99, " << stats.max_ms << "ms worst over " << stats.samples << " frames" << std::endl;
+	}
+}
 
-	VkResult acquire_next_image_result = vkAcquireNextImageKHR(
+void Render()
+{
+	VK_HELPER_CPU_ZONE("Render");
+	// Wait for the oldest frame in flight to finish and find the next image
+	VkResult begin_frame_result = VkHelper::BeginFrame(
 		device,
 		swap_chain,
-		UINT64_MAX,
-		image_available_semaphore,
-		VK_NULL_HANDLE,
-		&current_frame_index
+		frame_loop
 	);
-	assert(acquire_next_image_result == VK_SUCCESS);
+	// The swapchain no longer matches the window, rebuild it and pick the frame up next time round
+	if (begin_frame_result == VK_ERROR_OUT_OF_DATE_KHR)
+	{
+		RebuildRenderResources();
+		return;
+	}
 
-	// Reset and wait
-	VkResult queue_idle_result = vkQueueWaitIdle(
-		graphics_queue
-	);
-	assert(queue_idle_result == VK_SUCCESS);
+	// Now we know what image we are rendering, write its uniforms
+	UpdateUniforms(frame_loop.image_index);
 
-	VkResult reset_fences_result = vkResetFences(
-		device,
-		1,
-		&fences.get()[current_frame_index]
-	);
-	assert(reset_fences_result == VK_SUCCESS);
+	// The last frame to use this images command buffer has finished, so its timings are ready
+	VkHelper::CollectGpuTimings(gpu_profiler, frame_loop.image_index);
+	if (gpu_profile && frame_loop.frame_number > 0 && frame_loop.frame_number % 300 == 0) PrintGpuTimings();
 
-	render_submission_info.pCommandBuffers = &graphics_command_buffers.get()[current_frame_index];
-
-	VkResult queue_submit_result = vkQueueSubmit(
+	// Submit the commands recorded for this image and present it. We don't wait for the GPU here, the CPU carries
+	// straight on with the next frame while this one is being rendered
+	VkResult end_frame_result = VkHelper::EndFrame(
+		device,
 		graphics_queue,
-		1,
-		&render_submission_info,
-		fences.get()[current_frame_index]
-	);
-	assert(queue_submit_result == VK_SUCCESS);
-
-	present_info.pImageIndices = &current_frame_index;
-
-	VkResult queue_present_result = vkQueuePresentKHR(
 		present_queue,
-		&present_info
+		swap_chain,
+		frame_loop,
+		&graphics_command_buffers.get()[frame_loop.image_index],  // The command buffer that renders to this image
+		1,
+		VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT              // Only the colour output needs to wait for the image
 	);
 	// If the window was resized or something else made the current render invalid, we need to rebuild all the
 	// render resources
-	if (queue_present_result == VK_ERROR_OUT_OF_DATE_KHR)
+	if (end_frame_result == VK_ERROR_OUT_OF_DATE_KHR)
 	{
 		RebuildRenderResources();
 	}
-
-	assert(queue_present_result == VK_SUCCESS || queue_present_result == VK_ERROR_OUT_OF_DATE_KHR);
-
-
-	VkResult device_idle_result = vkDeviceWaitIdle(device);
-	assert(device_idle_result == VK_SUCCESS);
 }
 
 int main(int argc, char **argv)
 {
+	VK_HELPER_CPU_THREAD_NAME("Main");
+
+	headless = VkHelper::ParseHeadlessOptions(argc, argv);
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--gpu-profile") == 0) gpu_profile = true;
+	}
+	VkHelper::StartBenchmark(VkHelper::ParseBenchmarkOptions(argc, argv), "IndirectDrawing", benchmark);
+	// The benchmark reports the GPU timings as well
+	if (benchmark.enabled) gpu_profile = true;
 
 	Setup();
 
+	benchmark.allocator = &allocator;
+	benchmark.gpu_profiler = &gpu_profiler;
+	VkHelper::MarkBenchmarkPhase(benchmark, "Setup");
+
+	// Time how long the driver takes to build the pipelines, compare the first run (cold cache) with later runs (warm cache)
+	std::chrono::high_resolution_clock::time_point pipeline_build_start = std::chrono::high_resolution_clock::now();
+
+	// Queue up the graphics and cull pipelines, the texture and model are loaded while they build
 	CreateGraphicsPipeline();
+	CreateCullPipeline();
 
 	// Create albedo texture for the model
-	STexture metal_texture = CreateTexture("../../../Data/Images/futuristic-panels1-bl/futuristic-panels1-albedo.png");
+	std::chrono::high_resolution_clock::time_point texture_load_start = std::chrono::high_resolution_clock::now();
+
+	std::vector<STexture> textures = CreateTextures({
+		"../../../Data/Images/futuristic-panels1-bl/futuristic-panels1-albedo.png"
+	});
+	STexture& metal_texture = textures[0];
+	VkHelper::MarkBenchmarkPhase(benchmark, "Textures");
+
+	std::chrono::high_resolution_clock::time_point texture_load_end = std::chrono::high_resolution_clock::now();
+	std::cout << "Texture loading took " << std::chrono::duration_cast<std::chrono::microseconds>(texture_load_end - texture_load_start).count() / 1000.0f
+		<< "ms" << std::endl;
+	// Textures and framebuffer attachments with the same sampler state all share one VkSampler
+	std::cout << VkHelper::SamplerCacheReferenceCount() << " samplers in use, " << VkHelper::SamplerCacheSize() << " created" << std::endl;
 
-	// Set the albedo texture
-	SetAlbedoTexture(metal_texture);
+	// Send the texture to the GPU, the model can be loaded while it is copied
+	uint64_t texture_upload = VkHelper::SubmitUploads(upload_manager);
 
-	// Load the new model
-	CreateModel("../../../Data/Models/Octopus.obj", octopus_model);
+	// Load the new model, its materials use the albedo texture
+	CreateModel("../../../Data/Models/Octopus.obj", octopus_model, metal_texture.heap_index);
+
+	// Now every model has added its materials, send the table to the GPU
+	CreateMaterialBuffer();
+	VkHelper::MarkBenchmarkPhase(benchmark, "Model");
 
 
 
@@ -1531,14 +2238,14 @@ int main(int argc, char **argv)
 	//////////////////////////////////
 
 	// Loop through the models and randomly give them a position in space
-	// and scale them down to 30% of there size
+	// and scale them down to 30% of there size. They are spread out much wider than the camera can see
 	for (int i = 0; i < MODEL_COUNT; i++)
 	{
 		model_positions[i] = glm::mat4(1.0f);
 		glm::vec3 test = glm::vec3(
-			(float)((rand() % 200) - 100) * 0.1f,
-			(float)((rand() % 200) - 100) * 0.1f,
-			-10 - (float)(rand() % 100) * 0.1f
+			(float)((rand() % 2000) - 1000) * 0.1f,
+			(float)((rand() % 2000) - 1000) * 0.1f,
+			-10 - (float)(rand() % 900) * 0.1f
 		);
 		model_positions[i] = glm::translate(model_positions[i], test);
 		model_positions[i] = glm::scale(model_positions[i], glm::vec3(0.3f,0.3f,0.3f));
@@ -1548,37 +2255,42 @@ int main(int argc, char **argv)
 
 	VkHelper::CreateBuffer(
 		device,                                                          // What device are we going to use to create the buffer
-		physical_device_mem_properties,                                  // What memory properties are available on the device
+		allocator,                                                       // What allocator are we getting the memory from
 		model_position_buffer.buffer,                                    // What buffer are we going to be creating
-		model_position_buffer.buffer_memory,                             // The output for the buffer memory
+		model_position_buffer.allocation,                                // The output for the buffer allocation
 		model_position_buffer_size,                                      // How much memory we wish to allocate on the GPU
-		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,                               // What type of buffer do we want. Buffers can have multiple types, for example, uniform & vertex buffer.
-																		 // for now we want to keep the buffer specialized to one type as this will allow vulkan to optimize the data.
+		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |                              // What type of buffer do we want. The cull shader reads the positions as a storage buffer,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |                             // and without culling they are drawn from directly as a vertex buffer
+		VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 		VK_SHARING_MODE_EXCLUSIVE,                                       // There are two modes, exclusive and concurrent. Defines if it can concurrently be used by multiple queue
 																		 // families at the same time
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT                              // What properties do we require of our memory
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT                              // With this many instances, keep them in GPU memory as they are read every frame
 	);
 
-	// Get the pointer to the GPU memory
-	VkResult model_position_mapped_memory_result = vkMapMemory(
-		device,                                                         // The device that the memory is on
-		model_position_buffer.buffer_memory,                            // The device memory instance
-		0,                                                              // Offset from the memory starts that we are accessing
-		model_position_buffer_size,                                     // How much memory are we accessing
-		0,                                                              // Flags (we don't need this for basic buffers)
-		&model_position_buffer.mapped_buffer_memory                     // The return for the memory pointer
+	// Copy the positions to the GPU through the upload managers staging memory
+	VkHelper::UploadBuffer(
+		upload_manager,
+		model_positions,                                                 // Source for the memory (CPU-Ram)
+		model_position_buffer_size,                                      // How much data we are transferring
+		model_position_buffer.buffer,                                    // What buffer are we copying into
+		0,
+		VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, // Read by the cull shader or the vertex input
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT
 	);
 
-	// Could we map the GPU memory to our CPU accessible pointer
-	assert(model_position_mapped_memory_result == VK_SUCCESS);
+	uint64_t model_position_upload = VkHelper::SubmitUploads(upload_manager);
 
 
-
-	// Transfer data over to the model position buffer
-	memcpy(
-		model_position_buffer.mapped_buffer_memory,                     // The destination for our memory (GPU)
-		model_positions,                                                // Source for the memory (CPU-Ram)
-		model_position_buffer_size                                      // How much data we are transferring
+	// The cull writes the instances that can be seen in to this buffer, it needs to be able to hold all of them
+	VkHelper::CreateBuffer(
+		device,                                                          // What device are we going to use to create the buffer
+		allocator,                                                       // What allocator are we getting the memory from
+		visible_model_position_buffer.buffer,                            // What buffer are we going to be creating
+		visible_model_position_buffer.allocation,                        // The output for the buffer allocation
+		model_position_buffer_size,                                      // How much memory we wish to allocate on the GPU
+		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VK_SHARING_MODE_EXCLUSIVE,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT                              // Only the GPU ever touches this buffer
 	);
 
 
@@ -1594,7 +2306,7 @@ int main(int argc, char **argv)
 	indirect_draw_command.firstInstance = 0;							// If we are rendering a range of models (which we are), whats the first model index we want to render?
 	indirect_draw_command.indexCount = octopus_model.index_count;		// How many indexes are we wanting to render? 3 per triangle normally
 	indirect_draw_command.instanceCount = MODEL_COUNT;					// How many models are we wanting to render? Each model gets a position from the position
-																		// array allocated to it.
+																		// array allocated to it. When culling, the cull shader replaces this every frame
 	indirect_draw_command.vertexOffset = octopus_model.vertex_offset;	// How much should the vertex be offset?
 
 
@@ -1603,29 +2315,20 @@ int main(int argc, char **argv)
 
 	VkHelper::CreateBuffer(
 		device,                                                          // What device are we going to use to create the buffer
-		physical_device_mem_properties,                                  // What memory properties are available on the device
+		allocator,                                                       // What allocator are we getting the memory from
 		indirect_draw_buffer.buffer,                                     // What buffer are we going to be creating
-		indirect_draw_buffer.buffer_memory,                              // The output for the buffer memory
+		indirect_draw_buffer.allocation,                                 // The output for the buffer allocation
 		indirect_buffer_size,                                            // How much memory we wish to allocate on the GPU
-		VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,                             // What type of buffer do we want. Buffers can have multiple types, for example, uniform & vertex buffer.
-																		 // for now we want to keep the buffer specialized to one type as this will allow vulkan to optimize the data.
+		VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |                            // What type of buffer do we want. The cull shader writes the instance count as a storage buffer
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |                             // and it is cleared with vkCmdFillBuffer at the start of the frame
+		VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 		VK_SHARING_MODE_EXCLUSIVE,                                       // There are two modes, exclusive and concurrent. Defines if it can concurrently be used by multiple queue
 																		 // families at the same time
 		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT                              // What properties do we require of our memory
 	);
 
-	// Get the pointer to the GPU memory
-	VkResult mapped_memory_result = vkMapMemory(
-		device,                                                         // The device that the memory is on
-		indirect_draw_buffer.buffer_memory,                             // The device memory instance
-		0,                                                              // Offset from the memory starts that we are accessing
-		indirect_buffer_size,                                           // How much memory are we accessing
-		0,                                                              // Flags (we don't need this for basic buffers)
-		&indirect_draw_buffer.mapped_buffer_memory                      // The return for the memory pointer
-	);
-
-	// Could we map the GPU memory to our CPU accessible pointer
-	assert(mapped_memory_result == VK_SUCCESS);
+	// The allocator keeps host visible blocks mapped, so we can just take the pointer
+	indirect_draw_buffer.mapped_buffer_memory = indirect_draw_buffer.allocation.mapped_memory;
 
 
 
@@ -1637,65 +2340,156 @@ int main(int argc, char **argv)
 	);
 
 
+
+	/////////////////////////////////
+	///// Setup Frustum Culling /////
+	/////////////////////////////////
+
+	SCullSettings cull_settings;
+	// The sphere is in model space, the shader moves it with each instances matrix
+	cull_settings.bounding_sphere = octopus_model.bounding_sphere;
+	cull_settings.instance_count = MODEL_COUNT;
+
+	VkHelper::CreateBuffer(
+		device,                                                          // What device are we going to use to create the buffer
+		allocator,                                                       // What allocator are we getting the memory from
+		cull_settings_buffer.buffer,                                     // What buffer are we going to be creating
+		cull_settings_buffer.allocation,                                 // The output for the buffer allocation
+		sizeof(SCullSettings),                                           // How much memory we wish to allocate on the GPU
+		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+		VK_SHARING_MODE_EXCLUSIVE,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT                              // What properties do we require of our memory
+	);
+
+	// The allocator keeps host visible blocks mapped, so we can just take the pointer
+	cull_settings_buffer.mapped_buffer_memory = cull_settings_buffer.allocation.mapped_memory;
+
+	// Transfer data over to the cull settings buffer
+	memcpy(
+		cull_settings_buffer.mapped_buffer_memory,                      // The destination for our memory (GPU)
+		&cull_settings,                                                 // Source for the memory (CPU-Ram)
+		sizeof(SCullSettings)                                           // How much data we are transferring
+	);
+
+	UpdateCullDescriptors(
+		static_cast<uint32_t>(model_position_buffer_size),
+		static_cast<uint32_t>(indirect_buffer_size)
+	);
+	VkHelper::MarkBenchmarkPhase(benchmark, "Buffers");
+
+
+	// We need the pipelines now to record the commands
+	{
+		VK_HELPER_CPU_ZONE("Wait for pipelines");
+		graphics_pipeline = graphics_pipeline_build.get();
+		cull_pipeline = cull_pipeline_build.get();
+	}
+	VkHelper::MarkBenchmarkPhase(benchmark, "Wait for pipelines");
+
+	std::chrono::high_resolution_clock::time_point pipeline_build_end = std::chrono::high_resolution_clock::now();
+	std::cout << "Pipelines ready after " << std::chrono::duration_cast<std::chrono::microseconds>(pipeline_build_end - pipeline_build_start).count() / 1000.0f
+		<< "ms (" << (VkHelper::PipelineCacheLoadedFromDisk() ? "warm" : "cold") << " pipeline cache)" << std::endl;
+
 	// Regenerate the command buffers
 	BuildCommandBuffers(graphics_command_buffers, swapchain_image_count);
+	VkHelper::MarkBenchmarkPhase(benchmark, "Command buffers");
+
+	// The textures and model positions need to be on the GPU before we can start rendering
+	VkHelper::WaitForUpload(upload_manager, texture_upload);
+	// The mips have been generated, so any views and descriptors the compute fallback used can go
+	VkHelper::ReleaseMipmapResources(mipmap_generator);
+	VkHelper::WaitForUpload(upload_manager, model_position_upload);
+	VkHelper::MarkBenchmarkPhase(benchmark, "Wait for uploads");
+
+	std::chrono::high_resolution_clock::time_point render_start = std::chrono::high_resolution_clock::now();
 
 	while (window_open)
 	{
-		PollWindow();
+		if (!headless.enabled) PollWindow();
 
 		Render();
+
+		VkHelper::RecordBenchmarkFrame(benchmark);
+
+		// A headless run stops after a fixed number of frames so runs can be compared
+		if (headless.enabled && headless.frame_count > 0 && frame_loop.frame_number >= headless.frame_count) window_open = false;
 	}
 
+	// Let the frames that are still in flight finish before we start cleaning up
+	VkResult device_idle_result = vkDeviceWaitIdle(device);
+	assert(device_idle_result == VK_SUCCESS);
+
+	if (headless.enabled)
+	{
+		std::chrono::high_resolution_clock::time_point render_end = std::chrono::high_resolution_clock::now();
+		float render_ms = std::chrono::duration_cast<std::chrono::microseconds>(render_end - render_start).count() / 1000.0f;
+		std::cout << "Rendered " << frame_loop.frame_number << " headless frames in " << render_ms << "ms, "
+			<< render_ms / frame_loop.frame_number << "ms per frame" << std::endl;
+	}
+
+	if (benchmark.enabled)
+	{
+		if (VkHelper::WriteBenchmarkResults(benchmark)) std::cout << "Benchmark results written to " << benchmark.output_path << std::endl;
+		else std::cout << "Unable to write the benchmark results to " << benchmark.output_path << std::endl;
+	}
+
+	if (gpu_profile)
+	{
+		PrintGpuTimings();
+		if (VkHelper::WriteGpuTrace(gpu_profiler, "IndirectDrawing.gputrace.json")) std::cout << "GPU trace written to IndirectDrawing.gputrace.json" << std::endl;
+	}
+	VkHelper::DestroyGpuProfiler(gpu_profiler);
+
+	// Does nothing unless Vk-Helper was built with VK_HELPER_CPU_PROFILE
+	VK_HELPER_CPU_WRITE_TRACE("IndirectDrawing.cputrace.json");
+
 	////////////////////
 	///// Clean Up /////
 	////////////////////
 
 
-	// Now we unmap the data
-	vkUnmapMemory(
-		device,
-		indirect_draw_buffer.buffer_memory
-	);
-
-	// Clean up the buffer data
-	vkDestroyBuffer(
+	// Clean up the buffer and give its memory back to the allocator
+	VkHelper::DestroyBuffer(
 		device,
+		allocator,
 		indirect_draw_buffer.buffer,
-		nullptr
+		indirect_draw_buffer.allocation
 	);
 
-	// Free the memory that was allocated for the buffer
-	vkFreeMemory(
+	VkHelper::DestroyBuffer(
 		device,
-		indirect_draw_buffer.buffer_memory,
-		nullptr
+		allocator,
+		material_buffer.buffer,
+		material_buffer.allocation
 	);
 
 
-	// Now we unmap the data
-	vkUnmapMemory(
+	// Clean up the buffer and give its memory back to the allocator
+	VkHelper::DestroyBuffer(
 		device,
-		model_position_buffer.buffer_memory
+		allocator,
+		model_position_buffer.buffer,
+		model_position_buffer.allocation
 	);
 
-	// Clean up the buffer data
-	vkDestroyBuffer(
+	VkHelper::DestroyBuffer(
 		device,
-		model_position_buffer.buffer,
-		nullptr
+		allocator,
+		visible_model_position_buffer.buffer,
+		visible_model_position_buffer.allocation
 	);
 
-	// Free the memory that was allocated for the buffer
-	vkFreeMemory(
+	VkHelper::DestroyBuffer(
 		device,
-		model_position_buffer.buffer_memory,
-		nullptr
+		allocator,
+		cull_settings_buffer.buffer,
+		cull_settings_buffer.allocation
 	);
 
 
 	DestroyTexture(metal_texture);
 
+	DestroyCullPipeline();
 	DestroyGraphicsPipeline();
 	// Finish previous projects cleanups
 	Destroy();
@@ -1,11 +1,15 @@
 
+// Nothing is presented, the surface extensions are only asked for where the Win32 surface exists
+#ifdef _WIN32
 #define VK_USE_PLATFORM_WIN32_KHR
+#endif
 #include <assert.h>
 #include <stdio.h>
 #include <string.h>
 #include <memory>
 #include <stdexcept>
 #include <iostream>
+#include <chrono>
 
 
 #define GLM_ENABLE_EXPERIMENTAL
@@ -22,6 +26,8 @@
 
 #include <VkInitializers.hpp>
 #include <VkCore.hpp>
+#include <VkDispatch.hpp>
+#include <VkPipelineCache.hpp>
 
 
 struct SBuffer
@@ -38,6 +44,9 @@ struct SBuffer
 
 VkInstance instance;
 VkDebugReportCallbackEXT debugger;
+// Start with --no-validation to leave out the validation layers and the debugger, the benchmark runner uses this so it
+// times the sample rather than the layers
+bool validation = true;
 VkPhysicalDevice physical_device = VK_NULL_HANDLE;
 
 
@@ -66,25 +75,30 @@ void Setup()
 
 
 	// Define what Layers and Extensions we require
+#ifdef VK_USE_PLATFORM_WIN32_KHR
 	const uint32_t extention_count = 3;
 	const char *instance_extensions[extention_count] = { "VK_EXT_debug_report" ,VK_KHR_SURFACE_EXTENSION_NAME,VK_KHR_WIN32_SURFACE_EXTENSION_NAME };
+#else
+	const uint32_t extention_count = 1;
+	const char *instance_extensions[extention_count] = { "VK_EXT_debug_report" };
+#endif
 	const uint32_t layer_count = 1;
 	const char *instance_layers[layer_count] = { "VK_LAYER_LUNARG_standard_validation" };
 
 	// Check to see if we have the layer requirments
-	assert(VkHelper::CheckLayersSupport(instance_layers, 1) && "Unsupported Layers Found");
+	assert(VkHelper::CheckLayersSupport(instance_layers, validation ? layer_count : 0) && "Unsupported Layers Found");
 
 	// Create the Vulkan Instance
 	instance = VkHelper::CreateInstance(
-		instance_extensions, extention_count,
-		instance_layers, layer_count,
+		instance_extensions, validation ? extention_count : 0,    // Without validation there is no debug report to hook up
+		instance_layers, validation ? layer_count : 0,
 		"Compute Pipeline", VK_MAKE_VERSION(1, 0, 0),
 		"Vulkan", VK_MAKE_VERSION(1, 0, 0),
 		VK_MAKE_VERSION(1, 1, 108));
 
 	// Attach a debugger to the application to give us validation feedback.
 	// This is useful as it tells us about any issues without application
-	debugger = VkHelper::CreateDebugger(instance);
+	if (validation) debugger = VkHelper::CreateDebugger(instance);
 
 	// Define what Device Extensions we require
 	const uint32_t physical_device_extention_count = 1;
@@ -134,6 +148,13 @@ void Setup()
 		&compute_queue
 	);
 
+	// Load the pipeline cache from the last run, all pipelines created through Vk-Helper will use it
+	VkHelper::LoadPipelineCache(
+		device,
+		physical_device_properties,                            // Used to check the cache was made by this GPU and driver
+		"ComputePipeline.pipelinecache"                        // Where the cache is stored between runs
+	);
+
 	command_pool = VkHelper::CreateCommandPool(
 		device,
 		physical_devices_queue_family,                         // What queue family we are wanting to use to send commands to the GPU
@@ -159,6 +180,12 @@ void Destroy()
 		nullptr
 	);
 
+	// Write the pipeline cache out so the next run can skip compiling the shaders
+	VkHelper::DestroyPipelineCache(device);
+
+	// The device is going away, free its dispatch table so a later device given the same handle loads its own
+	VkHelper::UnregisterDeviceDispatch(device);
+
 	// Clean up the device now that the project is stopping
 	vkDestroyDevice(
 		device,
@@ -167,10 +194,13 @@ void Destroy()
 
 	// Destroy the debug callback
 	// We cant directly call vkDestroyDebugReportCallbackEXT as we need to find the pointer within the Vulkan DLL, See function implementation for details.
-	VkHelper::DestroyDebugger(
-		instance, 
-		debugger
-	);
+	if (validation)
+	{
+		VkHelper::DestroyDebugger(
+			instance,
+			debugger
+		);
+	}
 
 	// Clean up the vulkan instance
 	vkDestroyInstance(
@@ -182,6 +212,11 @@ void Destroy()
 
 int main(int argc, char **argv)
 {
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--no-validation") == 0) validation = false;
+	}
+
 
 	Setup();
 
@@ -377,10 +412,13 @@ int main(int argc, char **argv)
 	compute_pipeline_create_info.layout = compute_pipeline_layout;
 	compute_pipeline_create_info.stage = info;
 
+	// Time how long the driver takes to build the pipelines, compare the first run (cold cache) with later runs (warm cache)
+	std::chrono::high_resolution_clock::time_point pipeline_build_start = std::chrono::high_resolution_clock::now();
+
 	// Create the compute pipeline
 	VkResult create_compute_pipeline = vkCreateComputePipelines(
 		device,
-		0,
+		VkHelper::GetPipelineCache(),                          // Reuse any shaders compiled on a previous run
 		1,
 		&compute_pipeline_create_info,
 		nullptr,
@@ -389,6 +427,10 @@ int main(int argc, char **argv)
 
 	assert(create_compute_pipeline == VK_SUCCESS);
 
+	std::chrono::high_resolution_clock::time_point pipeline_build_end = std::chrono::high_resolution_clock::now();
+	std::cout << "Pipeline creation took " << std::chrono::duration_cast<std::chrono::microseconds>(pipeline_build_end - pipeline_build_start).count() / 1000.0f
+		<< "ms (" << (VkHelper::PipelineCacheLoadedFromDisk() ? "warm" : "cold") << " pipeline cache)" << std::endl;
+
 
 
 	////////////////////////////////////////////////////////////////////////
@@ -1,5 +1,8 @@
 
+// The window surface is only hooked up for Windows, anywhere else the sample can still be run with --headless
+#ifdef _WIN32
 #define VK_USE_PLATFORM_WIN32_KHR
+#endif
 #include <assert.h>
 #include <stdio.h>
 #include <string.h>
@@ -27,6 +30,13 @@ typedef std::chrono::high_resolution_clock Clock;
 
 #include <VkInitializers.hpp>
 #include <VkCore.hpp>
+#include <VkDispatch.hpp>
+#include <VkPipelineCache.hpp>
+#include <VkPipelineBuildQueue.hpp>
+#include <VkFrameLoop.hpp>
+#include <VkHeadless.hpp>
+#include <VkGpuProfiler.hpp>
+#include <VkRingBuffer.hpp>
 
 
 #define PARTICLE_COUNT 1000			// How many particles will there be
@@ -104,9 +114,13 @@ VkPhysicalDeviceFeatures physical_device_features;
 VkPhysicalDeviceMemoryProperties physical_device_mem_properties;
 
 VkDevice device = VK_NULL_HANDLE;
+// The devices own functions, the commands recorded every frame are called through this rather than the loader
+const VkHelper::DeviceDispatch* device_dispatch = nullptr;
 VkQueue graphics_queue = VK_NULL_HANDLE;
 VkQueue present_queue = VK_NULL_HANDLE;
 VkCommandPool command_pool;
+// The ring buffer the camera is pushed into gets its memory from here
+VkHelper::Allocator allocator;
 
 bool window_open;
 SDL_Window* window;
@@ -128,27 +142,41 @@ VkRenderPass renderpass = VK_NULL_HANDLE;
 std::unique_ptr<VkFramebuffer> framebuffers = nullptr;
 std::unique_ptr<VkHelper::VulkanAttachments> framebuffer_attachments = nullptr;
 
-uint32_t current_frame_index = 0; // What frame are we currently using
-std::unique_ptr<VkFence> fences = nullptr;
+// How many frames the CPU is allowed to get ahead of the GPU
+const uint32_t frames_in_flight = 2;
+VkHelper::FrameLoop frame_loop;
 
-VkSemaphore image_available_semaphore;
-VkSemaphore render_finished_semaphore;
-VkSubmitInfo render_submission_info = {};
-VkPresentInfoKHR present_info = {};
-VkPipelineStageFlags wait_stages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+// Start with --headless [frame count] to render a fixed number of frames into offscreen images, with no window
+VkHelper::HeadlessOptions headless;
+VkHelper::HeadlessSwapchain headless_swapchain;
+
+// Start with --gpu-profile to time the particle compute and draw on the GPU. The timings are printed every few hundred
+// frames and written out as a Chrome trace when the sample closes
+bool gpu_profile = false;
+VkHelper::GpuProfiler gpu_profiler;
+// Each frame in flights compute command buffer has its own slot of queries, each prerecorded graphics command buffer
+// uses one of the slots after them
+const uint32_t graphics_gpu_slot_offset = frames_in_flight;
+uint32_t compute_gpu_scope = 0;
+uint32_t draw_gpu_scope = 0;
+
+VkHelper::PipelineBuildQueue pipeline_build_queue;
 
 std::unique_ptr<VkCommandBuffer> graphics_command_buffers = nullptr;
 
 const unsigned int shader_stage_count = 3;
 std::unique_ptr<VkShaderModule> graphics_shader_modules;
 VkPipeline graphics_pipeline = VK_NULL_HANDLE;
+std::shared_future<VkPipeline> graphics_pipeline_build;
 VkPipelineLayout graphics_pipeline_layout = VK_NULL_HANDLE;
 
-std::unique_ptr<VkFence> compute_fence;
 VkShaderModule compute_shader_module;
 VkPipeline compute_pipeline = VK_NULL_HANDLE;
+std::shared_future<VkPipeline> compute_pipeline_build;
 VkPipelineLayout compute_pipeline_layout = VK_NULL_HANDLE;
-VkCommandBuffer compute_command_buffer = VK_NULL_HANDLE;
+// One compute command buffer per frame in flight, each reads the particle settings from its frames region of the buffer.
+// They are submitted along with the frames graphics command buffer, so there is no separate fence for the CPU to wait on
+std::unique_ptr<VkCommandBuffer> compute_command_buffers = nullptr;
 
 
 VkBuffer particle_vertex_buffer = VK_NULL_HANDLE;
@@ -161,13 +189,17 @@ VkDescriptorSet particle_descriptor_set;
 
 
 SCamera camera;
-SBuffer camera_buffer;
+// The camera is pushed into a ring buffer, each swapchain image reads it from its own region
+VkHelper::RingBuffer uniform_buffer;
 VkDescriptorPool camera_descriptor_pool;
 VkDescriptorSetLayout camera_descriptor_set_layout;
 VkDescriptorSet camera_descriptor_set;
 
 SParticleSystemSettings particle_system_settings;
+// Holds a copy of the settings for each frame in flight, so the CPU never writes over settings a previous frame is still reading
 SBuffer particle_system_buffer;
+// Distance between each frames settings, rounded up to minUniformBufferOffsetAlignment
+VkDeviceSize particle_system_settings_stride = 0;
 std::chrono::steady_clock::time_point last_frame_time;
 float delta_time;
 
@@ -214,10 +246,34 @@ void BuildCamera()
 	);
 	// Flip the cameras prospective upside down as glm assumes that the renderer we are using renders top to bottom, vulkan is the opposite
 	camera.projection[1][1] *= -1.0f;
+}
 
-	// Transfer data over to the texture buffer
+// Push this frames camera into its region of the ring buffer
+void UpdateUniforms(uint32_t frame_index)
+{
+	// Wait till the last submit that used this region is done before we write into it
+	VkHelper::BeginRingBufferFrame(
+		device,
+		uniform_buffer,
+		frame_index,
+		VkHelper::CurrentFrameFence(frame_loop)
+	);
+
+	uint32_t camera_offset = 0;
+	void* camera_memory = nullptr;
+	bool allocated = VkHelper::RingBufferAllocate(
+		uniform_buffer,                             // What ring buffer are we allocating from
+		sizeof(SCamera),                            // How much memory do we need
+		camera_offset,                              // The dynamic offset of the data
+		camera_memory                               // Where we can write the data
+	);
+	// The camera is the only thing we push each frame, so it sits at the start of the frames region.
+	// This is the dynamic offset the command buffers were recorded with
+	assert(allocated && camera_offset == VkHelper::RingBufferRegionOffset(uniform_buffer, frame_index));
+
+	// Transfer data over to the uniform buffer
 	memcpy(
-		camera_buffer.mapped_buffer_memory,         // The destination for our memory (GPU)
+		camera_memory,                              // The destination for our memory (GPU)
 		&camera,                                    // Source for the memory (CPU-Ram)
 		sizeof(SCamera)                             // How much data we are transferring
 	);
@@ -263,6 +319,7 @@ void DestroyWindow()
 // Create windows surface for sdl to interface with
 void CreateSurface()
 {
+#ifdef VK_USE_PLATFORM_WIN32_KHR
 	auto CreateWin32SurfaceKHR = (PFN_vkCreateWin32SurfaceKHR)vkGetInstanceProcAddr(instance, "vkCreateWin32SurfaceKHR");
 
 	VkWin32SurfaceCreateInfoKHR createInfo = {};
@@ -274,6 +331,9 @@ void CreateSurface()
 	{
 		throw std::runtime_error("failed to create window surface!");
 	}
+#else
+	throw std::runtime_error("window surfaces are only supported on windows, run with --headless instead");
+#endif
 }
 
 // Everything within the Setup is from previous tutorials
@@ -290,17 +350,34 @@ void CreateSurface()
 void Setup()
 {
 
-	WindowSetup("Vulkan", 1080, 720);
+	if (headless.enabled)
+	{
+		// No window, the offscreen images are the size the window would have been
+		window_width = 1080;
+		window_height = 720;
+		window_open = true;
+	}
+	else
+	{
+		WindowSetup("Vulkan", 1080, 720);
+	}
 
 
 	// Define what Layers and Extensions we require
-	const uint32_t extention_count = 3;
-	const char *instance_extensions[extention_count] = { "VK_EXT_debug_report" ,VK_KHR_SURFACE_EXTENSION_NAME,VK_KHR_WIN32_SURFACE_EXTENSION_NAME };
-	const uint32_t layer_count = 1;
-	const char *instance_layers[layer_count] = { "VK_LAYER_LUNARG_standard_validation" };
+#ifdef VK_USE_PLATFORM_WIN32_KHR
+	const uint32_t window_extention_count = 3;
+	const char *instance_extensions[window_extention_count] = { "VK_EXT_debug_report" ,VK_KHR_SURFACE_EXTENSION_NAME,VK_KHR_WIN32_SURFACE_EXTENSION_NAME };
+#else
+	const uint32_t window_extention_count = 1;
+	const char *instance_extensions[window_extention_count] = { "VK_EXT_debug_report" };
+#endif
+	const char *instance_layers[1] = { "VK_LAYER_LUNARG_standard_validation" };
+	// A headless run needs no surface, and is left without the validation layers as they would be most of what it times
+	const uint32_t extention_count = headless.enabled ? 0 : window_extention_count;
+	const uint32_t layer_count = headless.enabled ? 0 : 1;
 
 	// Check to see if we have the layer requirments
-	assert(VkHelper::CheckLayersSupport(instance_layers, 1) && "Unsupported Layers Found");
+	assert(VkHelper::CheckLayersSupport(instance_layers, layer_count) && "Unsupported Layers Found");
 
 	// Create the Vulkan Instance
 	instance = VkHelper::CreateInstance(
@@ -312,9 +389,10 @@ void Setup()
 
 	// Attach a debugger to the application to give us validation feedback.
 	// This is useful as it tells us about any issues without application
-	debugger = VkHelper::CreateDebugger(instance);
+	if (!headless.enabled) debugger = VkHelper::CreateDebugger(instance);
 
 	// Define what Device Extensions we require
+	// The swapchain extension is still needed headless, the frames leave their images in the present layout
 	const uint32_t physical_device_extention_count = 1;
 	// Note that this extension list is different from the instance on as we are telling the system what device settings we need.
 	const char *physical_device_extensions[physical_device_extention_count] = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
@@ -323,7 +401,7 @@ void Setup()
 
 	// The surface creation is added here as it needs to happen before the physical device creation and after we have said to the instance that we need a surface
 	// The surface is the reference back to the OS window
-	CreateSurface();
+	if (!headless.enabled) CreateSurface();
 
 
 
@@ -363,6 +441,8 @@ void Setup()
 		physical_device_extention_count                        // How many extensions are there
 	);
 
+	device_dispatch = &VkHelper::GetDeviceDispatch(device);
+
 	vkGetDeviceQueue(
 		device,
 		physical_devices_queue_family,
@@ -377,6 +457,28 @@ void Setup()
 		&present_queue
 	);
 
+	// Create the allocator that the camera ring buffer will get its memory from
+	VkHelper::CreateAllocator(
+		device,
+		physical_device_properties,
+		physical_device_mem_properties,
+		allocator
+	);
+
+	// Load the pipeline cache from the last run, all pipelines created through Vk-Helper will use it
+	VkHelper::LoadPipelineCache(
+		device,
+		physical_device_properties,                            // Used to check the cache was made by this GPU and driver
+		"ComputeParticleSystem.pipelinecache"                  // Where the cache is stored between runs
+	);
+
+	// Start the workers that will compile our pipelines in the background
+	VkHelper::CreatePipelineBuildQueue(
+		device,
+		0,                                                     // Use all but one of the CPU threads
+		pipeline_build_queue
+	);
+
 	command_pool = VkHelper::CreateCommandPool(
 		device,
 		physical_devices_queue_family,                         // What queue family we are wanting to use to send commands to the GPU
@@ -388,12 +490,32 @@ void Setup()
 
 
 
-	// Create the fences required for the swap chain rendering 
-	VkHelper::CreateFence(device, fences, swapchain_image_count);
+	// Create the per frame semaphores, fences and command buffers for the frames in flight
+	VkHelper::CreateFrameLoop(
+		device,
+		command_pool,
+		swapchain_image_count,                                 // How many images the frames will be rendering into
+		frames_in_flight,                                      // How many frames can be worked on at once
+		frame_loop
+	);
+	// Acquire and present from the offscreen images rather than a swapchain
+	if (headless.enabled) frame_loop.headless_swapchain = &headless_swapchain;
 
-	// Create the image available and finished semaphore
-	VkHelper::CreateVkSemaphore(device, image_available_semaphore);
-	VkHelper::CreateVkSemaphore(device, render_finished_semaphore);
+	if (gpu_profile)
+	{
+		bool gpu_profiler_created = VkHelper::CreateGpuProfiler(
+			physical_device,
+			device,
+			physical_devices_queue_family,
+			frames_in_flight + swapchain_image_count,          // A slot for each compute and each graphics command buffer
+			2,                                                 // The particle update and the draw
+			100000,                                            // How many scopes to keep for the trace
+			gpu_profiler
+		);
+		if (!gpu_profiler_created) std::cout << "The graphics queue can't write timestamps, GPU profiling is off" << std::endl;
+	}
+	compute_gpu_scope = VkHelper::RegisterGpuScope(gpu_profiler, "Particle update");
+	draw_gpu_scope = VkHelper::RegisterGpuScope(gpu_profiler, "Particle draw");
 
 	VkCommandBufferAllocateInfo command_buffer_allocate_info = VkHelper::CommandBufferAllocateInfo(
 		command_pool,
@@ -409,10 +531,6 @@ void Setup()
 	);
 	assert(allocate_command_buffer_resut == VK_SUCCESS);
 
-	render_submission_info = VkHelper::SubmitInfo(1, &image_available_semaphore, 1, &render_finished_semaphore, wait_stages);
-
-	present_info = VkHelper::PresentInfoKHR(1, &render_finished_semaphore, swap_chain);
-
 	// Create the models vertex buffer
 	VkHelper::CreateBuffer(
 		device,                                                                      // What device are we going to use to create the buffer
@@ -481,38 +599,17 @@ void Setup()
 
 
 
-	camera_buffer.buffer_size = sizeof(SCamera);
-	camera_buffer.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
-	camera_buffer.sharing_mode = VK_SHARING_MODE_EXCLUSIVE;
-	camera_buffer.buffer_memory_properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-
-	// Create a temp buffer to store the image in before we transfer it over to the image
-	VkHelper::CreateBuffer(
-		device,								   // What device are we going to use to create the buffer
-		physical_device_mem_properties,		   // What memory properties are available on the device
-		camera_buffer.buffer,                  // What buffer are we going to be creating
-		camera_buffer.buffer_memory,           // The output for the buffer memory
-		camera_buffer.buffer_size,             // How much memory we wish to allocate on the GPU
-		camera_buffer.usage,                   // What type of buffer do we want. Buffers can have multiple types, for example, uniform & vertex buffer.
-											   // for now we want to keep the buffer specialized to one type as this will allow vulkan to optimize the data.
-		camera_buffer.sharing_mode,            // There are two modes, exclusive and concurrent. Defines if it can concurrently be used by multiple queue
-											   // families at the same time
-		camera_buffer.buffer_memory_properties // What properties do we require of our memory
+	// Create the ring buffer the camera will be pushed into every frame
+	VkHelper::CreateRingBuffer(
+		device,                                // What device are we going to use to create the buffer
+		allocator,                             // What allocator are we getting the memory from
+		physical_device_properties,            // Used to find the dynamic offset alignment
+		64 * 1024,                             // How much data can each frame push
+		swapchain_image_count,                 // One region for each image, the command buffers are recorded per image
+		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,    // The ranges will be bound as dynamic uniform buffers
+		uniform_buffer                         // The output ring buffer
 	);
 
-	// Get the pointer to the GPU memory
-	VkResult mapped_memory_result = vkMapMemory(
-		device,                                        // The device that the memory is on
-		camera_buffer.buffer_memory,                   // The device memory instance
-		0,                                             // Offset from the memory starts that we are accessing
-		camera_buffer.buffer_size,                     // How much memory are we accessing
-		0,                                             // Flags (we don't need this for basic buffers)
-		&camera_buffer.mapped_buffer_memory            // The return for the memory pointer
-	);
-
-	// Could we map the GPU memory to our CPU accessible pointer
-	assert(mapped_memory_result == VK_SUCCESS);
-
 	BuildCamera();
 
 	// Define how many descriptor pools we will need
@@ -520,7 +617,7 @@ void Setup()
 
 	// Define that the new descriptor pool will be taking a combined image sampler
 	VkDescriptorPoolSize camera_pool_size[camera_descriptor_pool_size_count] = {
-		VkHelper::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1)
+		VkHelper::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1)
 	};
 
 
@@ -535,7 +632,7 @@ void Setup()
 
 	// Define at what stage of the rendering pipeline the texture is coming into as well as what shader and what location
 	VkDescriptorSetLayoutBinding camera_layout_bindings[camera_descriptor_pool_size_count] = {
-		VkHelper::DescriptorSetLayoutBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT)
+		VkHelper::DescriptorSetLayoutBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1, VK_SHADER_STAGE_VERTEX_BIT)
 	};
 
 	// Create the new texture set layout
@@ -554,7 +651,11 @@ void Setup()
 	);
 	
 
-	particle_system_buffer.buffer_size = sizeof(SParticleSystemSettings);
+	// Round each frames settings up so they can be bound with a dynamic offset
+	VkDeviceSize settings_alignment = physical_device_properties.limits.minUniformBufferOffsetAlignment;
+	particle_system_settings_stride = (sizeof(SParticleSystemSettings) + settings_alignment - 1) / settings_alignment * settings_alignment;
+
+	particle_system_buffer.buffer_size = particle_system_settings_stride * frames_in_flight;
 	particle_system_buffer.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
 	particle_system_buffer.sharing_mode = VK_SHARING_MODE_EXCLUSIVE;
 	particle_system_buffer.buffer_memory_properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
@@ -574,7 +675,7 @@ void Setup()
 	);
 
 	// Get the pointer to the GPU memory
-	mapped_memory_result = vkMapMemory(
+	VkResult mapped_memory_result = vkMapMemory(
 		device,                                        // The device that the memory is on
 		particle_system_buffer.buffer_memory,          // The device memory instance
 		0,                                             // Offset from the memory starts that we are accessing
@@ -590,12 +691,12 @@ void Setup()
 	last_frame_time = Clock::now();
 
 	VkDescriptorBufferInfo descriptorImageInfo = VkHelper::DescriptorBufferInfo(
-		camera_buffer.buffer,
-		camera_buffer.buffer_size,
-		0
+		uniform_buffer.buffer,
+		sizeof(SCamera),
+		0                                      // The images region is selected with a dynamic offset when binding
 	);
 
-	VkWriteDescriptorSet descriptorWrite = VkHelper::WriteDescriptorSet(camera_descriptor_set, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, descriptorImageInfo, 0);
+	VkWriteDescriptorSet descriptorWrite = VkHelper::WriteDescriptorSet(camera_descriptor_set, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, descriptorImageInfo, 0);
 
 	// Update the descriptor with the texture data
 	vkUpdateDescriptorSets(
@@ -715,27 +816,22 @@ void Destroy()
 		nullptr
 	);
 
-	for (uint32_t i = 0; i < swapchain_image_count; i++)
-	{
-		vkDestroyFence(
-			device,
-			fences.get()[i],
-			nullptr
-		);
-	}
-
-	vkDestroySemaphore(
+	VkHelper::DestroyFrameLoop(
 		device,
-		image_available_semaphore,
-		nullptr
+		command_pool,
+		frame_loop
 	);
 
-	vkDestroySemaphore(
+	// Clean up the uniform ring buffer
+	VkHelper::DestroyRingBuffer(
 		device,
-		render_finished_semaphore,
-		nullptr
+		allocator,
+		uniform_buffer
 	);
 
+	// Now the ring buffer is gone, give the allocators blocks back
+	VkHelper::DestroyAllocator(allocator);
+
 	// Clean up the command pool
 	vkDestroyCommandPool(
 		device,
@@ -743,6 +839,18 @@ void Destroy()
 		nullptr
 	);
 
+	// Let any pipelines still being built finish before the cache is written
+	VkHelper::DestroyPipelineBuildQueue(pipeline_build_queue);
+
+	// Write the pipeline cache out so the next run can skip compiling the shaders
+	VkHelper::DestroyPipelineCache(device);
+
+	// Any samplers the textures and attachments didn't give back are still held by the cache, they go before the device
+	VkHelper::DestroySamplerCache(device);
+
+	// The device is going away, free its dispatch table so a later device given the same handle loads its own
+	VkHelper::UnregisterDeviceDispatch(device);
+
 	// Clean up the device now that the project is stopping
 	vkDestroyDevice(
 		device,
@@ -751,10 +859,13 @@ void Destroy()
 
 	// Destroy the debug callback
 	// We cant directly call vkDestroyDebugReportCallbackEXT as we need to find the pointer within the Vulkan DLL, See function implementation for details.
-	VkHelper::DestroyDebugger(
-		instance, 
-		debugger
-	);
+	if (!headless.enabled)
+	{
+		VkHelper::DestroyDebugger(
+			instance, 
+			debugger
+		);
+	}
 
 	// Clean up the vulkan instance
 	vkDestroyInstance(
@@ -762,7 +873,7 @@ void Destroy()
 		NULL
 	);
 
-	DestroyWindow();
+	if (!headless.enabled) DestroyWindow();
 }
 
 void CreateGraphicsPipeline()
@@ -829,47 +940,67 @@ void CreateGraphicsPipeline()
 		texture_descriptor_set_layout
 	};
 
-	// Create the pipeline
-	graphics_pipeline = VkHelper::CreateGraphicsPipeline(
-		physical_device,
-		device,
-		renderpass,
-		graphics_pipeline_layout,
-		shader_stage_count,
-		shader_paths,
-		shader_stages_bits,
-		graphics_shader_modules.get(),
-		descriptor_set_layout_count,
-		descriptor_set_layout,
-		vertex_input_attribute_description_count,
-		vertex_input_attribute_descriptions.get(),
-		vertex_input_binding_description_count,
-		vertex_input_binding_descriptions.get(),
-		dynamic_state_count,
-		dynamic_states,
-		VK_PRIMITIVE_TOPOLOGY_POINT_LIST,
-		VK_POLYGON_MODE_FILL,
-		100.0f,
-		VK_CULL_MODE_NONE
+	// Describe the pipeline and hand it over to the build queue, it will be compiled on a worker thread
+	// while the main thread carries on loading the rest of the scene
+	VkHelper::GraphicsPipelineDescription description;
+	description.physical_device = physical_device;
+	description.renderpass = renderpass;
+	description.pipeline_layout = &graphics_pipeline_layout;
+	description.shader_modules = graphics_shader_modules.get();
+	description.shader_paths.assign(shader_paths, shader_paths + shader_stage_count);
+	description.shader_stages.assign(shader_stages_bits, shader_stages_bits + shader_stage_count);
+	description.descriptor_set_layouts.assign(descriptor_set_layout, descriptor_set_layout + descriptor_set_layout_count);
+	description.vertex_input_attribute_descriptions.assign(vertex_input_attribute_descriptions.get(), vertex_input_attribute_descriptions.get() + vertex_input_attribute_description_count);
+	description.vertex_input_binding_descriptions.assign(vertex_input_binding_descriptions.get(), vertex_input_binding_descriptions.get() + vertex_input_binding_description_count);
+	description.dynamic_states.assign(dynamic_states, dynamic_states + dynamic_state_count);
+	description.topology = VK_PRIMITIVE_TOPOLOGY_POINT_LIST;
+	description.polygon_mode = VK_POLYGON_MODE_FILL;
+	description.line_width = 100.0f;
+	description.cull_mode = VK_CULL_MODE_NONE;
+
+	graphics_pipeline_build = VkHelper::QueueGraphicsPipeline(
+		pipeline_build_queue,
+		description
 	);
 	
 }
 
 void CreateRenderResources()
 {
-	swap_chain = VkHelper::CreateSwapchain(
-		physical_device,
-		device,
-		surface,
-		surface_capabilities,
-		surface_format,
-		present_mode,
-		window_width,
-		window_height,
-		swapchain_image_count,
-		swapchain_images,
-		swapchain_image_views
-	);
+	if (headless.enabled)
+	{
+		// Three images, the same as a triple buffered swapchain
+		surface_format.format = VK_FORMAT_B8G8R8A8_UNORM;
+		swap_chain = VK_NULL_HANDLE;
+		VkHelper::CreateHeadlessSwapchain(
+			device,
+			physical_device_mem_properties,
+			surface_format.format,
+			window_width,
+			window_height,
+			3,
+			headless_swapchain,
+			swapchain_image_count,
+			swapchain_images,
+			swapchain_image_views
+		);
+	}
+	else
+	{
+		swap_chain = VkHelper::CreateSwapchain(
+			physical_device,
+			device,
+			surface,
+			surface_capabilities,
+			surface_format,
+			present_mode,
+			window_width,
+			window_height,
+			swapchain_image_count,
+			swapchain_images,
+			swapchain_image_views
+		);
+	}
 
 
 	const VkFormat colorFormat = VK_FORMAT_R8G8B8A8_UNORM;
@@ -945,7 +1076,7 @@ void CreateComputePipeline()
 	// Define that the new descriptor pool will be taking a combined image sampler
 	VkDescriptorPoolSize vertex_pool_size[vertex_descriptor_pool_size_count] = {
 		VkHelper::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1),
-		VkHelper::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1),
+		VkHelper::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1),
 	};
 
 
@@ -961,7 +1092,7 @@ void CreateComputePipeline()
 	// Define at what stage of the rendering pipeline the texture is coming into as well as what shader and what location
 	VkDescriptorSetLayoutBinding vertex_layout_bindings[vertex_descriptor_pool_size_count] = {
 		VkHelper::DescriptorSetLayoutBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT),
-		VkHelper::DescriptorSetLayoutBinding(1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT)
+		VkHelper::DescriptorSetLayoutBinding(1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1, VK_SHADER_STAGE_COMPUTE_BIT)
 	};
 
 	// Create the new texture set layout
@@ -1008,15 +1139,16 @@ void CreateComputePipeline()
 
 	{
 		// Update the vertex buffer being accessed by the compute shader
+		// Only one frames settings are visible at a time, the dynamic offset picks which frame
 		VkDescriptorBufferInfo vertex_descriptor_buffer_info = VkHelper::DescriptorBufferInfo(
 			particle_system_buffer.buffer,
-			particle_system_buffer.buffer_size,
+			sizeof(SParticleSystemSettings),
 			0
 		);
 
 		VkWriteDescriptorSet descriptor_writes = VkHelper::WriteDescriptorSet(
 			particle_descriptor_set,
-			VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+			VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
 			vertex_descriptor_buffer_info,
 			1
 		);
@@ -1039,45 +1171,44 @@ void CreateComputePipeline()
 		particle_descriptor_set_layout
 	};
 
-	compute_pipeline = VkHelper::CreateComputePipeline(
-		device,
-		compute_pipeline_layout,
-		"../../../Data/Shaders/14-ComputeParticleSystem/ParticleSystemCompute/comp.spv",
-		compute_shader_module,
-		descriptor_set_layout_count,
-		descriptor_set_layout
-	);
-
+	// Build the compute pipeline on a worker thread at the same time as the graphics pipeline
+	VkHelper::ComputePipelineDescription compute_description;
+	compute_description.pipeline_layout = &compute_pipeline_layout;
+	compute_description.shader_module = &compute_shader_module;
+	compute_description.shader_path = "../../../Data/Shaders/14-ComputeParticleSystem/ParticleSystemCompute/comp.spv";
+	compute_description.descriptor_set_layouts.assign(descriptor_set_layout, descriptor_set_layout + descriptor_set_layout_count);
 
-	compute_fence = std::unique_ptr<VkFence>();
-	// Create a new fence to make sure the execution of the command buffer was successful 
-	VkHelper::CreateFence(
-		device,
-		compute_fence,
-		1
+	compute_pipeline_build = VkHelper::QueueComputePipeline(
+		pipeline_build_queue,
+		compute_description
 	);
 
-	// Define the structure needed to allocate a new command buffer
+
+	// Define the structure needed to allocate a compute command buffer for each frame in flight
 	VkCommandBufferAllocateInfo command_buffer_allocate_info = VkHelper::CommandBufferAllocateInfo(
 		command_pool,
-		1
+		frames_in_flight
 	);
 
-	// Allocate the new command buffer
+	compute_command_buffers = std::unique_ptr<VkCommandBuffer>(new VkCommandBuffer[frames_in_flight]);
+
+	// Allocate the new command buffers
 	VkResult allocate_command_buffer_resut = vkAllocateCommandBuffers(
 		device,
 		&command_buffer_allocate_info,
-		&compute_command_buffer
+		compute_command_buffers.get()
 	);
+	assert(allocate_command_buffer_resut == VK_SUCCESS);
 }
 
 void DestroyComputePipeline()
 {
 
-	vkDestroyFence(
+	vkFreeCommandBuffers(
 		device,
-		*compute_fence.get(),
-		nullptr
+		command_pool,
+		frames_in_flight,
+		compute_command_buffers.get()
 	);
 
 	vkDestroyPipeline(
@@ -1294,10 +1425,9 @@ void DestroyTexture(STexture& texture)
 	);
 
 	// Destroy the image sampler now that we are done with that
-	vkDestroySampler(
+	VkHelper::ReleaseSampler(
 		device,
-		texture.sampler,
-		nullptr
+		texture.sampler
 	);
 
 	// Destroy the image we are displaying
@@ -1337,11 +1467,21 @@ void DestroyRenderResources()
 		nullptr
 	);
 
-	vkDestroySwapchainKHR(
-		device,
-		swap_chain,
-		nullptr
-	);
+	if (headless.enabled)
+	{
+		VkHelper::DestroyHeadlessSwapchain(
+			device,
+			headless_swapchain
+		);
+	}
+	else
+	{
+		vkDestroySwapchainKHR(
+			device,
+			swap_chain,
+			nullptr
+		);
+	}
 
 	for (uint32_t i = 0; i < swapchain_image_count; i++)
 	{
@@ -1373,10 +1513,9 @@ void DestroyRenderResources()
 			framebuffer_attachments.get()[i].color.memory,
 			nullptr
 		);
-		vkDestroySampler(
+		VkHelper::ReleaseSampler(
 			device,
-			framebuffer_attachments.get()[i].color.sampler,
-			nullptr
+			framebuffer_attachments.get()[i].color.sampler
 		);
 		vkDestroyImageView(
 			device,
@@ -1393,22 +1532,103 @@ void DestroyRenderResources()
 			framebuffer_attachments.get()[i].depth.memory,
 			nullptr
 		);
-		vkDestroySampler(
+		VkHelper::ReleaseSampler(
 			device,
-			framebuffer_attachments.get()[i].depth.sampler,
-			nullptr
+			framebuffer_attachments.get()[i].depth.sampler
 		);
 	}
 }
 
 void RebuildRenderResources()
 {
+	// Only the window can go out of date, the headless images stay the same size
+	assert(!headless.enabled);
+
 	// Wait for the device to finish
 	VkResult device_idle_result = vkDeviceWaitIdle(device);
 	assert(device_idle_result == VK_SUCCESS);
+	uint32_t old_swapchain_image_count = swapchain_image_count;
 	// Destroy and rebuild the render resources
 	DestroyRenderResources();
 	CreateRenderResources();
+	// The old swapchain images are gone, so forget which frames were using them
+	VkHelper::ResetFrameLoopImages(frame_loop, swapchain_image_count);
+
+	// There is a graphics command buffer per image, so if the image count changed they need to be allocated again
+	if (swapchain_image_count != old_swapchain_image_count)
+	{
+		vkFreeCommandBuffers(
+			device,
+			command_pool,
+			old_swapchain_image_count,
+			graphics_command_buffers.get()
+		);
+
+		VkCommandBufferAllocateInfo command_buffer_allocate_info = VkHelper::CommandBufferAllocateInfo(
+			command_pool,
+			swapchain_image_count
+		);
+
+		graphics_command_buffers = std::unique_ptr<VkCommandBuffer>(new VkCommandBuffer[swapchain_image_count]);
+
+		VkResult allocate_command_buffer_resut = vkAllocateCommandBuffers(
+			device,
+			&command_buffer_allocate_info,
+			graphics_command_buffers.get()
+		);
+		assert(allocate_command_buffer_resut == VK_SUCCESS);
+	}
+
+	// The graphics command buffers have a profiler slot each after the compute ones. Nothing is in flight, so the old
+	// query pool can go straight away
+	VkQueryPool old_query_pool = VkHelper::GrowGpuProfiler(gpu_profiler, graphics_gpu_slot_offset + swapchain_image_count);
+	if (old_query_pool != VK_NULL_HANDLE)
+	{
+		vkDestroyQueryPool(
+			device,
+			old_query_pool,
+			nullptr
+		);
+	}
+
+	// The camera ring buffer has a region per image, so a larger swapchain needs a larger ring buffer
+	if (swapchain_image_count > uniform_buffer.region_count)
+	{
+		VkDeviceSize region_size = uniform_buffer.region_size;
+		VkHelper::DestroyRingBuffer(
+			device,
+			allocator,
+			uniform_buffer
+		);
+
+		VkHelper::CreateRingBuffer(
+			device,
+			allocator,
+			physical_device_properties,
+			region_size,                                       // Each frame pushes the same amount as before
+			swapchain_image_count,                             // One region for each image of the new swapchain
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			uniform_buffer
+		);
+
+		// The device is idle, so the camera set can point straight at the new buffer
+		VkDescriptorBufferInfo camera_buffer_info = VkHelper::DescriptorBufferInfo(
+			uniform_buffer.buffer,
+			sizeof(SCamera),
+			0
+		);
+
+		VkWriteDescriptorSet camera_write = VkHelper::WriteDescriptorSet(camera_descriptor_set, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, camera_buffer_info, 0);
+
+		vkUpdateDescriptorSets(
+			device,
+			1,
+			&camera_write,
+			0,
+			NULL
+		);
+	}
+
 	BuildCommandBuffers(graphics_command_buffers, swapchain_image_count);
 }
 
@@ -1480,15 +1700,19 @@ void BuildCommandBuffers(std::unique_ptr<VkCommandBuffer>& command_buffers, cons
 		// check to see if the command buffer was created
 		assert(begin_command_buffer_result == VK_SUCCESS);
 
+		// The timestamp queries have to be reset outside of the render pass
+		VkHelper::ResetGpuProfilerSlot(command_buffers.get()[i], gpu_profiler, i + graphics_gpu_slot_offset);
+		VkHelper::BeginGpuScope(command_buffers.get()[i], gpu_profiler, i + graphics_gpu_slot_offset, draw_gpu_scope);
+
 		// Define that we will be starting a new render pass
-		vkCmdBeginRenderPass(
+		device_dispatch->vkCmdBeginRenderPass(
 			command_buffers.get()[i],
 			&render_pass_info,
 			VK_SUBPASS_CONTENTS_INLINE
 		);
 
 		// Set the viewport
-		vkCmdSetViewport(
+		device_dispatch->vkCmdSetViewport(
 			command_buffers.get()[i],
 			0,
 			1,
@@ -1496,7 +1720,7 @@ void BuildCommandBuffers(std::unique_ptr<VkCommandBuffer>& command_buffers, cons
 		);
 
 		// Set the scissor region
-		vkCmdSetScissor(
+		device_dispatch->vkCmdSetScissor(
 			command_buffers.get()[i],
 			0,
 			1,
@@ -1504,7 +1728,7 @@ void BuildCommandBuffers(std::unique_ptr<VkCommandBuffer>& command_buffers, cons
 		);
 
 		// Bind the graphics pipeline
-		vkCmdBindPipeline(
+		device_dispatch->vkCmdBindPipeline(
 			command_buffers.get()[i],
 			VK_PIPELINE_BIND_POINT_GRAPHICS,
 			graphics_pipeline
@@ -1512,7 +1736,7 @@ void BuildCommandBuffers(std::unique_ptr<VkCommandBuffer>& command_buffers, cons
 		
 		VkDeviceSize offsets[] = { 0 };
 		// Bind the models vertex buffer
-		vkCmdBindVertexBuffers(
+		device_dispatch->vkCmdBindVertexBuffers(
 			command_buffers.get()[i],
 			0,
 			1,
@@ -1521,20 +1745,23 @@ void BuildCommandBuffers(std::unique_ptr<VkCommandBuffer>& command_buffers, cons
 		);
 
 
+		// The camera is read from the images region of the ring buffer
+		uint32_t camera_dynamic_offset = static_cast<uint32_t>(VkHelper::RingBufferRegionOffset(uniform_buffer, i));
+
 		// Bind the position to the pipeline
-		vkCmdBindDescriptorSets(
+		device_dispatch->vkCmdBindDescriptorSets(
 			command_buffers.get()[i],
 			VK_PIPELINE_BIND_POINT_GRAPHICS,
 			graphics_pipeline_layout,
 			0,
 			1,
 			&camera_descriptor_set,
-			0,
-			NULL
+			1,
+			&camera_dynamic_offset
 		);
 
 		// Bind the texture to the pipeline
-		vkCmdBindDescriptorSets(
+		device_dispatch->vkCmdBindDescriptorSets(
 			command_buffers.get()[i],
 			VK_PIPELINE_BIND_POINT_GRAPHICS,
 			graphics_pipeline_layout,
@@ -1546,7 +1773,7 @@ void BuildCommandBuffers(std::unique_ptr<VkCommandBuffer>& command_buffers, cons
 		);
 
 		// Render from the pre made render buffer 
-		vkCmdDrawIndirect(
+		device_dispatch->vkCmdDrawIndirect(
 			command_buffers.get()[i],
 			indirect_draw_buffer.buffer,
 			0,
@@ -1556,10 +1783,12 @@ void BuildCommandBuffers(std::unique_ptr<VkCommandBuffer>& command_buffers, cons
 
 
 		// End the rendering
-		vkCmdEndRenderPass(
+		device_dispatch->vkCmdEndRenderPass(
 			command_buffers.get()[i]
 		);
 
+		VkHelper::EndGpuScope(command_buffers.get()[i], gpu_profiler, i + graphics_gpu_slot_offset, draw_gpu_scope);
+
 		// End the current rendering command
 		VkResult end_command_buffer_result = vkEndCommandBuffer(
 			command_buffers.get()[i]
@@ -1573,48 +1802,97 @@ void BuildComputeBuffers()
 	// Create a info structure to start the command buffer recording
 	VkCommandBufferBeginInfo command_buffer_begin_info = VkHelper::CommandBufferBeginInfo(VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT);
 
-	// Start the command buffer recording process
-	VkResult begin_command_buffer_result = vkBeginCommandBuffer(
-		compute_command_buffer,
-		&command_buffer_begin_info
-	);
+	for (uint32_t i = 0; i < frames_in_flight; i++)
+	{
+		uint32_t settings_offset = static_cast<uint32_t>(particle_system_settings_stride * i);
 
-	// Attach the pipeline to the command
-	vkCmdBindPipeline(
-		compute_command_buffer,
-		VK_PIPELINE_BIND_POINT_COMPUTE,
-		compute_pipeline
-	);
+		// Start the command buffer recording process
+		VkResult begin_command_buffer_result = vkBeginCommandBuffer(
+			compute_command_buffers.get()[i],
+			&command_buffer_begin_info
+		);
 
-	// Bind the data descriptor set to the command
-	vkCmdBindDescriptorSets(
-		compute_command_buffer,
-		VK_PIPELINE_BIND_POINT_COMPUTE,
-		compute_pipeline_layout,
-		0,
-		1,
-		&particle_descriptor_set,
-		0,
-		0
-	);
+		VkHelper::ResetGpuProfilerSlot(compute_command_buffers.get()[i], gpu_profiler, i);
+		VkHelper::BeginGpuScope(compute_command_buffers.get()[i], gpu_profiler, i, compute_gpu_scope);
 
-	// Execute the command
-	// The way the compute commands are ran is in a 3D coordinate space, for example, if we wanted to process a texture
-	// we would want to run the compute shader for the width x height of the texture, but in this instance we just want 
-	// to process it on a 1D array, so to work out the total amount of shader calls X * Y * Z or 'data_size' * 1 * 1
-	vkCmdDispatch(
-		compute_command_buffer,
-		PARTICLE_COUNT,							// X axis
-		1,										// Y axis
-		1										// Z axis
-	);
+		// Attach the pipeline to the command
+		device_dispatch->vkCmdBindPipeline(
+			compute_command_buffers.get()[i],
+			VK_PIPELINE_BIND_POINT_COMPUTE,
+			compute_pipeline
+		);
 
-	// End the command recording
-	VkResult end_command_buffer_result = vkEndCommandBuffer(
-		compute_command_buffer
-	);
+		// Bind the data descriptor set to the command
+		device_dispatch->vkCmdBindDescriptorSets(
+			compute_command_buffers.get()[i],
+			VK_PIPELINE_BIND_POINT_COMPUTE,
+			compute_pipeline_layout,
+			0,
+			1,
+			&particle_descriptor_set,
+			1,
+			&settings_offset                               // Read the settings from this frames region of the buffer
+		);
+
+		// With frames in flight, the previous frames may still be drawing the particles while the compute is submitted.
+		// As both are on the same queue, a barrier here makes the compute wait for the earlier vertex reads to finish
+		VkMemoryBarrier vertex_read_barrier = {};
+		vertex_read_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		vertex_read_barrier.srcAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+		vertex_read_barrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+
+		device_dispatch->vkCmdPipelineBarrier(
+			compute_command_buffers.get()[i],
+			VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,                 // Wait for the vertex input of earlier draws
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,               // Before the compute shader writes the particles
+			0,
+			1,
+			&vertex_read_barrier,
+			0,
+			nullptr,
+			0,
+			nullptr
+		);
+
+		// Execute the command
+		// The way the compute commands are ran is in a 3D coordinate space, for example, if we wanted to process a texture
+		// we would want to run the compute shader for the width x height of the texture, but in this instance we just want 
+		// to process it on a 1D array, so to work out the total amount of shader calls X * Y * Z or 'data_size' * 1 * 1
+		device_dispatch->vkCmdDispatch(
+			compute_command_buffers.get()[i],
+			PARTICLE_COUNT,							// X axis
+			1,										// Y axis
+			1										// Z axis
+		);
+
+		// Make the new particle positions visible to the vertex input of the draws submitted after this
+		VkMemoryBarrier compute_write_barrier = {};
+		compute_write_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		compute_write_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		compute_write_barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
 
-	assert(end_command_buffer_result == VK_SUCCESS);
+		device_dispatch->vkCmdPipelineBarrier(
+			compute_command_buffers.get()[i],
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+			0,
+			1,
+			&compute_write_barrier,
+			0,
+			nullptr,
+			0,
+			nullptr
+		);
+
+		VkHelper::EndGpuScope(compute_command_buffers.get()[i], gpu_profiler, i, compute_gpu_scope);
+
+		// End the command recording
+		VkResult end_command_buffer_result = vkEndCommandBuffer(
+			compute_command_buffers.get()[i]
+		);
+
+		assert(end_command_buffer_result == VK_SUCCESS);
+	}
 }
 
 void UpdateParticleSystem()
@@ -1632,119 +1910,99 @@ void UpdateParticleSystem()
 
 	particle_system_settings.system_position = glm::vec3( sin(delta_time * 0.25f) * 4, 0, 0 );
 
+	// BeginFrame has waited on this frames fence, so nothing is still reading its region of the settings
+	unsigned char* frame_settings = static_cast<unsigned char*>(particle_system_buffer.mapped_buffer_memory) +
+		particle_system_settings_stride * frame_loop.frame_index;
+
 	// Transfer data over to the texture buffer
 	memcpy(
-		particle_system_buffer.mapped_buffer_memory,		// The destination for our memory (GPU)
+		frame_settings,										// The destination for our memory (GPU)
 		&particle_system_settings,							// Source for the memory (CPU-Ram)
 		sizeof(SParticleSystemSettings)						// How much data we are transferring
 	);
 
+	// The last compute submit from this frame in flight has finished, so its timings are ready
+	VkHelper::CollectGpuTimings(gpu_profiler, frame_loop.frame_index);
+}
 
-	// Create a new submit info instance
-	VkSubmitInfo submit_info = VkHelper::SubmitInfo(compute_command_buffer);
-
-	// Submit the command pool to the queue for execution
-	VkResult compute_submit_result = vkQueueSubmit(
-		graphics_queue,										// You can use the graphics queue to process compute tasks
-		1,
-		&submit_info,
-		*compute_fence.get()
-	);
-	assert(compute_submit_result == VK_SUCCESS);
-
-	// Wait for the fence to be released, this will happen upon the completion of the compute shader
-	VkResult wait_for_fence_result = vkWaitForFences(
-		device,
-		1,
-		compute_fence.get(),
-		VK_TRUE,
-		LONG_MAX
-	);
-	assert(wait_for_fence_result == VK_SUCCESS);
-
-	// Reset the fence for the "next" call of the shader, in this case we are not doing multiple calls, but we could
-	VkResult reset_fence_result = vkResetFences(
-		device,
-		1,
-		compute_fence.get()
-	);
-	assert(wait_for_fence_result == VK_SUCCESS);
+void PrintGpuTimings()
+{
+	for (const VkHelper::GpuScopeStats& stats : VkHelper::GetGpuScopeStats(gpu_profiler))
+	{
+		std::cout << stats.name << ": " << stats.average_ms << "ms average, " << stats.p50_ms << "ms p50, " << stats.p95_ms << "ms p95, "
+			<< stats.p99_ms << "ms p99, " << stats.max_ms << "ms worst over " << stats.samples << " frames" << std::endl;
+	}
 }
 
 void Render()
 {
-	// Find next image
-	VkResult wait_for_fences = vkWaitForFences(
-		device,
-		1,
-		&fences.get()[current_frame_index],
-		VK_TRUE,
-		UINT32_MAX
-	);
-	assert(wait_for_fences == VK_SUCCESS);
-
-	VkResult acquire_next_image_result = vkAcquireNextImageKHR(
+	// Wait for the oldest frame in flight to finish and find the next image
+	VkResult begin_frame_result = VkHelper::BeginFrame(
 		device,
 		swap_chain,
-		UINT64_MAX,
-		image_available_semaphore,
-		VK_NULL_HANDLE,
-		&current_frame_index
+		frame_loop
 	);
-	assert(acquire_next_image_result == VK_SUCCESS);
-
-	// Reset and wait
-	VkResult queue_idle_result = vkQueueWaitIdle(
-		graphics_queue
-	);
-	assert(queue_idle_result == VK_SUCCESS);
+	// The swapchain no longer matches the window, rebuild it and pick the frame up next time round
+	if (begin_frame_result == VK_ERROR_OUT_OF_DATE_KHR)
+	{
+		RebuildRenderResources();
+		return;
+	}
 
-	VkResult reset_fences_result = vkResetFences(
-		device,
-		1,
-		&fences.get()[current_frame_index]
-	);
-	assert(reset_fences_result == VK_SUCCESS);
+	// Now we know what image we are rendering, write its camera
+	UpdateUniforms(frame_loop.image_index);
 
-	render_submission_info.pCommandBuffers = &graphics_command_buffers.get()[current_frame_index];
+	// Move the particles on, the compute for this frame is submitted along with its draw
+	UpdateParticleSystem();
 
-	VkResult queue_submit_result = vkQueueSubmit(
-		graphics_queue,
-		1,
-		&render_submission_info,
-		fences.get()[current_frame_index]
-	);
-	assert(queue_submit_result == VK_SUCCESS);
+	// The last frame to use this images command buffer has finished, so its timings are ready
+	VkHelper::CollectGpuTimings(gpu_profiler, frame_loop.image_index + graphics_gpu_slot_offset);
+	if (gpu_profile && frame_loop.frame_number > 0 && frame_loop.frame_number % 300 == 0) PrintGpuTimings();
 
-	present_info.pImageIndices = &current_frame_index;
+	// The compute runs first in the same submit, its barriers make the draw wait for the new particle positions
+	VkCommandBuffer frame_command_buffers[2] = {
+		compute_command_buffers.get()[frame_loop.frame_index],
+		graphics_command_buffers.get()[frame_loop.image_index]
+	};
 
-	VkResult queue_present_result = vkQueuePresentKHR(
+	// Submit the commands recorded for this image and present it. We don't wait for the GPU here, the CPU carries
+	// straight on with the next frame while this one is being rendered
+	VkResult end_frame_result = VkHelper::EndFrame(
+		device,
+		graphics_queue,
 		present_queue,
-		&present_info
+		swap_chain,
+		frame_loop,
+		frame_command_buffers,                                     // The particle update and the commands that render to this image
+		2,
+		VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT              // Only the colour output needs to wait for the image
 	);
 	// If the window was resized or something else made the current render invalid, we need to rebuild all the
 	// render resources
-	if (queue_present_result == VK_ERROR_OUT_OF_DATE_KHR)
+	if (end_frame_result == VK_ERROR_OUT_OF_DATE_KHR)
 	{
 		RebuildRenderResources();
 	}
-
-	assert(queue_present_result == VK_SUCCESS || queue_present_result == VK_ERROR_OUT_OF_DATE_KHR);
-
-
-	VkResult device_idle_result = vkDeviceWaitIdle(device);
-	assert(device_idle_result == VK_SUCCESS);
 }
 
 int main(int argc, char **argv)
 {
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--gpu-profile") == 0) gpu_profile = true;
+	}
+
 	// Setup the vulkan instance and device settings
+	headless = VkHelper::ParseHeadlessOptions(argc, argv);
 	Setup();
 
-	// Create the graphics pipeline
+	// Time how long the driver takes to build the pipelines, compare the first run (cold cache) with later runs (warm cache)
+	std::chrono::high_resolution_clock::time_point pipeline_build_start = std::chrono::high_resolution_clock::now();
+
+	// Queue up the graphics pipeline
 	CreateGraphicsPipeline();
 
-	// Create the particle system compute pipeline
+	// Queue up the particle system compute pipeline
 	CreateComputePipeline();
 
 	// Create albedo texture for the model
@@ -1777,18 +2035,49 @@ int main(int argc, char **argv)
 		sizeof(SParticleData) * PARTICLE_COUNT				                     // How much data we are transferring
 	);
 
+	// The scene was loaded while the pipelines were building, we need them now to record the commands
+	graphics_pipeline = graphics_pipeline_build.get();
+	compute_pipeline = compute_pipeline_build.get();
+
+	std::chrono::high_resolution_clock::time_point pipeline_build_end = std::chrono::high_resolution_clock::now();
+	std::cout << "Pipelines ready after " << std::chrono::duration_cast<std::chrono::microseconds>(pipeline_build_end - pipeline_build_start).count() / 1000.0f
+		<< "ms (" << (VkHelper::PipelineCacheLoadedFromDisk() ? "warm" : "cold") << " pipeline cache)" << std::endl;
+
 	// Regenerate the command buffers
 	BuildCommandBuffers(graphics_command_buffers, swapchain_image_count);
 
 	BuildComputeBuffers();
 
+	std::chrono::high_resolution_clock::time_point render_start = std::chrono::high_resolution_clock::now();
+
 	while (window_open)
 	{
-		PollWindow();
+		if (!headless.enabled) PollWindow();
 
-		UpdateParticleSystem();
 		Render();
+
+		// A headless run stops after a fixed number of frames so runs can be compared
+		if (headless.enabled && headless.frame_count > 0 && frame_loop.frame_number >= headless.frame_count) window_open = false;
+	}
+
+	// Let the frames that are still in flight finish before we start cleaning up
+	VkResult device_idle_result = vkDeviceWaitIdle(device);
+	assert(device_idle_result == VK_SUCCESS);
+
+	if (headless.enabled)
+	{
+		std::chrono::high_resolution_clock::time_point render_end = std::chrono::high_resolution_clock::now();
+		float render_ms = std::chrono::duration_cast<std::chrono::microseconds>(render_end - render_start).count() / 1000.0f;
+		std::cout << "Rendered " << frame_loop.frame_number << " headless frames in " << render_ms << "ms, "
+			<< render_ms / frame_loop.frame_number << "ms per frame" << std::endl;
+	}
+
+	if (gpu_profile)
+	{
+		PrintGpuTimings();
+		if (VkHelper::WriteGpuTrace(gpu_profiler, "ComputeParticleSystem.gputrace.json")) std::cout << "GPU trace written to ComputeParticleSystem.gputrace.json" << std::endl;
 	}
+	VkHelper::DestroyGpuProfiler(gpu_profiler);
 
 	////////////////////
 	///// Clean Up /////
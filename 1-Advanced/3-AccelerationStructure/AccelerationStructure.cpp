@@ -1,11 +1,15 @@
 
+// The window surface is only hooked up for Windows, anywhere else the sample can still be run with --headless
+#ifdef _WIN32
 #define VK_USE_PLATFORM_WIN32_KHR
+#endif
 #include <assert.h>
 #include <stdio.h>
 #include <string.h>
 #include <memory>
 #include <stdexcept>
 #include <iostream>
+#include <chrono>
 
 
 #define GLM_ENABLE_EXPERIMENTAL
@@ -25,6 +29,10 @@
 
 #include <VkInitializers.hpp>
 #include <VkCore.hpp>
+#include <VkDispatch.hpp>
+#include <VkFrameLoop.hpp>
+#include <VkHeadless.hpp>
+#include <VkRingBuffer.hpp>
 
 struct SBuffer
 {
@@ -139,6 +147,8 @@ VkDevice device = VK_NULL_HANDLE;
 VkQueue graphics_queue = VK_NULL_HANDLE;
 VkQueue present_queue = VK_NULL_HANDLE;
 VkCommandPool command_pool;
+// The ring buffer the camera is pushed into gets its memory from here
+VkHelper::Allocator allocator;
 
 
 
@@ -186,14 +196,13 @@ VkDeviceMemory top_level_as_instance_buffer_memory = VK_NULL_HANDLE;
 // Raw pointer that will point to GPU memory
 void* top_level_as_instance_mapped_buffer_memory = nullptr;
 
-uint32_t current_frame_index = 0; // What frame are we currently using
-std::unique_ptr<VkFence> fences = nullptr;
+// How many frames the CPU is allowed to get ahead of the GPU
+const uint32_t frames_in_flight = 2;
+VkHelper::FrameLoop frame_loop;
 
-VkSemaphore image_available_semaphore;
-VkSemaphore render_finished_semaphore;
-VkSubmitInfo render_submission_info = {};
-VkPresentInfoKHR present_info = {};
-VkPipelineStageFlags wait_stages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+// Start with --headless [frame count] to render a fixed number of frames into offscreen images, with no window
+VkHelper::HeadlessOptions headless;
+VkHelper::HeadlessSwapchain headless_swapchain;
 
 std::unique_ptr<VkCommandBuffer> graphics_command_buffers = nullptr;
 
@@ -210,7 +219,8 @@ VkDeviceMemory index_buffer_memory = VK_NULL_HANDLE;
 void* index_mapped_buffer_memory = nullptr;
 
 SCamera camera;
-SBuffer camera_buffer;
+// The camera is pushed into a ring buffer, each swapchain image reads it from its own region
+VkHelper::RingBuffer uniform_buffer;
 VkDescriptorPool camera_descriptor_pool;
 VkDescriptorSetLayout camera_descriptor_set_layout;
 VkDescriptorSet camera_descriptor_set;
@@ -260,10 +270,34 @@ void BuildCamera()
 	// Flip the cameras prospective upside down as glm assumes that the renderer we are using renders top to bottom, vulkan is the opposite
 	camera.projection[1][1] *= -1.0f;
 	camera.projection = glm::inverse(camera.projection);
+}
 
-	// Transfer data over to the texture buffer
+// Push this frames camera into its region of the ring buffer
+void UpdateUniforms(uint32_t frame_index)
+{
+	// Wait till the last submit that used this region is done before we write into it
+	VkHelper::BeginRingBufferFrame(
+		device,
+		uniform_buffer,
+		frame_index,
+		VkHelper::CurrentFrameFence(frame_loop)
+	);
+
+	uint32_t camera_offset = 0;
+	void* camera_memory = nullptr;
+	bool allocated = VkHelper::RingBufferAllocate(
+		uniform_buffer,                             // What ring buffer are we allocating from
+		sizeof(SCamera),                            // How much memory do we need
+		camera_offset,                              // The dynamic offset of the data
+		camera_memory                               // Where we can write the data
+	);
+	// The camera is the only thing we push each frame, so it sits at the start of the frames region.
+	// This is the dynamic offset the descriptor set is bound with
+	assert(allocated && camera_offset == VkHelper::RingBufferRegionOffset(uniform_buffer, frame_index));
+
+	// Transfer data over to the uniform buffer
 	memcpy(
-		camera_buffer.mapped_buffer_memory,         // The destination for our memory (GPU)
+		camera_memory,                              // The destination for our memory (GPU)
 		&camera,                                    // Source for the memory (CPU-Ram)
 		sizeof(SCamera)                             // How much data we are transferring
 	);
@@ -309,6 +343,7 @@ void DestroyWindow()
 // Create windows surface for sdl to interface with
 void CreateSurface()
 {
+#ifdef VK_USE_PLATFORM_WIN32_KHR
 	auto CreateWin32SurfaceKHR = (PFN_vkCreateWin32SurfaceKHR)vkGetInstanceProcAddr(instance, "vkCreateWin32SurfaceKHR");
 
 	VkWin32SurfaceCreateInfoKHR createInfo = {};
@@ -320,6 +355,9 @@ void CreateSurface()
 	{
 		throw std::runtime_error("failed to create window surface!");
 	}
+#else
+	throw std::runtime_error("window surfaces are only supported on windows, run with --headless instead");
+#endif
 }
 
 // Everything within the Setup is from previous tutorials
@@ -335,17 +373,35 @@ void CreateSurface()
 void Setup()
 {
 
-	WindowSetup("Vulkan", 1080, 720);
+	if (headless.enabled)
+	{
+		// No window, the offscreen images are the size the window would have been
+		window_width = 1080;
+		window_height = 720;
+		window_open = true;
+	}
+	else
+	{
+		WindowSetup("Vulkan", 1080, 720);
+	}
 
 
 	// Define what Layers and Extensions we require
-	const uint32_t extention_count = 4;
-	const char *instance_extensions[extention_count] = { VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME, "VK_EXT_debug_report" ,VK_KHR_SURFACE_EXTENSION_NAME,VK_KHR_WIN32_SURFACE_EXTENSION_NAME };
-	const uint32_t layer_count = 1;
-	const char *instance_layers[layer_count] = { "VK_LAYER_LUNARG_standard_validation" };
+#ifdef VK_USE_PLATFORM_WIN32_KHR
+	const uint32_t window_extention_count = 4;
+	const char *instance_extensions[window_extention_count] = { VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME, "VK_EXT_debug_report" ,VK_KHR_SURFACE_EXTENSION_NAME,VK_KHR_WIN32_SURFACE_EXTENSION_NAME };
+#else
+	const uint32_t window_extention_count = 2;
+	const char *instance_extensions[window_extention_count] = { VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME, "VK_EXT_debug_report" };
+#endif
+	const char *instance_layers[1] = { "VK_LAYER_LUNARG_standard_validation" };
+	// A headless run only needs the extensions at the front of the list, not the surface or the debug report. It is left
+	// without the validation layers as they would be most of what it times
+	const uint32_t extention_count = headless.enabled ? 1 : window_extention_count;
+	const uint32_t layer_count = headless.enabled ? 0 : 1;
 
 	// Check to see if we have the layer requirments
-	assert(VkHelper::CheckLayersSupport(instance_layers, 1) && "Unsupported Layers Found");
+	assert(VkHelper::CheckLayersSupport(instance_layers, layer_count) && "Unsupported Layers Found");
 
 	// Create the Vulkan Instance
 	instance = VkHelper::CreateInstance(
@@ -357,9 +413,10 @@ void Setup()
 
 	// Attach a debugger to the application to give us validation feedback.
 	// This is useful as it tells us about any issues without application
-	debugger = VkHelper::CreateDebugger(instance);
+	if (!headless.enabled) debugger = VkHelper::CreateDebugger(instance);
 
 	// Define what Device Extensions we require
+	// The swapchain extension is still needed headless, the frames leave their images in the present layout
 	const uint32_t physical_device_extention_count = 3;
 	// Note that this extension list is different from the instance on as we are telling the system what device settings we need.
 	const char *physical_device_extensions[physical_device_extention_count] = { 
@@ -372,7 +429,7 @@ void Setup()
 
 	// The surface creation is added here as it needs to happen before the physical device creation and after we have said to the instance that we need a surface
 	// The surface is the reference back to the OS window
-	CreateSurface();
+	if (!headless.enabled) CreateSurface();
 
 
 
@@ -426,6 +483,14 @@ void Setup()
 		&present_queue
 	);
 
+	// Create the allocator that the camera ring buffer will get its memory from
+	VkHelper::CreateAllocator(
+		device,
+		physical_device_properties,
+		physical_device_mem_properties,
+		allocator
+	);
+
 	command_pool = VkHelper::CreateCommandPool(
 		device,
 		physical_devices_queue_family,                         // What queue family we are wanting to use to send commands to the GPU
@@ -437,12 +502,16 @@ void Setup()
 
 
 
-	// Create the fences required for the swap chain rendering 
-	VkHelper::CreateFence(device, fences, swapchain_image_count);
-
-	// Create the image available and finished semaphore
-	VkHelper::CreateVkSemaphore(device, image_available_semaphore);
-	VkHelper::CreateVkSemaphore(device, render_finished_semaphore);
+	// Create the per frame semaphores, fences and command buffers for the frames in flight
+	VkHelper::CreateFrameLoop(
+		device,
+		command_pool,
+		swapchain_image_count,                                 // How many images the frames will be rendering into
+		frames_in_flight,                                      // How many frames can be worked on at once
+		frame_loop
+	);
+	// Acquire and present from the offscreen images rather than a swapchain
+	if (headless.enabled) frame_loop.headless_swapchain = &headless_swapchain;
 
 	VkCommandBufferAllocateInfo command_buffer_allocate_info = VkHelper::CommandBufferAllocateInfo(
 		command_pool,
@@ -458,10 +527,6 @@ void Setup()
 	);
 	assert(allocate_command_buffer_resut == VK_SUCCESS);
 
-	render_submission_info = VkHelper::SubmitInfo(1, &image_available_semaphore, 1, &render_finished_semaphore, wait_stages);
-
-	present_info = VkHelper::PresentInfoKHR(1, &render_finished_semaphore, swap_chain);
-
 	// Create the models vertex buffer
 	VkHelper::CreateBuffer(
 		device,																		// What device are we going to use to create the buffer
@@ -592,38 +657,17 @@ void Setup()
 
 
 
-	camera_buffer.buffer_size = sizeof(SCamera);
-	camera_buffer.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
-	camera_buffer.sharing_mode = VK_SHARING_MODE_EXCLUSIVE;
-	camera_buffer.buffer_memory_properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-
-	// Create a temp buffer to store the image in before we transfer it over to the image
-	VkHelper::CreateBuffer(
-		device,								   // What device are we going to use to create the buffer
-		physical_device_mem_properties,		   // What memory properties are available on the device
-		camera_buffer.buffer,                  // What buffer are we going to be creating
-		camera_buffer.buffer_memory,           // The output for the buffer memory
-		camera_buffer.buffer_size,             // How much memory we wish to allocate on the GPU
-		camera_buffer.usage,                   // What type of buffer do we want. Buffers can have multiple types, for example, uniform & vertex buffer.
-											   // for now we want to keep the buffer specialized to one type as this will allow vulkan to optimize the data.
-		camera_buffer.sharing_mode,            // There are two modes, exclusive and concurrent. Defines if it can concurrently be used by multiple queue
-											   // families at the same time
-		camera_buffer.buffer_memory_properties // What properties do we require of our memory
+	// Create the ring buffer the camera will be pushed into every frame
+	VkHelper::CreateRingBuffer(
+		device,                                // What device are we going to use to create the buffer
+		allocator,                             // What allocator are we getting the memory from
+		physical_device_properties,            // Used to find the dynamic offset alignment
+		64 * 1024,                             // How much data can each frame push
+		swapchain_image_count,                 // One region for each image, the command buffers are recorded per image
+		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,    // The ranges will be bound as dynamic uniform buffers
+		uniform_buffer                         // The output ring buffer
 	);
 
-	// Get the pointer to the GPU memory
-	VkResult mapped_memory_result = vkMapMemory(
-		device,                                        // The device that the memory is on
-		camera_buffer.buffer_memory,                   // The device memory instance
-		0,                                             // Offset from the memory starts that we are accessing
-		camera_buffer.buffer_size,                     // How much memory are we accessing
-		0,                                             // Flags (we don't need this for basic buffers)
-		&camera_buffer.mapped_buffer_memory            // The return for the memory pointer
-	);
-
-	// Could we map the GPU memory to our CPU accessible pointer
-	assert(mapped_memory_result == VK_SUCCESS);
-
 
 
 	BuildCamera();
@@ -637,7 +681,7 @@ void Setup()
 	VkDescriptorPoolSize camera_pool_size[camera_descriptor_pool_size_count] = {
 		VkHelper::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_NV, 1),
 		VkHelper::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1),
-		VkHelper::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1)
+		VkHelper::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1)
 	};
 
 
@@ -654,7 +698,7 @@ void Setup()
 	VkDescriptorSetLayoutBinding camera_layout_bindings[camera_descriptor_pool_size_count] = {
 		VkHelper::DescriptorSetLayoutBinding(0, VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_NV, 1, VK_SHADER_STAGE_RAYGEN_BIT_NV),
 		VkHelper::DescriptorSetLayoutBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_RAYGEN_BIT_NV),
-		VkHelper::DescriptorSetLayoutBinding(2, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_RAYGEN_BIT_NV | VK_SHADER_STAGE_CLOSEST_HIT_BIT_NV | VK_SHADER_STAGE_MISS_BIT_NV)
+		VkHelper::DescriptorSetLayoutBinding(2, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1, VK_SHADER_STAGE_RAYGEN_BIT_NV | VK_SHADER_STAGE_CLOSEST_HIT_BIT_NV | VK_SHADER_STAGE_MISS_BIT_NV)
 	};
 
 	// Create the new texture set layout
@@ -675,14 +719,14 @@ void Setup()
 
 
 	VkDescriptorBufferInfo descriptorCameraInfo = VkHelper::DescriptorBufferInfo(
-		camera_buffer.buffer,
-		camera_buffer.buffer_size,
-		0
+		uniform_buffer.buffer,
+		sizeof(SCamera),
+		0                                      // The images region is selected with a dynamic offset when the set is bound
 	);
 
 	VkWriteDescriptorSet descriptorCameraWrite = VkHelper::WriteDescriptorSet(
 		camera_descriptor_set,
-		VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+		VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
 		descriptorCameraInfo,
 		2
 	);
@@ -781,27 +825,21 @@ void Destroy()
 		nullptr
 	);
 
-	for (uint32_t i = 0; i < swapchain_image_count; i++)
-	{
-		vkDestroyFence(
-			device,
-			fences.get()[i],
-			nullptr
-		);
-	}
-
-	vkDestroySemaphore(
+	VkHelper::DestroyFrameLoop(
 		device,
-		image_available_semaphore,
-		nullptr
+		command_pool,
+		frame_loop
 	);
 
-	vkDestroySemaphore(
+	// Clean up the uniform ring buffer
+	VkHelper::DestroyRingBuffer(
 		device,
-		render_finished_semaphore,
-		nullptr
+		allocator,
+		uniform_buffer
 	);
 
+	// Now the ring buffer is gone, give the allocators blocks back
+	VkHelper::DestroyAllocator(allocator);
 
 	// Clean up the command pool
 	vkDestroyCommandPool(
@@ -810,6 +848,12 @@ void Destroy()
 		nullptr
 	);
 
+	// Any samplers the textures and attachments didn't give back are still held by the cache, they go before the device
+	VkHelper::DestroySamplerCache(device);
+
+	// The device is going away, free its dispatch table so a later device given the same handle loads its own
+	VkHelper::UnregisterDeviceDispatch(device);
+
 	// Clean up the device now that the project is stopping
 	vkDestroyDevice(
 		device,
@@ -818,10 +862,13 @@ void Destroy()
 
 	// Destroy the debug callback
 	// We cant directly call vkDestroyDebugReportCallbackEXT as we need to find the pointer within the Vulkan DLL, See function implementation for details.
-	VkHelper::DestroyDebugger(
-		instance, 
-		debugger
-	);
+	if (!headless.enabled)
+	{
+		VkHelper::DestroyDebugger(
+			instance, 
+			debugger
+		);
+	}
 
 	// Clean up the vulkan instance
 	vkDestroyInstance(
@@ -829,24 +876,45 @@ void Destroy()
 		NULL
 	);
 
-	DestroyWindow();
+	if (!headless.enabled) DestroyWindow();
 }
 
 void CreateRenderResources()
 {
-	swap_chain = VkHelper::CreateSwapchain(
-		physical_device,
-		device,
-		surface,
-		surface_capabilities,
-		surface_format,
-		present_mode,
-		window_width,
-		window_height,
-		swapchain_image_count,
-		swapchain_images,
-		swapchain_image_views
-	);
+	if (headless.enabled)
+	{
+		// Three images, the same as a triple buffered swapchain
+		surface_format.format = VK_FORMAT_B8G8R8A8_UNORM;
+		swap_chain = VK_NULL_HANDLE;
+		VkHelper::CreateHeadlessSwapchain(
+			device,
+			physical_device_mem_properties,
+			surface_format.format,
+			window_width,
+			window_height,
+			3,
+			headless_swapchain,
+			swapchain_image_count,
+			swapchain_images,
+			swapchain_image_views
+		);
+	}
+	else
+	{
+		swap_chain = VkHelper::CreateSwapchain(
+			physical_device,
+			device,
+			surface,
+			surface_capabilities,
+			surface_format,
+			present_mode,
+			window_width,
+			window_height,
+			swapchain_image_count,
+			swapchain_images,
+			swapchain_image_views
+		);
+	}
 }
 
 STexture CreateTexture(const char* path)
@@ -1193,10 +1261,9 @@ void DestroyTexture(STexture& texture)
 	);
 
 	// Destroy the image sampler now that we are done with that
-	vkDestroySampler(
+	VkHelper::ReleaseSampler(
 		device,
-		texture.sampler,
-		nullptr
+		texture.sampler
 	);
 
 	// Destroy the image we are displaying
@@ -1231,7 +1298,9 @@ void CreateModel(const char* path, ModelInstance& model_instance)
 {
 	
 	ObjLoader<SVertexData> loader;
-	loader.loadModel(path);
+	// Merge the vertices that are shared between triangles so the index buffer can reuse them
+	loader.loadModel(path, true);
+	std::cout << path << ": " << loader.m_sourceVertexCount << " vertices before deduplication, " << loader.m_vertices.size() << " after" << std::endl;
 
 	model_instance.vertex_offset = used_verticies;
 	model_instance.index_offset = used_index;
@@ -1274,11 +1343,21 @@ void CreateModel(const char* path, ModelInstance& model_instance)
 
 void DestroyRenderResources()
 {
-	vkDestroySwapchainKHR(
-		device,
-		swap_chain,
-		nullptr
-	);
+	if (headless.enabled)
+	{
+		VkHelper::DestroyHeadlessSwapchain(
+			device,
+			headless_swapchain
+		);
+	}
+	else
+	{
+		vkDestroySwapchainKHR(
+			device,
+			swap_chain,
+			nullptr
+		);
+	}
 
 	for (uint32_t i = 0; i < swapchain_image_count; i++)
 	{
@@ -1292,12 +1371,56 @@ void DestroyRenderResources()
 
 void RebuildRenderResources()
 {
+	// Only the window can go out of date, the headless images stay the same size
+	assert(!headless.enabled);
+
 	// Wait for the device to finish
 	VkResult device_idle_result = vkDeviceWaitIdle(device);
 	assert(device_idle_result == VK_SUCCESS);
 	// Destroy and rebuild the render resources
 	DestroyRenderResources();
 	CreateRenderResources();
+	// The old swapchain images are gone, so forget which frames were using them
+	VkHelper::ResetFrameLoopImages(frame_loop, swapchain_image_count);
+
+	// The camera ring buffer has a region per image, so a larger swapchain needs a larger ring buffer
+	if (swapchain_image_count > uniform_buffer.region_count)
+	{
+		VkDeviceSize region_size = uniform_buffer.region_size;
+		VkHelper::DestroyRingBuffer(
+			device,
+			allocator,
+			uniform_buffer
+		);
+
+		VkHelper::CreateRingBuffer(
+			device,
+			allocator,
+			physical_device_properties,
+			region_size,                                       // Each frame pushes the same amount as before
+			swapchain_image_count,                             // One region for each image of the new swapchain
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			uniform_buffer
+		);
+
+		// The device is idle, so the camera set can point straight at the new buffer
+		VkDescriptorBufferInfo camera_buffer_info = VkHelper::DescriptorBufferInfo(
+			uniform_buffer.buffer,
+			sizeof(SCamera),
+			0
+		);
+
+		VkWriteDescriptorSet camera_write = VkHelper::WriteDescriptorSet(camera_descriptor_set, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, camera_buffer_info, 2);
+
+		vkUpdateDescriptorSets(
+			device,
+			1,
+			&camera_write,
+			0,
+			NULL
+		);
+	}
+
 	BuildCommandBuffers(graphics_command_buffers, swapchain_image_count);
 }
 
@@ -1376,6 +1499,7 @@ void BuildCommandBuffers(std::unique_ptr<VkCommandBuffer>& command_buffers, cons
 
 
 		// We will add the raytracing pipline and descriptors down the line
+		// When the camera set is bound it takes RingBufferRegionOffset(uniform_buffer, i) as its dynamic offset
 
 
 
@@ -1390,67 +1514,40 @@ void BuildCommandBuffers(std::unique_ptr<VkCommandBuffer>& command_buffers, cons
 
 void Render()
 {
-	// Find next image
-	VkResult wait_for_fences = vkWaitForFences(
-		device,
-		1,
-		&fences.get()[current_frame_index],
-		VK_TRUE,
-		UINT32_MAX
-	);
-	assert(wait_for_fences == VK_SUCCESS);
-
-	VkResult acquire_next_image_result = vkAcquireNextImageKHR(
+	// Wait for the oldest frame in flight to finish and find the next image
+	VkResult begin_frame_result = VkHelper::BeginFrame(
 		device,
 		swap_chain,
-		UINT64_MAX,
-		image_available_semaphore,
-		VK_NULL_HANDLE,
-		&current_frame_index
+		frame_loop
 	);
-	assert(acquire_next_image_result == VK_SUCCESS);
+	// The swapchain no longer matches the window, rebuild it and pick the frame up next time round
+	if (begin_frame_result == VK_ERROR_OUT_OF_DATE_KHR)
+	{
+		RebuildRenderResources();
+		return;
+	}
 
-	// Reset and wait
-	VkResult queue_idle_result = vkQueueWaitIdle(
-		graphics_queue
-	);
-	assert(queue_idle_result == VK_SUCCESS);
+	// Now we know what image we are rendering, write its camera
+	UpdateUniforms(frame_loop.image_index);
 
-	VkResult reset_fences_result = vkResetFences(
+	// Submit the commands recorded for this image and present it. We don't wait for the GPU here, the CPU carries
+	// straight on with the next frame while this one is being rendered
+	VkResult end_frame_result = VkHelper::EndFrame(
 		device,
-		1,
-		&fences.get()[current_frame_index]
-	);
-	assert(reset_fences_result == VK_SUCCESS);
-
-	render_submission_info.pCommandBuffers = &graphics_command_buffers.get()[current_frame_index];
-
-	VkResult queue_submit_result = vkQueueSubmit(
 		graphics_queue,
-		1,
-		&render_submission_info,
-		fences.get()[current_frame_index]
-	);
-	assert(queue_submit_result == VK_SUCCESS);
-
-	present_info.pImageIndices = &current_frame_index;
-
-	VkResult queue_present_result = vkQueuePresentKHR(
 		present_queue,
-		&present_info
+		swap_chain,
+		frame_loop,
+		&graphics_command_buffers.get()[frame_loop.image_index],  // The command buffer that renders to this image
+		1,
+		VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT              // Only the colour output needs to wait for the image
 	);
 	// If the window was resized or something else made the current render invalid, we need to rebuild all the
 	// render resources
-	if (queue_present_result == VK_ERROR_OUT_OF_DATE_KHR)
+	if (end_frame_result == VK_ERROR_OUT_OF_DATE_KHR)
 	{
 		RebuildRenderResources();
 	}
-
-	assert(queue_present_result == VK_SUCCESS || queue_present_result == VK_ERROR_OUT_OF_DATE_KHR);
-
-
-	VkResult device_idle_result = vkDeviceWaitIdle(device);
-	assert(device_idle_result == VK_SUCCESS);
 }
 
 VKAPI_ATTR void VKAPI_CALL
@@ -1465,9 +1562,8 @@ vkCmdBuildAccelerationStructureNV(
 	VkBuffer                             scratch,
 	VkDeviceSize                         scratchOffset )
 {
-	static const auto call = reinterpret_cast<PFN_vkCmdBuildAccelerationStructureNV>(
-		vkGetDeviceProcAddr( device, "vkCmdBuildAccelerationStructureNV" ));
-	return call( commandBuffer, pInfo, instanceData, instanceOffset, update, dst, src, scratch,
+	// Looked up in the devices own dispatch table rather than cached in a static, which would only ever hold the first devices function
+	return VkHelper::GetDeviceDispatch( device ).vkCmdBuildAccelerationStructureNV( commandBuffer, pInfo, instanceData, instanceOffset, update, dst, src, scratch,
 		scratchOffset );
 }
 
@@ -1833,6 +1929,7 @@ unsigned int UpdateGeometryInstances(ASInstance* model_instances, unsigned int m
 int main(int argc, char **argv)
 {
 
+	headless = VkHelper::ParseHeadlessOptions(argc, argv);
 	Setup();
 
 
@@ -1989,11 +2086,28 @@ int main(int argc, char **argv)
 	// Regenerate the command buffers
 	BuildCommandBuffers(graphics_command_buffers, swapchain_image_count);
 
+	std::chrono::high_resolution_clock::time_point render_start = std::chrono::high_resolution_clock::now();
+
 	while (window_open)
 	{
-		PollWindow();
+		if (!headless.enabled) PollWindow();
 
 		Render();
+
+		// A headless run stops after a fixed number of frames so runs can be compared
+		if (headless.enabled && headless.frame_count > 0 && frame_loop.frame_number >= headless.frame_count) window_open = false;
+	}
+
+	// Let the frames that are still in flight finish before we start cleaning up
+	VkResult device_idle_result = vkDeviceWaitIdle(device);
+	assert(device_idle_result == VK_SUCCESS);
+
+	if (headless.enabled)
+	{
+		std::chrono::high_resolution_clock::time_point render_end = std::chrono::high_resolution_clock::now();
+		float render_ms = std::chrono::duration_cast<std::chrono::microseconds>(render_end - render_start).count() / 1000.0f;
+		std::cout << "Rendered " << frame_loop.frame_number << " headless frames in " << render_ms << "ms, "
+			<< render_ms / frame_loop.frame_number << "ms per frame" << std::endl;
 	}
 
 	////////////////////
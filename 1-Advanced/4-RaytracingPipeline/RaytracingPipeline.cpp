@@ -1,13 +1,17 @@
 
 #define VKCORE_RTX
 
+// The window surface is only hooked up for Windows, anywhere else the sample can still be run with --headless
+#ifdef _WIN32
 #define VK_USE_PLATFORM_WIN32_KHR
+#endif
 #include <assert.h>
 #include <stdio.h>
 #include <string.h>
 #include <memory>
 #include <stdexcept>
 #include <iostream>
+#include <chrono>
 
 
 #define GLM_ENABLE_EXPERIMENTAL
@@ -27,6 +31,15 @@
 
 #include <VkInitializers.hpp>
 #include <VkCore.hpp>
+#include <VkDispatch.hpp>
+#include <VkPipelineCache.hpp>
+#include <VkFrameLoop.hpp>
+#include <VkHeadless.hpp>
+#include <VkRingBuffer.hpp>
+#include <VkUploadManager.hpp>
+#include <VkTextureLoader.hpp>
+#include <VkKtx.hpp>
+#include <VkGpuProfiler.hpp>
 
 struct SBuffer
 {
@@ -38,6 +51,8 @@ struct SBuffer
 	VkMemoryPropertyFlags buffer_memory_properties;
 	// Raw pointer that will point to GPU memory
 	void* mapped_buffer_memory = nullptr;
+	// Region of the allocators memory the buffer is bound to
+	VkHelper::Allocation allocation;
 };
 
 struct STexture
@@ -45,10 +60,12 @@ struct STexture
 	SBuffer transfer_buffer;
 	unsigned int width;
 	unsigned int height;
+	uint32_t mip_levels = 1;
 	VkFormat format;
 
 	VkImage image;
-	VkDeviceMemory memory;
+	// Region of the allocators memory the image is bound to
+	VkHelper::Allocation allocation;
 	VkImageView view;
 	VkImageLayout layout;
 	VkSampler sampler;
@@ -57,7 +74,8 @@ struct STexture
 struct SMaterial
 {
 	STexture diffuse;
-	STexture metal;
+	// AO, roughness, metallic and height packed into R, G, B and A, see PackedChannel in obj_loader.h
+	STexture surface;
 };
 
 struct SCamera
@@ -128,9 +146,20 @@ VkPhysicalDeviceProperties physical_device_properties;
 VkPhysicalDeviceFeatures physical_device_features;
 VkPhysicalDeviceMemoryProperties physical_device_mem_properties;
 
+// Sub allocates buffer and image memory out of large blocks
+VkHelper::Allocator allocator;
+
+// Batches up texture and buffer uploads into as few submits as possible
+VkHelper::UploadManager upload_manager;
+
 VkDevice device = VK_NULL_HANDLE;
+// The devices own functions, the commands recorded every frame are called through this rather than the loader
+const VkHelper::DeviceDispatch* device_dispatch = nullptr;
 VkQueue graphics_queue = VK_NULL_HANDLE;
 VkQueue present_queue = VK_NULL_HANDLE;
+// Queue used for uploads, this will be the graphics queue if the GPU has no dedicated transfer queue
+VkQueue transfer_queue = VK_NULL_HANDLE;
+uint32_t transfer_queue_family = 0;
 VkCommandPool command_pool;
 
 
@@ -194,17 +223,22 @@ void* top_level_as_instance_mapped_buffer_memory = nullptr;
 STexture raytracing_staging_texture;
 
 
-uint32_t current_frame_index = 0; // What frame are we currently using
-std::unique_ptr<VkFence> fences = nullptr;
+// How many frames the CPU is allowed to get ahead of the GPU
+const uint32_t frames_in_flight = 2;
+VkHelper::FrameLoop frame_loop;
 
-VkSemaphore image_available_semaphore;
-VkSemaphore render_finished_semaphore;
-VkSubmitInfo render_submission_info = {};
-VkPresentInfoKHR present_info = {};
-VkPipelineStageFlags wait_stages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+// Start with --headless [frame count] to render a fixed number of frames into offscreen images, with no window
+VkHelper::HeadlessOptions headless;
+VkHelper::HeadlessSwapchain headless_swapchain;
 
 std::unique_ptr<VkCommandBuffer> graphics_command_buffers = nullptr;
 
+// Start with --gpu-profile to time the ray trace on the GPU. The timings are printed every few hundred frames and
+// written out as a Chrome trace when the sample closes
+bool gpu_profile = false;
+VkHelper::GpuProfiler gpu_profiler;
+uint32_t trace_gpu_scope = 0;
+
 
 VkBuffer particle_vertex_buffer = VK_NULL_HANDLE;
 VkDeviceMemory particle_vertex_buffer_memory = VK_NULL_HANDLE;
@@ -218,7 +252,8 @@ VkDeviceMemory index_buffer_memory = VK_NULL_HANDLE;
 void* index_mapped_buffer_memory = nullptr;
 
 SCamera camera;
-SBuffer camera_buffer;
+// Per frame uniform data, each swapchain image has its own region so we never write to memory the GPU is reading
+VkHelper::RingBuffer uniform_buffer;
 VkDescriptorPool camera_descriptor_pool;
 VkDescriptorSetLayout camera_descriptor_set_layout;
 VkDescriptorSet camera_descriptor_set;
@@ -268,10 +303,34 @@ void BuildCamera()
 	// Flip the cameras prospective upside down as glm assumes that the renderer we are using renders top to bottom, vulkan is the opposite
 	camera.projection[1][1] *= -1.0f;
 	camera.projection = glm::inverse(camera.projection);
+}
 
-	// Transfer data over to the texture buffer
+// Push this frames uniform data into its region of the ring buffer
+void UpdateUniforms(uint32_t frame_index)
+{
+	// Wait till the last submit that used this region is done before we write into it
+	VkHelper::BeginRingBufferFrame(
+		device,
+		uniform_buffer,
+		frame_index,
+		VkHelper::CurrentFrameFence(frame_loop)
+	);
+
+	uint32_t camera_offset = 0;
+	void* camera_memory = nullptr;
+	bool allocated = VkHelper::RingBufferAllocate(
+		uniform_buffer,                             // What ring buffer are we allocating from
+		sizeof(SCamera),                            // How much memory do we need
+		camera_offset,                              // The dynamic offset of the data
+		camera_memory                               // Where we can write the data
+	);
+	// The camera is always the first thing we push each frame, so it sits at the start of the frames region.
+	// This is the dynamic offset the command buffers were recorded with
+	assert(allocated && camera_offset == VkHelper::RingBufferRegionOffset(uniform_buffer, frame_index));
+
+	// Transfer data over to the uniform buffer
 	memcpy(
-		camera_buffer.mapped_buffer_memory,         // The destination for our memory (GPU)
+		camera_memory,                              // The destination for our memory (GPU)
 		&camera,                                    // Source for the memory (CPU-Ram)
 		sizeof(SCamera)                             // How much data we are transferring
 	);
@@ -317,6 +376,7 @@ void DestroyWindow()
 // Create windows surface for sdl to interface with
 void CreateSurface()
 {
+#ifdef VK_USE_PLATFORM_WIN32_KHR
 	auto CreateWin32SurfaceKHR = (PFN_vkCreateWin32SurfaceKHR)vkGetInstanceProcAddr(instance, "vkCreateWin32SurfaceKHR");
 
 	VkWin32SurfaceCreateInfoKHR createInfo = {};
@@ -328,6 +388,9 @@ void CreateSurface()
 	{
 		throw std::runtime_error("failed to create window surface!");
 	}
+#else
+	throw std::runtime_error("window surfaces are only supported on windows, run with --headless instead");
+#endif
 }
 
 // Everything within the Setup is from previous tutorials
@@ -343,17 +406,35 @@ void CreateSurface()
 void Setup()
 {
 
-	WindowSetup("Vulkan", 1080, 720);
+	if (headless.enabled)
+	{
+		// No window, the offscreen images are the size the window would have been
+		window_width = 1080;
+		window_height = 720;
+		window_open = true;
+	}
+	else
+	{
+		WindowSetup("Vulkan", 1080, 720);
+	}
 
 
 	// Define what Layers and Extensions we require
-	const uint32_t extention_count = 4;
-	const char *instance_extensions[extention_count] = { VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME, "VK_EXT_debug_report" ,VK_KHR_SURFACE_EXTENSION_NAME,VK_KHR_WIN32_SURFACE_EXTENSION_NAME };
-	const uint32_t layer_count = 1;
-	const char *instance_layers[layer_count] = { "VK_LAYER_LUNARG_standard_validation" };
+#ifdef VK_USE_PLATFORM_WIN32_KHR
+	const uint32_t window_extention_count = 4;
+	const char *instance_extensions[window_extention_count] = { VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME, "VK_EXT_debug_report" ,VK_KHR_SURFACE_EXTENSION_NAME,VK_KHR_WIN32_SURFACE_EXTENSION_NAME };
+#else
+	const uint32_t window_extention_count = 2;
+	const char *instance_extensions[window_extention_count] = { VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME, "VK_EXT_debug_report" };
+#endif
+	const char *instance_layers[1] = { "VK_LAYER_LUNARG_standard_validation" };
+	// A headless run only needs the extensions at the front of the list, not the surface or the debug report. It is left
+	// without the validation layers as they would be most of what it times
+	const uint32_t extention_count = headless.enabled ? 1 : window_extention_count;
+	const uint32_t layer_count = headless.enabled ? 0 : 1;
 
 	// Check to see if we have the layer requirments
-	assert(VkHelper::CheckLayersSupport(instance_layers, 1) && "Unsupported Layers Found");
+	assert(VkHelper::CheckLayersSupport(instance_layers, layer_count) && "Unsupported Layers Found");
 
 	// Create the Vulkan Instance
 	instance = VkHelper::CreateInstance(
@@ -365,9 +446,10 @@ void Setup()
 
 	// Attach a debugger to the application to give us validation feedback.
 	// This is useful as it tells us about any issues without application
-	debugger = VkHelper::CreateDebugger(instance);
+	if (!headless.enabled) debugger = VkHelper::CreateDebugger(instance);
 
 	// Define what Device Extensions we require
+	// The swapchain extension is still needed headless, the frames leave their images in the present layout
 	const uint32_t physical_device_extention_count = 3;
 	// Note that this extension list is different from the instance on as we are telling the system what device settings we need.
 	const char *physical_device_extensions[physical_device_extention_count] = { 
@@ -380,7 +462,7 @@ void Setup()
 
 	// The surface creation is added here as it needs to happen before the physical device creation and after we have said to the instance that we need a surface
 	// The surface is the reference back to the OS window
-	CreateSurface();
+	if (!headless.enabled) CreateSurface();
 
 
 
@@ -404,25 +486,42 @@ void Setup()
 	// Get Physical Device properties and features needed for raytracing
 	VkHelper::GetPhysicalDevicePropertiesAndFeatures2(physical_device, device_raytracing_properties, physical_device_properties2, device_features2);
 
-	// Define how many queues we will need in our project, for now, we will just create a single queue
-	static const float queue_priority = 1.0f;
-	VkDeviceQueueCreateInfo queue_create_info = VkHelper::DeviceQueueCreateInfo(
-		&queue_priority,
-		1,
-		physical_devices_queue_family
+	// Look for a dedicated transfer queue family, uploads will run there so they don't hold up rendering
+	bool has_transfer_queue = VkHelper::FindTransferQueueFamily(
+		physical_device,
+		transfer_queue_family
 	);
+	if (!has_transfer_queue) transfer_queue_family = physical_devices_queue_family;
+
+	// Define how many queues we will need in our project, a graphics queue and a transfer queue if there is one
+	static const float queue_priority = 1.0f;
+	const uint32_t queue_create_info_count = has_transfer_queue ? 2 : 1;
+	VkDeviceQueueCreateInfo queue_create_info[2] = {
+		VkHelper::DeviceQueueCreateInfo(
+			&queue_priority,
+			1,
+			physical_devices_queue_family
+		),
+		VkHelper::DeviceQueueCreateInfo(
+			&queue_priority,
+			1,
+			transfer_queue_family
+		)
+	};
 
 
 	// Now we have the physical device, create the device instance
 	device = VkHelper::CreateDevice(                           
 		physical_device,                                       // The physical device we are basic the device from
-		&queue_create_info,                                    // A pointer array, pointing to a list of queues we want to make
-		1,                                                     // How many queues are in the list
+		queue_create_info,                                     // A pointer array, pointing to a list of queues we want to make
+		queue_create_info_count,                               // How many queues are in the list
 		physical_device_features,                              // What features do you want enabled on the device
 		physical_device_extensions,                            // What extensions do you want on the device
 		physical_device_extention_count                        // How many extensions are there
 	);
 
+	device_dispatch = &VkHelper::GetDeviceDispatch(device);
+
 	vkGetDeviceQueue(
 		device,
 		physical_devices_queue_family,
@@ -430,6 +529,33 @@ void Setup()
 		&graphics_queue
 	);
 
+	// Create the allocator that our buffers and images will get their memory from
+	VkHelper::CreateAllocator(
+		device,
+		physical_device_properties,
+		physical_device_mem_properties,
+		allocator
+	);
+
+	vkGetDeviceQueue(
+		device,
+		transfer_queue_family,
+		0,
+		&transfer_queue
+	);
+
+	// Create the upload manager with a 64MB staging ring
+	VkHelper::CreateUploadManager(
+		device,
+		allocator,
+		transfer_queue,
+		transfer_queue_family,
+		graphics_queue,
+		physical_devices_queue_family,
+		64 * 1024 * 1024,
+		upload_manager
+	);
+
 	vkGetDeviceQueue(
 		device,
 		physical_devices_queue_family,
@@ -437,6 +563,13 @@ void Setup()
 		&present_queue
 	);
 
+	// Load the pipeline cache from the last run, all pipelines created through Vk-Helper will use it
+	VkHelper::LoadPipelineCache(
+		device,
+		physical_device_properties,                            // Used to check the cache was made by this GPU and driver
+		"RaytracingPipeline.pipelinecache"                     // Where the cache is stored between runs
+	);
+
 	command_pool = VkHelper::CreateCommandPool(
 		device,
 		physical_devices_queue_family,                         // What queue family we are wanting to use to send commands to the GPU
@@ -448,12 +581,32 @@ void Setup()
 
 
 
-	// Create the fences required for the swap chain rendering 
-	VkHelper::CreateFence(device, fences, swapchain_image_count);
+	// Create the per frame semaphores, fences and command buffers for the frames in flight
+	VkHelper::CreateFrameLoop(
+		device,
+		command_pool,
+		swapchain_image_count,                                 // How many images the frames will be rendering into
+		frames_in_flight,                                      // How many frames can be worked on at once
+		frame_loop
+	);
+	// Acquire and present from the offscreen images rather than a swapchain
+	if (headless.enabled) frame_loop.headless_swapchain = &headless_swapchain;
 
-	// Create the image available and finished semaphore
-	VkHelper::CreateVkSemaphore(device, image_available_semaphore);
-	VkHelper::CreateVkSemaphore(device, render_finished_semaphore);
+	// Each prerecorded command buffer gets its own slot of timestamp queries
+	if (gpu_profile)
+	{
+		bool gpu_profiler_created = VkHelper::CreateGpuProfiler(
+			physical_device,
+			device,
+			physical_devices_queue_family,
+			swapchain_image_count,                             // A slot for each command buffer
+			1,                                                 // The ray trace
+			100000,                                            // How many scopes to keep for the trace
+			gpu_profiler
+		);
+		if (!gpu_profiler_created) std::cout << "The graphics queue can't write timestamps, GPU profiling is off" << std::endl;
+	}
+	trace_gpu_scope = VkHelper::RegisterGpuScope(gpu_profiler, "Trace rays");
 
 	VkCommandBufferAllocateInfo command_buffer_allocate_info = VkHelper::CommandBufferAllocateInfo(
 		command_pool,
@@ -469,10 +622,6 @@ void Setup()
 	);
 	assert(allocate_command_buffer_resut == VK_SUCCESS);
 
-	render_submission_info = VkHelper::SubmitInfo(1, &image_available_semaphore, 1, &render_finished_semaphore, wait_stages);
-
-	present_info = VkHelper::PresentInfoKHR(1, &render_finished_semaphore, swap_chain);
-
 	// Create the models vertex buffer
 	VkHelper::CreateBuffer(
 		device,																		// What device are we going to use to create the buffer
@@ -603,38 +752,17 @@ void Setup()
 
 
 
-	camera_buffer.buffer_size = sizeof(SCamera);
-	camera_buffer.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
-	camera_buffer.sharing_mode = VK_SHARING_MODE_EXCLUSIVE;
-	camera_buffer.buffer_memory_properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-
-	// Create a temp buffer to store the image in before we transfer it over to the image
-	VkHelper::CreateBuffer(
-		device,								   // What device are we going to use to create the buffer
-		physical_device_mem_properties,		   // What memory properties are available on the device
-		camera_buffer.buffer,                  // What buffer are we going to be creating
-		camera_buffer.buffer_memory,           // The output for the buffer memory
-		camera_buffer.buffer_size,             // How much memory we wish to allocate on the GPU
-		camera_buffer.usage,                   // What type of buffer do we want. Buffers can have multiple types, for example, uniform & vertex buffer.
-											   // for now we want to keep the buffer specialized to one type as this will allow vulkan to optimize the data.
-		camera_buffer.sharing_mode,            // There are two modes, exclusive and concurrent. Defines if it can concurrently be used by multiple queue
-											   // families at the same time
-		camera_buffer.buffer_memory_properties // What properties do we require of our memory
+	// Create the ring buffer the camera will be pushed into every frame
+	VkHelper::CreateRingBuffer(
+		device,                                // What device are we going to use to create the buffer
+		allocator,                             // What allocator are we getting the memory from
+		physical_device_properties,            // Used to find the dynamic offset alignment
+		64 * 1024,                             // How much data can each frame push
+		swapchain_image_count,                 // One region for each image, the command buffers are recorded per image
+		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,    // The ranges will be bound as dynamic uniform buffers
+		uniform_buffer                         // The output ring buffer
 	);
 
-	// Get the pointer to the GPU memory
-	VkResult mapped_memory_result = vkMapMemory(
-		device,                                        // The device that the memory is on
-		camera_buffer.buffer_memory,                   // The device memory instance
-		0,                                             // Offset from the memory starts that we are accessing
-		camera_buffer.buffer_size,                     // How much memory are we accessing
-		0,                                             // Flags (we don't need this for basic buffers)
-		&camera_buffer.mapped_buffer_memory            // The return for the memory pointer
-	);
-
-	// Could we map the GPU memory to our CPU accessible pointer
-	assert(mapped_memory_result == VK_SUCCESS);
-
 
 
 	BuildCamera();
@@ -648,7 +776,7 @@ void Setup()
 	VkDescriptorPoolSize camera_pool_size[camera_descriptor_pool_size_count] = {
 		VkHelper::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_NV, 1),
 		VkHelper::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1),
-		VkHelper::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1)
+		VkHelper::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1)
 	};
 
 
@@ -665,7 +793,7 @@ void Setup()
 	VkDescriptorSetLayoutBinding camera_layout_bindings[camera_descriptor_pool_size_count] = {
 		VkHelper::DescriptorSetLayoutBinding(0, VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_NV, 1, VK_SHADER_STAGE_RAYGEN_BIT_NV | VK_SHADER_STAGE_CLOSEST_HIT_BIT_NV),
 		VkHelper::DescriptorSetLayoutBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_RAYGEN_BIT_NV),
-		VkHelper::DescriptorSetLayoutBinding(2, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_RAYGEN_BIT_NV | VK_SHADER_STAGE_CLOSEST_HIT_BIT_NV | VK_SHADER_STAGE_MISS_BIT_NV)
+		VkHelper::DescriptorSetLayoutBinding(2, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1, VK_SHADER_STAGE_RAYGEN_BIT_NV | VK_SHADER_STAGE_CLOSEST_HIT_BIT_NV | VK_SHADER_STAGE_MISS_BIT_NV)
 	};
 
 	// Create the new texture set layout
@@ -686,14 +814,14 @@ void Setup()
 
 
 	VkDescriptorBufferInfo descriptorCameraInfo = VkHelper::DescriptorBufferInfo(
-		camera_buffer.buffer,
-		camera_buffer.buffer_size,
-		0
+		uniform_buffer.buffer,
+		sizeof(SCamera),
+		0                                      // The frames region is selected with a dynamic offset when binding
 	);
 
 	VkWriteDescriptorSet descriptorCameraWrite = VkHelper::WriteDescriptorSet(
 		camera_descriptor_set,
-		VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+		VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
 		descriptorCameraInfo,
 		2
 	);
@@ -792,28 +920,20 @@ void Destroy()
 		nullptr
 	);
 
-	for (uint32_t i = 0; i < swapchain_image_count; i++)
-	{
-		vkDestroyFence(
-			device,
-			fences.get()[i],
-			nullptr
-		);
-	}
-
-	vkDestroySemaphore(
+	VkHelper::DestroyFrameLoop(
 		device,
-		image_available_semaphore,
-		nullptr
+		command_pool,
+		frame_loop
 	);
 
-	vkDestroySemaphore(
+
+	// Clean up the uniform ring buffer
+	VkHelper::DestroyRingBuffer(
 		device,
-		render_finished_semaphore,
-		nullptr
+		allocator,
+		uniform_buffer
 	);
 
-
 	// Clean up the command pool
 	vkDestroyCommandPool(
 		device,
@@ -821,6 +941,24 @@ void Destroy()
 		nullptr
 	);
 
+	// Wait for any outstanding uploads and release the staging ring
+	VkHelper::DestroyUploadManager(
+		allocator,
+		upload_manager
+	);
+
+	// Now all buffers and images are gone, give the allocators blocks back
+	VkHelper::DestroyAllocator(allocator);
+
+	// Write the pipeline cache out so the next run can skip compiling the shaders
+	VkHelper::DestroyPipelineCache(device);
+
+	// Any samplers the textures and attachments didn't give back are still held by the cache, they go before the device
+	VkHelper::DestroySamplerCache(device);
+
+	// The device is going away, free its dispatch table so a later device given the same handle loads its own
+	VkHelper::UnregisterDeviceDispatch(device);
+
 	// Clean up the device now that the project is stopping
 	vkDestroyDevice(
 		device,
@@ -829,10 +967,13 @@ void Destroy()
 
 	// Destroy the debug callback
 	// We cant directly call vkDestroyDebugReportCallbackEXT as we need to find the pointer within the Vulkan DLL, See function implementation for details.
-	VkHelper::DestroyDebugger(
-		instance, 
-		debugger
-	);
+	if (!headless.enabled)
+	{
+		VkHelper::DestroyDebugger(
+			instance, 
+			debugger
+		);
+	}
 
 	// Clean up the vulkan instance
 	vkDestroyInstance(
@@ -840,97 +981,114 @@ void Destroy()
 		NULL
 	);
 
-	DestroyWindow();
+	if (!headless.enabled) DestroyWindow();
 }
 
 void CreateRenderResources()
 {
-	swap_chain = VkHelper::CreateSwapchain(
-		physical_device,
-		device,
-		surface,
-		surface_capabilities,
-		surface_format,
-		present_mode,
-		window_width,
-		window_height,
-		swapchain_image_count,
-		swapchain_images,
-		swapchain_image_views
-	);
+	if (headless.enabled)
+	{
+		// Three images, the same as a triple buffered swapchain
+		surface_format.format = VK_FORMAT_B8G8R8A8_UNORM;
+		swap_chain = VK_NULL_HANDLE;
+		VkHelper::CreateHeadlessSwapchain(
+			device,
+			physical_device_mem_properties,
+			surface_format.format,
+			window_width,
+			window_height,
+			3,
+			headless_swapchain,
+			swapchain_image_count,
+			swapchain_images,
+			swapchain_image_views
+		);
+	}
+	else
+	{
+		swap_chain = VkHelper::CreateSwapchain(
+			physical_device,
+			device,
+			surface,
+			surface_capabilities,
+			surface_format,
+			present_mode,
+			window_width,
+			window_height,
+			swapchain_image_count,
+			swapchain_images,
+			swapchain_image_views
+		);
+	}
 }
 
-STexture CreateTexture(const char* path)
+// Create a texture from a KTX2 file, its mip levels are copied to the GPU as they are
+STexture CreateTexture(const VkHelper::KtxTexture& ktx_texture)
 {
 	STexture texture;
-	// Used to store the raw image data
-	std::vector<unsigned char> image_data;
+	texture.width = ktx_texture.width;
+	texture.height = ktx_texture.height;
+	texture.mip_levels = static_cast<uint32_t>(ktx_texture.levels.size());
+	texture.format = ktx_texture.format;
+	texture.layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
-	// Load using "loadpng" the image from file
-	unsigned error = lodepng::decode(
-		image_data,
+	VkHelper::CreateImage(
+		device,
+		allocator,
 		texture.width,
 		texture.height,
-		path
+		texture.format,
+		VK_IMAGE_TILING_OPTIMAL,
+		VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		texture.image,
+		texture.allocation,
+		VK_IMAGE_LAYOUT_UNDEFINED,
+		texture.mip_levels
 	);
-	// Validate that the image could be found and accessed
-	if (error)
+
+	// Point the upload at each level inside the loaded file, the blocks go straight into the staging ring
+	std::vector<VkHelper::ImageLevel> levels(texture.mip_levels);
+	for (uint32_t level = 0; level < texture.mip_levels; level++)
 	{
-		std::cout << lodepng_error_text(error) << std::endl;
-		exit(-1);
+		levels[level].data = ktx_texture.data.data() + ktx_texture.levels[level].offset;
+		levels[level].size = ktx_texture.levels[level].size;
+		levels[level].width = ktx_texture.levels[level].width;
+		levels[level].height = ktx_texture.levels[level].height;
 	}
 
-	// How big is the texture in bytes? RGBA = 4 bytes * Width * Height
-	const unsigned int texture_size = texture.width * texture.height * 4;
-
-
-	texture.transfer_buffer.buffer_size = texture_size;
-	texture.transfer_buffer.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
-	texture.transfer_buffer.sharing_mode = VK_SHARING_MODE_EXCLUSIVE;
-	texture.transfer_buffer.buffer_memory_properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-
-	// Create a temp buffer to store the image in before we transfer it over to the image
-	VkHelper::CreateBuffer(
-		device,											 // What device are we going to use to create the buffer
-		physical_device_mem_properties,					 // What memory properties are available on the device
-		texture.transfer_buffer.buffer,                  // What buffer are we going to be creating
-		texture.transfer_buffer.buffer_memory,           // The output for the buffer memory
-		texture.transfer_buffer.buffer_size,             // How much memory we wish to allocate on the GPU
-		texture.transfer_buffer.usage,                   // What type of buffer do we want. Buffers can have multiple types, for example, uniform & vertex buffer.
-														 // for now we want to keep the buffer specialized to one type as this will allow vulkan to optimize the data.
-		texture.transfer_buffer.sharing_mode,            // There are two modes, exclusive and concurrent. Defines if it can concurrently be used by multiple queue
-														 // families at the same time
-		texture.transfer_buffer.buffer_memory_properties // What properties do we require of our memory
-	);
-
-	// Get the pointer to the GPU memory
-	VkResult mapped_memory_result = vkMapMemory(
-		device,                                                  // The device that the memory is on
-		texture.transfer_buffer.buffer_memory,                   // The device memory instance
-		0,                                                       // Offset from the memory starts that we are accessing
-		texture.transfer_buffer.buffer_size,                     // How much memory are we accessing
-		0,                                                       // Flags (we don't need this for basic buffers)
-		&texture.transfer_buffer.mapped_buffer_memory            // The return for the memory pointer
+	VkHelper::UploadImageLevels(
+		upload_manager,
+		levels.data(),
+		texture.mip_levels,
+		texture.image,
+		texture.layout,
+		VK_ACCESS_SHADER_READ_BIT,
+		VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_NV
 	);
 
-	// Could we map the GPU memory to our CPU accessible pointer
-	assert(mapped_memory_result == VK_SUCCESS);
-
-
-	// Transfer data over to the texture buffer
-	memcpy(
-		texture.transfer_buffer.mapped_buffer_memory,         // The destination for our memory (GPU)
-		image_data.data(),                                    // Source for the memory (CPU-Ram)
-		texture_size                                          // How much data we are transferring
+	VkHelper::CreateImageSampler(
+		device,
+		texture.image,
+		texture.format,
+		texture.view,
+		texture.sampler,
+		texture.mip_levels
 	);
 
+	return texture;
+}
 
-	// Now that the texture data is on the graphics card, we can unmap it
-	vkUnmapMemory(
-		device,
-		texture.transfer_buffer.buffer_memory
-	);
+// Create a texture from a png that has been decoded into RGBA8
+STexture CreateTexture(const VkHelper::DecodedImage& image)
+{
+	STexture texture;
+	texture.width = image.width;
+	texture.height = image.height;
+	const unsigned char* image_data = image.pixels.data();
 
+	// How big is the texture in bytes? RGBA = 4 bytes * Width * Height
+	const unsigned int texture_size = texture.width * texture.height * 4;
 
 
 	texture.layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;		// Define that the the image is read only
@@ -941,7 +1099,7 @@ STexture CreateTexture(const char* path)
 	// Create the image we will be rendering
 	VkHelper::CreateImage(
 		device,
-		physical_device_mem_properties,
+		allocator,
 		texture.width,
 		texture.height,
 		texture.format,
@@ -949,90 +1107,23 @@ STexture CreateTexture(const char* path)
 		VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
 		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 		texture.image,
-		texture.memory,
-		VK_IMAGE_LAYOUT_UNDEFINED										// Here we define the initial layout, later we change its layout to VK_FORMAT_R8G8B8A8_UNORM
-	);
-
-
-	// Create a new command that we will run on the GPU, this will be used to change the images settings
-	// and transfer the image data between the buffer and the image
-	VkCommandBuffer copy_cmd = VkHelper::BeginSingleTimeCommands(device, command_pool);
-
-	// The sub resource range describes the regions of the image we will be transition
-	VkImageSubresourceRange subresourceRange = {};
-	// Image only contains color data
-	subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	// Start at first mip level
-	subresourceRange.baseMipLevel = 0;
-	// We will transition on all mip levels
-	subresourceRange.levelCount = 1;
-	// The 2D texture only has one layer
-	subresourceRange.layerCount = 1;
-
-	// Optimal image will be used as destination for the copy, so we must transfer from our
-	// initial undefined image layout to the transfer destination layout
-
-	VkHelper::SetImageLayout(
-		copy_cmd,
-		texture.image,
-		VK_IMAGE_LAYOUT_UNDEFINED,
-		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-		subresourceRange
+		texture.allocation,
+		VK_IMAGE_LAYOUT_UNDEFINED										// Here we define the initial layout, the upload moves it to texture.layout
 	);
 
-	// Only dealing with one mip level for now
-	VkBufferImageCopy bufferCopyRegion = {};
-	bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	bufferCopyRegion.imageSubresource.mipLevel = 0;
-	bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
-	bufferCopyRegion.imageSubresource.layerCount = 1;
-	bufferCopyRegion.imageExtent.width = static_cast<uint32_t>(texture.width);
-	bufferCopyRegion.imageExtent.height = static_cast<uint32_t>(texture.height);
-	bufferCopyRegion.imageExtent.depth = 1;
-	bufferCopyRegion.bufferOffset = 0;
-
-	// Copy mip levels from staging buffer
-	vkCmdCopyBufferToImage(
-		copy_cmd,
-		texture.transfer_buffer.buffer,
-		texture.image,
-		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-		1,
-		&bufferCopyRegion
-	);
-
-
 
-	// Now the data is mapped to the texture, we no longer need the buffer
-	vkDestroyBuffer(
-		device,
-		texture.transfer_buffer.buffer,
-		nullptr
-	);
-
-	// Now change the images layout from VK_IMAGE_LAYOUT_UNDEFINED to VK_FORMAT_R8G8B8A8_UNORM
-	VkHelper::SetImageLayout(
-		copy_cmd,
-		texture.image,
-		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-		texture.layout,							// Set to VK_FORMAT_R8G8B8A8_UNORM
-		subresourceRange
-	);
-
-	// Finish the new command and run it
-	VkHelper::EndSingleTimeCommands(
-		device,
-		graphics_queue,
-		copy_cmd,
-		command_pool
-	);
-
-	// Clean up after the command buffer
-	vkFreeCommandBuffers(
-		device,
-		command_pool,
-		1,
-		&copy_cmd
+	// Rather then submitting and waiting for the copy here, the upload manager records it into its current batch.
+	// The image is not usable until the batch returned by SubmitUploads has completed
+	VkHelper::UploadImage(
+		upload_manager,
+		image_data,                                                     // Source for the memory (CPU-Ram)
+		texture_size,                                                   // How much data we are transferring
+		texture.image,                                                  // What image are we copying into
+		texture.width,
+		texture.height,
+		texture.layout,                                                 // What layout should the image be left in
+		VK_ACCESS_SHADER_READ_BIT,                                      // How will the image be used after the upload
+		VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_NV
 	);
 
 
@@ -1049,6 +1140,64 @@ STexture CreateTexture(const char* path)
 }
 
 
+// Load a set of textures at once. The pngs are decoded on worker threads and each one is copied into the staging ring
+// as soon as it has decoded. Everything ends up in the upload managers current batch, so the whole set goes to the GPU
+// with one SubmitUploads
+std::vector<STexture> CreateTextures(const std::vector<std::string>& paths)
+{
+	std::vector<STexture> textures(paths.size());
+
+	VkHelper::DecodeImages(
+		paths,
+		0,                                                              // Use every core to decode
+		[&](uint32_t index, VkHelper::DecodedImage& image)
+		{
+			// Validate that the image could be found and accessed
+			if (image.error)
+			{
+				std::cout << image.path << ": " << lodepng_error_text(image.error) << std::endl;
+				exit(-1);
+			}
+			textures[index] = CreateTexture(image);
+		}
+	);
+
+	return textures;
+}
+
+// Load the greyscale PBR maps of a material as one texture with AO, roughness, metallic and height in R, G, B and A.
+// The hit shader then needs a single sample to read all four. The KtxEncoder tool writes a pre-packed copy, when it
+// is missing the pngs are decoded in parallel and packed here. Pass an empty path for a map the material doesn't have
+STexture CreatePackedTexture(const std::string& packed_path, const std::string& ao_path, const std::string& roughness_path,
+	const std::string& metallic_path, const std::string& height_path)
+{
+	VkHelper::KtxTexture ktx_texture;
+	if (VkHelper::LoadKtx2(packed_path.c_str(), ktx_texture) && VkHelper::SupportsSampledFormat(physical_device, ktx_texture.format))
+	{
+		std::cout << "Loaded " << packed_path << std::endl;
+		return CreateTexture(ktx_texture);
+	}
+
+	VkHelper::ChannelSource sources[4];
+	sources[PACKED_AO].path = ao_path;
+	sources[PACKED_AO].default_value = 255;                            // No occlusion
+	sources[PACKED_ROUGHNESS].path = roughness_path;
+	sources[PACKED_ROUGHNESS].default_value = 255;                     // Fully rough, no reflections
+	sources[PACKED_METALLIC].path = metallic_path;
+	sources[PACKED_METALLIC].default_value = 0;                        // Not metal
+	sources[PACKED_HEIGHT].path = height_path;
+	sources[PACKED_HEIGHT].default_value = 0;                          // Flat
+
+	VkHelper::DecodedImage packed;
+	if (!VkHelper::DecodePackedImage(sources, 0, packed))
+	{
+		std::cout << "Failed to pack " << packed.path << ": " << (packed.error ? lodepng_error_text(packed.error) : "the maps are not all the same size") << std::endl;
+		exit(-1);
+	}
+
+	return CreateTexture(packed);
+}
+
 STexture CreateTexture(unsigned int width, unsigned int height, VkImageUsageFlags usageFlags)
 {
 	STexture texture;
@@ -1067,9 +1216,9 @@ STexture CreateTexture(unsigned int width, unsigned int height, VkImageUsageFlag
 	// Create a temp buffer to store the image in before we transfer it over to the image
 	VkHelper::CreateBuffer(
 		device,											 // What device are we going to use to create the buffer
-		physical_device_mem_properties,					 // What memory properties are available on the device
+		allocator,										 // What allocator are we getting the memory from
 		texture.transfer_buffer.buffer,                  // What buffer are we going to be creating
-		texture.transfer_buffer.buffer_memory,           // The output for the buffer memory
+		texture.transfer_buffer.allocation,              // The output for the buffer allocation
 		texture.transfer_buffer.buffer_size,             // How much memory we wish to allocate on the GPU
 		texture.transfer_buffer.usage,                   // What type of buffer do we want. Buffers can have multiple types, for example, uniform & vertex buffer.
 														 // for now we want to keep the buffer specialized to one type as this will allow vulkan to optimize the data.
@@ -1087,7 +1236,7 @@ STexture CreateTexture(unsigned int width, unsigned int height, VkImageUsageFlag
 	// Create the image we will be rendering
 	VkHelper::CreateImage(
 		device,
-		physical_device_mem_properties,
+		allocator,
 		texture.width,
 		texture.height,
 		texture.format,
@@ -1095,7 +1244,7 @@ STexture CreateTexture(unsigned int width, unsigned int height, VkImageUsageFlag
 		usageFlags,
 		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 		texture.image,
-		texture.memory,
+		texture.allocation,
 		VK_IMAGE_LAYOUT_UNDEFINED										// Here we define the initial layout, later we change its layout to VK_FORMAT_R8G8B8A8_UNORM
 	);
 
@@ -1149,13 +1298,6 @@ STexture CreateTexture(unsigned int width, unsigned int height, VkImageUsageFlag
 
 
 
-	// Now the data is mapped to the texture, we no longer need the buffer
-	vkDestroyBuffer(
-		device,
-		texture.transfer_buffer.buffer,
-		nullptr
-	);
-
 	// Now change the images layout from VK_IMAGE_LAYOUT_UNDEFINED to VK_FORMAT_R8G8B8A8_UNORM
 	VkHelper::SetImageLayout(
 		copy_cmd,
@@ -1181,6 +1323,14 @@ STexture CreateTexture(unsigned int width, unsigned int height, VkImageUsageFlag
 		&copy_cmd
 	);
 
+	// Now the copy has finished, we no longer need the buffer
+	VkHelper::DestroyBuffer(
+		device,
+		allocator,
+		texture.transfer_buffer.buffer,
+		texture.transfer_buffer.allocation
+	);
+
 
 	// Create a new image sampler, this will allow the shaders to sample the texture
 	VkHelper::CreateImageSampler(
@@ -1196,25 +1346,24 @@ STexture CreateTexture(unsigned int width, unsigned int height, VkImageUsageFlag
 
 void DestroyTexture(STexture& texture)
 {
-	// Free the memory that was allocated for the buffer
-	vkFreeMemory(
+	// Destroy the image sampler now that we are done with that
+	VkHelper::ReleaseSampler(
 		device,
-		texture.transfer_buffer.buffer_memory,
-		nullptr
+		texture.sampler
 	);
 
-	// Destroy the image sampler now that we are done with that
-	vkDestroySampler(
+	vkDestroyImageView(
 		device,
-		texture.sampler,
+		texture.view,
 		nullptr
 	);
 
-	// Destroy the image we are displaying
-	vkDestroyImage(
+	// Destroy the image we are displaying and give its memory back to the allocator
+	VkHelper::DestroyImage(
 		device,
+		allocator,
 		texture.image,
-		nullptr
+		texture.allocation
 	);
 }
 
@@ -1231,9 +1380,9 @@ void SetMaterial(SMaterial& material)
 
 	
 	descriptorImageInfos[1] = VkHelper::DescriptorImageInfo(
-		material.metal.sampler,
-		material.metal.view,
-		material.metal.layout
+		material.surface.sampler,
+		material.surface.view,
+		material.surface.layout
 	);
 	
 	VkWriteDescriptorSet descriptorWrite = VkHelper::WriteDescriptorSet(texture_descriptor_set, descriptorImageInfos, 2, 2);
@@ -1252,7 +1401,9 @@ void LoadModel(const char* path, VkHelper::ModelInstance& model_instance)
 {
 	
 	ObjLoader<SVertexData> loader;
-	loader.loadModel(path);
+	// Merge the vertices that are shared between triangles so the index buffer can reuse them
+	loader.loadModel(path, true);
+	std::cout << path << ": " << loader.m_sourceVertexCount << " vertices before deduplication, " << loader.m_vertices.size() << " after" << std::endl;
 
 	model_instance.vertex_offset = used_verticies;
 	model_instance.index_offset = used_index;
@@ -1314,11 +1465,21 @@ void CreateModel(VkHelper::ModelInstance& model_instance, glm::mat4 transform, u
 
 void DestroyRenderResources()
 {
-	vkDestroySwapchainKHR(
-		device,
-		swap_chain,
-		nullptr
-	);
+	if (headless.enabled)
+	{
+		VkHelper::DestroyHeadlessSwapchain(
+			device,
+			headless_swapchain
+		);
+	}
+	else
+	{
+		vkDestroySwapchainKHR(
+			device,
+			swap_chain,
+			nullptr
+		);
+	}
 
 	for (uint32_t i = 0; i < swapchain_image_count; i++)
 	{
@@ -1332,12 +1493,93 @@ void DestroyRenderResources()
 
 void RebuildRenderResources()
 {
+	// Only the window can go out of date, the headless images stay the same size
+	assert(!headless.enabled);
+
 	// Wait for the device to finish
 	VkResult device_idle_result = vkDeviceWaitIdle(device);
 	assert(device_idle_result == VK_SUCCESS);
+	uint32_t old_swapchain_image_count = swapchain_image_count;
 	// Destroy and rebuild the render resources
 	DestroyRenderResources();
 	CreateRenderResources();
+	// The old swapchain images are gone, so forget which frames were using them
+	VkHelper::ResetFrameLoopImages(frame_loop, swapchain_image_count);
+
+	// There is a command buffer per image, so if the image count changed they need to be allocated again
+	if (swapchain_image_count != old_swapchain_image_count)
+	{
+		vkFreeCommandBuffers(
+			device,
+			command_pool,
+			old_swapchain_image_count,
+			graphics_command_buffers.get()
+		);
+
+		VkCommandBufferAllocateInfo command_buffer_allocate_info = VkHelper::CommandBufferAllocateInfo(
+			command_pool,
+			swapchain_image_count
+		);
+
+		graphics_command_buffers = std::unique_ptr<VkCommandBuffer>(new VkCommandBuffer[swapchain_image_count]);
+
+		VkResult allocate_command_buffer_resut = vkAllocateCommandBuffers(
+			device,
+			&command_buffer_allocate_info,
+			graphics_command_buffers.get()
+		);
+		assert(allocate_command_buffer_resut == VK_SUCCESS);
+	}
+
+	// Each command buffer has its own profiler slot. Nothing is in flight, so the old query pool can go straight away
+	VkQueryPool old_query_pool = VkHelper::GrowGpuProfiler(gpu_profiler, swapchain_image_count);
+	if (old_query_pool != VK_NULL_HANDLE)
+	{
+		vkDestroyQueryPool(
+			device,
+			old_query_pool,
+			nullptr
+		);
+	}
+
+	// The camera ring buffer has a region per image, so a larger swapchain needs a larger ring buffer
+	if (swapchain_image_count > uniform_buffer.region_count)
+	{
+		VkDeviceSize region_size = uniform_buffer.region_size;
+		VkHelper::DestroyRingBuffer(
+			device,
+			allocator,
+			uniform_buffer
+		);
+
+		VkHelper::CreateRingBuffer(
+			device,
+			allocator,
+			physical_device_properties,
+			region_size,                                       // Each frame pushes the same amount as before
+			swapchain_image_count,                             // One region for each image of the new swapchain
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			uniform_buffer
+		);
+
+		// The device is idle, so the camera set can point straight at the new buffer
+		VkDescriptorBufferInfo camera_buffer_info = VkHelper::DescriptorBufferInfo(
+			uniform_buffer.buffer,
+			sizeof(SCamera),
+			0
+		);
+
+		VkWriteDescriptorSet camera_write = VkHelper::WriteDescriptorSet(camera_descriptor_set, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, camera_buffer_info, 2);
+
+		vkUpdateDescriptorSets(
+			device,
+			1,
+			&camera_write,
+			0,
+			NULL
+		);
+	}
+
 	DestroyRaytracingTexture();
 	CreateRaytracingTexture();
 	BuildCommandBuffers(graphics_command_buffers, swapchain_image_count);
@@ -1399,7 +1641,7 @@ void BuildCommandBuffers(std::unique_ptr<VkCommandBuffer>& command_buffers, cons
 		assert(begin_command_buffer_result == VK_SUCCESS);
 
 		// Set the viewport
-		vkCmdSetViewport(
+		device_dispatch->vkCmdSetViewport(
 			command_buffers.get()[i],
 			0,
 			1,
@@ -1407,7 +1649,7 @@ void BuildCommandBuffers(std::unique_ptr<VkCommandBuffer>& command_buffers, cons
 		);
 
 		// Set the scissor region
-		vkCmdSetScissor(
+		device_dispatch->vkCmdSetScissor(
 			command_buffers.get()[i],
 			0,
 			1,
@@ -1415,7 +1657,7 @@ void BuildCommandBuffers(std::unique_ptr<VkCommandBuffer>& command_buffers, cons
 		);
 
 		// Bind the ray tracing pipeline
-		vkCmdBindPipeline(
+		device_dispatch->vkCmdBindPipeline(
 			command_buffers.get()[i], 
 			VK_PIPELINE_BIND_POINT_RAY_TRACING_NV,
 			raytracing_pipeline
@@ -1423,18 +1665,21 @@ void BuildCommandBuffers(std::unique_ptr<VkCommandBuffer>& command_buffers, cons
 
 
 
-		vkCmdBindDescriptorSets(
+		// Each frame reads its camera from its own region of the ring buffer
+		uint32_t camera_dynamic_offset = static_cast<uint32_t>(VkHelper::RingBufferRegionOffset(uniform_buffer, i));
+
+		device_dispatch->vkCmdBindDescriptorSets(
 			command_buffers.get()[i],
 			VK_PIPELINE_BIND_POINT_RAY_TRACING_NV,
 			raytracing_pipeline_layout,
 			0,
 			1,
 			&camera_descriptor_set,
-			0,
-			NULL
+			1,
+			&camera_dynamic_offset
 		);
 
-		vkCmdBindDescriptorSets(
+		device_dispatch->vkCmdBindDescriptorSets(
 			command_buffers.get()[i],
 			VK_PIPELINE_BIND_POINT_RAY_TRACING_NV,
 			raytracing_pipeline_layout,
@@ -1447,16 +1692,41 @@ void BuildCommandBuffers(std::unique_ptr<VkCommandBuffer>& command_buffers, cons
 
 
 
+		// Every frame in flight traces into the same staging texture, so make sure the copy out of it from the
+		// previous frame has finished before we start writing the new one
+		VkMemoryBarrier staging_texture_barrier = {};
+		staging_texture_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		staging_texture_barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		staging_texture_barrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+
+		// The queries are reset outside of any render pass before this buffer writes its timestamps
+		VkHelper::ResetGpuProfilerSlot(command_buffers.get()[i], gpu_profiler, i);
+
+		device_dispatch->vkCmdPipelineBarrier(
+			command_buffers.get()[i],
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_NV,
+			0,
+			1,
+			&staging_texture_barrier,
+			0,
+			nullptr,
+			0,
+			nullptr
+		);
+
 		VkDeviceSize rayGenOffset = 0;
 		VkDeviceSize missOffset = rayGenEntrySize;
 		VkDeviceSize missStride = missEntrySize;
 		VkDeviceSize hitGroupOffset = rayGenEntrySize + missEntrySize;
 		VkDeviceSize hitGroupStride = hitGroupEntrySize;
 
-		vkCmdTraceRaysNV(command_buffers.get()[i], stb_buffer, rayGenOffset,
+		VkHelper::BeginGpuScope(command_buffers.get()[i], gpu_profiler, i, trace_gpu_scope);
+		device_dispatch->vkCmdTraceRaysNV(command_buffers.get()[i], stb_buffer, rayGenOffset,
 			stb_buffer, missOffset, missStride,
 			stb_buffer, hitGroupOffset, hitGroupStride,
 			VK_NULL_HANDLE, 0, 0, window_width, window_height, 1);
+		VkHelper::EndGpuScope(command_buffers.get()[i], gpu_profiler, i, trace_gpu_scope);
 
 
 		
@@ -1489,7 +1759,7 @@ void BuildCommandBuffers(std::unique_ptr<VkCommandBuffer>& command_buffers, cons
 		copyRegion.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
 		copyRegion.dstOffset = { 0, 0, 0 };
 		copyRegion.extent = { window_width, window_height, 1 };
-		vkCmdCopyImage(
+		device_dispatch->vkCmdCopyImage(
 			command_buffers.get()[i],
 			raytracing_staging_texture.image,
 			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
@@ -1526,98 +1796,58 @@ void BuildCommandBuffers(std::unique_ptr<VkCommandBuffer>& command_buffers, cons
 	}
 }
 
-void Render()
+void PrintGpuTimings()
 {
-	// Find next image
-	VkResult wait_for_fences = vkWaitForFences(
-		device,
-		1,
-		&fences.get()[current_frame_index],
-		VK_TRUE,
-		UINT32_MAX
-	);
-	assert(wait_for_fences == VK_SUCCESS);
+	for (const VkHelper::GpuScopeStats& stats : VkHelper::GetGpuScopeStats(gpu_profiler))
+	{
+		std::cout << stats.name << ": " << stats.average_ms << "ms average, " << stats.p50_ms << "ms p50, " << stats.p95_ms << "ms p95, "
+			<< stats.p99_ms << "ms p99, " << stats.max_ms << "ms worst over " << stats.samples << " frames" << std::endl;
+	}
+}
 
-	VkResult acquire_next_image_result = vkAcquireNextImageKHR(
+void Render()
+{
+	// Wait for the oldest frame in flight to finish and find the next image
+	VkResult begin_frame_result = VkHelper::BeginFrame(
 		device,
 		swap_chain,
-		UINT64_MAX,
-		image_available_semaphore,
-		VK_NULL_HANDLE,
-		&current_frame_index
+		frame_loop
 	);
-	assert(acquire_next_image_result == VK_SUCCESS);
+	// The swapchain no longer matches the window, rebuild it and pick the frame up next time round
+	if (begin_frame_result == VK_ERROR_OUT_OF_DATE_KHR)
+	{
+		RebuildRenderResources();
+		return;
+	}
 
-	// Reset and wait
-	VkResult queue_idle_result = vkQueueWaitIdle(
-		graphics_queue
-	);
-	assert(queue_idle_result == VK_SUCCESS);
+	// Now we know what image we are rendering, write its uniforms
+	UpdateUniforms(frame_loop.image_index);
 
-	VkResult reset_fences_result = vkResetFences(
-		device,
-		1,
-		&fences.get()[current_frame_index]
-	);
-	assert(reset_fences_result == VK_SUCCESS);
+	// The last frame to use this images command buffer has finished, so its timings are ready
+	VkHelper::CollectGpuTimings(gpu_profiler, frame_loop.image_index);
+	if (gpu_profile && frame_loop.frame_number > 0 && frame_loop.frame_number % 300 == 0) PrintGpuTimings();
 
-	render_submission_info.pCommandBuffers = &graphics_command_buffers.get()[current_frame_index];
-
-	VkResult queue_submit_result = vkQueueSubmit(
+	// Submit the commands recorded for this image and present it. We don't wait for the GPU here, the CPU carries
+	// straight on with the next frame while this one is being rendered
+	VkResult end_frame_result = VkHelper::EndFrame(
+		device,
 		graphics_queue,
-		1,
-		&render_submission_info,
-		fences.get()[current_frame_index]
-	);
-	assert(queue_submit_result == VK_SUCCESS);
-
-	present_info.pImageIndices = &current_frame_index;
-
-	VkResult queue_present_result = vkQueuePresentKHR(
 		present_queue,
-		&present_info
+		swap_chain,
+		frame_loop,
+		&graphics_command_buffers.get()[frame_loop.image_index],  // The command buffer that renders to this image
+		1,
+		VK_PIPELINE_STAGE_TRANSFER_BIT                             // The raytraced image is copied into the swapchain image
 	);
 	// If the window was resized or something else made the current render invalid, we need to rebuild all the
 	// render resources
-	if (queue_present_result == VK_ERROR_OUT_OF_DATE_KHR)
+	if (end_frame_result == VK_ERROR_OUT_OF_DATE_KHR)
 	{
 		RebuildRenderResources();
 	}
-
-	assert(queue_present_result == VK_SUCCESS || queue_present_result == VK_ERROR_OUT_OF_DATE_KHR);
-
-
-	VkResult device_idle_result = vkDeviceWaitIdle(device);
-	assert(device_idle_result == VK_SUCCESS);
 }
 
 
-
-VKAPI_ATTR void VKAPI_CALL vkCmdTraceRaysNV(VkCommandBuffer commandBuffer,
-	VkBuffer        raygenShaderBindingTableBuffer,
-	VkDeviceSize    raygenShaderBindingOffset,
-	VkBuffer        missShaderBindingTableBuffer,
-	VkDeviceSize    missShaderBindingOffset,
-	VkDeviceSize    missShaderBindingStride,
-	VkBuffer        hitShaderBindingTableBuffer,
-	VkDeviceSize    hitShaderBindingOffset,
-	VkDeviceSize    hitShaderBindingStride,
-	VkBuffer        callableShaderBindingTableBuffer,
-	VkDeviceSize    callableShaderBindingOffset,
-	VkDeviceSize    callableShaderBindingStride,
-	uint32_t        width,
-	uint32_t        height,
-	uint32_t        depth)
-{
-	static const auto call = reinterpret_cast<PFN_vkCmdTraceRaysNV>(
-		vkGetDeviceProcAddr(device, "vkCmdTraceRaysNV"));
-	return call(commandBuffer, raygenShaderBindingTableBuffer, raygenShaderBindingOffset,
-		missShaderBindingTableBuffer, missShaderBindingOffset, missShaderBindingStride,
-		hitShaderBindingTableBuffer, hitShaderBindingOffset, hitShaderBindingStride,
-		callableShaderBindingTableBuffer, callableShaderBindingOffset,
-		callableShaderBindingStride, width, height, depth);
-}
-
 #ifndef ROUND_UP
 #define ROUND_UP(v, powerOf2Alignment) (((v) + (powerOf2Alignment)-1) & ~((powerOf2Alignment)-1))
 #endif
@@ -1677,16 +1907,7 @@ void CreateRaytracingTexture()
 
 void DestroyRaytracingTexture()
 {
-	vkDestroySampler(
-		device,
-		raytracing_staging_texture.sampler,
-		nullptr
-	);
-	vkDestroyImage(
-		device,
-		raytracing_staging_texture.image,
-		nullptr
-	);
+	DestroyTexture(raytracing_staging_texture);
 }
 
 
@@ -1822,15 +2043,37 @@ void StopRecordingAndSubmitAccelerationStructure(VkCommandBuffer commandBuffer)
 
 int main(int argc, char **argv)
 {
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--gpu-profile") == 0) gpu_profile = true;
+	}
 
+	headless = VkHelper::ParseHeadlessOptions(argc, argv);
 	Setup();
 
 	SMaterial metal_material;
 
-	// Create albedo texture for the model
-	metal_material.diffuse = CreateTexture("../../../Data/Images/futuristic-panels1-bl/futuristic-panels1-albedo.png");
-	// Create metal texture for the model
-	metal_material.metal = CreateTexture("../../../Data/Images/futuristic-panels1-bl/futuristic-panels1-metallic.png");
+	std::chrono::high_resolution_clock::time_point texture_load_start = std::chrono::high_resolution_clock::now();
+
+	// Create the albedo texture and the packed AO, roughness, metallic and height texture for the model
+	std::vector<STexture> material_textures = CreateTextures({
+		"../../../Data/Images/futuristic-panels1-bl/futuristic-panels1-albedo.png"
+	});
+	metal_material.diffuse = material_textures[0];
+	metal_material.surface = CreatePackedTexture(
+		"../../../Data/Images/futuristic-panels1-bl/futuristic-panels1-packed.ktx2",
+		"../../../Data/Images/futuristic-panels1-bl/futuristic-panels1-ao.png",
+		"../../../Data/Images/futuristic-panels1-bl/futuristic-panels1-roughness.png",
+		"../../../Data/Images/futuristic-panels1-bl/futuristic-panels1-metallic.png",
+		"../../../Data/Images/futuristic-panels1-bl/futuristic-panels1-height.png"
+	);
+
+	std::chrono::high_resolution_clock::time_point texture_load_end = std::chrono::high_resolution_clock::now();
+	std::cout << "Texture loading took " << std::chrono::duration_cast<std::chrono::microseconds>(texture_load_end - texture_load_start).count() / 1000.0f
+		<< "ms" << std::endl;
+
+	// Send both textures to the GPU in one submit, the model can be loaded while they are copied
+	uint64_t texture_upload = VkHelper::SubmitUploads(upload_manager);
 
 
 	// Set the albedo texture
@@ -1967,30 +2210,22 @@ int main(int argc, char **argv)
 
 
 
-	VkRayTracingPipelineCreateInfoNV vulkan_pipeline_create_info{};
-	vulkan_pipeline_create_info.sType = VK_STRUCTURE_TYPE_RAY_TRACING_PIPELINE_CREATE_INFO_NV;
-	vulkan_pipeline_create_info.pNext = nullptr;
-	vulkan_pipeline_create_info.flags = 0;
-	vulkan_pipeline_create_info.stageCount = shader_stage_create_info_count;
-	vulkan_pipeline_create_info.pStages = shader_stage_create_info.get();
-	vulkan_pipeline_create_info.groupCount = shader_group_create_info_count;
-	vulkan_pipeline_create_info.pGroups = shader_group_create_info.get();
-	vulkan_pipeline_create_info.maxRecursionDepth = 3;
-	vulkan_pipeline_create_info.layout = raytracing_pipeline_layout;
-	vulkan_pipeline_create_info.basePipelineHandle = VK_NULL_HANDLE;
-	vulkan_pipeline_create_info.basePipelineIndex = 0;
-
+	// Time how long the driver takes to build the pipelines, compare the first run (cold cache) with later runs (warm cache)
+	std::chrono::high_resolution_clock::time_point pipeline_build_start = std::chrono::high_resolution_clock::now();
 
-	VkResult create_pipeline_result = vkCreateRayTracingPipelinesNV(
+	raytracing_pipeline = VkHelper::CreateRayTracingPipeline(
 		device,
-		nullptr,
-		1,
-		&vulkan_pipeline_create_info,
-		nullptr,
-		&raytracing_pipeline
+		raytracing_pipeline_layout,
+		shader_stage_create_info_count,                        // How many shaders are in the pipeline
+		shader_stage_create_info.get(),
+		shader_group_create_info_count,                        // How many shader groups are there
+		shader_group_create_info.get(),
+		3                                                      // How deep can the rays recurse
 	);
 
-	assert(create_pipeline_result == VK_SUCCESS);
+	std::chrono::high_resolution_clock::time_point pipeline_build_end = std::chrono::high_resolution_clock::now();
+	std::cout << "Pipeline creation took " << std::chrono::duration_cast<std::chrono::microseconds>(pipeline_build_end - pipeline_build_start).count() / 1000.0f
+		<< "ms (" << (VkHelper::PipelineCacheLoadedFromDisk() ? "warm" : "cold") << " pipeline cache)" << std::endl;
 
 	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 	// Gonna have to explain this
@@ -2115,12 +2350,39 @@ int main(int argc, char **argv)
 	// Regenerate the command buffers
 	BuildCommandBuffers(graphics_command_buffers, swapchain_image_count);
 
+	// The textures need to be on the GPU before we can start rendering
+	VkHelper::WaitForUpload(upload_manager, texture_upload);
+
+	std::chrono::high_resolution_clock::time_point render_start = std::chrono::high_resolution_clock::now();
+
 	while (window_open)
 	{
-		PollWindow();
+		if (!headless.enabled) PollWindow();
 
 		Render();
+
+		// A headless run stops after a fixed number of frames so runs can be compared
+		if (headless.enabled && headless.frame_count > 0 && frame_loop.frame_number >= headless.frame_count) window_open = false;
+	}
+
+	// Let the frames that are still in flight finish before we start cleaning up
+	VkResult device_idle_result = vkDeviceWaitIdle(device);
+	assert(device_idle_result == VK_SUCCESS);
+
+	if (headless.enabled)
+	{
+		std::chrono::high_resolution_clock::time_point render_end = std::chrono::high_resolution_clock::now();
+		float render_ms = std::chrono::duration_cast<std::chrono::microseconds>(render_end - render_start).count() / 1000.0f;
+		std::cout << "Rendered " << frame_loop.frame_number << " headless frames in " << render_ms << "ms, "
+			<< render_ms / frame_loop.frame_number << "ms per frame" << std::endl;
+	}
+
+	if (gpu_profile)
+	{
+		PrintGpuTimings();
+		if (VkHelper::WriteGpuTrace(gpu_profiler, "RaytracingPipeline.gputrace.json")) std::cout << "GPU trace written to RaytracingPipeline.gputrace.json" << std::endl;
 	}
+	VkHelper::DestroyGpuProfiler(gpu_profiler);
 
 	////////////////////
 	///// Clean Up ///// 
@@ -2128,7 +2390,7 @@ int main(int argc, char **argv)
 
 	DestroyTexture(metal_material.diffuse);
 
-	DestroyTexture(metal_material.metal);
+	DestroyTexture(metal_material.surface);
 
 	DestroyRaytracingTexture();
 
@@ -15,10 +15,12 @@ layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inNormal;
 layout(location = 2) in vec3 inColor;
 layout(location = 3) in vec2 inUV;
+layout(location = 4) in uint inMatID;
 
 layout(location = 0) out vec3 outColor;
 layout(location = 1) out vec3 outNormal;
 layout(location = 2) out vec2 outUV;
+layout(location = 3) flat out uint outMatID;
 
 void main()
 {
@@ -26,4 +28,5 @@ void main()
 	outColor = inColor;
 	outNormal = inNormal;
 	outUV = inUV;
+	outMatID = inMatID;
 }
\ No newline at end of file
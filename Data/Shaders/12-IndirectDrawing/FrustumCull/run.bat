@@ -0,0 +1,2 @@
+C:/VulkanSDK/Bin32/glslangValidator.exe -V shader.comp
+pause
\ No newline at end of file
@@ -2,12 +2,22 @@
 
 #extension GL_EXT_nonuniform_qualifier : enable
 
-layout (set = 1, binding = 0) uniform sampler2D diffuseTex;
+struct Material
+{
+	uint albedoTexture;
+};
+
+// The material table, indexed by the vertices matID
+layout (set = 0, binding = 1) readonly buffer MaterialBuffer { Material materials[]; };
+
+// Every texture in the scene, the material says which one to use
+layout (set = 1, binding = 0) uniform sampler2D textures[];
 
 
 layout(location = 0) in vec3 inColor;
 layout(location = 1) in vec3 inNormal;
 layout(location = 2) in vec2 inUV;
+layout(location = 3) flat in uint inMatID;
 
 layout(location = 0) out vec4 outColor;
 
@@ -19,7 +29,9 @@ const vec3 lightColor = vec3(1.0f,1.0f,1.0f);
 
 void main() 
 {
-	vec3 texColor = texture(diffuseTex, inUV).xyz;
+	Material material = materials[inMatID];
+	// The texture can change between neighbouring pixels, so the index has to be marked as non uniform
+	vec3 texColor = texture(textures[nonuniformEXT(material.albedoTexture)], inUV).xyz;
 	float diff = max(dot(normalize(inNormal), lightDir), 0.0f);
 	vec3 diffuse = diff * lightColor;
 
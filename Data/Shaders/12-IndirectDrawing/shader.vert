@@ -18,9 +18,12 @@ layout(location = 3) in vec2 inUV;
 
 layout(location = 4) in mat4 inModel;
 
+layout(location = 8) in uint inMatID;
+
 layout(location = 0) out vec3 outColor;
 layout(location = 1) out vec3 outNormal;
 layout(location = 2) out vec2 outUV;
+layout(location = 3) flat out uint outMatID;
 
 void main()
 {
@@ -28,4 +31,5 @@ void main()
 	outColor = inColor;
 	outNormal = inNormal;
 	outUV = inUV;
+	outMatID = inMatID;
 }
\ No newline at end of file
@@ -0,0 +1,236 @@
+// Times how long it takes the CPU to rewrite a batch of descriptor sets three different ways:
+// - One vkUpdateDescriptorSets call per binding, how most of the samples write their sets
+// - One vkUpdateDescriptorSets call per set, with a VkWriteDescriptorSet for each binding
+// - One vkUpdateDescriptorSetWithTemplate call per set, through VkHelper::DescriptorTemplate
+// No window or swapchain is needed, so it runs on any device that supports Vulkan 1.1
+//
+// Usage: DescriptorBenchmark [set count] [iterations]
+
+#include <assert.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <iostream>
+#include <chrono>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include <VkInitializers.hpp>
+#include <VkCore.hpp>
+#include <VkDispatch.hpp>
+#include <VkDescriptorAllocator.hpp>
+#include <VkDescriptorTemplate.hpp>
+
+VkInstance instance;
+VkPhysicalDevice physical_device;
+VkPhysicalDeviceProperties physical_device_properties;
+VkPhysicalDeviceFeatures physical_device_features;
+VkPhysicalDeviceMemoryProperties physical_device_mem_properties;
+uint32_t physical_devices_queue_family = 0;
+VkDevice device;
+
+// The same shape as the indirect drawing cull set, four storage buffers and a uniform buffer
+const uint32_t binding_count = 5;
+
+struct SBenchmarkDescriptors
+{
+	VkDescriptorBufferInfo buffers[binding_count - 1];
+	VkDescriptorBufferInfo settings;
+};
+
+// Run one of the update paths over every set and return the average time per set in nanoseconds
+template <typename UpdateFunction>
+double TimeUpdates(const char* name, uint32_t iterations, std::vector<VkDescriptorSet>& descriptor_sets, UpdateFunction update)
+{
+	// Warm up the driver so the first path isn't paying for anything the others get for free
+	for (VkDescriptorSet& descriptor_set : descriptor_sets) update(descriptor_set);
+
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	for (uint32_t i = 0; i < iterations; i++)
+	{
+		for (VkDescriptorSet& descriptor_set : descriptor_sets) update(descriptor_set);
+	}
+	std::chrono::high_resolution_clock::time_point end = std::chrono::high_resolution_clock::now();
+
+	double total_ns = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+	double per_set_ns = total_ns / (static_cast<double>(iterations) * descriptor_sets.size());
+
+	std::cout << name << ": " << total_ns / 1000000.0 << "ms total, " << per_set_ns << "ns per set" << std::endl;
+	return per_set_ns;
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t set_count = argc > 1 ? static_cast<uint32_t>(atoi(argv[1])) : 1024;
+	uint32_t iterations = argc > 2 ? static_cast<uint32_t>(atoi(argv[2])) : 200;
+	assert(set_count > 0 && iterations > 0);
+
+
+	// No validation layers, they would be most of what we end up timing
+	instance = VkHelper::CreateInstance(
+		nullptr, 0,
+		nullptr, 0,
+		"Descriptor Benchmark", VK_MAKE_VERSION(1, 0, 0),
+		"Vulkan", VK_MAKE_VERSION(1, 0, 0),
+		VK_MAKE_VERSION(1, 1, 108));
+
+	bool foundPhysicalDevice = VkHelper::GetPhysicalDevice(
+		instance,
+		physical_device,                                       // Return of physical device instance
+		physical_device_properties,                            // Physical device properties
+		physical_devices_queue_family,                         // Physical device queue family
+		physical_device_features,                              // Physical device features
+		physical_device_mem_properties,                        // Physical device memory properties
+		nullptr,                                               // No device extensions are needed
+		0,                                                     // Extension count
+		VK_QUEUE_COMPUTE_BIT                                   // What queues we need to be available
+	);
+	assert(foundPhysicalDevice);
+
+	static const float queue_priority = 1.0f;
+	VkDeviceQueueCreateInfo queue_create_info = VkHelper::DeviceQueueCreateInfo(
+		&queue_priority,
+		1,
+		physical_devices_queue_family
+	);
+
+	device = VkHelper::CreateDevice(
+		physical_device,
+		&queue_create_info,
+		1,
+		physical_device_features,
+		nullptr,
+		0
+	);
+
+	std::cout << "Device: " << physical_device_properties.deviceName << std::endl;
+	std::cout << set_count << " sets of " << binding_count << " bindings, " << iterations << " iterations" << std::endl;
+
+
+	// The sets are written but never used, so the buffers don't need any particular memory
+	VkBuffer buffer;
+	VkDeviceMemory buffer_memory;
+	bool buffer_created = VkHelper::CreateBuffer(
+		device,
+		physical_device_mem_properties,
+		buffer,
+		buffer_memory,
+		64 * 1024,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+		VK_SHARING_MODE_EXCLUSIVE,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+	);
+	assert(buffer_created);
+
+
+	// Describe the layout once, the template is built from the same description
+	VkHelper::DescriptorTemplateBinding template_bindings[binding_count];
+	for (uint32_t i = 0; i < binding_count - 1; i++)
+	{
+		template_bindings[i] = VkHelper::TemplateBinding(i, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT,
+			offsetof(SBenchmarkDescriptors, buffers) + i * sizeof(VkDescriptorBufferInfo));
+	}
+	template_bindings[binding_count - 1] = VkHelper::TemplateBinding(binding_count - 1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT,
+		offsetof(SBenchmarkDescriptors, settings));
+
+	VkHelper::DescriptorTemplate descriptor_template;
+	VkHelper::CreateDescriptorTemplate(
+		device,
+		template_bindings,
+		binding_count,
+		descriptor_template
+	);
+
+	const VkHelper::DescriptorPoolRatio pool_ratios[] = {
+		{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, static_cast<float>(binding_count - 1) },
+		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1.0f }
+	};
+
+	VkHelper::DescriptorAllocator descriptor_allocator;
+	VkHelper::CreateDescriptorAllocator(
+		device,
+		pool_ratios,
+		2,
+		set_count,
+		0,
+		descriptor_allocator
+	);
+
+	std::vector<VkDescriptorSet> descriptor_sets(set_count);
+	for (VkDescriptorSet& descriptor_set : descriptor_sets)
+	{
+		bool allocated = VkHelper::AllocateDescriptorSet(descriptor_allocator, descriptor_template.descriptor_set_layout, descriptor_set);
+		assert(allocated);
+	}
+
+
+	// Every path writes the same buffer ranges
+	SBenchmarkDescriptors descriptors;
+	for (uint32_t i = 0; i < binding_count - 1; i++)
+	{
+		descriptors.buffers[i] = VkHelper::DescriptorBufferInfo(buffer, 1024, i * 1024);
+	}
+	descriptors.settings = VkHelper::DescriptorBufferInfo(buffer, 256, (binding_count - 1) * 1024);
+
+
+	double per_write_ns = TimeUpdates("vkUpdateDescriptorSets per binding", iterations, descriptor_sets, [&](VkDescriptorSet& descriptor_set)
+	{
+		for (uint32_t i = 0; i < binding_count - 1; i++)
+		{
+			VkWriteDescriptorSet descriptor_write = VkHelper::WriteDescriptorSet(descriptor_set, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, descriptors.buffers[i], i);
+			vkUpdateDescriptorSets(device, 1, &descriptor_write, 0, NULL);
+		}
+		VkWriteDescriptorSet descriptor_write = VkHelper::WriteDescriptorSet(descriptor_set, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, descriptors.settings, binding_count - 1);
+		vkUpdateDescriptorSets(device, 1, &descriptor_write, 0, NULL);
+	});
+
+	double per_set_ns = TimeUpdates("vkUpdateDescriptorSets per set", iterations, descriptor_sets, [&](VkDescriptorSet& descriptor_set)
+	{
+		VkWriteDescriptorSet descriptor_writes[binding_count];
+		for (uint32_t i = 0; i < binding_count - 1; i++)
+		{
+			descriptor_writes[i] = VkHelper::WriteDescriptorSet(descriptor_set, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, descriptors.buffers[i], i);
+		}
+		descriptor_writes[binding_count - 1] = VkHelper::WriteDescriptorSet(descriptor_set, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, descriptors.settings, binding_count - 1);
+		vkUpdateDescriptorSets(device, binding_count, descriptor_writes, 0, NULL);
+	});
+
+	double template_ns = TimeUpdates("vkUpdateDescriptorSetWithTemplate", iterations, descriptor_sets, [&](VkDescriptorSet& descriptor_set)
+	{
+		VkHelper::UpdateDescriptorSet(descriptor_template, descriptor_set, &descriptors);
+	});
+
+	std::cout << "Template speedup: " << per_write_ns / template_ns << "x over per binding writes, "
+		<< per_set_ns / template_ns << "x over per set writes" << std::endl;
+
+
+	VkHelper::DestroyDescriptorAllocator(descriptor_allocator);
+	VkHelper::DestroyDescriptorTemplate(descriptor_template);
+
+	vkDestroyBuffer(
+		device,
+		buffer,
+		nullptr
+	);
+
+	vkFreeMemory(
+		device,
+		buffer_memory,
+		nullptr
+	);
+
+	// The device is going away, free its dispatch table so a later device given the same handle loads its own
+	VkHelper::UnregisterDeviceDispatch(device);
+
+	vkDestroyDevice(
+		device,
+		nullptr
+	);
+
+	vkDestroyInstance(
+		instance,
+		nullptr
+	);
+
+	return 0;
+}
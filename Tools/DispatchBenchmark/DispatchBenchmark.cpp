@@ -0,0 +1,240 @@
+// Times how long the CPU spends calling into the driver two different ways:
+// - Through the loader, the vkCmdFillBuffer the samples link against, which looks up the dispatch table of the handle
+//   and then jumps into the driver
+// - Through VkHelper::DeviceDispatch, the devices own function pointers from vkGetDeviceProcAddr
+// Each way is timed recording commands and calling a device function that never reaches the GPU. The command buffers
+// are never submitted, so no window, swapchain or queue work is needed
+//
+// Usage: DispatchBenchmark [calls per batch] [batches]
+
+#include <assert.h>
+#include <stdlib.h>
+#include <iostream>
+#include <chrono>
+
+#include <vulkan/vulkan.h>
+
+#include <VkInitializers.hpp>
+#include <VkCore.hpp>
+#include <VkDispatch.hpp>
+
+VkInstance instance;
+VkPhysicalDevice physical_device;
+VkPhysicalDeviceProperties physical_device_properties;
+VkPhysicalDeviceFeatures physical_device_features;
+VkPhysicalDeviceMemoryProperties physical_device_mem_properties;
+uint32_t physical_devices_queue_family = 0;
+VkDevice device;
+VkCommandPool command_pool;
+VkCommandBuffer command_buffer;
+
+// Record a batch of commands into the command buffer, only the recording is timed, not the begin, end or pool reset
+template <typename RecordFunction>
+double TimeCommands(const char* name, uint32_t calls, uint32_t batches, RecordFunction record)
+{
+	VkCommandBufferBeginInfo begin_info = VkHelper::CommandBufferBeginInfo(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+	long long total_ns = 0;
+
+	// The first batch warms up the command pool so it already has the memory the rest of the batches need
+	for (uint32_t batch = 0; batch <= batches; batch++)
+	{
+		vkResetCommandPool(device, command_pool, 0);
+		vkBeginCommandBuffer(command_buffer, &begin_info);
+
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		for (uint32_t i = 0; i < calls; i++) record();
+		std::chrono::high_resolution_clock::time_point end = std::chrono::high_resolution_clock::now();
+
+		vkEndCommandBuffer(command_buffer);
+		if (batch > 0) total_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+	}
+
+	double per_call_ns = static_cast<double>(total_ns) / (static_cast<double>(calls) * batches);
+	std::cout << name << ": " << total_ns / 1000000.0 << "ms total, " << per_call_ns << "ns per call" << std::endl;
+	return per_call_ns;
+}
+
+// Same as TimeCommands for calls that are not recorded into a command buffer
+template <typename CallFunction>
+double TimeCalls(const char* name, uint32_t calls, uint32_t batches, CallFunction call)
+{
+	for (uint32_t i = 0; i < calls; i++) call();
+
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	for (uint32_t batch = 0; batch < batches; batch++)
+	{
+		for (uint32_t i = 0; i < calls; i++) call();
+	}
+	std::chrono::high_resolution_clock::time_point end = std::chrono::high_resolution_clock::now();
+
+	long long total_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+	double per_call_ns = static_cast<double>(total_ns) / (static_cast<double>(calls) * batches);
+	std::cout << name << ": " << total_ns / 1000000.0 << "ms total, " << per_call_ns << "ns per call" << std::endl;
+	return per_call_ns;
+}
+
+void PrintSaving(const char* name, double loader_ns, double dispatch_ns)
+{
+	std::cout << name << ": " << loader_ns - dispatch_ns << "ns saved per call (" << (1.0 - dispatch_ns / loader_ns) * 100.0
+		<< "%)" << std::endl << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t calls = argc > 1 ? static_cast<uint32_t>(atoi(argv[1])) : 10000;
+	uint32_t batches = argc > 2 ? static_cast<uint32_t>(atoi(argv[2])) : 100;
+	assert(calls > 0 && batches > 0);
+
+
+	// No validation layers, they sit between the loader and the driver on both paths and would be most of what we time
+	instance = VkHelper::CreateInstance(
+		nullptr, 0,
+		nullptr, 0,
+		"Dispatch Benchmark", VK_MAKE_VERSION(1, 0, 0),
+		"Vulkan", VK_MAKE_VERSION(1, 0, 0),
+		VK_MAKE_VERSION(1, 1, 108));
+
+	bool foundPhysicalDevice = VkHelper::GetPhysicalDevice(
+		instance,
+		physical_device,                                       // Return of physical device instance
+		physical_device_properties,                            // Physical device properties
+		physical_devices_queue_family,                         // Physical device queue family
+		physical_device_features,                              // Physical device features
+		physical_device_mem_properties,                        // Physical device memory properties
+		nullptr,                                               // No device extensions are needed
+		0,                                                     // Extension count
+		VK_QUEUE_COMPUTE_BIT                                   // What queues we need to be available
+	);
+	assert(foundPhysicalDevice);
+
+	static const float queue_priority = 1.0f;
+	VkDeviceQueueCreateInfo queue_create_info = VkHelper::DeviceQueueCreateInfo(
+		&queue_priority,
+		1,
+		physical_devices_queue_family
+	);
+
+	// CreateDevice loads the devices dispatch table as well
+	device = VkHelper::CreateDevice(
+		physical_device,
+		&queue_create_info,
+		1,
+		physical_device_features,
+		nullptr,
+		0
+	);
+	const VkHelper::DeviceDispatch& dispatch = VkHelper::GetDeviceDispatch(device);
+
+	std::cout << "Device: " << physical_device_properties.deviceName << std::endl;
+	std::cout << batches << " batches of " << calls << " calls" << std::endl << std::endl;
+
+
+	// The commands are recorded but never submitted, so the buffer doesn't need any particular memory
+	VkBuffer buffer;
+	VkDeviceMemory buffer_memory;
+	bool buffer_created = VkHelper::CreateBuffer(
+		device,
+		physical_device_mem_properties,
+		buffer,
+		buffer_memory,
+		64 * 1024,
+		VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_SHARING_MODE_EXCLUSIVE,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+	);
+	assert(buffer_created);
+
+	command_pool = VkHelper::CreateCommandPool(
+		device,
+		physical_devices_queue_family,
+		0
+	);
+
+	VkCommandBufferAllocateInfo command_buffer_allocate_info = VkHelper::CommandBufferAllocateInfo(
+		command_pool,
+		1
+	);
+	VkResult allocate_result = vkAllocateCommandBuffers(
+		device,
+		&command_buffer_allocate_info,
+		&command_buffer
+	);
+	assert(allocate_result == VK_SUCCESS);
+
+	VkFenceCreateInfo fence_info = {};
+	fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+	VkFence fence;
+	VkResult fence_result = vkCreateFence(
+		device,
+		&fence_info,
+		nullptr,
+		&fence
+	);
+	assert(fence_result == VK_SUCCESS);
+
+
+	double loader_fill_ns = TimeCommands("vkCmdFillBuffer through the loader", calls, batches, [&]()
+	{
+		vkCmdFillBuffer(command_buffer, buffer, 0, 256, 0);
+	});
+
+	double dispatch_fill_ns = TimeCommands("vkCmdFillBuffer through the dispatch table", calls, batches, [&]()
+	{
+		dispatch.vkCmdFillBuffer(command_buffer, buffer, 0, 256, 0);
+	});
+
+	PrintSaving("vkCmdFillBuffer", loader_fill_ns, dispatch_fill_ns);
+
+	double loader_fence_ns = TimeCalls("vkGetFenceStatus through the loader", calls, batches, [&]()
+	{
+		vkGetFenceStatus(device, fence);
+	});
+
+	double dispatch_fence_ns = TimeCalls("vkGetFenceStatus through the dispatch table", calls, batches, [&]()
+	{
+		dispatch.vkGetFenceStatus(device, fence);
+	});
+
+	PrintSaving("vkGetFenceStatus", loader_fence_ns, dispatch_fence_ns);
+
+
+	vkDestroyFence(
+		device,
+		fence,
+		nullptr
+	);
+
+	vkDestroyCommandPool(
+		device,
+		command_pool,
+		nullptr
+	);
+
+	vkDestroyBuffer(
+		device,
+		buffer,
+		nullptr
+	);
+
+	vkFreeMemory(
+		device,
+		buffer_memory,
+		nullptr
+	);
+
+	// The device is going away, free its dispatch table so a later device given the same handle loads its own
+	VkHelper::UnregisterDeviceDispatch(device);
+
+	vkDestroyDevice(
+		device,
+		nullptr
+	);
+
+	vkDestroyInstance(
+		instance,
+		nullptr
+	);
+
+	return 0;
+}
@@ -0,0 +1,545 @@
+// Offline texture encoder. Loads a png, builds its mip chain and writes it out as a block compressed KTX2 file
+// that the samples can copy straight to the GPU without decoding anything at startup.
+//
+// Usage: KtxEncoder <input.png> <output.ktx2> <bc1|bc3|bc4|bc5|bc7|rgba8> [--srgb] [--no-mips]
+//        KtxEncoder --pack <ao.png> <roughness.png> <metallic.png> <height.png> <output.ktx2> <bc7|rgba8> [--no-mips]
+//
+// Pack mode puts the greyscale PBR maps of a material into the R, G, B and A channels of one texture, pass - for a
+// map the material doesn't have. BC7 keeps the four channels apart far better than BC1 or BC3 would
+//
+//   bc1   RGB, 4 bits per texel. Good for color maps without alpha
+//   bc3   RGBA, 8 bits per texel. Color with smooth alpha
+//   bc4   R, 4 bits per texel. Single channel maps like roughness, metallic, ao and height
+//   bc5   RG, 8 bits per texel. Tangent space normal maps, the shader rebuilds Z
+//   bc7   RGBA, 8 bits per texel. Highest quality color
+//   rgba8 Uncompressed with pre-built mips, for GPUs without BC support
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+
+#include <lodepng.h>
+#include <vulkan/vulkan.h>
+
+#include <VkKtx.hpp>
+#include <VkTextureLoader.hpp>
+
+struct Image
+{
+	uint32_t width;
+	uint32_t height;
+	std::vector<unsigned char> pixels;        // RGBA8
+};
+
+// Box filter a level down to the next one. Odd sizes reuse the last row or column
+Image Downsample(const Image& source)
+{
+	Image destination;
+	destination.width = source.width > 1 ? source.width / 2 : 1;
+	destination.height = source.height > 1 ? source.height / 2 : 1;
+	destination.pixels.resize(destination.width * destination.height * 4);
+
+	for (uint32_t y = 0; y < destination.height; y++)
+	{
+		const uint32_t y0 = y * 2 < source.height ? y * 2 : source.height - 1;
+		const uint32_t y1 = y * 2 + 1 < source.height ? y * 2 + 1 : source.height - 1;
+		for (uint32_t x = 0; x < destination.width; x++)
+		{
+			const uint32_t x0 = x * 2 < source.width ? x * 2 : source.width - 1;
+			const uint32_t x1 = x * 2 + 1 < source.width ? x * 2 + 1 : source.width - 1;
+			for (uint32_t channel = 0; channel < 4; channel++)
+			{
+				const uint32_t sum =
+					source.pixels[(y0 * source.width + x0) * 4 + channel] +
+					source.pixels[(y0 * source.width + x1) * 4 + channel] +
+					source.pixels[(y1 * source.width + x0) * 4 + channel] +
+					source.pixels[(y1 * source.width + x1) * 4 + channel];
+				destination.pixels[(y * destination.width + x) * 4 + channel] = static_cast<unsigned char>((sum + 2) / 4);
+			}
+		}
+	}
+	return destination;
+}
+
+// Grab a 4x4 block of texels, texels past the edge of the image repeat the edge
+void FetchBlock(const Image& image, uint32_t block_x, uint32_t block_y, unsigned char block[16][4])
+{
+	for (uint32_t y = 0; y < 4; y++)
+	{
+		uint32_t image_y = block_y * 4 + y;
+		if (image_y >= image.height) image_y = image.height - 1;
+		for (uint32_t x = 0; x < 4; x++)
+		{
+			uint32_t image_x = block_x * 4 + x;
+			if (image_x >= image.width) image_x = image.width - 1;
+			memcpy(block[y * 4 + x], &image.pixels[(image_y * image.width + image_x) * 4], 4);
+		}
+	}
+}
+
+// Find the two ends of the line through the block that best fits its colors. The line follows the main axis
+// of the colors found with a few rounds of power iteration, the ends are the texels furthest along it
+void FitLine(const unsigned char block[16][4], uint32_t channels, float start[4], float end[4])
+{
+	float mean[4] = {};
+	for (uint32_t i = 0; i < 16; i++)
+		for (uint32_t c = 0; c < channels; c++)
+			mean[c] += block[i][c] / 16.0f;
+
+	float covariance[4][4] = {};
+	for (uint32_t i = 0; i < 16; i++)
+		for (uint32_t a = 0; a < channels; a++)
+			for (uint32_t b = 0; b < channels; b++)
+				covariance[a][b] += (block[i][a] - mean[a]) * (block[i][b] - mean[b]);
+
+	float axis[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	for (uint32_t iteration = 0; iteration < 8; iteration++)
+	{
+		float next[4] = {};
+		float length = 0.0f;
+		for (uint32_t a = 0; a < channels; a++)
+		{
+			for (uint32_t b = 0; b < channels; b++) next[a] += covariance[a][b] * axis[b];
+			length += next[a] * next[a];
+		}
+		// A flat block has no main axis, any direction will do
+		if (length < 1e-6f) break;
+		length = sqrtf(length);
+		for (uint32_t a = 0; a < channels; a++) axis[a] = next[a] / length;
+	}
+
+	float min_projection = 1e30f;
+	float max_projection = -1e30f;
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		float projection = 0.0f;
+		for (uint32_t c = 0; c < channels; c++) projection += (block[i][c] - mean[c]) * axis[c];
+		if (projection < min_projection) min_projection = projection;
+		if (projection > max_projection) max_projection = projection;
+	}
+
+	for (uint32_t c = 0; c < 4; c++)
+	{
+		start[c] = c < channels ? mean[c] + axis[c] * min_projection : 255.0f;
+		end[c] = c < channels ? mean[c] + axis[c] * max_projection : 255.0f;
+	}
+}
+
+uint32_t Clamp(float value, uint32_t max)
+{
+	if (value <= 0.0f) return 0;
+	uint32_t rounded = static_cast<uint32_t>(value + 0.5f);
+	return rounded > max ? max : rounded;
+}
+
+uint32_t ColorDistance(const unsigned char* a, const unsigned char* b, uint32_t channels)
+{
+	uint32_t distance = 0;
+	for (uint32_t c = 0; c < channels; c++)
+	{
+		int difference = static_cast<int>(a[c]) - static_cast<int>(b[c]);
+		distance += difference * difference;
+	}
+	return distance;
+}
+
+uint16_t To565(const float color[4])
+{
+	return static_cast<uint16_t>((Clamp(color[0] * 31.0f / 255.0f, 31) << 11) | (Clamp(color[1] * 63.0f / 255.0f, 63) << 5) | Clamp(color[2] * 31.0f / 255.0f, 31));
+}
+
+void From565(uint16_t color, unsigned char out[4])
+{
+	const uint32_t r = (color >> 11) & 31;
+	const uint32_t g = (color >> 5) & 63;
+	const uint32_t b = color & 31;
+	out[0] = static_cast<unsigned char>((r << 3) | (r >> 2));
+	out[1] = static_cast<unsigned char>((g << 2) | (g >> 4));
+	out[2] = static_cast<unsigned char>((b << 3) | (b >> 2));
+	out[3] = 255;
+}
+
+// 4 color BC1 block, also used for the color half of BC3
+void EncodeBC1(const unsigned char block[16][4], unsigned char* out)
+{
+	float start[4];
+	float end[4];
+	FitLine(block, 3, start, end);
+
+	uint16_t color0 = To565(end);
+	uint16_t color1 = To565(start);
+	// color0 > color1 picks the 4 color mode, equal endpoints are a single color block
+	if (color0 < color1)
+	{
+		uint16_t swap = color0;
+		color0 = color1;
+		color1 = swap;
+	}
+
+	unsigned char palette[4][4];
+	From565(color0, palette[0]);
+	From565(color1, palette[1]);
+	for (uint32_t c = 0; c < 3; c++)
+	{
+		palette[2][c] = static_cast<unsigned char>((2 * palette[0][c] + palette[1][c] + 1) / 3);
+		palette[3][c] = static_cast<unsigned char>((palette[0][c] + 2 * palette[1][c] + 1) / 3);
+	}
+
+	uint32_t indices = 0;
+	if (color0 != color1)
+	{
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			uint32_t best = 0;
+			uint32_t best_distance = ColorDistance(block[i], palette[0], 3);
+			for (uint32_t p = 1; p < 4; p++)
+			{
+				uint32_t distance = ColorDistance(block[i], palette[p], 3);
+				if (distance < best_distance)
+				{
+					best = p;
+					best_distance = distance;
+				}
+			}
+			indices |= best << (i * 2);
+		}
+	}
+
+	out[0] = static_cast<unsigned char>(color0 & 0xFF);
+	out[1] = static_cast<unsigned char>(color0 >> 8);
+	out[2] = static_cast<unsigned char>(color1 & 0xFF);
+	out[3] = static_cast<unsigned char>(color1 >> 8);
+	for (uint32_t i = 0; i < 4; i++) out[4 + i] = static_cast<unsigned char>(indices >> (i * 8));
+}
+
+// Single channel block with 8 interpolated values, used by BC3 alpha, BC4 and both halves of BC5
+void EncodeBC4(const unsigned char block[16][4], uint32_t channel, unsigned char* out)
+{
+	unsigned char min_value = 255;
+	unsigned char max_value = 0;
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		if (block[i][channel] < min_value) min_value = block[i][channel];
+		if (block[i][channel] > max_value) max_value = block[i][channel];
+	}
+
+	// value0 > value1 picks the 8 value mode
+	unsigned char palette[8];
+	palette[0] = max_value;
+	palette[1] = min_value;
+	for (uint32_t i = 1; i < 7; i++)
+	{
+		palette[i + 1] = static_cast<unsigned char>(((7 - i) * max_value + i * min_value + 3) / 7);
+	}
+
+	uint64_t indices = 0;
+	if (max_value != min_value)
+	{
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			uint32_t best = 0;
+			int best_distance = 256;
+			for (uint32_t p = 0; p < 8; p++)
+			{
+				int distance = abs(static_cast<int>(block[i][channel]) - static_cast<int>(palette[p]));
+				if (distance < best_distance)
+				{
+					best = p;
+					best_distance = distance;
+				}
+			}
+			indices |= static_cast<uint64_t>(best) << (i * 3);
+		}
+	}
+
+	out[0] = max_value;
+	out[1] = min_value;
+	for (uint32_t i = 0; i < 6; i++) out[2 + i] = static_cast<unsigned char>(indices >> (i * 8));
+}
+
+// Writes bits into a 128 bit block, lowest bit first
+struct BitWriter
+{
+	unsigned char* out;
+	uint32_t position;
+
+	void Write(uint32_t value, uint32_t bit_count)
+	{
+		for (uint32_t i = 0; i < bit_count; i++, position++)
+		{
+			if (value & (1u << i)) out[position / 8] |= static_cast<unsigned char>(1u << (position % 8));
+		}
+	}
+};
+
+// Pick the 7 bit endpoint and shared p-bit that land closest to the wanted color
+void QuantizeBC7Endpoint(const float color[4], uint32_t quantized[4], uint32_t& p_bit)
+{
+	float best_error = 1e30f;
+	for (uint32_t p = 0; p < 2; p++)
+	{
+		uint32_t candidate[4];
+		float error = 0.0f;
+		for (uint32_t c = 0; c < 4; c++)
+		{
+			candidate[c] = Clamp((color[c] - p) / 2.0f, 127);
+			float difference = static_cast<float>((candidate[c] << 1) | p) - color[c];
+			error += difference * difference;
+		}
+		if (error < best_error)
+		{
+			best_error = error;
+			p_bit = p;
+			memcpy(quantized, candidate, sizeof(candidate));
+		}
+	}
+}
+
+// BC7 mode 6, one subset with 7777.1 endpoints and 4 bit indices. It handles smooth color and alpha well
+// and is quick to search, the other modes would only be worth it for blocks with sharp edges
+void EncodeBC7(const unsigned char block[16][4], unsigned char* out)
+{
+	static const uint32_t weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	float start[4];
+	float end[4];
+	FitLine(block, 4, start, end);
+
+	uint32_t endpoints[2][4];
+	uint32_t p_bits[2];
+	QuantizeBC7Endpoint(start, endpoints[0], p_bits[0]);
+	QuantizeBC7Endpoint(end, endpoints[1], p_bits[1]);
+
+	unsigned char palette[16][4];
+	for (uint32_t p = 0; p < 16; p++)
+	{
+		for (uint32_t c = 0; c < 4; c++)
+		{
+			const uint32_t e0 = (endpoints[0][c] << 1) | p_bits[0];
+			const uint32_t e1 = (endpoints[1][c] << 1) | p_bits[1];
+			palette[p][c] = static_cast<unsigned char>(((64 - weights[p]) * e0 + weights[p] * e1 + 32) >> 6);
+		}
+	}
+
+	uint32_t indices[16];
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		uint32_t best = 0;
+		uint32_t best_distance = ColorDistance(block[i], palette[0], 4);
+		for (uint32_t p = 1; p < 16; p++)
+		{
+			uint32_t distance = ColorDistance(block[i], palette[p], 4);
+			if (distance < best_distance)
+			{
+				best = p;
+				best_distance = distance;
+			}
+		}
+		indices[i] = best;
+	}
+
+	// The top bit of the first index isn't stored, so it must be 0. Swapping the endpoints flips every index
+	if (indices[0] & 8)
+	{
+		for (uint32_t c = 0; c < 4; c++)
+		{
+			uint32_t swap = endpoints[0][c];
+			endpoints[0][c] = endpoints[1][c];
+			endpoints[1][c] = swap;
+		}
+		uint32_t swap = p_bits[0];
+		p_bits[0] = p_bits[1];
+		p_bits[1] = swap;
+		for (uint32_t i = 0; i < 16; i++) indices[i] = 15 - indices[i];
+	}
+
+	memset(out, 0, 16);
+	BitWriter writer = { out, 0 };
+	writer.Write(1 << 6, 7);                      // Mode 6
+	for (uint32_t c = 0; c < 4; c++)
+	{
+		writer.Write(endpoints[0][c], 7);
+		writer.Write(endpoints[1][c], 7);
+	}
+	writer.Write(p_bits[0], 1);
+	writer.Write(p_bits[1], 1);
+	writer.Write(indices[0], 3);
+	for (uint32_t i = 1; i < 16; i++) writer.Write(indices[i], 4);
+}
+
+std::vector<unsigned char> EncodeLevel(const Image& image, VkFormat format)
+{
+	std::vector<unsigned char> encoded(static_cast<size_t>(VkHelper::KtxLevelSize(format, image.width, image.height)));
+
+	if (!VkHelper::IsBlockCompressedFormat(format))
+	{
+		memcpy(encoded.data(), image.pixels.data(), encoded.size());
+		return encoded;
+	}
+
+	const uint32_t block_size = VkHelper::KtxFormatBlockSize(format);
+	const uint32_t blocks_x = (image.width + 3) / 4;
+	const uint32_t blocks_y = (image.height + 3) / 4;
+	unsigned char block[16][4];
+
+	for (uint32_t block_y = 0; block_y < blocks_y; block_y++)
+	{
+		for (uint32_t block_x = 0; block_x < blocks_x; block_x++)
+		{
+			FetchBlock(image, block_x, block_y, block);
+			unsigned char* out = &encoded[(block_y * blocks_x + block_x) * block_size];
+
+			switch (format)
+			{
+			case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+			case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+				EncodeBC1(block, out);
+				break;
+			case VK_FORMAT_BC3_UNORM_BLOCK:
+			case VK_FORMAT_BC3_SRGB_BLOCK:
+				EncodeBC4(block, 3, out);
+				EncodeBC1(block, out + 8);
+				break;
+			case VK_FORMAT_BC4_UNORM_BLOCK:
+				EncodeBC4(block, 0, out);
+				break;
+			case VK_FORMAT_BC5_UNORM_BLOCK:
+				EncodeBC4(block, 0, out);
+				EncodeBC4(block, 1, out + 8);
+				break;
+			case VK_FORMAT_BC7_UNORM_BLOCK:
+			case VK_FORMAT_BC7_SRGB_BLOCK:
+				EncodeBC7(block, out);
+				break;
+			default:
+				assert(0 && "Unsupported format");
+				break;
+			}
+		}
+	}
+	return encoded;
+}
+
+VkFormat ParseFormat(const std::string& name, bool srgb)
+{
+	if (name == "bc1") return srgb ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+	if (name == "bc3") return srgb ? VK_FORMAT_BC3_SRGB_BLOCK : VK_FORMAT_BC3_UNORM_BLOCK;
+	if (name == "bc4") return VK_FORMAT_BC4_UNORM_BLOCK;
+	if (name == "bc5") return VK_FORMAT_BC5_UNORM_BLOCK;
+	if (name == "bc7") return srgb ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
+	if (name == "rgba8") return srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+	return VK_FORMAT_UNDEFINED;
+}
+
+int main(int argc, char **argv)
+{
+	// In pack mode four greyscale maps are packed into the channels of one texture before encoding
+	const bool pack = argc > 1 && strcmp(argv[1], "--pack") == 0;
+	const int required_arguments = pack ? 8 : 4;
+
+	if (argc < required_arguments)
+	{
+		std::cout << "Usage: KtxEncoder <input.png> <output.ktx2> <bc1|bc3|bc4|bc5|bc7|rgba8> [--srgb] [--no-mips]" << std::endl;
+		std::cout << "       KtxEncoder --pack <ao.png> <roughness.png> <metallic.png> <height.png> <output.ktx2> <bc7|rgba8> [--no-mips]" << std::endl;
+		std::cout << "       Pass - in place of a map the material doesn't have" << std::endl;
+		return 1;
+	}
+
+	const char* output_path = argv[required_arguments - 2];
+	const char* format_name = argv[required_arguments - 1];
+
+	bool srgb = false;
+	bool mips = true;
+	for (int i = required_arguments; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--srgb") == 0) srgb = true;
+		else if (strcmp(argv[i], "--no-mips") == 0) mips = false;
+	}
+
+	const VkFormat format = ParseFormat(format_name, srgb);
+	if (format == VK_FORMAT_UNDEFINED)
+	{
+		std::cout << "Unknown format " << format_name << std::endl;
+		return 1;
+	}
+
+	std::chrono::high_resolution_clock::time_point encode_start = std::chrono::high_resolution_clock::now();
+
+	Image image;
+	if (pack)
+	{
+		// AO, roughness, metallic and height go into R, G, B and A. Missing maps get a value that leaves the surface unchanged
+		const unsigned char default_values[4] = { 255, 255, 0, 0 };
+		VkHelper::ChannelSource sources[4];
+		for (uint32_t channel = 0; channel < 4; channel++)
+		{
+			if (strcmp(argv[2 + channel], "-") != 0) sources[channel].path = argv[2 + channel];
+			sources[channel].channel = 0;                                   // Greyscale pngs decode with the value in every color channel
+			sources[channel].default_value = default_values[channel];
+		}
+
+		VkHelper::DecodedImage packed;
+		if (!VkHelper::DecodePackedImage(sources, 0, packed))
+		{
+			std::cout << "Failed to pack " << packed.path << ": " << (packed.error ? lodepng_error_text(packed.error) : "the maps are not all the same size") << std::endl;
+			return 1;
+		}
+		image.width = packed.width;
+		image.height = packed.height;
+		image.pixels.swap(packed.pixels);
+	}
+	else
+	{
+		unsigned error = lodepng::decode(
+			image.pixels,
+			image.width,
+			image.height,
+			argv[1]
+		);
+		if (error)
+		{
+			std::cout << argv[1] << ": " << lodepng_error_text(error) << std::endl;
+			return 1;
+		}
+	}
+
+	const uint32_t width = image.width;
+	const uint32_t height = image.height;
+
+	// Encode every level down to 1x1
+	std::vector<std::vector<unsigned char>> levels;
+	levels.push_back(EncodeLevel(image, format));
+	while (mips && (image.width > 1 || image.height > 1))
+	{
+		image = Downsample(image);
+		levels.push_back(EncodeLevel(image, format));
+	}
+
+	std::vector<const void*> level_data;
+	size_t encoded_size = 0;
+	for (const std::vector<unsigned char>& level : levels)
+	{
+		level_data.push_back(level.data());
+		encoded_size += level.size();
+	}
+
+	if (!VkHelper::WriteKtx2(output_path, format, width, height, static_cast<uint32_t>(levels.size()), level_data.data()))
+	{
+		std::cout << "Failed to write " << output_path << std::endl;
+		return 1;
+	}
+
+	std::chrono::high_resolution_clock::time_point encode_end = std::chrono::high_resolution_clock::now();
+
+	std::cout << output_path << ": " << width << "x" << height << " " << levels.size() << " levels, " << encoded_size / 1024 << "KB ("
+		<< encoded_size * 100 / (static_cast<size_t>(width) * height * 4) << "% of RGBA8) in "
+		<< std::chrono::duration_cast<std::chrono::milliseconds>(encode_end - encode_start).count() << "ms" << std::endl;
+
+	return 0;
+}
@@ -0,0 +1,624 @@
+// Benchmark runner for the samples. Every sample that can run headless is launched with --headless, renders a number
+// of warm up frames and then the measured frames, and writes back its startup phases, CPU frame times, GPU scope
+// timings and peak device memory. The samples that run once and exit are launched with --no-validation a number of
+// times each run, and the runner times the whole process. The results of every sample are gathered into one JSON file.
+// Only the offscreen images are used, so it runs on a machine with no GPU through a software driver such as Mesa's lavapipe.
+//
+// Usage: SampleBenchmark [--frames N] [--warmup N] [--runs N] [--out results.json]
+//        SampleBenchmark --compare <baseline.json> <results.json> [--threshold percent]
+//
+// Compare mode lists the change in every metric and flags a slowdown when the mean got worse by more than the
+// threshold (5% by default) and a one sided Welch's t-test says the difference is significant at the 99% level.
+// It exits with 1 if anything was flagged, so it can fail a CI job
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+
+// CMake points these at the built samples, they are run from their own directory so their data paths resolve
+#ifndef CAMERA_SAMPLE_PATH
+#define CAMERA_SAMPLE_PATH "11-Camera"
+#endif
+#ifndef INDIRECT_DRAWING_SAMPLE_PATH
+#define INDIRECT_DRAWING_SAMPLE_PATH "0-IndirectDrawing"
+#endif
+#ifndef INSTANCE_SAMPLE_PATH
+#define INSTANCE_SAMPLE_PATH "0-Instance"
+#endif
+#ifndef PHYSICAL_DEVICE_SAMPLE_PATH
+#define PHYSICAL_DEVICE_SAMPLE_PATH "1-PhysicalDevice"
+#endif
+#ifndef DEVICE_SAMPLE_PATH
+#define DEVICE_SAMPLE_PATH "2-Device"
+#endif
+#ifndef COMMAND_POOLS_SAMPLE_PATH
+#define COMMAND_POOLS_SAMPLE_PATH "3-CommandPools"
+#endif
+#ifndef BUFFERS_SAMPLE_PATH
+#define BUFFERS_SAMPLE_PATH "4-Buffers"
+#endif
+#ifndef DESCRIPTORS_SAMPLE_PATH
+#define DESCRIPTORS_SAMPLE_PATH "5-Descriptors"
+#endif
+#ifndef COMPUTE_PIPELINE_SAMPLE_PATH
+#define COMPUTE_PIPELINE_SAMPLE_PATH "1-ComputePipeline"
+#endif
+
+// How many times a sample that runs once and exits is launched in each run, a single launch is too short to compare
+const uint32_t launches_per_run = 10;
+
+struct SSample
+{
+	const char* name;
+	// Empty for samples that can't be benchmarked
+	const char* path;
+	// Why the sample is skipped
+	const char* reason;
+	// The sample does its work once and exits rather than rendering frames, so the runner times the whole process
+	bool run_once;
+};
+
+// Every sample target. The samples that render through the frame loop run headless, the ones that run once and exit are
+// timed from start to finish, and the rest are listed so the results show what was not measured and why
+const SSample samples[] = {
+	{ "0-Instance",              INSTANCE_SAMPLE_PATH, "", true },
+	{ "1-PhysicalDevice",        PHYSICAL_DEVICE_SAMPLE_PATH, "", true },
+	{ "2-Device",                DEVICE_SAMPLE_PATH, "", true },
+	{ "3-CommandPools",          COMMAND_POOLS_SAMPLE_PATH, "", true },
+	{ "4-Buffers",               BUFFERS_SAMPLE_PATH, "", true },
+	{ "5-Descriptors",           DESCRIPTORS_SAMPLE_PATH, "", true },
+	{ "6-Swapchain",             "", "needs a window, it only creates a swapchain", false },
+	{ "7-Renderpass",            "", "needs a window, it only creates a render pass", false },
+	{ "8-Present",               "", "runs headless but records no benchmark results", false },
+	{ "9-GraphicsPipeline",      "", "runs headless but records no benchmark results", false },
+	{ "10-Texturing",            "", "runs headless but records no benchmark results", false },
+	{ "11-Camera",               CAMERA_SAMPLE_PATH, "", false },
+	{ "0-IndirectDrawing",       INDIRECT_DRAWING_SAMPLE_PATH, "", false },
+	{ "1-ComputePipeline",       COMPUTE_PIPELINE_SAMPLE_PATH, "", true },
+	{ "2-ComputeParticleSystem", "", "runs headless but records no benchmark results", false },
+	{ "3-AccelerationStructure", "", "needs VK_NV_ray_tracing", false },
+	{ "4-RaytracingPipeline",    "", "needs VK_NV_ray_tracing", false },
+};
+const uint32_t sample_count = sizeof(samples) / sizeof(samples[0]);
+
+
+///////////////////////
+///// JSON Reader /////
+///////////////////////
+
+// Just enough JSON to read back the files the samples and this tool write
+struct JsonValue
+{
+	enum Type { Null, Bool, Number, String, Array, Object };
+	Type type = Null;
+	bool boolean = false;
+	double number = 0.0;
+	std::string string;
+	std::vector<JsonValue> array;
+	std::vector<std::pair<std::string, JsonValue>> object;
+
+	const JsonValue* Find(const char* key) const
+	{
+		for (const std::pair<std::string, JsonValue>& member : object)
+		{
+			if (member.first == key) return &member.second;
+		}
+		return nullptr;
+	}
+};
+
+void SkipWhitespace(const char*& c)
+{
+	while (*c == ' ' || *c == '\t' || *c == '\n' || *c == '\r') c++;
+}
+
+bool ParseJson(const char*& c, JsonValue& value);
+
+bool ParseJsonString(const char*& c, std::string& string)
+{
+	if (*c != '"') return false;
+	c++;
+	while (*c != '"')
+	{
+		if (*c == '\0') return false;
+		if (*c == '\\')
+		{
+			c++;
+			if (*c == '\0') return false;
+			if (*c == 'n') string += '\n';
+			else if (*c == 't') string += '\t';
+			else string += *c;
+			c++;
+			continue;
+		}
+		string += *c++;
+	}
+	c++;
+	return true;
+}
+
+bool ParseJson(const char*& c, JsonValue& value)
+{
+	SkipWhitespace(c);
+	if (*c == '{')
+	{
+		value.type = JsonValue::Object;
+		c++;
+		SkipWhitespace(c);
+		if (*c == '}') { c++; return true; }
+		while (true)
+		{
+			std::pair<std::string, JsonValue> member;
+			SkipWhitespace(c);
+			if (!ParseJsonString(c, member.first)) return false;
+			SkipWhitespace(c);
+			if (*c++ != ':') return false;
+			if (!ParseJson(c, member.second)) return false;
+			value.object.push_back(member);
+			SkipWhitespace(c);
+			if (*c == ',') { c++; continue; }
+			if (*c == '}') { c++; return true; }
+			return false;
+		}
+	}
+	if (*c == '[')
+	{
+		value.type = JsonValue::Array;
+		c++;
+		SkipWhitespace(c);
+		if (*c == ']') { c++; return true; }
+		while (true)
+		{
+			value.array.push_back(JsonValue());
+			if (!ParseJson(c, value.array.back())) return false;
+			SkipWhitespace(c);
+			if (*c == ',') { c++; continue; }
+			if (*c == ']') { c++; return true; }
+			return false;
+		}
+	}
+	if (*c == '"')
+	{
+		value.type = JsonValue::String;
+		return ParseJsonString(c, value.string);
+	}
+	if (strncmp(c, "true", 4) == 0) { value.type = JsonValue::Bool; value.boolean = true; c += 4; return true; }
+	if (strncmp(c, "false", 5) == 0) { value.type = JsonValue::Bool; c += 5; return true; }
+	if (strncmp(c, "null", 4) == 0) { value.type = JsonValue::Null; c += 4; return true; }
+
+	char* end = nullptr;
+	value.number = strtod(c, &end);
+	if (end == c) return false;
+	value.type = JsonValue::Number;
+	c = end;
+	return true;
+}
+
+bool ReadFile(const std::string& path, std::string& contents)
+{
+	std::ifstream file(path.c_str());
+	if (!file.is_open()) return false;
+	std::stringstream stream;
+	stream << file.rdbuf();
+	contents = stream.str();
+	return true;
+}
+
+bool LoadJson(const std::string& path, JsonValue& value)
+{
+	std::string contents;
+	if (!ReadFile(path, contents)) return false;
+	const char* c = contents.c_str();
+	return ParseJson(c, value);
+}
+
+
+//////////////////////////
+///// Running Samples /////
+//////////////////////////
+
+std::string DirectoryOf(const std::string& path)
+{
+	size_t slash = path.find_last_of("/\\");
+	return slash == std::string::npos ? "." : path.substr(0, slash);
+}
+
+// Run the sample from its own directory, with its output going to a log next to it so the results stay readable.
+// Returns the path of the results file the sample wrote, or an empty string if it failed
+std::string RunSample(const SSample& sample, uint32_t frames, uint32_t warmup, uint32_t run)
+{
+	const std::string directory = DirectoryOf(sample.path);
+	const std::string results_name = std::string(sample.name) + ".benchmark" + std::to_string(run) + ".json";
+	const std::string log_name = std::string(sample.name) + ".benchmark" + std::to_string(run) + ".log";
+
+	// Leave nothing from an earlier run that could be mistaken for this ones results
+	const std::string results_path = directory + "/" + results_name;
+	remove(results_path.c_str());
+
+#ifdef _WIN32
+	std::string command = "cd /d \"" + directory + "\" && \"" + sample.path + "\"";
+#else
+	std::string command = "cd \"" + directory + "\" && \"" + sample.path + "\"";
+#endif
+	command += " --headless " + std::to_string(warmup + frames) + " --warmup " + std::to_string(warmup) +
+		" --benchmark " + results_name + " > " + log_name + " 2>&1";
+
+	int exit_code = system(command.c_str());
+	if (exit_code != 0)
+	{
+		std::cout << "  " << sample.name << " exited with " << exit_code << ", see " << directory << "/" << log_name << std::endl;
+		return "";
+	}
+	return results_path;
+}
+
+// Launch a sample that runs once and exits a number of times without the validation layers, timing each launch from
+// start to finish. The runner writes the results file itself in the same form as the samples do
+std::string RunOnceSample(const SSample& sample, uint32_t run)
+{
+	const std::string directory = DirectoryOf(sample.path);
+	const std::string results_path = directory + "/" + sample.name + ".benchmark" + std::to_string(run) + ".json";
+	const std::string log_name = std::string(sample.name) + ".benchmark" + std::to_string(run) + ".log";
+	remove(results_path.c_str());
+
+#ifdef _WIN32
+	std::string command = "cd /d \"" + directory + "\" && \"" + sample.path + "\"";
+#else
+	std::string command = "cd \"" + directory + "\" && \"" + sample.path + "\"";
+#endif
+	command += " --no-validation > " + log_name + " 2>&1";
+
+	std::vector<double> launch_ms;
+	for (uint32_t launch = 0; launch < launches_per_run; launch++)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		int exit_code = system(command.c_str());
+		std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+		if (exit_code != 0)
+		{
+			std::cout << "  " << sample.name << " exited with " << exit_code << ", see " << directory << "/" << log_name << std::endl;
+			return "";
+		}
+		launch_ms.push_back(std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000.0);
+	}
+
+	std::ofstream results(results_path.c_str(), std::ios::trunc);
+	if (!results.is_open()) return "";
+
+	double total_ms = 0.0;
+	for (double ms : launch_ms) total_ms += ms;
+	results << "{\"sample\":\"" << sample.name << "\",\"process_ms\":{\"average\":" << total_ms / launch_ms.size() << ",\"samples\":[";
+	for (size_t i = 0; i < launch_ms.size(); i++)
+	{
+		if (i > 0) results << ",";
+		results << launch_ms[i];
+	}
+	results << "]}}";
+	return results.good() ? results_path : "";
+}
+
+void PrintRunSummary(const JsonValue& results)
+{
+	const JsonValue* cpu = results.Find("cpu_frame_ms");
+	if (cpu != nullptr && cpu->Find("p95") != nullptr)
+	{
+		std::cout << "  CPU frame: " << cpu->Find("average")->number << "ms average, " << cpu->Find("p95")->number << "ms p95" << std::endl;
+	}
+	const JsonValue* gpu = results.Find("gpu_ms");
+	if (gpu != nullptr)
+	{
+		for (const JsonValue& scope : gpu->array)
+		{
+			std::cout << "  GPU " << scope.Find("name")->string << ": " << scope.Find("average")->number << "ms average" << std::endl;
+		}
+	}
+	const JsonValue* startup = results.Find("startup_ms");
+	if (startup != nullptr)
+	{
+		double startup_ms = 0.0;
+		for (const JsonValue& phase : startup->array) startup_ms += phase.Find("ms")->number;
+		std::cout << "  Startup: " << startup_ms << "ms" << std::endl;
+	}
+	const JsonValue* memory = results.Find("peak_device_memory_bytes");
+	if (memory != nullptr && memory->type == JsonValue::Number)
+	{
+		std::cout << "  Peak device memory: " << memory->number / (1024.0 * 1024.0) << "MB" << std::endl;
+	}
+	const JsonValue* process = results.Find("process_ms");
+	if (process != nullptr && process->Find("average") != nullptr)
+	{
+		std::cout << "  Process: " << process->Find("average")->number << "ms average over " << launches_per_run << " launches" << std::endl;
+	}
+}
+
+int RunBenchmarks(uint32_t frames, uint32_t warmup, uint32_t runs, const std::string& output_path)
+{
+	std::ofstream output(output_path.c_str(), std::ios::trunc);
+	if (!output.is_open())
+	{
+		std::cout << "Unable to open " << output_path << std::endl;
+		return 1;
+	}
+
+	std::cout << frames << " measured frames after " << warmup << " warm up frames, " << runs << " runs of each sample" << std::endl;
+
+	output << "{\"frames\":" << frames << ",\"warmup\":" << warmup << ",\"runs\":" << runs << ",\"samples\":[";
+	bool any_failed = false;
+	for (uint32_t i = 0; i < sample_count; i++)
+	{
+		const SSample& sample = samples[i];
+		if (i > 0) output << ",";
+		output << "\n{\"name\":\"" << sample.name << "\",";
+
+		if (sample.path[0] == '\0')
+		{
+			std::cout << sample.name << ": skipped, " << sample.reason << std::endl;
+			output << "\"status\":\"skipped\",\"reason\":\"" << sample.reason << "\"}";
+			continue;
+		}
+
+		std::cout << sample.name << std::endl;
+		std::vector<std::string> run_results;
+		for (uint32_t run = 0; run < runs; run++)
+		{
+			std::string results_path = sample.run_once ? RunOnceSample(sample, run) : RunSample(sample, frames, warmup, run);
+			std::string results;
+			JsonValue parsed;
+			if (results_path.empty() || !ReadFile(results_path, results) || !LoadJson(results_path, parsed))
+			{
+				run_results.clear();
+				break;
+			}
+			PrintRunSummary(parsed);
+			run_results.push_back(results);
+		}
+
+		if (run_results.empty())
+		{
+			any_failed = true;
+			output << "\"status\":\"failed\"}";
+			continue;
+		}
+
+		// The samples results are already JSON, so they are copied in as they are
+		output << "\"status\":\"ok\",\"runs\":[";
+		for (size_t run = 0; run < run_results.size(); run++)
+		{
+			if (run > 0) output << ",";
+			output << "\n" << run_results[run];
+		}
+		output << "]}";
+	}
+	output << "\n]}\n";
+
+	std::cout << "Results written to " << output_path << std::endl;
+	return any_failed ? 1 : 0;
+}
+
+
+/////////////////////
+///// Comparing /////
+/////////////////////
+
+// Every measurement of one metric of one sample, across all of its runs
+struct SMetric
+{
+	std::string name;
+	std::vector<double> samples;
+	// Metrics that don't vary from run to run, like memory, are compared on the threshold alone
+	bool exact = false;
+};
+
+SMetric& FindMetric(std::vector<SMetric>& metrics, const std::string& name, bool exact)
+{
+	for (SMetric& metric : metrics)
+	{
+		if (metric.name == name) return metric;
+	}
+	metrics.push_back(SMetric());
+	metrics.back().name = name;
+	metrics.back().exact = exact;
+	return metrics.back();
+}
+
+std::vector<SMetric> GatherMetrics(const JsonValue& sample)
+{
+	std::vector<SMetric> metrics;
+	const JsonValue* runs = sample.Find("runs");
+	if (runs == nullptr) return metrics;
+
+	for (const JsonValue& run : runs->array)
+	{
+		const JsonValue* cpu = run.Find("cpu_frame_ms");
+		if (cpu != nullptr && cpu->Find("samples") != nullptr)
+		{
+			SMetric& metric = FindMetric(metrics, "CPU frame", false);
+			for (const JsonValue& ms : cpu->Find("samples")->array) metric.samples.push_back(ms.number);
+		}
+
+		const JsonValue* gpu = run.Find("gpu_ms");
+		if (gpu != nullptr)
+		{
+			for (const JsonValue& scope : gpu->array)
+			{
+				SMetric& metric = FindMetric(metrics, "GPU " + scope.Find("name")->string, false);
+				for (const JsonValue& ms : scope.Find("samples")->array) metric.samples.push_back(ms.number);
+			}
+		}
+
+		// One measurement of each phase per run, so these need several runs before they can be tested
+		const JsonValue* startup = run.Find("startup_ms");
+		if (startup != nullptr)
+		{
+			double startup_ms = 0.0;
+			for (const JsonValue& phase : startup->array)
+			{
+				FindMetric(metrics, "Startup " + phase.Find("name")->string, false).samples.push_back(phase.Find("ms")->number);
+				startup_ms += phase.Find("ms")->number;
+			}
+			FindMetric(metrics, "Startup total", false).samples.push_back(startup_ms);
+		}
+
+		const JsonValue* memory = run.Find("peak_device_memory_bytes");
+		if (memory != nullptr && memory->type == JsonValue::Number)
+		{
+			FindMetric(metrics, "Peak device memory", true).samples.push_back(memory->number);
+		}
+
+		const JsonValue* process = run.Find("process_ms");
+		if (process != nullptr && process->Find("samples") != nullptr)
+		{
+			SMetric& metric = FindMetric(metrics, "Process", false);
+			for (const JsonValue& ms : process->Find("samples")->array) metric.samples.push_back(ms.number);
+		}
+	}
+	return metrics;
+}
+
+void MeanAndVariance(const std::vector<double>& values, double& mean, double& variance)
+{
+	mean = 0.0;
+	for (double value : values) mean += value;
+	mean /= values.size();
+
+	variance = 0.0;
+	for (double value : values) variance += (value - mean) * (value - mean);
+	variance = values.size() > 1 ? variance / (values.size() - 1) : 0.0;
+}
+
+// One sided 99% critical values of Student's t distribution, anything between two entries uses the lower degrees of
+// freedom so the test stays on the safe side
+double CriticalT(double degrees_of_freedom)
+{
+	static const double table[][2] = {
+		{ 1, 31.821 }, { 2, 6.965 }, { 3, 4.541 }, { 4, 3.747 }, { 5, 3.365 }, { 6, 3.143 }, { 7, 2.998 }, { 8, 2.896 },
+		{ 9, 2.821 }, { 10, 2.764 }, { 12, 2.681 }, { 15, 2.602 }, { 20, 2.528 }, { 30, 2.457 }, { 60, 2.390 }, { 120, 2.358 }
+	};
+	double critical = table[0][1];
+	for (const auto& entry : table)
+	{
+		if (degrees_of_freedom >= entry[0]) critical = entry[1];
+	}
+	return degrees_of_freedom >= 1000 ? 2.326 : critical;
+}
+
+// Welch's t-test, as the two runs don't have to have the same variance. Frame times are not fully independent of
+// each other, which is why a slowdown also has to be over the threshold to be flagged
+bool SignificantlySlower(const std::vector<double>& baseline, const std::vector<double>& current)
+{
+	if (baseline.size() < 2 || current.size() < 2) return false;
+
+	double baseline_mean, baseline_variance, current_mean, current_variance;
+	MeanAndVariance(baseline, baseline_mean, baseline_variance);
+	MeanAndVariance(current, current_mean, current_variance);
+
+	double baseline_error = baseline_variance / baseline.size();
+	double current_error = current_variance / current.size();
+	double standard_error = sqrt(baseline_error + current_error);
+	if (standard_error == 0.0) return current_mean > baseline_mean;
+
+	double t = (current_mean - baseline_mean) / standard_error;
+	double degrees_of_freedom = (baseline_error + current_error) * (baseline_error + current_error) /
+		(baseline_error * baseline_error / (baseline.size() - 1) + current_error * current_error / (current.size() - 1));
+
+	return t > CriticalT(degrees_of_freedom);
+}
+
+int CompareResults(const std::string& baseline_path, const std::string& results_path, double threshold)
+{
+	JsonValue baseline, results;
+	if (!LoadJson(baseline_path, baseline))
+	{
+		std::cout << "Unable to read " << baseline_path << std::endl;
+		return 2;
+	}
+	if (!LoadJson(results_path, results))
+	{
+		std::cout << "Unable to read " << results_path << std::endl;
+		return 2;
+	}
+
+	uint32_t slowdowns = 0;
+	const JsonValue* result_samples = results.Find("samples");
+	const JsonValue* baseline_samples = baseline.Find("samples");
+	if (result_samples == nullptr || baseline_samples == nullptr) return 2;
+
+	for (const JsonValue& sample : result_samples->array)
+	{
+		const std::string& name = sample.Find("name")->string;
+		if (sample.Find("status")->string != "ok") continue;
+
+		const JsonValue* baseline_sample = nullptr;
+		for (const JsonValue& candidate : baseline_samples->array)
+		{
+			if (candidate.Find("name")->string == name && candidate.Find("status")->string == "ok") baseline_sample = &candidate;
+		}
+		if (baseline_sample == nullptr)
+		{
+			std::cout << name << ": not in the baseline" << std::endl;
+			continue;
+		}
+
+		std::cout << name << std::endl;
+		std::vector<SMetric> baseline_metrics = GatherMetrics(*baseline_sample);
+		for (const SMetric& metric : GatherMetrics(sample))
+		{
+			const SMetric* baseline_metric = nullptr;
+			for (const SMetric& candidate : baseline_metrics)
+			{
+				if (candidate.name == metric.name) baseline_metric = &candidate;
+			}
+			if (baseline_metric == nullptr || baseline_metric->samples.empty() || metric.samples.empty()) continue;
+
+			double baseline_mean, baseline_variance, current_mean, current_variance;
+			MeanAndVariance(baseline_metric->samples, baseline_mean, baseline_variance);
+			MeanAndVariance(metric.samples, current_mean, current_variance);
+			double change = baseline_mean > 0.0 ? (current_mean - baseline_mean) / baseline_mean * 100.0 : 0.0;
+
+			bool slower = change > threshold && (metric.exact || SignificantlySlower(baseline_metric->samples, metric.samples));
+			if (slower) slowdowns++;
+
+			std::cout << "  " << (slower ? "SLOWER " : "       ") << metric.name << ": " << baseline_mean << " -> " << current_mean
+				<< " (" << (change >= 0.0 ? "+" : "") << change << "%)" << std::endl;
+		}
+	}
+
+	std::cout << slowdowns << " significant slowdowns over " << threshold << "%" << std::endl;
+	return slowdowns > 0 ? 1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+	if (argc >= 4 && strcmp(argv[1], "--compare") == 0)
+	{
+		double threshold = 5.0;
+		for (int i = 4; i + 1 < argc; i++)
+		{
+			if (strcmp(argv[i], "--threshold") == 0) threshold = atof(argv[++i]);
+		}
+		return CompareResults(argv[2], argv[3], threshold);
+	}
+
+	uint32_t frames = 1000;
+	uint32_t warmup = 100;
+	uint32_t runs = 3;
+	std::string output_path = "benchmark_results.json";
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		if (strcmp(argv[i], "--frames") == 0) frames = static_cast<uint32_t>(atoi(argv[++i]));
+		else if (strcmp(argv[i], "--warmup") == 0) warmup = static_cast<uint32_t>(atoi(argv[++i]));
+		else if (strcmp(argv[i], "--runs") == 0) runs = static_cast<uint32_t>(atoi(argv[++i]));
+		else if (strcmp(argv[i], "--out") == 0) output_path = argv[++i];
+	}
+	assert(frames > 0 && runs > 0);
+
+	return RunBenchmarks(frames, warmup, runs, output_path);
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <mutex>
+
+namespace VkHelper
+{
+	// Block index used by allocations that have their own VkDeviceMemory
+	const uint32_t DEDICATED_ALLOCATION = UINT32_MAX;
+
+	// A free region inside of a memory block
+	struct MemoryRange
+	{
+		VkDeviceSize offset;
+		VkDeviceSize size;
+	};
+
+	// One large vkAllocateMemory that is split between many buffers and images
+	struct MemoryBlock
+	{
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize size = 0;
+		uint32_t memory_type = 0;
+		// Linear resources (buffers and linear images) and optimal images are kept in separate blocks,
+		// this way neighbouring resources can never break the bufferImageGranularity rule
+		bool linear = true;
+		// How many live allocations are in the block
+		uint32_t allocation_count = 0;
+		// Host visible blocks are mapped once for their whole lifetime
+		void* mapped_memory = nullptr;
+		// Free regions of the block, sorted by offset
+		std::vector<MemoryRange> free_ranges;
+	};
+
+	// Handle to a region of memory returned by the allocator
+	struct Allocation
+	{
+		// Memory the resource needs to be bound to
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		// Offset of the resource inside of the memory
+		VkDeviceSize offset = 0;
+		// How much memory was reserved for the resource
+		VkDeviceSize size = 0;
+		uint32_t memory_type = 0;
+		// What block the allocation came from, DEDICATED_ALLOCATION if it owns its memory
+		uint32_t block_index = DEDICATED_ALLOCATION;
+		// Raw pointer that will point to GPU memory, only set for host visible memory
+		void* mapped_memory = nullptr;
+	};
+
+	struct Allocator
+	{
+		VkDevice device = VK_NULL_HANDLE;
+		VkPhysicalDeviceMemoryProperties physical_device_mem_properties;
+		VkDeviceSize buffer_image_granularity = 1;
+		VkDeviceSize non_coherent_atom_size = 1;
+		// Default size of each block of memory
+		VkDeviceSize block_size = 0;
+		std::vector<MemoryBlock> blocks;
+		uint32_t dedicated_allocation_count = 0;
+		// How much memory the dedicated allocations cover between them
+		VkDeviceSize dedicated_allocation_size = 0;
+		// Allocations may be requested from loading threads
+		std::mutex lock;
+	};
+
+	// Setup the allocator, no memory is allocated until the first request is made
+	void CreateAllocator(const VkDevice& device, const VkPhysicalDeviceProperties& physical_device_properties, const VkPhysicalDeviceMemoryProperties& physical_device_mem_properties,
+		Allocator& allocator, VkDeviceSize block_size = 64 * 1024 * 1024);
+
+	// Free all blocks that the allocator owns. All allocations must have been freed before this
+	void DestroyAllocator(Allocator& allocator);
+
+	// Find a region of memory that meets the requirements. Requests larger then half a block, or that ask for it, get their own memory
+	bool Allocate(Allocator& allocator, const VkMemoryRequirements& memory_requirements, VkMemoryPropertyFlags memory_properties, bool linear,
+		Allocation& allocation, bool dedicated = false);
+
+	// Return the region of memory to the allocator
+	void Free(Allocator& allocator, Allocation& allocation);
+
+	// How many VkDeviceMemory objects are live, how much memory they cover and how much of that is in use
+	void GetAllocatorStats(Allocator& allocator, uint32_t& device_memory_count, VkDeviceSize& allocated_size, VkDeviceSize& used_size);
+}
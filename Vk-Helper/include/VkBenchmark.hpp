@@ -0,0 +1,68 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace VkHelper
+{
+	struct Allocator;
+	struct GpuProfiler;
+
+	// Any arguments the benchmark runner passed to a sample
+	struct BenchmarkOptions
+	{
+		// Where to write the results, benchmarking is off when this is empty
+		std::string output_path;
+		// How many frames to render before measuring any, so caches warming up and the first submits are not counted
+		uint32_t warmup_frames = 0;
+	};
+
+	// Looks for --benchmark <output path> and --warmup <frame count> in the programs arguments
+	BenchmarkOptions ParseBenchmarkOptions(int argc, char** argv);
+
+	struct BenchmarkPhase
+	{
+		std::string name;
+		float ms;
+	};
+
+	// Collects what a sample is doing while the benchmark runner has it running headless: how long each part of startup
+	// took, the CPU time of every frame after the warm up, the GPU scopes of the samples profiler and the most device
+	// memory the allocator had out at once. Every function does nothing unless StartBenchmark was given an output path
+	struct BenchmarkRecorder
+	{
+		bool enabled = false;
+		std::string output_path;
+		std::string sample_name;
+		uint32_t warmup_frames = 0;
+		// Caps how many frame times are kept, far more than any benchmark run renders
+		uint32_t max_samples = 100000;
+
+		// Startup is split into phases, each one runs from the last mark to the next
+		std::chrono::steady_clock::time_point last_mark;
+		std::vector<BenchmarkPhase> startup_phases;
+
+		std::chrono::steady_clock::time_point last_frame;
+		uint32_t frames_seen = 0;
+		std::vector<float> frame_ms;
+
+		// Optional, set once they have been created. Without the allocator no peak memory is reported
+		Allocator* allocator = nullptr;
+		GpuProfiler* gpu_profiler = nullptr;
+		VkDeviceSize peak_device_memory = 0;
+	};
+
+	void StartBenchmark(const BenchmarkOptions& options, const char* sample_name, BenchmarkRecorder& recorder);
+
+	// Ends the current startup phase and names it
+	void MarkBenchmarkPhase(BenchmarkRecorder& recorder, const char* name);
+
+	// Call once at the end of every frame, the frame time is the time since the last call. Once the warm up frames are
+	// done the GPU profilers history is cleared, so its stats only cover the measured frames too
+	void RecordBenchmarkFrame(BenchmarkRecorder& recorder);
+
+	// Write everything that was recorded to the output path as JSON for the benchmark runner to pick up
+	bool WriteBenchmarkResults(BenchmarkRecorder& recorder);
+}
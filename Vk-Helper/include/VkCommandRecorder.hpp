@@ -0,0 +1,87 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+namespace VkHelper
+{
+	struct DeviceDispatch;
+
+	// A piece of recording work. It is recorded into its own secondary command buffer, which is begun and ended for it
+	struct SecondaryRecordJob
+	{
+		// Which frames command pools the secondary command buffer comes from
+		uint32_t frame_index = 0;
+		// The render pass, subpass and framebuffer the secondary command buffer will be executed within
+		VkCommandBufferInheritanceInfo inheritance = {};
+		// RENDER_PASS_CONTINUE is needed for anything executed inside a render pass. Secondary command buffers executed from
+		// a primary that has SIMULTANEOUS_USE need it too, or the primary loses it
+		VkCommandBufferUsageFlags usage_flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+		// Called on a worker thread, nothing in it can touch another jobs command buffer
+		std::function<void(VkCommandBuffer command_buffer)> record;
+	};
+
+	// Records secondary command buffers across a pool of worker threads. Command pools can only be used by one thread at a
+	// time, so every thread has its own pool for every frame, and no locking is needed while recording. A frames pools
+	// are reset together in BeginRecorderFrame, which also makes their command buffers free to be handed out again.
+	// Jobs are dealt out to a queue per thread, a thread that runs out of work takes jobs from the back of the others
+	// queues, so a few slow jobs don't leave the rest of the threads idle
+	struct CommandRecorder
+	{
+		struct ThreadCommandPool
+		{
+			VkCommandPool command_pool = VK_NULL_HANDLE;
+			// Every secondary command buffer allocated from the pool, reused after each reset
+			std::vector<VkCommandBuffer> command_buffers;
+			// How many of the command buffers have been handed out since the last reset
+			uint32_t used = 0;
+		};
+
+		struct WorkQueue
+		{
+			std::deque<uint32_t> jobs;
+			std::mutex lock;
+		};
+
+		VkDevice device = VK_NULL_HANDLE;
+		// Every thread begins and ends its command buffers through the devices own functions
+		const DeviceDispatch* dispatch = nullptr;
+		uint32_t frame_count = 0;
+		// Including the thread that calls RecordSecondaryCommandBuffers, which records alongside the workers
+		uint32_t thread_count = 0;
+		// thread_command_pools[frame_index * thread_count + thread_index]
+		std::vector<ThreadCommandPool> thread_command_pools;
+		std::vector<std::unique_ptr<WorkQueue>> work_queues;
+		std::vector<std::thread> workers;
+
+		// The batch being recorded, only changed while no jobs are queued
+		const SecondaryRecordJob* jobs = nullptr;
+		VkCommandBuffer* secondary_command_buffers = nullptr;
+
+		std::mutex lock;
+		std::condition_variable work_available;
+		std::condition_variable work_finished;
+		// Bumped every batch so sleeping workers know there is something new to look at
+		uint64_t batch = 0;
+		uint32_t jobs_remaining = 0;
+		bool stopping = false;
+	};
+
+	// Passing a thread_count of 0 uses one thread per CPU core
+	void CreateCommandRecorder(const VkDevice& device, uint32_t queue_family, uint32_t frame_count, uint32_t thread_count, CommandRecorder& recorder);
+
+	void DestroyCommandRecorder(CommandRecorder& recorder);
+
+	// Reset every threads command pool for the frame. The GPU must have finished with the frames command buffers
+	void BeginRecorderFrame(CommandRecorder& recorder, uint32_t frame_index);
+
+	// Record every job in parallel and wait for them all to finish. secondary_command_buffers is filled in job order, ready
+	// to be passed to vkCmdExecuteCommands
+	void RecordSecondaryCommandBuffers(CommandRecorder& recorder, const SecondaryRecordJob* jobs, uint32_t job_count, VkCommandBuffer* secondary_command_buffers);
+}
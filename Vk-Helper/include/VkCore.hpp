@@ -3,6 +3,9 @@
 #include <vulkan/vulkan.h>
 #include <memory>
 
+#include <VkAllocator.hpp>
+#include <VkSamplerCache.hpp>
+
 namespace VkHelper
 {
 	struct FrameBufferAttachment
@@ -81,8 +84,9 @@ namespace VkHelper
 		VkPhysicalDeviceFeatures& device_features, VkPhysicalDeviceMemoryProperties& device_mem_properties, const char ** physical_device_extentions, const unsigned int extention_count,
 		VkQueueFlags required_queue_flags, VkSurfaceKHR surface = VK_NULL_HANDLE);
 
+	// next is chained onto VkDeviceCreateInfo::pNext, use it to enable extension features such as descriptor indexing
 	VkDevice CreateDevice(const VkPhysicalDevice& physical_device, VkDeviceQueueCreateInfo* queue_infos, uint32_t queue_info_count, VkPhysicalDeviceFeatures& physical_device_features,
-		const char** extensions, unsigned int extensions_count);
+		const char** extensions, unsigned int extensions_count, const void* next = nullptr);
 
 	VkCommandPool CreateCommandPool(const VkDevice& device, const uint32_t& queue_family, VkCommandPoolCreateFlags flags);
 
@@ -99,10 +103,25 @@ namespace VkHelper
 
 	VkSwapchainKHR CreateSwapchain(const VkPhysicalDevice & physical_device, const VkDevice & device, const VkSurfaceKHR& surface, VkSurfaceCapabilitiesKHR & surface_capabilities,
 		VkSurfaceFormatKHR& surface_format, VkPresentModeKHR& present_mode, uint32_t window_width, uint32_t window_height, 
-		uint32_t& swapchain_image_count, std::unique_ptr<VkImage>& swapchain_images, std::unique_ptr<VkImageView>& swapchain_image_views);
+		uint32_t& swapchain_image_count, std::unique_ptr<VkImage>& swapchain_images, std::unique_ptr<VkImageView>& swapchain_image_views,
+		VkSwapchainKHR old_swapchain = VK_NULL_HANDLE);
 
 	void CreateImage(const VkDevice& device, const VkPhysicalDeviceMemoryProperties& physical_device_mem_properties, uint32_t width, uint32_t height, VkFormat format, 
-		VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage & image, VkDeviceMemory & image_memory, VkImageLayout initialLayout);
+		VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage & image, VkDeviceMemory & image_memory, VkImageLayout initialLayout,
+		uint32_t mip_levels = 1);
+
+	// Same as CreateBuffer, but the memory is sub allocated from the allocator. Host visible buffers are already mapped in allocation.mapped_memory
+	bool CreateBuffer(const VkDevice& device, Allocator& allocator, VkBuffer& buffer, Allocation& allocation, VkDeviceSize size, VkBufferUsageFlags usage,
+		VkSharingMode sharing_mode, VkMemoryPropertyFlags buffer_memory_properties);
+
+	// Same as CreateImage, but the memory is sub allocated from the allocator
+	void CreateImage(const VkDevice& device, Allocator& allocator, uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling,
+		VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, Allocation& allocation, VkImageLayout initialLayout,
+		uint32_t mip_levels = 1);
+
+	void DestroyBuffer(const VkDevice& device, Allocator& allocator, VkBuffer& buffer, Allocation& allocation);
+
+	void DestroyImage(const VkDevice& device, Allocator& allocator, VkImage& image, Allocation& allocation);
 
 	VkCommandBuffer BeginSingleTimeCommands(const VkDevice& device, const VkCommandPool& command_pool);
 
@@ -112,16 +131,31 @@ namespace VkHelper
 
 	void TransitionImageLayout(const VkDevice& device, const VkQueue& queue, VkCommandPool command_pool, VkImage image, VkFormat format, VkImageLayout old_layout, VkImageLayout new_layout, VkImageSubresourceRange subresourceRange);
 
+	// The attachments sampler comes from the sampler cache, give it back with ReleaseSampler
 	void CreateAttachmentImages(const VkDevice& device, const VkQueue& queue, uint32_t width, uint32_t height, const VkPhysicalDeviceMemoryProperties& physical_device_mem_properties, const VkPhysicalDeviceFeatures& physical_device_features,
 		const VkPhysicalDeviceProperties& physical_device_properties, const VkCommandPool& command_pool, VkFormat format, VkImageUsageFlags usage, VkHelper::FrameBufferAttachment & attachment);
 
 	VkFormat FindSupportedFormat(const VkPhysicalDevice& physical_device, const VkFormat* candidate_formats, const uint32_t candidate_format_count, VkImageTiling tiling, VkFormatFeatureFlags features);
 	
+	// Create the render pass along with a framebuffer and attachments for each swapchain image
 	VkRenderPass CreateRenderPass(const VkPhysicalDevice & physical_device, const VkDevice& device, VkFormat present_format, VkFormat image_color_format, const uint32_t& swapchain_image_count, 
 		const VkPhysicalDeviceMemoryProperties& physical_device_mem_properties, const VkPhysicalDeviceFeatures& physical_device_features, const VkPhysicalDeviceProperties& physical_device_properties, 
 		const VkCommandPool& command_pool, const VkQueue& queue, uint32_t width, uint32_t height, std::unique_ptr<VkFramebuffer>& framebuffers, std::unique_ptr<VulkanAttachments>& framebuffer_attachments,
 		std::unique_ptr<VkImageView>& swapchain_image_views);
 
+	// Create just the render pass. It only depends on the formats, so it can outlive swapchains of the same format
+	VkRenderPass CreateRenderPass(const VkPhysicalDevice & physical_device, const VkDevice& device, VkFormat present_format, VkFormat image_color_format);
+
+	// Create a framebuffer and attachments for each swapchain image to go with an existing render pass
+	void CreateFramebuffers(const VkPhysicalDevice & physical_device, const VkDevice& device, const VkRenderPass& renderpass, VkFormat image_color_format, const uint32_t& swapchain_image_count,
+		const VkPhysicalDeviceMemoryProperties& physical_device_mem_properties, const VkPhysicalDeviceFeatures& physical_device_features, const VkPhysicalDeviceProperties& physical_device_properties,
+		const VkCommandPool& command_pool, const VkQueue& queue, uint32_t width, uint32_t height, std::unique_ptr<VkFramebuffer>& framebuffers, std::unique_ptr<VulkanAttachments>& framebuffer_attachments,
+		std::unique_ptr<VkImageView>& swapchain_image_views);
+
+	// Destroy the framebuffers, their attachments and the swapchain image views
+	void DestroyFramebuffers(const VkDevice& device, uint32_t swapchain_image_count, VkFramebuffer* framebuffers, VulkanAttachments* framebuffer_attachments,
+		VkImageView* swapchain_image_views);
+
 	void ReadShaderFile(const char* filename, char*& data, unsigned int& size);
 
 	VkPipeline CreateGraphicsPipeline(const VkPhysicalDevice & physical_device, const VkDevice& device, const VkRenderPass& renderpass, VkPipelineLayout& graphics_pipeline_layout,
@@ -136,9 +170,13 @@ namespace VkHelper
 	VkPipeline CreateComputePipeline(const VkDevice& device, VkPipelineLayout& compute_pipeline_layout,
 		const char* shader_path, VkShaderModule& shader_module, uint32_t descriptor_set_layout_count, const VkDescriptorSetLayout* descriptor_set_layout);
 
+	VkPipeline CreateRayTracingPipeline(const VkDevice& device, const VkPipelineLayout& raytracing_pipeline_layout, uint32_t shader_stage_count, const VkPipelineShaderStageCreateInfo* shader_stages,
+		uint32_t shader_group_count, const VkRayTracingShaderGroupCreateInfoNV* shader_groups, uint32_t max_recursion_depth);
+
 	VkShaderModule LoadShader(const VkDevice& device, const char* path);
 
-	void CreateImageSampler(const VkDevice& device, const VkImage& image, VkFormat format, VkImageView& imageView, VkSampler& sampler);
+	// The view covers mip_levels levels. The sampler is shared through the sampler cache, give it back with ReleaseSampler
+	void CreateImageSampler(const VkDevice& device, const VkImage& image, VkFormat format, VkImageView& imageView, VkSampler& sampler, uint32_t mip_levels = 1);
 
 	void SetImageLayout(VkCommandBuffer cmdbuffer, VkImage image, VkImageLayout oldImageLayout,
 		VkImageLayout newImageLayout, VkImageSubresourceRange subresourceRange);
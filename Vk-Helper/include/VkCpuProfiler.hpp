@@ -0,0 +1,87 @@
+#pragma once
+
+// CPU zones for seeing where the frame and startup time goes. Configure with -DVK_HELPER_CPU_PROFILE=ON to turn them on,
+// otherwise every macro below expands to nothing and no profiling code is built at all.
+//
+//   VK_HELPER_CPU_ZONE("Render");                    Time from here to the end of the enclosing scope
+//   VK_HELPER_CPU_THREAD_NAME("Pipeline builder");   Name the calling thread in the trace
+//   VK_HELPER_CPU_WRITE_TRACE("Sample.cputrace.json"); Write every zone so far out as a Chrome trace
+//
+// Zone names must be string literals, only the pointer is kept
+
+#ifdef VK_HELPER_CPU_PROFILE
+
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <string>
+
+namespace VkHelper
+{
+	struct CpuZoneEvent
+	{
+		const char* name;
+		uint64_t start_ns;
+		uint64_t end_ns;
+	};
+
+	// Each thread records into its own buffer, so recording a zone takes no locks. Only the owning thread writes to the
+	// buffer, count is published with release so WriteCpuTrace can read every event before it while the thread carries on.
+	// Once a buffer is full any more zones on that thread are counted as dropped rather than growing it
+	struct CpuThreadBuffer
+	{
+		static const uint32_t capacity = 65536;
+
+		uint32_t thread_index = 0;
+		std::string thread_name;
+		std::unique_ptr<CpuZoneEvent[]> events;
+		std::atomic<uint32_t> count;
+		std::atomic<uint32_t> dropped;
+	};
+
+	// Nanoseconds since the profiler was first used
+	uint64_t CpuProfilerNow();
+
+	// The calling threads buffer, created and registered the first time the thread records a zone
+	CpuThreadBuffer& CpuProfilerThreadBuffer();
+
+	void SetCpuThreadName(const std::string& name);
+
+	bool WriteCpuTrace(const char* path);
+
+	struct CpuZone
+	{
+		CpuZone(const char* name) : name(name), start_ns(CpuProfilerNow()) {}
+
+		~CpuZone()
+		{
+			uint64_t end_ns = CpuProfilerNow();
+			CpuThreadBuffer& buffer = CpuProfilerThreadBuffer();
+			uint32_t index = buffer.count.load(std::memory_order_relaxed);
+			if (index >= CpuThreadBuffer::capacity)
+			{
+				buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+			buffer.events[index] = { name, start_ns, end_ns };
+			buffer.count.store(index + 1, std::memory_order_release);
+		}
+
+		const char* name;
+		uint64_t start_ns;
+	};
+}
+
+#define VK_HELPER_CPU_CONCAT_INNER(a, b) a##b
+#define VK_HELPER_CPU_CONCAT(a, b) VK_HELPER_CPU_CONCAT_INNER(a, b)
+#define VK_HELPER_CPU_ZONE(name) VkHelper::CpuZone VK_HELPER_CPU_CONCAT(cpu_zone_, __LINE__)(name)
+#define VK_HELPER_CPU_THREAD_NAME(name) VkHelper::SetCpuThreadName(name)
+#define VK_HELPER_CPU_WRITE_TRACE(path) VkHelper::WriteCpuTrace(path)
+
+#else
+
+#define VK_HELPER_CPU_ZONE(name)
+#define VK_HELPER_CPU_THREAD_NAME(name)
+#define VK_HELPER_CPU_WRITE_TRACE(path)
+
+#endif
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+
+namespace VkHelper
+{
+	// How many descriptors of a type to make room for per set, so a pool for 100 sets with a ratio of 2.0 gets 200
+	struct DescriptorPoolRatio
+	{
+		VkDescriptorType type;
+		float ratio;
+	};
+
+	// Hands out descriptor sets from a list of pools rather than one pool sized by hand. When a pool runs out
+	// (VK_ERROR_OUT_OF_POOL_MEMORY or VK_ERROR_FRAGMENTED_POOL) a new, larger one is made and the allocation is retried.
+	// Resetting the allocator resets every pool with vkResetDescriptorPool, which frees all of their sets at once and
+	// keeps the pools for reuse, so sets never need to be freed one at a time
+	struct DescriptorAllocator
+	{
+		VkDevice device = VK_NULL_HANDLE;
+		std::vector<DescriptorPoolRatio> ratios;
+		VkDescriptorPoolCreateFlags flags = 0;
+		// How many sets the next new pool will hold, each new pool is bigger than the last up to max_sets_per_pool
+		uint32_t sets_per_pool = 0;
+		uint32_t max_sets_per_pool = 0;
+		// The pool sets are currently allocated from
+		VkDescriptorPool current_pool = VK_NULL_HANDLE;
+		// Pools that have run out or been passed over since the last reset
+		std::vector<VkDescriptorPool> used_pools;
+		// Pools that have been reset and are ready to be used again
+		std::vector<VkDescriptorPool> free_pools;
+	};
+
+	// Ratios that suit the samples, a few of each of the common descriptor types
+	std::vector<DescriptorPoolRatio> DefaultDescriptorPoolRatios();
+
+	void CreateDescriptorAllocator(const VkDevice& device, const DescriptorPoolRatio* ratios, uint32_t ratio_count, uint32_t sets_per_pool,
+		VkDescriptorPoolCreateFlags flags, DescriptorAllocator& descriptor_allocator);
+
+	void DestroyDescriptorAllocator(DescriptorAllocator& descriptor_allocator);
+
+	// Allocate a set, growing the allocator if the current pool is full. Returns false if the set can not fit in a brand new pool
+	bool AllocateDescriptorSet(DescriptorAllocator& descriptor_allocator, const VkDescriptorSetLayout& descriptor_set_layout, VkDescriptorSet& descriptor_set);
+
+	// Free every set the allocator has handed out. None of them can still be in use by the GPU
+	void ResetDescriptorAllocator(DescriptorAllocator& descriptor_allocator);
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <stddef.h>
+
+namespace VkHelper
+{
+	// One binding of a descriptor set, along with where its descriptor info lives in the struct that is passed to
+	// UpdateDescriptorSet. offset is normally offsetof(MyStruct, member) and stride is the distance between array elements
+	struct DescriptorTemplateBinding
+	{
+		uint32_t binding;
+		VkDescriptorType type;
+		uint32_t count;
+		VkShaderStageFlags stage_flags;
+		size_t offset;
+		size_t stride;
+	};
+
+	// A descriptor set layout and the update template that fills it. The layout is described once, then every binding
+	// of a set is written from a packed struct in a single vkUpdateDescriptorSetWithTemplate call, rather than building
+	// a VkWriteDescriptorSet per binding and having the driver walk them in vkUpdateDescriptorSets
+	struct DescriptorTemplate
+	{
+		VkDevice device = VK_NULL_HANDLE;
+		VkDescriptorSetLayout descriptor_set_layout = VK_NULL_HANDLE;
+		VkDescriptorUpdateTemplate update_template = VK_NULL_HANDLE;
+	};
+
+	DescriptorTemplateBinding TemplateBinding(uint32_t binding, VkDescriptorType type, VkShaderStageFlags stage_flags, size_t offset, uint32_t count = 1, size_t stride = 0);
+
+	// Create the descriptor set layout and the update template from the same binding list
+	void CreateDescriptorTemplate(const VkDevice& device, const DescriptorTemplateBinding* bindings, uint32_t binding_count, DescriptorTemplate& descriptor_template);
+
+	void DestroyDescriptorTemplate(DescriptorTemplate& descriptor_template);
+
+	// Write every binding of the set from data, a struct laid out as the template bindings describe
+	void UpdateDescriptorSet(const DescriptorTemplate& descriptor_template, const VkDescriptorSet& descriptor_set, const void* data);
+}
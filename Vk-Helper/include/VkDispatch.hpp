@@ -0,0 +1,199 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+// Every device level function that goes in the dispatch table. The table, and the code that loads it, are generated
+// from these lists, so supporting another function is a matter of adding it here
+
+// Vulkan 1.0 and 1.1
+#define VK_HELPER_DEVICE_CORE_FUNCTIONS(X) \
+	X(vkDestroyDevice) \
+	X(vkGetDeviceQueue) \
+	X(vkQueueSubmit) \
+	X(vkQueueWaitIdle) \
+	X(vkDeviceWaitIdle) \
+	X(vkAllocateMemory) \
+	X(vkFreeMemory) \
+	X(vkMapMemory) \
+	X(vkUnmapMemory) \
+	X(vkFlushMappedMemoryRanges) \
+	X(vkInvalidateMappedMemoryRanges) \
+	X(vkGetDeviceMemoryCommitment) \
+	X(vkBindBufferMemory) \
+	X(vkBindImageMemory) \
+	X(vkGetBufferMemoryRequirements) \
+	X(vkGetImageMemoryRequirements) \
+	X(vkGetImageSparseMemoryRequirements) \
+	X(vkQueueBindSparse) \
+	X(vkCreateFence) \
+	X(vkDestroyFence) \
+	X(vkResetFences) \
+	X(vkGetFenceStatus) \
+	X(vkWaitForFences) \
+	X(vkCreateSemaphore) \
+	X(vkDestroySemaphore) \
+	X(vkCreateEvent) \
+	X(vkDestroyEvent) \
+	X(vkGetEventStatus) \
+	X(vkSetEvent) \
+	X(vkResetEvent) \
+	X(vkCreateQueryPool) \
+	X(vkDestroyQueryPool) \
+	X(vkGetQueryPoolResults) \
+	X(vkCreateBuffer) \
+	X(vkDestroyBuffer) \
+	X(vkCreateBufferView) \
+	X(vkDestroyBufferView) \
+	X(vkCreateImage) \
+	X(vkDestroyImage) \
+	X(vkGetImageSubresourceLayout) \
+	X(vkCreateImageView) \
+	X(vkDestroyImageView) \
+	X(vkCreateShaderModule) \
+	X(vkDestroyShaderModule) \
+	X(vkCreatePipelineCache) \
+	X(vkDestroyPipelineCache) \
+	X(vkGetPipelineCacheData) \
+	X(vkMergePipelineCaches) \
+	X(vkCreateGraphicsPipelines) \
+	X(vkCreateComputePipelines) \
+	X(vkDestroyPipeline) \
+	X(vkCreatePipelineLayout) \
+	X(vkDestroyPipelineLayout) \
+	X(vkCreateSampler) \
+	X(vkDestroySampler) \
+	X(vkCreateDescriptorSetLayout) \
+	X(vkDestroyDescriptorSetLayout) \
+	X(vkCreateDescriptorPool) \
+	X(vkDestroyDescriptorPool) \
+	X(vkResetDescriptorPool) \
+	X(vkAllocateDescriptorSets) \
+	X(vkFreeDescriptorSets) \
+	X(vkUpdateDescriptorSets) \
+	X(vkCreateFramebuffer) \
+	X(vkDestroyFramebuffer) \
+	X(vkCreateRenderPass) \
+	X(vkDestroyRenderPass) \
+	X(vkGetRenderAreaGranularity) \
+	X(vkCreateCommandPool) \
+	X(vkDestroyCommandPool) \
+	X(vkResetCommandPool) \
+	X(vkAllocateCommandBuffers) \
+	X(vkFreeCommandBuffers) \
+	X(vkBeginCommandBuffer) \
+	X(vkEndCommandBuffer) \
+	X(vkResetCommandBuffer) \
+	X(vkCmdBindPipeline) \
+	X(vkCmdSetViewport) \
+	X(vkCmdSetScissor) \
+	X(vkCmdSetLineWidth) \
+	X(vkCmdSetDepthBias) \
+	X(vkCmdSetBlendConstants) \
+	X(vkCmdSetDepthBounds) \
+	X(vkCmdSetStencilCompareMask) \
+	X(vkCmdSetStencilWriteMask) \
+	X(vkCmdSetStencilReference) \
+	X(vkCmdBindDescriptorSets) \
+	X(vkCmdBindIndexBuffer) \
+	X(vkCmdBindVertexBuffers) \
+	X(vkCmdDraw) \
+	X(vkCmdDrawIndexed) \
+	X(vkCmdDrawIndirect) \
+	X(vkCmdDrawIndexedIndirect) \
+	X(vkCmdDispatch) \
+	X(vkCmdDispatchIndirect) \
+	X(vkCmdCopyBuffer) \
+	X(vkCmdCopyImage) \
+	X(vkCmdBlitImage) \
+	X(vkCmdCopyBufferToImage) \
+	X(vkCmdCopyImageToBuffer) \
+	X(vkCmdUpdateBuffer) \
+	X(vkCmdFillBuffer) \
+	X(vkCmdClearColorImage) \
+	X(vkCmdClearDepthStencilImage) \
+	X(vkCmdClearAttachments) \
+	X(vkCmdResolveImage) \
+	X(vkCmdSetEvent) \
+	X(vkCmdResetEvent) \
+	X(vkCmdWaitEvents) \
+	X(vkCmdPipelineBarrier) \
+	X(vkCmdBeginQuery) \
+	X(vkCmdEndQuery) \
+	X(vkCmdResetQueryPool) \
+	X(vkCmdWriteTimestamp) \
+	X(vkCmdCopyQueryPoolResults) \
+	X(vkCmdPushConstants) \
+	X(vkCmdBeginRenderPass) \
+	X(vkCmdNextSubpass) \
+	X(vkCmdEndRenderPass) \
+	X(vkCmdExecuteCommands) \
+	X(vkBindBufferMemory2) \
+	X(vkBindImageMemory2) \
+	X(vkGetDeviceGroupPeerMemoryFeatures) \
+	X(vkCmdSetDeviceMask) \
+	X(vkCmdDispatchBase) \
+	X(vkGetImageMemoryRequirements2) \
+	X(vkGetBufferMemoryRequirements2) \
+	X(vkGetImageSparseMemoryRequirements2) \
+	X(vkTrimCommandPool) \
+	X(vkGetDeviceQueue2) \
+	X(vkCreateSamplerYcbcrConversion) \
+	X(vkDestroySamplerYcbcrConversion) \
+	X(vkCreateDescriptorUpdateTemplate) \
+	X(vkDestroyDescriptorUpdateTemplate) \
+	X(vkUpdateDescriptorSetWithTemplate) \
+	X(vkGetDescriptorSetLayoutSupport)
+
+// Extensions the samples use, these are left null when the device was created without the extension
+#define VK_HELPER_DEVICE_EXTENSION_FUNCTIONS(X) \
+	X(vkCreateSwapchainKHR) \
+	X(vkDestroySwapchainKHR) \
+	X(vkGetSwapchainImagesKHR) \
+	X(vkAcquireNextImageKHR) \
+	X(vkQueuePresentKHR) \
+	X(vkCreateAccelerationStructureNV) \
+	X(vkDestroyAccelerationStructureNV) \
+	X(vkGetAccelerationStructureMemoryRequirementsNV) \
+	X(vkBindAccelerationStructureMemoryNV) \
+	X(vkCmdBuildAccelerationStructureNV) \
+	X(vkCmdCopyAccelerationStructureNV) \
+	X(vkCmdTraceRaysNV) \
+	X(vkCreateRayTracingPipelinesNV) \
+	X(vkGetRayTracingShaderGroupHandlesNV) \
+	X(vkGetAccelerationStructureHandleNV) \
+	X(vkCmdWriteAccelerationStructuresPropertiesNV) \
+	X(vkCompileDeferredNV)
+
+namespace VkHelper
+{
+	// The devices own function pointers, fetched with vkGetDeviceProcAddr. Calling vkCmdDraw and friends through the
+	// loader goes through a trampoline that looks up the dispatch table of the handle first, calling through this
+	// table goes straight into the driver (or the first enabled layer). Each device has its own table, so two devices
+	// on different drivers each call into their own driver. The members have the same names as the functions:
+	//
+	//   dispatch.vkCmdDraw(command_buffer, 3, 1, 0, 0);
+	struct DeviceDispatch
+	{
+		VkDevice device = VK_NULL_HANDLE;
+
+#define VK_HELPER_DISPATCH_MEMBER(name) PFN_##name name = nullptr;
+		VK_HELPER_DEVICE_CORE_FUNCTIONS(VK_HELPER_DISPATCH_MEMBER)
+		VK_HELPER_DEVICE_EXTENSION_FUNCTIONS(VK_HELPER_DISPATCH_MEMBER)
+#undef VK_HELPER_DISPATCH_MEMBER
+	};
+
+	// Fill the table with the devices functions
+	void LoadDeviceDispatch(const VkDevice& device, DeviceDispatch& dispatch);
+
+	// The table for a device. CreateDevice loads the table for each device it creates, a device created some other way
+	// has its table loaded the first time it is looked up. The table lives until the device is unregistered, so the
+	// reference can be kept for the lifetime of the device. Looking a table up takes no locks
+	const DeviceDispatch& GetDeviceDispatch(const VkDevice& device);
+
+	// Load the table again, for when a new device has been given the handle of one that was destroyed
+	const DeviceDispatch& ReloadDeviceDispatch(const VkDevice& device);
+
+	// Forget the devices table and free its slot for the next device. Call it just before vkDestroyDevice, once nothing
+	// else will record or submit with the device, so a later device given the same handle can't be handed the old table
+	void UnregisterDeviceDispatch(const VkDevice& device);
+}
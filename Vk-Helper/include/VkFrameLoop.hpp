@@ -0,0 +1,116 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <memory>
+#include <chrono>
+#include <deque>
+#include <functional>
+
+namespace VkHelper
+{
+	struct HeadlessSwapchain;
+	struct DeviceDispatch;
+
+	// Lets the CPU record and submit up to frames_in_flight frames ahead of the GPU. Each frame in flight owns its own
+	// semaphores, fence and command buffer, while each swapchain image remembers which frame fence last rendered to it
+	struct FrameLoop
+	{
+		// The devices own functions, the waits, submits and presents of every frame call straight into the driver
+		const DeviceDispatch* dispatch = nullptr;
+		uint32_t frames_in_flight = 0;
+		// Which of the frames in flight we are currently using, this indexes the semaphores, fences and command buffers
+		uint32_t frame_index = 0;
+		// Which swapchain image was acquired for the current frame, this indexes anything that is per swapchain image
+		uint32_t image_index = 0;
+		uint32_t swapchain_image_count = 0;
+
+		// Signaled by vkAcquireNextImageKHR once the image can be rendered to
+		std::unique_ptr<VkSemaphore> image_available_semaphores;
+		// Signaled by the render submit and waited on by the present
+		std::unique_ptr<VkSemaphore> render_finished_semaphores;
+		// Signaled once the GPU has finished with the frame
+		std::unique_ptr<VkFence> frame_fences;
+		// The frame fence that was last used to render to each swapchain image, these are not owned by the images
+		std::unique_ptr<VkFence> image_fences;
+		// A command buffer per frame in flight for anything that is recorded each frame
+		std::unique_ptr<VkCommandBuffer> command_buffers;
+
+		// How many frames have been submitted
+		uint64_t frame_number = 0;
+		// Resources that may still be used by frames in flight, each is destroyed once BeginFrame reaches destroy_frame
+		struct RetiredResource
+		{
+			uint64_t destroy_frame;
+			std::function<void()> destroy;
+		};
+		std::deque<RetiredResource> retired_resources;
+
+		// When set, images are acquired from and presented to the headless swapchain rather than the swapchain passed to
+		// BeginFrame and EndFrame, and the image semaphores are not used as there is no presentation engine to sync with
+		HeadlessSwapchain* headless_swapchain = nullptr;
+	};
+
+	// For recording the frames commands from scratch every frame rather than prerecording them. Each frame in flight has
+	// a TRANSIENT command pool that is reset in one go with vkResetCommandPool once the frames fence has signaled, so
+	// no command buffer is ever reset on its own, and the command buffer is begun with ONE_TIME_SUBMIT each frame
+	struct FrameCommands
+	{
+		const DeviceDispatch* dispatch = nullptr;
+		uint32_t frames_in_flight = 0;
+		std::unique_ptr<VkCommandPool> command_pools;
+		// One command buffer from each pool
+		std::unique_ptr<VkCommandBuffer> command_buffers;
+
+		// How long the CPU spent between BeginFrameCommands and EndFrameCommands, since the last TakeFrameRecordingStats
+		std::chrono::high_resolution_clock::time_point record_start;
+		uint32_t recorded_frames = 0;
+		float total_record_ms = 0.0f;
+		float max_record_ms = 0.0f;
+		float last_record_ms = 0.0f;
+	};
+
+	struct FrameRecordingStats
+	{
+		uint32_t frames = 0;
+		float average_ms = 0.0f;
+		float max_ms = 0.0f;
+		float last_ms = 0.0f;
+	};
+
+	void CreateFrameLoop(const VkDevice& device, const VkCommandPool& command_pool, uint32_t swapchain_image_count, uint32_t frames_in_flight, FrameLoop& frame_loop);
+
+	void DestroyFrameLoop(const VkDevice& device, const VkCommandPool& command_pool, FrameLoop& frame_loop);
+
+	// Needs to be called once the swapchain has been rebuilt. Each image index keeps waiting on the frame that last used it
+	// in the old swapchain, so the device doesn't need to be idle
+	void ResetFrameLoopImages(FrameLoop& frame_loop, uint32_t swapchain_image_count);
+
+	// Wait until the current frame in flight is free and acquire the next swapchain image into frame_loop.image_index.
+	// VK_ERROR_OUT_OF_DATE_KHR is passed back so the caller can rebuild the swapchain and skip the frame
+	VkResult BeginFrame(const VkDevice& device, const VkSwapchainKHR& swapchain, FrameLoop& frame_loop);
+
+	// Submit the command buffers for the frame and present the image, then move on to the next frame in flight.
+	// The present result is returned so the caller can rebuild the swapchain if needed
+	VkResult EndFrame(const VkDevice& device, const VkQueue& graphics_queue, const VkQueue& present_queue, VkSwapchainKHR& swapchain, FrameLoop& frame_loop,
+		const VkCommandBuffer* command_buffers, uint32_t command_buffer_count, VkPipelineStageFlags wait_stage);
+
+	// Fence that will be signaled when the current frame finishes on the GPU
+	const VkFence& CurrentFrameFence(const FrameLoop& frame_loop);
+
+	// Destroy something once every frame that has already been submitted has finished, rather than waiting for the device
+	// to go idle. Called from BeginFrame, or from DestroyFrameLoop for anything still waiting
+	void RetireResource(FrameLoop& frame_loop, const std::function<void()>& destroy);
+
+	void CreateFrameCommands(const VkDevice& device, uint32_t queue_family, uint32_t frames_in_flight, FrameCommands& frame_commands);
+
+	void DestroyFrameCommands(const VkDevice& device, FrameCommands& frame_commands);
+
+	// Reset the current frames command pool and begin its command buffer. Call after BeginFrame, which has waited on the frames fence
+	VkCommandBuffer BeginFrameCommands(const VkDevice& device, const FrameLoop& frame_loop, FrameCommands& frame_commands);
+
+	// End the current frames command buffer and note how long it took to record
+	void EndFrameCommands(const FrameLoop& frame_loop, FrameCommands& frame_commands);
+
+	// The recording cost of the frames since the last call, the counts then start again
+	FrameRecordingStats TakeFrameRecordingStats(FrameCommands& frame_commands);
+}
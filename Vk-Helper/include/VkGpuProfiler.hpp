@@ -0,0 +1,111 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <string>
+
+namespace VkHelper
+{
+	struct DeviceDispatch;
+
+	// How long a scope has been taking on the GPU over the recent frames
+	struct GpuScopeStats
+	{
+		std::string name;
+		uint32_t samples = 0;
+		float last_ms = 0.0f;
+		float average_ms = 0.0f;
+		float p50_ms = 0.0f;
+		float p95_ms = 0.0f;
+		float p99_ms = 0.0f;
+		float max_ms = 0.0f;
+	};
+
+	// Times named scopes of command buffers on the GPU with timestamp queries. The query pool is split into slots, one
+	// for each command buffer that is in flight at once, so a prerecorded command buffer per swapchain image gets a slot
+	// per image, and a command buffer recorded each frame gets a slot per frame in flight. A slots results are only read
+	// once the fence for its last submit has signaled, so reading them back never stalls.
+	// Every function does nothing until CreateGpuProfiler has been called, so profiling can be left switched off
+	struct GpuProfiler
+	{
+		VkDevice device = VK_NULL_HANDLE;
+		// The timestamps are written and read back every frame, through the devices own functions
+		const DeviceDispatch* dispatch = nullptr;
+		VkQueryPool query_pool = VK_NULL_HANDLE;
+		uint32_t slot_count = 0;
+		uint32_t max_scopes = 0;
+		// Nanoseconds per timestamp tick
+		float timestamp_period = 0.0f;
+		// The queue only writes timestampValidBits of each timestamp
+		uint64_t timestamp_mask = 0;
+
+		std::vector<std::string> scope_names;
+		// Which scopes were recorded into each slot, scope_written[slot * max_scopes + scope]
+		std::vector<uint8_t> scope_written;
+		// Set once a slot has been submitted and has results waiting to be read
+		std::vector<uint8_t> slot_submitted;
+
+		// The last history_size durations in milliseconds of each scope, written round robin
+		uint32_t history_size = 512;
+		std::vector<std::vector<float>> history;
+		std::vector<uint32_t> history_next;
+		std::vector<float> last_ms;
+
+		struct TraceEvent
+		{
+			uint32_t scope;
+			uint64_t start;
+			uint64_t end;
+		};
+		// Every scope that has been read back, until max_trace_events is reached
+		std::vector<TraceEvent> trace_events;
+		size_t max_trace_events = 0;
+	};
+
+	// Ends the scope when it goes out of scope
+	struct GpuScope
+	{
+		GpuScope(VkCommandBuffer command_buffer, GpuProfiler& profiler, uint32_t slot, uint32_t scope);
+		~GpuScope();
+
+		VkCommandBuffer command_buffer;
+		GpuProfiler& profiler;
+		uint32_t slot;
+		uint32_t scope;
+	};
+
+	// Returns false and leaves the profiler switched off if the queue family can't write timestamps.
+	// max_trace_events is how many scopes are kept for WriteGpuTrace, 0 keeps none
+	bool CreateGpuProfiler(const VkPhysicalDevice& physical_device, const VkDevice& device, uint32_t queue_family, uint32_t slot_count, uint32_t max_scopes,
+		size_t max_trace_events, GpuProfiler& profiler);
+
+	void DestroyGpuProfiler(GpuProfiler& profiler);
+
+	// Give the profiler at least slot_count slots, for when a rebuilt swapchain has more images than it has slots. The
+	// scopes, history and trace are kept, but results still waiting in the old query pool are dropped. The old query pool
+	// is handed back so it can be destroyed once the frames that wrote into it are done, VK_NULL_HANDLE if it didn't grow
+	VkQueryPool GrowGpuProfiler(GpuProfiler& profiler, uint32_t slot_count);
+
+	// Give a scope a name, the returned id is passed to the begin and end calls
+	uint32_t RegisterGpuScope(GpuProfiler& profiler, const char* name);
+
+	// Reset the slots queries, recorded at the start of the command buffer and outside of any render pass
+	void ResetGpuProfilerSlot(VkCommandBuffer command_buffer, GpuProfiler& profiler, uint32_t slot);
+
+	void BeginGpuScope(VkCommandBuffer command_buffer, GpuProfiler& profiler, uint32_t slot, uint32_t scope);
+
+	void EndGpuScope(VkCommandBuffer command_buffer, GpuProfiler& profiler, uint32_t slot, uint32_t scope);
+
+	// Read back the results of the slots last submit, then mark it as being submitted again. Call it right before the
+	// slot is submitted, once the fence for its last submit has signaled
+	void CollectGpuTimings(GpuProfiler& profiler, uint32_t slot);
+
+	// Forget every duration read back so far, and keep up to history_size of each scope from now on
+	void ResetGpuScopeHistory(GpuProfiler& profiler, uint32_t history_size);
+
+	// Rolling stats for every scope that has been read back at least once
+	std::vector<GpuScopeStats> GetGpuScopeStats(const GpuProfiler& profiler);
+
+	// Write the kept scopes out as a Chrome trace, open it in chrome://tracing or https://ui.perfetto.dev
+	bool WriteGpuTrace(const GpuProfiler& profiler, const char* path);
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <memory>
+
+namespace VkHelper
+{
+	// Stands in for the swapchain when there is no window, such as on a CI machine running a software driver. The frames
+	// are rendered into a ring of offscreen images that are handed out in order, the same way a FIFO swapchain would.
+	// Once attached to a FrameLoop, BeginFrame and EndFrame acquire and present from the ring instead of the swapchain
+	struct HeadlessSwapchain
+	{
+		VkFormat format = VK_FORMAT_UNDEFINED;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint32_t image_count = 0;
+		// The images are owned by the headless swapchain, the views are owned by the caller like swapchain image views
+		std::unique_ptr<VkImage> images;
+		std::unique_ptr<VkDeviceMemory> image_memory;
+		// The image the next acquire will hand out
+		uint32_t next_image = 0;
+		// How many images have been presented
+		uint64_t presented_images = 0;
+	};
+
+	// Any arguments that were passed to run a sample without a window
+	struct HeadlessOptions
+	{
+		bool enabled = false;
+		// How many frames to render before closing, 0 renders until the sample decides to stop
+		uint32_t frame_count = 0;
+	};
+
+	// Looks for --headless [frame count] in the programs arguments, the frame count defaults to 1000
+	HeadlessOptions ParseHeadlessOptions(int argc, char** argv);
+
+	// Creates the images and fills swapchain_images and swapchain_image_views just like CreateSwapchain does, so the
+	// render pass and framebuffers can be created from them in the same way. The images can also be copied from
+	void CreateHeadlessSwapchain(const VkDevice& device, const VkPhysicalDeviceMemoryProperties& physical_device_mem_properties, VkFormat format,
+		uint32_t width, uint32_t height, uint32_t image_count, HeadlessSwapchain& headless_swapchain, uint32_t& swapchain_image_count,
+		std::unique_ptr<VkImage>& swapchain_images, std::unique_ptr<VkImageView>& swapchain_image_views);
+
+	// Destroys the images, the image views need to be destroyed by the caller first
+	void DestroyHeadlessSwapchain(const VkDevice& device, HeadlessSwapchain& headless_swapchain);
+
+	// Hand out the next image in the ring. Nothing needs to be waited on here as no presentation engine is reading the
+	// images, the frame loop already waits on the frame that last rendered to the image before it is reused
+	uint32_t AcquireHeadlessImage(HeadlessSwapchain& headless_swapchain);
+
+	void PresentHeadlessImage(HeadlessSwapchain& headless_swapchain, uint32_t image_index);
+}
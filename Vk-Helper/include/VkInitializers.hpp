@@ -19,6 +19,8 @@ namespace VkHelper
 
 	VkMemoryAllocateInfo MemroyAllocateInfo(VkDeviceSize size, uint32_t memory_type);
 
+	VkImageCreateInfo ImageCreateInfo(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkImageLayout initial_layout);
+
 	VkDescriptorPoolSize DescriptorPoolSize(VkDescriptorType type, uint32_t descriptorCount);
 
 	VkDescriptorPoolCreateInfo DescriptorPoolCreateInfo(const VkDescriptorPoolSize* sizes, uint32_t size_count, uint32_t max_sets);
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+
+namespace VkHelper
+{
+	// One mip level of a texture, offset is from the start of KtxTexture::data
+	struct KtxLevel
+	{
+		VkDeviceSize offset;
+		VkDeviceSize size;
+		uint32_t width;
+		uint32_t height;
+	};
+
+	// A 2D KTX2 texture read into memory. Only single layer, single face files without supercompression are supported
+	struct KtxTexture
+	{
+		VkFormat format = VK_FORMAT_UNDEFINED;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		// Level 0 is the full size image
+		std::vector<KtxLevel> levels;
+		// The whole file, the levels point into it
+		std::vector<unsigned char> data;
+	};
+
+	// How many bytes a 4x4 block takes for block compressed formats, or a single texel for the uncompressed formats we write.
+	// Returns 0 for formats the KTX2 reader and writer don't handle
+	uint32_t KtxFormatBlockSize(VkFormat format);
+
+	bool IsBlockCompressedFormat(VkFormat format);
+
+	// How many bytes a level of the given size takes up
+	VkDeviceSize KtxLevelSize(VkFormat format, uint32_t width, uint32_t height);
+
+	// Can the GPU sample images of this format with optimal tiling. BC formats also need the textureCompressionBC feature
+	bool SupportsSampledFormat(const VkPhysicalDevice& physical_device, VkFormat format);
+
+	// Returns false if the file is missing, is not a KTX2 file or uses something we don't support
+	bool LoadKtx2(const char* path, KtxTexture& texture);
+
+	// Write a 2D KTX2 file. level_data holds level_count pointers, largest level first, each KtxLevelSize bytes long
+	bool WriteKtx2(const char* path, VkFormat format, uint32_t width, uint32_t height, uint32_t level_count, const void* const* level_data);
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace VkHelper
+{
+	// Axis aligned box and a sphere around the boxes center that hold every vertex of the mesh
+	struct MeshBounds
+	{
+		float min[3];
+		float max[3];
+		float radius;
+	};
+
+	// Layout of the start of a mesh cache file. The vertex, index and material streams follow the header
+	// and each start on a 16 byte boundary
+	struct MeshCacheHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		// Used to tell if the source file has changed since the cache was written
+		uint64_t source_modified_time;
+		uint64_t source_size;
+		uint32_t vertex_stride;
+		uint32_t vertex_count;
+		uint32_t index_count;
+		// Used to tell if the cache was written with a different vertex or material layout
+		uint32_t material_stride;
+		uint32_t material_count;
+		uint32_t padding;
+		// Where each stream starts from the beginning of the file
+		uint64_t vertex_offset;
+		uint64_t index_offset;
+		uint64_t material_offset;
+		MeshBounds bounds;
+	};
+
+	// A mesh cache file mapped into memory, the pointers point straight into the mapping
+	// so they are only valid until CloseMeshCache is called
+	struct MeshCache
+	{
+		const MeshCacheHeader* header = nullptr;
+		const void* vertices = nullptr;
+		const uint32_t* indices = nullptr;
+		const void* materials = nullptr;
+
+		// The mapping itself
+		void* mapped_memory = nullptr;
+		size_t mapped_size = 0;
+		void* file_handle = nullptr;          // Only used on windows
+		void* mapping_handle = nullptr;       // Only used on windows
+		int file_descriptor = -1;             // Only used on POSIX
+	};
+
+	// Find the bounds of a set of vertices. position_offset is where the vec3 position sits inside each vertex
+	MeshBounds ComputeMeshBounds(const void* vertices, uint32_t vertex_count, uint32_t vertex_stride, uint32_t position_offset);
+
+	// Write a mesh cache for the source file at source_path. The source files modification time and size are stored
+	// so later loads can tell if the cache is out of date
+	bool WriteMeshCache(const char* cache_path, const char* source_path, const void* vertices, uint32_t vertex_count, uint32_t vertex_stride,
+		const uint32_t* indices, uint32_t index_count, const void* materials, uint32_t material_count, uint32_t material_stride, const MeshBounds& bounds);
+
+	// Map a mesh cache into memory. Returns false if there is no cache, it was written with a different vertex or material
+	// layout, or the source files modification time or size no longer match, in which case the cache should be rebuilt
+	bool OpenMeshCache(const char* cache_path, const char* source_path, uint32_t vertex_stride, uint32_t material_stride, MeshCache& mesh_cache);
+
+	void CloseMeshCache(MeshCache& mesh_cache);
+}
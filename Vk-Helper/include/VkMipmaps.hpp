@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <string>
+
+namespace VkHelper
+{
+	// Generates the mip chain of a image on the GPU. Formats that support linear filtered blits are downsampled
+	// with a chain of vkCmdBlitImage calls, any other format falls back to a compute shader
+	struct MipmapGenerator
+	{
+		VkDevice device = VK_NULL_HANDLE;
+		VkPhysicalDevice physical_device = VK_NULL_HANDLE;
+
+		// The compute fallback, it is only built the first time a format needs it
+		std::string compute_shader_path;
+		VkDescriptorSetLayout descriptor_set_layout = VK_NULL_HANDLE;
+		VkPipelineLayout pipeline_layout = VK_NULL_HANDLE;
+		VkShaderModule shader_module = VK_NULL_HANDLE;
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		VkSampler sampler = VK_NULL_HANDLE;
+
+		// Per level views and descriptor pools used by recorded compute downsamples, they must
+		// live until the GPU has finished with them
+		std::vector<VkImageView> level_views;
+		std::vector<VkDescriptorPool> descriptor_pools;
+	};
+
+	// How many levels a full mip chain down to 1x1 has
+	uint32_t MipLevelCount(uint32_t width, uint32_t height);
+
+	// Can the format be downsampled with a linear filtered vkCmdBlitImage
+	bool SupportsBlitMipmaps(const VkPhysicalDevice& physical_device, VkFormat format);
+
+	// The compute shader writes through a rgba8 storage image, so the fallback supports formats that can be viewed that way
+	void CreateMipmapGenerator(const VkDevice& device, const VkPhysicalDevice& physical_device, const char* compute_shader_path, MipmapGenerator& mipmap_generator);
+
+	void DestroyMipmapGenerator(MipmapGenerator& mipmap_generator);
+
+	// The usage flags a image of this format needs on top of its own so its mips can be generated
+	VkImageUsageFlags MipmapImageUsage(const MipmapGenerator& mipmap_generator, VkFormat format);
+
+	// Record the mip generation into a command buffer from a queue family that supports graphics and compute.
+	// Level 0 must be in VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL having just been written by a transfer, the other levels
+	// must be undefined. Every level is left in final_layout
+	void RecordGenerateMipmaps(MipmapGenerator& mipmap_generator, VkCommandBuffer command_buffer, VkImage image, VkFormat format, uint32_t width, uint32_t height,
+		uint32_t mip_levels, VkImageLayout final_layout, VkAccessFlags dst_access, VkPipelineStageFlags dst_stage);
+
+	// Free the views and descriptor pools of the compute downsamples, only call this once the GPU has finished everything recorded so far
+	void ReleaseMipmapResources(MipmapGenerator& mipmap_generator);
+}
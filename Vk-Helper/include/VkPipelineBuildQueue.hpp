@@ -0,0 +1,82 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <deque>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+
+namespace VkHelper
+{
+	// Everything CreateGraphicsPipeline needs, copied so it can be built on another thread after the caller has returned
+	struct GraphicsPipelineDescription
+	{
+		VkPhysicalDevice physical_device = VK_NULL_HANDLE;
+		VkRenderPass renderpass = VK_NULL_HANDLE;
+		// Outputs, these are written by the worker so they must stay alive until the pipeline is ready
+		VkPipelineLayout* pipeline_layout = nullptr;
+		VkShaderModule* shader_modules = nullptr;                       // One per shader path
+		std::vector<std::string> shader_paths;
+		std::vector<VkShaderStageFlagBits> shader_stages;
+		std::vector<VkDescriptorSetLayout> descriptor_set_layouts;
+		std::vector<VkVertexInputAttributeDescription> vertex_input_attribute_descriptions;
+		std::vector<VkVertexInputBindingDescription> vertex_input_binding_descriptions;
+		std::vector<VkDynamicState> dynamic_states;
+		VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+		VkPolygonMode polygon_mode = VK_POLYGON_MODE_FILL;
+		float line_width = 1.0f;
+		VkCullModeFlags cull_mode = VK_CULL_MODE_FRONT_BIT;
+		VkBool32 depth_write_enable = VK_TRUE;
+		VkBool32 depth_test_enable = VK_TRUE;
+	};
+
+	struct ComputePipelineDescription
+	{
+		// Outputs, these are written by the worker so they must stay alive until the pipeline is ready
+		VkPipelineLayout* pipeline_layout = nullptr;
+		VkShaderModule* shader_module = nullptr;
+		std::string shader_path;
+		std::vector<VkDescriptorSetLayout> descriptor_set_layouts;
+	};
+
+	struct RayTracingPipelineDescription
+	{
+		VkPipelineLayout pipeline_layout = VK_NULL_HANDLE;
+		// The shader modules and any specialization info these point to must stay alive until the pipeline is ready
+		std::vector<VkPipelineShaderStageCreateInfo> shader_stages;
+		std::vector<VkRayTracingShaderGroupCreateInfoNV> shader_groups;
+		uint32_t max_recursion_depth = 1;
+	};
+
+	// A pool of worker threads that build pipelines in the background. All the workers go through Vk-Helpers pipeline
+	// cache, which Vulkan lets many threads use at once, so pipelines built by one run are reused by the next
+	struct PipelineBuildQueue
+	{
+		VkDevice device = VK_NULL_HANDLE;
+		std::vector<std::thread> workers;
+		// Pipelines waiting for a worker, oldest first
+		std::deque<std::function<void()>> jobs;
+		std::mutex lock;
+		std::condition_variable job_available;
+		bool stopping = false;
+	};
+
+	// Passing a thread_count of 0 uses one less thread than the CPU has, leaving the main thread free
+	void CreatePipelineBuildQueue(const VkDevice& device, uint32_t thread_count, PipelineBuildQueue& build_queue);
+
+	// Finishes any pipelines that are still queued then stops the workers
+	void DestroyPipelineBuildQueue(PipelineBuildQueue& build_queue);
+
+	std::shared_future<VkPipeline> QueueGraphicsPipeline(PipelineBuildQueue& build_queue, const GraphicsPipelineDescription& description);
+
+	std::shared_future<VkPipeline> QueueComputePipeline(PipelineBuildQueue& build_queue, const ComputePipelineDescription& description);
+
+	std::shared_future<VkPipeline> QueueRayTracingPipeline(PipelineBuildQueue& build_queue, const RayTracingPipelineDescription& description);
+
+	// Check without blocking if a queued pipeline has been built
+	bool IsPipelineReady(const std::shared_future<VkPipeline>& pipeline);
+}
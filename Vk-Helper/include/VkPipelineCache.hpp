@@ -0,0 +1,37 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+namespace VkHelper
+{
+	// Layout of the header the driver writes at the start of the pipeline cache data (VK_PIPELINE_CACHE_HEADER_VERSION_ONE)
+	struct PipelineCacheHeader
+	{
+		uint32_t header_size;
+		uint32_t header_version;
+		uint32_t vendor_id;
+		uint32_t device_id;
+		uint8_t pipeline_cache_uuid[VK_UUID_SIZE];
+	};
+
+	// Check that cache data was written by the same GPU and driver we are running on. Data from another driver
+	// should be thrown away rather than handed to vkCreatePipelineCache
+	bool IsPipelineCacheDataValid(const void* data, size_t size, const VkPhysicalDeviceProperties& physical_device_properties);
+
+	// Create the pipeline cache that all of Vk-Helpers pipeline creation goes through. If the file at path holds a valid
+	// cache from a previous run it is used to seed the new cache, so the driver can skip compiling the shaders again
+	void LoadPipelineCache(const VkDevice& device, const VkPhysicalDeviceProperties& physical_device_properties, const char* path);
+
+	// Write the cache out to the path it was loaded from. The data is written to a temporary file first and then
+	// moved over the old one, so a crash part way through never leaves a half written cache behind
+	bool SavePipelineCache(const VkDevice& device);
+
+	// Save the cache and destroy it
+	void DestroyPipelineCache(const VkDevice& device);
+
+	// The cache to pass to vkCreate*Pipelines. Returns VK_NULL_HANDLE if no cache has been loaded, which Vulkan accepts
+	VkPipelineCache GetPipelineCache();
+
+	// Was the cache seeded from disk, useful for comparing cold and warm start up times
+	bool PipelineCacheLoadedFromDisk();
+}
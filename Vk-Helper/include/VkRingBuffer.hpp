@@ -0,0 +1,39 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <VkAllocator.hpp>
+
+namespace VkHelper
+{
+	// One buffer split into a region per frame in flight. Each frame pushes its uniform data into its own region
+	// and binds it using dynamic offsets, so the CPU never writes over data the GPU may still be reading
+	struct RingBuffer
+	{
+		VkBuffer buffer = VK_NULL_HANDLE;
+		Allocation allocation;
+		// Size of each frames region, rounded up to the alignment
+		VkDeviceSize region_size = 0;
+		uint32_t region_count = 0;
+		// Region we are currently pushing data into
+		uint32_t current_region = 0;
+		// How far into the current region we have allocated
+		VkDeviceSize head = 0;
+		// Every sub range starts on this alignment (minUniformBufferOffsetAlignment / minStorageBufferOffsetAlignment)
+		VkDeviceSize alignment = 1;
+	};
+
+	void CreateRingBuffer(const VkDevice& device, Allocator& allocator, const VkPhysicalDeviceProperties& physical_device_properties, VkDeviceSize region_size,
+		uint32_t region_count, VkBufferUsageFlags usage, RingBuffer& ring_buffer);
+
+	void DestroyRingBuffer(const VkDevice& device, Allocator& allocator, RingBuffer& ring_buffer);
+
+	// Move over to the region for this frame. The region is only reclaimed once the frames fence has signaled
+	void BeginRingBufferFrame(const VkDevice& device, RingBuffer& ring_buffer, uint32_t frame_index, const VkFence& frame_fence);
+
+	// Reserve an aligned range in the current region. Returns the dynamic offset to bind with and where to write the data
+	bool RingBufferAllocate(RingBuffer& ring_buffer, VkDeviceSize size, uint32_t& dynamic_offset, void*& mapped_memory);
+
+	// Where a frames region starts in the buffer
+	VkDeviceSize RingBufferRegionOffset(const RingBuffer& ring_buffer, uint32_t frame_index);
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+namespace VkHelper
+{
+	// Almost every texture and framebuffer attachment asks for the same sampler state, but each vkCreateSampler call
+	// counts towards maxSamplerAllocationCount (as low as 4000 on some drivers). Vk-Helper keeps one cache of samplers
+	// keyed on the whole VkSamplerCreateInfo, so textures with matching state share a single reference counted VkSampler.
+	// Samplers handed out by the cache must be given back with ReleaseSampler rather than destroyed with vkDestroySampler
+
+	// Find a sampler matching create_info, or create one if this is the first time the state has been asked for.
+	// Extension structs in pNext are not part of the key, so create_info.pNext must be null
+	VkSampler AcquireSampler(const VkDevice& device, const VkSamplerCreateInfo& create_info);
+
+	// Drop one reference to the sampler, it is destroyed when the last texture using it lets go.
+	// The sampler must not be in use by the GPU if this could be the last reference
+	void ReleaseSampler(const VkDevice& device, VkSampler sampler);
+
+	// Destroy every sampler the cache still holds for the device, whatever its reference count
+	void DestroySamplerCache(const VkDevice& device);
+
+	// How many unique samplers are alive, and how many textures hold references to them
+	uint32_t SamplerCacheSize();
+	uint32_t SamplerCacheReferenceCount();
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+
+namespace VkHelper
+{
+	// A bindless texture table. Every texture lives in one large combined image sampler array that is bound once, and
+	// shaders pick a texture by index (sampler2D textures[]) rather than having a descriptor set rebound per texture.
+	// The array is partially bound, so slots that nothing uses can be left empty, and update after bind, so textures
+	// can be added while command buffers that use the set are recorded or in flight
+	struct TextureHeap
+	{
+		VkDevice device = VK_NULL_HANDLE;
+		// How many textures the array has room for
+		uint32_t capacity = 0;
+		VkDescriptorPool descriptor_pool = VK_NULL_HANDLE;
+		VkDescriptorSetLayout descriptor_set_layout = VK_NULL_HANDLE;
+		VkDescriptorSet descriptor_set = VK_NULL_HANDLE;
+		// Slots given back by RemoveHeapTexture, reused before new slots are handed out
+		std::vector<uint32_t> free_slots;
+		// Every slot from here to capacity has never been used
+		uint32_t next_slot = 0;
+	};
+
+	// The descriptor indexing extension and features the heap needs. Pass the extension to GetPhysicalDevice and
+	// CreateDevice, and chain the features into CreateDevice
+	const char* TextureHeapExtension();
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT TextureHeapFeatures();
+
+	// Does the device support everything in TextureHeapFeatures
+	bool SupportsTextureHeap(const VkPhysicalDevice& physical_device);
+
+	// Create the heap with room for capacity textures, visible to the given shader stages. The capacity is clamped to the
+	// devices maxDescriptorSetUpdateAfterBindSampledImages limit
+	void CreateTextureHeap(const VkDevice& device, const VkPhysicalDevice& physical_device, uint32_t capacity, VkShaderStageFlags stage_flags, TextureHeap& heap);
+
+	void DestroyTextureHeap(TextureHeap& heap);
+
+	// Write a texture into a free slot and return the index shaders use to reach it
+	uint32_t AddHeapTexture(TextureHeap& heap, VkSampler sampler, VkImageView view, VkImageLayout layout);
+
+	// Give a slot back to the heap. The slot must no longer be read by any submitted work, it is not cleared, just reused
+	void RemoveHeapTexture(TextureHeap& heap, uint32_t index);
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include <string>
+#include <functional>
+
+namespace VkHelper
+{
+	// A png decoded into tightly packed RGBA8 pixels
+	struct DecodedImage
+	{
+		std::string path;
+		unsigned int width = 0;
+		unsigned int height = 0;
+		std::vector<unsigned char> pixels;
+		// lodepng error code, 0 if the image decoded
+		unsigned int error = 0;
+	};
+
+	// Where one channel of a packed texture comes from
+	struct ChannelSource
+	{
+		// An empty path fills the channel with default_value
+		std::string path;
+		// Which channel of the source image to take
+		uint32_t channel = 0;
+		unsigned char default_value = 0;
+	};
+
+	// Called on the thread that called DecodeImages, once per image. index is the images position in the path list
+	typedef std::function<void(uint32_t index, DecodedImage& image)> DecodedImageCallback;
+
+	// Decode a list of pngs on worker threads. Images are handed to the callback in the order they finish decoding, so
+	// the caller can be copying one image into staging memory while the workers are still decoding the rest. The pixels
+	// are freed once the callback returns. Passing a thread_count of 0 uses one thread per CPU core
+	void DecodeImages(const std::vector<std::string>& paths, uint32_t thread_count, const DecodedImageCallback& callback);
+
+	// Pack one channel from each of up to four greyscale or color pngs into a single RGBA8 image, so a material needs one
+	// texture and one sampler where it would have needed four. The sources are decoded on worker threads and must all be
+	// the same size. Returns false if there are no sources, the sources differ in size or one could not be decoded, in which
+	// case packed.path names the source and packed.error holds the lodepng error
+	bool DecodePackedImage(const ChannelSource sources[4], uint32_t thread_count, DecodedImage& packed);
+}
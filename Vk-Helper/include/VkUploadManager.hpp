@@ -0,0 +1,137 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <deque>
+
+#include <VkAllocator.hpp>
+#include <VkMipmaps.hpp>
+
+namespace VkHelper
+{
+	struct DeviceDispatch;
+
+	// A group of uploads that were submitted together
+	struct UploadBatch
+	{
+		uint64_t id = 0;
+		VkFence fence = VK_NULL_HANDLE;
+		// Signaled by the transfer queue and waited on by the graphics queue when ownership needs to change
+		VkSemaphore semaphore = VK_NULL_HANDLE;
+		VkCommandBuffer transfer_command_buffer = VK_NULL_HANDLE;
+		VkCommandBuffer acquire_command_buffer = VK_NULL_HANDLE;
+		// Region of the staging ring the batch is reading from
+		VkDeviceSize staging_begin = 0;
+		VkDeviceSize staging_end = 0;
+	};
+
+	// Tightly packed data for one mip level of a image
+	struct ImageLevel
+	{
+		const void* data = nullptr;
+		VkDeviceSize size = 0;
+		uint32_t width = 0;
+		uint32_t height = 0;
+	};
+
+	// A image whose mips still need to be generated once the graphics queue owns it
+	struct PendingMipmaps
+	{
+		VkImage image = VK_NULL_HANDLE;
+		VkFormat format = VK_FORMAT_UNDEFINED;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint32_t mip_levels = 1;
+		VkImageLayout final_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VkAccessFlags dst_access = 0;
+		VkPipelineStageFlags dst_stage = 0;
+	};
+
+	// Packs many buffer and image uploads into a shared staging ring and one command buffer per submit.
+	// When the device has a transfer only queue family the copies run there and ownership of the resources
+	// is handed over to the graphics queue family with release/acquire barriers.
+	// The upload manager is not thread safe, all calls should come from the same thread
+	struct UploadManager
+	{
+		VkDevice device = VK_NULL_HANDLE;
+		// Recording and submitting the uploads goes through the devices own functions
+		const DeviceDispatch* dispatch = nullptr;
+
+		VkQueue transfer_queue = VK_NULL_HANDLE;
+		uint32_t transfer_queue_family = 0;
+		VkCommandPool transfer_command_pool = VK_NULL_HANDLE;
+
+		VkQueue graphics_queue = VK_NULL_HANDLE;
+		uint32_t graphics_queue_family = 0;
+		VkCommandPool graphics_command_pool = VK_NULL_HANDLE;
+
+		VkBuffer staging_buffer = VK_NULL_HANDLE;
+		Allocation staging_allocation;
+		VkDeviceSize staging_size = 0;
+		// Where the next staging allocation will be made from
+		VkDeviceSize staging_head = 0;
+
+		// Batch that is currently being recorded
+		UploadBatch recording_batch;
+		bool recording = false;
+		// Barriers recorded at the end of the transfer command buffer. When the queue families differ these release ownership
+		std::vector<VkBufferMemoryBarrier> buffer_release_barriers;
+		std::vector<VkImageMemoryBarrier> image_release_barriers;
+		// Barriers that need to be recorded on the graphics queue to take ownership of the resources
+		std::vector<VkBufferMemoryBarrier> buffer_acquire_barriers;
+		std::vector<VkImageMemoryBarrier> image_acquire_barriers;
+		VkPipelineStageFlags acquire_stages = 0;
+
+		// Used by UploadImageMipmapped. Mips are generated on the graphics queue, so when the queue families
+		// differ they are recorded after the acquire barriers
+		MipmapGenerator* mipmap_generator = nullptr;
+		std::vector<PendingMipmaps> pending_mipmaps;
+
+		// Batches that have been submitted, oldest first
+		std::deque<UploadBatch> in_flight_batches;
+		// Fences and semaphores from completed batches, ready to be reused
+		std::vector<VkFence> free_fences;
+		std::vector<VkSemaphore> free_semaphores;
+
+		uint64_t next_batch_id = 1;
+		// Every batch up to and including this id has finished on the GPU
+		uint64_t completed_batch_id = 0;
+	};
+
+	// Look for a queue family that only supports transfer work, this normally maps to the GPUs DMA engines
+	bool FindTransferQueueFamily(const VkPhysicalDevice& physical_device, uint32_t& queue_family_index);
+
+	// If there is no dedicated transfer queue, pass the graphics queue and family as the transfer queue
+	void CreateUploadManager(const VkDevice& device, Allocator& allocator, const VkQueue& transfer_queue, uint32_t transfer_queue_family,
+		const VkQueue& graphics_queue, uint32_t graphics_queue_family, VkDeviceSize staging_size, UploadManager& upload_manager);
+
+	// Waits for all uploads to finish then releases everything
+	void DestroyUploadManager(Allocator& allocator, UploadManager& upload_manager);
+
+	// Copy data into a buffer. dst_access and dst_stage describe how the graphics queue will use the buffer afterwards
+	void UploadBuffer(UploadManager& upload_manager, const void* data, VkDeviceSize size, VkBuffer dst_buffer, VkDeviceSize dst_offset,
+		VkAccessFlags dst_access, VkPipelineStageFlags dst_stage);
+
+	// Copy tightly packed pixel data into the first mip of a image that is in VK_IMAGE_LAYOUT_UNDEFINED, leaving it in final_layout
+	void UploadImage(UploadManager& upload_manager, const void* data, VkDeviceSize size, VkImage dst_image, uint32_t width, uint32_t height,
+		VkImageLayout final_layout, VkAccessFlags dst_access, VkPipelineStageFlags dst_stage);
+
+	// Copy pre-built mip levels into a image that is in VK_IMAGE_LAYOUT_UNDEFINED, levels[i] is copied into mip i.
+	// Block compressed data can be uploaded this way as the copies are made straight from the staging ring
+	void UploadImageLevels(UploadManager& upload_manager, const ImageLevel* levels, uint32_t level_count, VkImage dst_image,
+		VkImageLayout final_layout, VkAccessFlags dst_access, VkPipelineStageFlags dst_stage);
+
+	// Copy tightly packed pixel data into the first mip of a image that is in VK_IMAGE_LAYOUT_UNDEFINED, then generate the
+	// rest of its mip chain. The image needs the usage flags from MipmapImageUsage and upload_manager.mipmap_generator must be set.
+	// The mipmap generator resources are only safe to release once the batch has finished
+	void UploadImageMipmapped(UploadManager& upload_manager, const void* data, VkDeviceSize size, VkImage dst_image, VkFormat format,
+		uint32_t width, uint32_t height, uint32_t mip_levels, VkImageLayout final_layout, VkAccessFlags dst_access, VkPipelineStageFlags dst_stage);
+
+	// Submit everything recorded since the last submit. The returned id can be polled or waited on
+	uint64_t SubmitUploads(UploadManager& upload_manager);
+
+	// Check without blocking if the uploads in the batch have finished
+	bool IsUploadComplete(UploadManager& upload_manager, uint64_t batch_id);
+
+	void WaitForUpload(UploadManager& upload_manager, uint64_t batch_id);
+}
@@ -0,0 +1,308 @@
+#include <VkAllocator.hpp>
+#include <VkCore.hpp>
+#include <VkInitializers.hpp>
+#include <assert.h>
+
+namespace
+{
+	VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	bool IsHostVisible(const VkHelper::Allocator& allocator, uint32_t memory_type)
+	{
+		return (allocator.physical_device_mem_properties.memoryTypes[memory_type].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0;
+	}
+
+	bool IsHostCoherent(const VkHelper::Allocator& allocator, uint32_t memory_type)
+	{
+		return (allocator.physical_device_mem_properties.memoryTypes[memory_type].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+	}
+
+	// Allocate a new VkDeviceMemory and map it if it is host visible
+	bool AllocateDeviceMemory(const VkHelper::Allocator& allocator, VkDeviceSize size, uint32_t memory_type, VkDeviceMemory& memory, void*& mapped_memory)
+	{
+		VkMemoryAllocateInfo memory_allocate_info = VkHelper::MemroyAllocateInfo(
+			size,                                                           // How much memory we wish to allocate on the GPU
+			memory_type                                                     // What type of memory we want to allocate
+		);
+
+		VkResult memory_allocation_result = vkAllocateMemory(
+			allocator.device,                                               // What device we want to allocate the memory on
+			&memory_allocate_info,                                          // The allocate info for memory allocation
+			nullptr,                                                        // ...
+			&memory                                                         // The output for the memory
+		);
+
+		// We may have run out of memory in this heap, let the caller decide what to do
+		if (memory_allocation_result != VK_SUCCESS) return false;
+
+		mapped_memory = nullptr;
+		if (IsHostVisible(allocator, memory_type))
+		{
+			// Memory can only be mapped once, so we map the whole block and hand out pointers into it
+			VkResult mapped_memory_result = vkMapMemory(
+				allocator.device,                                           // The device that the memory is on
+				memory,                                                     // The device memory instance
+				0,                                                          // Offset from the memory starts that we are accessing
+				VK_WHOLE_SIZE,                                              // How much memory are we accessing
+				0,                                                          // Flags (we don't need this for basic buffers)
+				&mapped_memory                                              // The return for the memory pointer
+			);
+
+			// Could we map the GPU memory to our CPU accessible pointer
+			assert(mapped_memory_result == VK_SUCCESS);
+		}
+		return true;
+	}
+
+	void FreeDeviceMemory(const VkHelper::Allocator& allocator, VkDeviceMemory& memory, void*& mapped_memory)
+	{
+		if (mapped_memory != nullptr)
+		{
+			vkUnmapMemory(
+				allocator.device,
+				memory
+			);
+			mapped_memory = nullptr;
+		}
+
+		vkFreeMemory(
+			allocator.device,
+			memory,
+			nullptr
+		);
+		memory = VK_NULL_HANDLE;
+	}
+
+	// First fit search through the blocks free ranges, splitting the range we land in
+	bool AllocateFromBlock(VkHelper::MemoryBlock& block, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset)
+	{
+		for (uint32_t i = 0; i < block.free_ranges.size(); i++)
+		{
+			VkHelper::MemoryRange& range = block.free_ranges[i];
+			VkDeviceSize aligned_offset = AlignUp(range.offset, alignment);
+			VkDeviceSize padding = aligned_offset - range.offset;
+
+			if (padding + size > range.size) continue;
+
+			VkHelper::MemoryRange before = { range.offset, padding };
+			VkHelper::MemoryRange after = { aligned_offset + size, range.size - padding - size };
+
+			// Replace the range with what is left on either side of the allocation
+			block.free_ranges.erase(block.free_ranges.begin() + i);
+			if (after.size > 0) block.free_ranges.insert(block.free_ranges.begin() + i, after);
+			if (before.size > 0) block.free_ranges.insert(block.free_ranges.begin() + i, before);
+
+			offset = aligned_offset;
+			block.allocation_count++;
+			return true;
+		}
+		return false;
+	}
+
+	// Put the range back into the free list, merging with its neighbours
+	void ReturnToBlock(VkHelper::MemoryBlock& block, VkDeviceSize offset, VkDeviceSize size)
+	{
+		uint32_t i = 0;
+		while (i < block.free_ranges.size() && block.free_ranges[i].offset < offset) i++;
+
+		block.free_ranges.insert(block.free_ranges.begin() + i, { offset, size });
+
+		// Merge with the next range
+		if (i + 1 < block.free_ranges.size() && block.free_ranges[i].offset + block.free_ranges[i].size == block.free_ranges[i + 1].offset)
+		{
+			block.free_ranges[i].size += block.free_ranges[i + 1].size;
+			block.free_ranges.erase(block.free_ranges.begin() + i + 1);
+		}
+		// Merge with the previous range
+		if (i > 0 && block.free_ranges[i - 1].offset + block.free_ranges[i - 1].size == block.free_ranges[i].offset)
+		{
+			block.free_ranges[i - 1].size += block.free_ranges[i].size;
+			block.free_ranges.erase(block.free_ranges.begin() + i);
+		}
+
+		block.allocation_count--;
+	}
+}
+
+void VkHelper::CreateAllocator(const VkDevice& device, const VkPhysicalDeviceProperties& physical_device_properties, const VkPhysicalDeviceMemoryProperties& physical_device_mem_properties,
+	Allocator& allocator, VkDeviceSize block_size)
+{
+	allocator.device = device;
+	allocator.physical_device_mem_properties = physical_device_mem_properties;
+	allocator.buffer_image_granularity = physical_device_properties.limits.bufferImageGranularity;
+	allocator.non_coherent_atom_size = physical_device_properties.limits.nonCoherentAtomSize;
+	allocator.block_size = block_size;
+	allocator.dedicated_allocation_count = 0;
+	allocator.dedicated_allocation_size = 0;
+	allocator.blocks.clear();
+}
+
+void VkHelper::DestroyAllocator(Allocator& allocator)
+{
+	std::lock_guard<std::mutex> guard(allocator.lock);
+
+	for (MemoryBlock& block : allocator.blocks)
+	{
+		if (block.memory == VK_NULL_HANDLE) continue;
+		// Anything still in the block at this point has been leaked by the user
+		assert(block.allocation_count == 0 && "Allocator destroyed with live allocations");
+		FreeDeviceMemory(allocator, block.memory, block.mapped_memory);
+	}
+	allocator.blocks.clear();
+
+	assert(allocator.dedicated_allocation_count == 0 && "Allocator destroyed with live dedicated allocations");
+}
+
+bool VkHelper::Allocate(Allocator& allocator, const VkMemoryRequirements& memory_requirements, VkMemoryPropertyFlags memory_properties, bool linear,
+	Allocation& allocation, bool dedicated)
+{
+	// Find the memory type required for this resource
+	uint32_t memory_type = FindMemoryType(
+		allocator.physical_device_mem_properties,                       // Properties describing the memory avaliable on the GPU
+		memory_requirements.memoryTypeBits,                             // What memory type vulkan has told us we need
+		memory_properties                                               // What properties do we rquire of our memory
+	);
+
+	VkDeviceSize alignment = memory_requirements.alignment;
+	VkDeviceSize size = memory_requirements.size;
+
+	// Flushing and invalidating non coherent memory works on whole atoms, so keep each resource in its own atoms
+	if (IsHostVisible(allocator, memory_type) && !IsHostCoherent(allocator, memory_type))
+	{
+		if (allocator.non_coherent_atom_size > alignment) alignment = allocator.non_coherent_atom_size;
+		size = AlignUp(size, allocator.non_coherent_atom_size);
+	}
+
+	// Don't let one block eat a large part of a small heap
+	const VkDeviceSize heap_size = allocator.physical_device_mem_properties.memoryHeaps[allocator.physical_device_mem_properties.memoryTypes[memory_type].heapIndex].size;
+	VkDeviceSize block_size = allocator.block_size;
+	if (block_size > heap_size / 8) block_size = heap_size / 8;
+
+	allocation.memory_type = memory_type;
+	allocation.size = size;
+
+	std::lock_guard<std::mutex> guard(allocator.lock);
+
+	if (dedicated || size > block_size / 2)
+	{
+		if (!AllocateDeviceMemory(allocator, size, memory_type, allocation.memory, allocation.mapped_memory)) return false;
+		allocation.offset = 0;
+		allocation.block_index = DEDICATED_ALLOCATION;
+		allocator.dedicated_allocation_count++;
+		allocator.dedicated_allocation_size += size;
+		return true;
+	}
+
+	// Try and fit the allocation into one of the existing blocks
+	uint32_t empty_slot = DEDICATED_ALLOCATION;
+	for (uint32_t i = 0; i < allocator.blocks.size(); i++)
+	{
+		MemoryBlock& block = allocator.blocks[i];
+		if (block.memory == VK_NULL_HANDLE)
+		{
+			empty_slot = i;
+			continue;
+		}
+		if (block.memory_type != memory_type || block.linear != linear) continue;
+
+		VkDeviceSize offset = 0;
+		if (AllocateFromBlock(block, size, alignment, offset))
+		{
+			allocation.memory = block.memory;
+			allocation.offset = offset;
+			allocation.block_index = i;
+			allocation.mapped_memory = block.mapped_memory != nullptr ? static_cast<char*>(block.mapped_memory) + offset : nullptr;
+			return true;
+		}
+	}
+
+	// No room anywhere, so we need to create a new block
+	MemoryBlock block;
+	block.size = block_size;
+	block.memory_type = memory_type;
+	block.linear = linear;
+	if (!AllocateDeviceMemory(allocator, block.size, memory_type, block.memory, block.mapped_memory)) return false;
+	block.free_ranges.push_back({ 0, block.size });
+
+	if (empty_slot == DEDICATED_ALLOCATION)
+	{
+		empty_slot = static_cast<uint32_t>(allocator.blocks.size());
+		allocator.blocks.push_back(block);
+	}
+	else
+	{
+		allocator.blocks[empty_slot] = block;
+	}
+
+	MemoryBlock& new_block = allocator.blocks[empty_slot];
+	VkDeviceSize offset = 0;
+	bool allocated = AllocateFromBlock(new_block, size, alignment, offset);
+	assert(allocated);
+
+	allocation.memory = new_block.memory;
+	allocation.offset = offset;
+	allocation.block_index = empty_slot;
+	allocation.mapped_memory = new_block.mapped_memory != nullptr ? static_cast<char*>(new_block.mapped_memory) + offset : nullptr;
+	return allocated;
+}
+
+void VkHelper::Free(Allocator& allocator, Allocation& allocation)
+{
+	if (allocation.memory == VK_NULL_HANDLE) return;
+
+	std::lock_guard<std::mutex> guard(allocator.lock);
+
+	if (allocation.block_index == DEDICATED_ALLOCATION)
+	{
+		FreeDeviceMemory(allocator, allocation.memory, allocation.mapped_memory);
+		allocator.dedicated_allocation_count--;
+		allocator.dedicated_allocation_size -= allocation.size;
+	}
+	else
+	{
+		MemoryBlock& block = allocator.blocks[allocation.block_index];
+		ReturnToBlock(block, allocation.offset, allocation.size);
+
+		// Give empty blocks back to the driver, but keep one per memory type around so we don't thrash
+		if (block.allocation_count == 0)
+		{
+			for (uint32_t i = 0; i < allocator.blocks.size(); i++)
+			{
+				const MemoryBlock& other = allocator.blocks[i];
+				if (i == allocation.block_index || other.memory == VK_NULL_HANDLE) continue;
+				if (other.memory_type == block.memory_type && other.linear == block.linear)
+				{
+					FreeDeviceMemory(allocator, block.memory, block.mapped_memory);
+					block.free_ranges.clear();
+					break;
+				}
+			}
+		}
+	}
+
+	allocation = Allocation();
+}
+
+void VkHelper::GetAllocatorStats(Allocator& allocator, uint32_t& device_memory_count, VkDeviceSize& allocated_size, VkDeviceSize& used_size)
+{
+	std::lock_guard<std::mutex> guard(allocator.lock);
+
+	// A dedicated allocation is the whole of its VkDeviceMemory, so all of it is in use
+	device_memory_count = allocator.dedicated_allocation_count;
+	allocated_size = allocator.dedicated_allocation_size;
+	used_size = allocator.dedicated_allocation_size;
+	for (const MemoryBlock& block : allocator.blocks)
+	{
+		if (block.memory == VK_NULL_HANDLE) continue;
+		device_memory_count++;
+		allocated_size += block.size;
+		used_size += block.size;
+		for (const MemoryRange& range : block.free_ranges)
+		{
+			used_size -= range.size;
+		}
+	}
+}
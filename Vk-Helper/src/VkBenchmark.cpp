@@ -0,0 +1,180 @@
+#include <VkBenchmark.hpp>
+#include <VkAllocator.hpp>
+#include <VkGpuProfiler.hpp>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <fstream>
+
+namespace
+{
+	float Percentile(const std::vector<float>& sorted, float percentile)
+	{
+		size_t index = static_cast<size_t>(percentile * (sorted.size() - 1) + 0.5f);
+		return sorted[std::min(index, sorted.size() - 1)];
+	}
+
+	// Names are written into the results as JSON strings
+	std::string EscapeJson(const std::string& text)
+	{
+		std::string escaped;
+		for (char c : text)
+		{
+			if (c == '"' || c == '\\') escaped += '\\';
+			escaped += c;
+		}
+		return escaped;
+	}
+
+	// The summary and every sample, the runner does its own statistics from the samples when comparing runs
+	void WriteTimings(std::ofstream& file, const std::vector<float>& samples)
+	{
+		std::vector<float> sorted = samples;
+		std::sort(sorted.begin(), sorted.end());
+
+		float average = 0.0f;
+		for (float ms : sorted) average += ms;
+		if (!sorted.empty()) average /= sorted.size();
+
+		file << "\"frames\":" << sorted.size() << ",\"average\":" << average;
+		if (!sorted.empty())
+		{
+			file << ",\"p50\":" << Percentile(sorted, 0.50f) << ",\"p95\":" << Percentile(sorted, 0.95f)
+				<< ",\"p99\":" << Percentile(sorted, 0.99f) << ",\"max\":" << sorted.back();
+		}
+		file << ",\"samples\":[";
+		for (size_t i = 0; i < samples.size(); i++)
+		{
+			if (i > 0) file << ",";
+			file << samples[i];
+		}
+		file << "]";
+	}
+
+	void SampleDeviceMemory(VkHelper::BenchmarkRecorder& recorder)
+	{
+		if (recorder.allocator == nullptr) return;
+
+		uint32_t device_memory_count = 0;
+		VkDeviceSize allocated_size = 0;
+		VkDeviceSize used_size = 0;
+		VkHelper::GetAllocatorStats(*recorder.allocator, device_memory_count, allocated_size, used_size);
+		recorder.peak_device_memory = std::max(recorder.peak_device_memory, allocated_size);
+	}
+}
+
+VkHelper::BenchmarkOptions VkHelper::ParseBenchmarkOptions(int argc, char** argv)
+{
+	BenchmarkOptions options;
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		if (strcmp(argv[i], "--benchmark") == 0) options.output_path = argv[++i];
+		else if (strcmp(argv[i], "--warmup") == 0) options.warmup_frames = static_cast<uint32_t>(atoi(argv[++i]));
+	}
+	return options;
+}
+
+void VkHelper::StartBenchmark(const BenchmarkOptions& options, const char* sample_name, BenchmarkRecorder& recorder)
+{
+	recorder.enabled = !options.output_path.empty();
+	recorder.output_path = options.output_path;
+	recorder.sample_name = sample_name;
+	recorder.warmup_frames = options.warmup_frames;
+	recorder.startup_phases.clear();
+	recorder.frames_seen = 0;
+	recorder.frame_ms.clear();
+	recorder.peak_device_memory = 0;
+	recorder.last_mark = std::chrono::steady_clock::now();
+	recorder.last_frame = recorder.last_mark;
+}
+
+void VkHelper::MarkBenchmarkPhase(BenchmarkRecorder& recorder, const char* name)
+{
+	if (!recorder.enabled) return;
+
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	BenchmarkPhase phase;
+	phase.name = name;
+	phase.ms = std::chrono::duration_cast<std::chrono::microseconds>(now - recorder.last_mark).count() / 1000.0f;
+	recorder.startup_phases.push_back(phase);
+
+	// The first frame is timed from the last phase of startup
+	recorder.last_mark = now;
+	recorder.last_frame = now;
+
+	SampleDeviceMemory(recorder);
+}
+
+void VkHelper::RecordBenchmarkFrame(BenchmarkRecorder& recorder)
+{
+	if (!recorder.enabled) return;
+
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	float ms = std::chrono::duration_cast<std::chrono::microseconds>(now - recorder.last_frame).count() / 1000.0f;
+	recorder.last_frame = now;
+	recorder.frames_seen++;
+
+	SampleDeviceMemory(recorder);
+
+	if (recorder.frames_seen <= recorder.warmup_frames) return;
+
+	// Throw away whatever the GPU profiler saw during the warm up. The timings are read back a few frames late, so
+	// nothing from the measured frames has been read yet
+	if (recorder.frames_seen == recorder.warmup_frames + 1 && recorder.gpu_profiler != nullptr)
+	{
+		VkHelper::ResetGpuScopeHistory(*recorder.gpu_profiler, recorder.max_samples);
+	}
+
+	if (recorder.frame_ms.size() < recorder.max_samples) recorder.frame_ms.push_back(ms);
+}
+
+bool VkHelper::WriteBenchmarkResults(BenchmarkRecorder& recorder)
+{
+	if (!recorder.enabled) return true;
+
+	std::ofstream file(recorder.output_path.c_str(), std::ios::trunc);
+	if (!file.is_open()) return false;
+
+	SampleDeviceMemory(recorder);
+
+	file << "{\n\"sample\":\"" << EscapeJson(recorder.sample_name) << "\",\n\"warmup_frames\":" << recorder.warmup_frames << ",\n";
+
+	file << "\"startup_ms\":[";
+	for (size_t i = 0; i < recorder.startup_phases.size(); i++)
+	{
+		if (i > 0) file << ",";
+		file << "\n{\"name\":\"" << EscapeJson(recorder.startup_phases[i].name) << "\",\"ms\":" << recorder.startup_phases[i].ms << "}";
+	}
+	file << "\n],\n";
+
+	file << "\"cpu_frame_ms\":{";
+	WriteTimings(file, recorder.frame_ms);
+	file << "},\n";
+
+	// Only the scopes the GPU profiler has read back since the warm up, none if the profiler is off
+	file << "\"gpu_ms\":[";
+	bool first_scope = true;
+	if (recorder.gpu_profiler != nullptr)
+	{
+		const GpuProfiler& profiler = *recorder.gpu_profiler;
+		for (size_t scope = 0; scope < profiler.scope_names.size() && scope < profiler.history.size(); scope++)
+		{
+			if (profiler.history[scope].empty()) continue;
+			if (!first_scope) file << ",";
+			first_scope = false;
+			file << "\n{\"name\":\"" << EscapeJson(profiler.scope_names[scope]) << "\",";
+			WriteTimings(file, profiler.history[scope]);
+			file << "}";
+		}
+	}
+	file << "\n],\n";
+
+	// Only counts memory that came from the allocator, null for samples that allocate their memory directly
+	file << "\"peak_device_memory_bytes\":";
+	if (recorder.allocator != nullptr) file << recorder.peak_device_memory;
+	else file << "null";
+	file << "\n}\n";
+
+	return file.good();
+}
@@ -0,0 +1,245 @@
+#include <VkCommandRecorder.hpp>
+#include <VkInitializers.hpp>
+#include <VkCore.hpp>
+#include <VkDispatch.hpp>
+#include <VkCpuProfiler.hpp>
+#include <assert.h>
+
+namespace
+{
+	// Take the next job from this threads own queue, or failing that, steal one from the back of another threads queue
+	bool NextJob(VkHelper::CommandRecorder& recorder, uint32_t thread_index, uint32_t& job_index)
+	{
+		{
+			VkHelper::CommandRecorder::WorkQueue& own_queue = *recorder.work_queues[thread_index];
+			std::lock_guard<std::mutex> lock(own_queue.lock);
+			if (!own_queue.jobs.empty())
+			{
+				job_index = own_queue.jobs.front();
+				own_queue.jobs.pop_front();
+				return true;
+			}
+		}
+		for (uint32_t i = 1; i < recorder.thread_count; i++)
+		{
+			VkHelper::CommandRecorder::WorkQueue& other_queue = *recorder.work_queues[(thread_index + i) % recorder.thread_count];
+			std::lock_guard<std::mutex> lock(other_queue.lock);
+			if (!other_queue.jobs.empty())
+			{
+				job_index = other_queue.jobs.back();
+				other_queue.jobs.pop_back();
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Hand out the next secondary command buffer from this threads pool for the frame, allocating one if they are all in use
+	VkCommandBuffer GrabCommandBuffer(VkHelper::CommandRecorder& recorder, uint32_t frame_index, uint32_t thread_index)
+	{
+		VkHelper::CommandRecorder::ThreadCommandPool& pool = recorder.thread_command_pools[frame_index * recorder.thread_count + thread_index];
+
+		if (pool.used == pool.command_buffers.size())
+		{
+			VkCommandBufferAllocateInfo allocate_info = VkHelper::CommandBufferAllocateInfo(
+				pool.command_pool,
+				1
+			);
+			allocate_info.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+
+			VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+			VkResult allocate_command_buffer_result = vkAllocateCommandBuffers(
+				recorder.device,
+				&allocate_info,
+				&command_buffer
+			);
+			assert(allocate_command_buffer_result == VK_SUCCESS);
+			pool.command_buffers.push_back(command_buffer);
+		}
+
+		return pool.command_buffers[pool.used++];
+	}
+
+	void RecordJob(VkHelper::CommandRecorder& recorder, uint32_t thread_index, uint32_t job_index)
+	{
+		VK_HELPER_CPU_ZONE("Record secondary command buffer");
+
+		const VkHelper::SecondaryRecordJob& job = recorder.jobs[job_index];
+		assert(job.frame_index < recorder.frame_count);
+
+		VkCommandBuffer command_buffer = GrabCommandBuffer(recorder, job.frame_index, thread_index);
+
+		VkCommandBufferInheritanceInfo inheritance = job.inheritance;
+		inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+
+		VkCommandBufferBeginInfo begin_info = VkHelper::CommandBufferBeginInfo(job.usage_flags);
+		begin_info.pInheritanceInfo = &inheritance;
+
+		VkResult begin_command_buffer_result = recorder.dispatch->vkBeginCommandBuffer(
+			command_buffer,
+			&begin_info
+		);
+		assert(begin_command_buffer_result == VK_SUCCESS);
+
+		job.record(command_buffer);
+
+		VkResult end_command_buffer_result = recorder.dispatch->vkEndCommandBuffer(
+			command_buffer
+		);
+		assert(end_command_buffer_result == VK_SUCCESS);
+
+		recorder.secondary_command_buffers[job_index] = command_buffer;
+	}
+
+	// Keep recording until there are no jobs left in any queue
+	void DrainJobs(VkHelper::CommandRecorder& recorder, uint32_t thread_index)
+	{
+		uint32_t job_index;
+		while (NextJob(recorder, thread_index, job_index))
+		{
+			RecordJob(recorder, thread_index, job_index);
+
+			std::lock_guard<std::mutex> lock(recorder.lock);
+			recorder.jobs_remaining--;
+			if (recorder.jobs_remaining == 0) recorder.work_finished.notify_all();
+		}
+	}
+
+	void WorkerLoop(VkHelper::CommandRecorder& recorder, uint32_t thread_index)
+	{
+		VK_HELPER_CPU_THREAD_NAME("Command recorder " + std::to_string(thread_index));
+
+		uint64_t seen_batch = 0;
+		while (true)
+		{
+			{
+				std::unique_lock<std::mutex> lock(recorder.lock);
+				recorder.work_available.wait(lock, [&] { return recorder.stopping || recorder.batch != seen_batch; });
+				if (recorder.stopping) return;
+				seen_batch = recorder.batch;
+			}
+			DrainJobs(recorder, thread_index);
+		}
+	}
+}
+
+void VkHelper::CreateCommandRecorder(const VkDevice& device, uint32_t queue_family, uint32_t frame_count, uint32_t thread_count, CommandRecorder& recorder)
+{
+	assert(frame_count > 0);
+
+	if (thread_count == 0) thread_count = std::thread::hardware_concurrency();
+	if (thread_count == 0) thread_count = 1;
+
+	recorder.device = device;
+	recorder.dispatch = &VkHelper::GetDeviceDispatch(device);
+	recorder.frame_count = frame_count;
+	recorder.thread_count = thread_count;
+	recorder.stopping = false;
+	recorder.batch = 0;
+	recorder.jobs_remaining = 0;
+
+	// Transient as the pools are reset every time the frame is recorded
+	recorder.thread_command_pools.resize(frame_count * thread_count);
+	for (CommandRecorder::ThreadCommandPool& pool : recorder.thread_command_pools)
+	{
+		pool.command_pool = VkHelper::CreateCommandPool(
+			device,
+			queue_family,
+			VK_COMMAND_POOL_CREATE_TRANSIENT_BIT
+		);
+		pool.used = 0;
+	}
+
+	for (uint32_t i = 0; i < thread_count; i++)
+	{
+		recorder.work_queues.push_back(std::unique_ptr<CommandRecorder::WorkQueue>(new CommandRecorder::WorkQueue()));
+	}
+
+	// Thread 0 is whichever thread calls RecordSecondaryCommandBuffers
+	for (uint32_t i = 1; i < thread_count; i++)
+	{
+		recorder.workers.push_back(std::thread(WorkerLoop, std::ref(recorder), i));
+	}
+}
+
+void VkHelper::DestroyCommandRecorder(CommandRecorder& recorder)
+{
+	{
+		std::lock_guard<std::mutex> lock(recorder.lock);
+		recorder.stopping = true;
+	}
+	recorder.work_available.notify_all();
+
+	for (std::thread& worker : recorder.workers)
+	{
+		worker.join();
+	}
+	recorder.workers.clear();
+	recorder.work_queues.clear();
+
+	// Destroying the pools frees their command buffers
+	for (CommandRecorder::ThreadCommandPool& pool : recorder.thread_command_pools)
+	{
+		vkDestroyCommandPool(
+			recorder.device,
+			pool.command_pool,
+			nullptr
+		);
+	}
+	recorder.thread_command_pools.clear();
+}
+
+void VkHelper::BeginRecorderFrame(CommandRecorder& recorder, uint32_t frame_index)
+{
+	assert(frame_index < recorder.frame_count);
+
+	for (uint32_t i = 0; i < recorder.thread_count; i++)
+	{
+		CommandRecorder::ThreadCommandPool& pool = recorder.thread_command_pools[frame_index * recorder.thread_count + i];
+
+		// One reset for the whole pool rather than resetting each command buffer
+		VkResult reset_command_pool_result = recorder.dispatch->vkResetCommandPool(
+			recorder.device,
+			pool.command_pool,
+			0
+		);
+		assert(reset_command_pool_result == VK_SUCCESS);
+		pool.used = 0;
+	}
+}
+
+void VkHelper::RecordSecondaryCommandBuffers(CommandRecorder& recorder, const SecondaryRecordJob* jobs, uint32_t job_count, VkCommandBuffer* secondary_command_buffers)
+{
+	if (job_count == 0) return;
+
+	VK_HELPER_CPU_ZONE("RecordSecondaryCommandBuffers");
+
+	{
+		std::lock_guard<std::mutex> lock(recorder.lock);
+		recorder.jobs = jobs;
+		recorder.secondary_command_buffers = secondary_command_buffers;
+		recorder.jobs_remaining = job_count;
+	}
+
+	// Deal the jobs out round robin, any thread that finishes early steals from the others
+	for (uint32_t i = 0; i < job_count; i++)
+	{
+		CommandRecorder::WorkQueue& queue = *recorder.work_queues[i % recorder.thread_count];
+		std::lock_guard<std::mutex> lock(queue.lock);
+		queue.jobs.push_back(i);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(recorder.lock);
+		recorder.batch++;
+	}
+	recorder.work_available.notify_all();
+
+	// Record on this thread too rather than sitting idle
+	DrainJobs(recorder, 0);
+
+	std::unique_lock<std::mutex> lock(recorder.lock);
+	recorder.work_finished.wait(lock, [&] { return recorder.jobs_remaining == 0; });
+	recorder.jobs = nullptr;
+	recorder.secondary_command_buffers = nullptr;
+}
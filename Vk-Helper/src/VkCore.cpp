@@ -1,5 +1,7 @@
 #include <VkCore.hpp>
 #include <VkInitializers.hpp>
+#include <VkPipelineCache.hpp>
+#include <VkDispatch.hpp>
 #include <assert.h>
 #include <stdio.h>
 #include <string.h>
@@ -7,6 +9,9 @@
 #include <fstream>
 
 
+// The loader doesn't export the ray tracing functions, so they are defined here and call into the table of the device
+// they are given. Every device gets its own table, so these work with more than one device
+
 VKAPI_ATTR VkResult VKAPI_CALL
 vkCreateRayTracingPipelinesNV(VkDevice      device,
 	VkPipelineCache                         pipelineCache,
@@ -15,9 +20,7 @@ vkCreateRayTracingPipelinesNV(VkDevice      device,
 	const VkAllocationCallbacks* pAllocator,
 	VkPipeline* pPipelines)
 {
-	static const auto call = reinterpret_cast<PFN_vkCreateRayTracingPipelinesNV>(
-		vkGetDeviceProcAddr(device, "vkCreateRayTracingPipelinesNV"));
-	return call(device, pipelineCache, createInfoCount, pCreateInfos, pAllocator, pPipelines);
+	return VkHelper::GetDeviceDispatch(device).vkCreateRayTracingPipelinesNV(device, pipelineCache, createInfoCount, pCreateInfos, pAllocator, pPipelines);
 }
 
 VKAPI_ATTR VkResult VKAPI_CALL
@@ -26,9 +29,7 @@ vkCreateAccelerationStructureNV(VkDevice       device,
 	const VkAllocationCallbacks* pAllocator,
 	VkAccelerationStructureNV* pAccelerationStructure)
 {
-	static const auto call = reinterpret_cast<PFN_vkCreateAccelerationStructureNV>(
-		vkGetDeviceProcAddr(device, "vkCreateAccelerationStructureNV"));
-	return call(device, pCreateInfo, pAllocator, pAccelerationStructure);
+	return VkHelper::GetDeviceDispatch(device).vkCreateAccelerationStructureNV(device, pCreateInfo, pAllocator, pAccelerationStructure);
 }
 
 VKAPI_ATTR void VKAPI_CALL vkGetAccelerationStructureMemoryRequirementsNV(
@@ -36,9 +37,7 @@ VKAPI_ATTR void VKAPI_CALL vkGetAccelerationStructureMemoryRequirementsNV(
 	const VkAccelerationStructureMemoryRequirementsInfoNV* pInfo,
 	VkMemoryRequirements2KHR* pMemoryRequirements)
 {
-	static const auto call = reinterpret_cast<PFN_vkGetAccelerationStructureMemoryRequirementsNV>(
-		vkGetDeviceProcAddr(device, "vkGetAccelerationStructureMemoryRequirementsNV"));
-	return call(device, pInfo, pMemoryRequirements);
+	return VkHelper::GetDeviceDispatch(device).vkGetAccelerationStructureMemoryRequirementsNV(device, pInfo, pMemoryRequirements);
 }
 
 
@@ -47,9 +46,7 @@ vkBindAccelerationStructureMemoryNV(VkDevice       device,
 	uint32_t                                       bindInfoCount,
 	const VkBindAccelerationStructureMemoryInfoNV* pBindInfos)
 {
-	static const auto call = reinterpret_cast<PFN_vkBindAccelerationStructureMemoryNV>(
-		vkGetDeviceProcAddr(device, "vkBindAccelerationStructureMemoryNV"));
-	return call(device, bindInfoCount, pBindInfos);
+	return VkHelper::GetDeviceDispatch(device).vkBindAccelerationStructureMemoryNV(device, bindInfoCount, pBindInfos);
 }
 
 VKAPI_ATTR void VKAPI_CALL
@@ -65,9 +62,7 @@ vkCmdBuildAccelerationStructureNV(
 	VkBuffer                             scratch,
 	VkDeviceSize                         scratchOffset)
 {
-	static const auto call = reinterpret_cast<PFN_vkCmdBuildAccelerationStructureNV>(
-		vkGetDeviceProcAddr(device, "vkCmdBuildAccelerationStructureNV"));
-	return call(commandBuffer, pInfo, instanceData, instanceOffset, update, dst, src, scratch,
+	return VkHelper::GetDeviceDispatch(device).vkCmdBuildAccelerationStructureNV(commandBuffer, pInfo, instanceData, instanceOffset, update, dst, src, scratch,
 		scratchOffset);
 }
 
@@ -77,9 +72,7 @@ vkGetAccelerationStructureHandleNV(VkDevice device,
 	size_t                    dataSize,
 	void* pData)
 {
-	static const auto call = reinterpret_cast<PFN_vkGetAccelerationStructureHandleNV>(
-		vkGetDeviceProcAddr(device, "vkGetAccelerationStructureHandleNV"));
-	return call(device, accelerationStructure, dataSize, pData);
+	return VkHelper::GetDeviceDispatch(device).vkGetAccelerationStructureHandleNV(device, accelerationStructure, dataSize, pData);
 }
 
 VKAPI_ATTR VkResult VKAPI_CALL vkGetRayTracingShaderGroupHandlesNV(VkDevice   device,
@@ -89,9 +82,7 @@ VKAPI_ATTR VkResult VKAPI_CALL vkGetRayTracingShaderGroupHandlesNV(VkDevice   de
 	size_t     dataSize,
 	void* pData)
 {
-	static const auto call = reinterpret_cast<PFN_vkGetRayTracingShaderGroupHandlesNV>(
-		vkGetDeviceProcAddr(device, "vkGetRayTracingShaderGroupHandlesNV"));
-	return call(device, pipeline, firstGroup, groupCount, dataSize, pData);
+	return VkHelper::GetDeviceDispatch(device).vkGetRayTracingShaderGroupHandlesNV(device, pipeline, firstGroup, groupCount, dataSize, pData);
 }
 
 // A basic debug callback. A more advanced one could be created, but this will do for basic debugging
@@ -411,7 +402,7 @@ bool VkHelper::GetPhysicalDevice(const VkInstance& instance, VkPhysicalDevice &
 }
 
 VkDevice VkHelper::CreateDevice(const VkPhysicalDevice & physical_device, VkDeviceQueueCreateInfo * queue_infos, uint32_t queue_info_count, VkPhysicalDeviceFeatures & physical_device_features,
-	const char** extensions, unsigned int extensions_count)
+	const char** extensions, unsigned int extensions_count, const void* next)
 {
 	// Create a device create info for the device
 	VkDeviceCreateInfo device_create_info = VkHelper::DeviceCreateInfo(
@@ -421,6 +412,7 @@ VkDevice VkHelper::CreateDevice(const VkPhysicalDevice & physical_device, VkDevi
 		extensions,                                             // What device extentions do we want
 		extensions_count                                        // How many extentions
 	);
+	device_create_info.pNext = next;                            // Any extension feature structs we want enabled
 	VkDevice device = VK_NULL_HANDLE;
 	// Finish off by creating the device itself
 	VkResult result = vkCreateDevice(
@@ -433,6 +425,9 @@ VkDevice VkHelper::CreateDevice(const VkPhysicalDevice & physical_device, VkDevi
 	// Was the vulkan device created sucsessfully
 	assert(result == VK_SUCCESS);
 
+	// Fetch the devices own function pointers now, so the first lookup on a hot path doesn't have to
+	VkHelper::ReloadDeviceDispatch(device);
+
 	return device;
 }
 
@@ -690,7 +685,7 @@ VkExtent2D ChooseSwapExtent(const VkSurfaceCapabilitiesKHR & capabilities, uint3
 
 VkSwapchainKHR VkHelper::CreateSwapchain(const VkPhysicalDevice & physical_device, const VkDevice & device, const VkSurfaceKHR& surface, VkSurfaceCapabilitiesKHR & surface_capabilities,
 	VkSurfaceFormatKHR& surface_format, VkPresentModeKHR& present_mode, uint32_t window_width, uint32_t window_height, uint32_t& swapchain_image_count, std::unique_ptr<VkImage>& swapchain_images,
-	std::unique_ptr<VkImageView>& swapchain_image_views)
+	std::unique_ptr<VkImageView>& swapchain_image_views, VkSwapchainKHR old_swapchain)
 {
 	VkSwapchainKHR swapchain = VK_NULL_HANDLE;
 
@@ -729,7 +724,7 @@ VkSwapchainKHR VkHelper::CreateSwapchain(const VkPhysicalDevice & physical_devic
 	create_info.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;// | VK_IMAGE_USAGE_STORAGE_BIT; // VK_IMAGE_USAGE_STORAGE_BIT used for raytracing
 	create_info.presentMode = present_mode;
 	create_info.clipped = VK_TRUE; // If we can't see a pixel, get rid of it
-	create_info.oldSwapchain = VK_NULL_HANDLE; // We are not remaking the swapchain
+	create_info.oldSwapchain = old_swapchain; // When remaking the swapchain, the driver can hand resources over from the old one
 
 	create_info.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE; // image is owned by one queue family
 	create_info.queueFamilyIndexCount = 0;
@@ -837,22 +832,18 @@ VkSwapchainKHR VkHelper::CreateSwapchain(const VkPhysicalDevice & physical_devic
 }
 
 void VkHelper::CreateImage(const VkDevice& device, const VkPhysicalDeviceMemoryProperties& physical_device_mem_properties, uint32_t width, uint32_t height, VkFormat format,
-	VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage & image, VkDeviceMemory & image_memory, VkImageLayout initialLayout)
+	VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage & image, VkDeviceMemory & image_memory, VkImageLayout initialLayout,
+	uint32_t mip_levels)
 {
-	VkImageCreateInfo image_create_info = {};
-	image_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-	image_create_info.imageType = VK_IMAGE_TYPE_2D;
-	image_create_info.extent.width = width;
-	image_create_info.extent.height = height;
-	image_create_info.extent.depth = 1;
-	image_create_info.mipLevels = 1;
-	image_create_info.arrayLayers = 1;
-	image_create_info.format = format;
-	image_create_info.tiling = tiling;
-	image_create_info.initialLayout = initialLayout;
-	image_create_info.usage = usage;
-	image_create_info.samples = VK_SAMPLE_COUNT_1_BIT;
-	image_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	VkImageCreateInfo image_create_info = VkHelper::ImageCreateInfo(
+		width,
+		height,
+		format,
+		tiling,
+		usage,
+		initialLayout
+	);
+	image_create_info.mipLevels = mip_levels;                           // How many mip levels does the image have
 
 
 	VkResult create_image_info_result = vkCreateImage(
@@ -897,6 +888,130 @@ void VkHelper::CreateImage(const VkDevice& device, const VkPhysicalDeviceMemoryP
 	assert(bind_result == VK_SUCCESS);
 }
 
+bool VkHelper::CreateBuffer(const VkDevice& device, Allocator& allocator, VkBuffer& buffer, Allocation& allocation, VkDeviceSize size, VkBufferUsageFlags usage,
+	VkSharingMode sharing_mode, VkMemoryPropertyFlags buffer_memory_properties)
+{
+	VkBufferCreateInfo buffer_info = VkHelper::BufferCreateInfo(
+		size,                                                            // How big do we want to buffer to be
+		usage,                                                           // What type of buffer do we want
+		sharing_mode                                                     // Can the buffer be used by multiple queue families at the same time
+	);
+
+	VkResult buffer_result = vkCreateBuffer(
+		device,                                                          // What device are we going to use to create the buffer
+		&buffer_info,                                                    // What create info are we going to use to base the new buffer on
+		nullptr,                                                         // ...
+		&buffer                                                          // What buffer are we going to create to
+	);
+
+	// Make sure the buffer was created sucsessfully
+	assert(buffer_result == VK_SUCCESS);
+
+	// Find out what the memory requirments of the buffer are
+	VkMemoryRequirements buffer_memory_requirements;
+	vkGetBufferMemoryRequirements(
+		device,                                                          // What device we are using to find the buffer requirments
+		buffer,                                                          // What buffer we are getting the requirments for
+		&buffer_memory_requirements                                      // Where are we wrighting the requirments too
+	);
+
+	// Rather then allocating new memory for the buffer, we ask the allocator for a region of one of its blocks
+	bool allocated = VkHelper::Allocate(
+		allocator,                                                       // What allocator we are getting the memory from
+		buffer_memory_requirements,                                      // Size, alignment and memory types the buffer needs
+		buffer_memory_properties,                                        // What properties do we rquire of our memory
+		true,                                                            // Buffers are always linear resources
+		allocation                                                       // The output for the allocation
+	);
+
+	// Could we allocate the new memory
+	assert(allocated);
+
+	// This time we use the offset value, as the buffer is sharing the memory with other resources
+	VkResult bind_buffer_memory = vkBindBufferMemory(
+		device,                                                         // What device the memory and buffer are on
+		buffer,                                                         // What buffer we want to bind
+		allocation.memory,                                              // What memory we want to beind to the buffer
+		allocation.offset                                               // The start offset from the beginning of the allocated memory
+	);
+
+	// Could we bind the new memory to the buffer
+	assert(bind_buffer_memory == VK_SUCCESS);
+
+	return allocated;
+}
+
+void VkHelper::CreateImage(const VkDevice& device, Allocator& allocator, uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling,
+	VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, Allocation& allocation, VkImageLayout initialLayout,
+	uint32_t mip_levels)
+{
+	VkImageCreateInfo image_create_info = VkHelper::ImageCreateInfo(
+		width,
+		height,
+		format,
+		tiling,
+		usage,
+		initialLayout
+	);
+	image_create_info.mipLevels = mip_levels;                           // How many mip levels does the image have
+
+	VkResult create_image_info_result = vkCreateImage(
+		device,
+		&image_create_info,
+		nullptr,
+		&image
+	);
+	assert(create_image_info_result == VK_SUCCESS);
+
+	VkMemoryRequirements mem_requirements;
+	vkGetImageMemoryRequirements(
+		device,
+		image,
+		&mem_requirements
+	);
+
+	bool allocated = VkHelper::Allocate(
+		allocator,
+		mem_requirements,
+		properties,
+		tiling == VK_IMAGE_TILING_LINEAR,                               // Optimal images are kept apart from linear resources
+		allocation
+	);
+	assert(allocated);
+
+	VkResult bind_result = vkBindImageMemory(
+		device,
+		image,
+		allocation.memory,
+		allocation.offset
+	);
+	assert(bind_result == VK_SUCCESS);
+}
+
+void VkHelper::DestroyBuffer(const VkDevice& device, Allocator& allocator, VkBuffer& buffer, Allocation& allocation)
+{
+	vkDestroyBuffer(
+		device,
+		buffer,
+		nullptr
+	);
+	buffer = VK_NULL_HANDLE;
+
+	VkHelper::Free(allocator, allocation);
+}
+
+void VkHelper::DestroyImage(const VkDevice& device, Allocator& allocator, VkImage& image, Allocation& allocation)
+{
+	vkDestroyImage(
+		device,
+		image,
+		nullptr
+	);
+	image = VK_NULL_HANDLE;
+
+	VkHelper::Free(allocator, allocation);
+}
+
 
 
 VkCommandBuffer VkHelper::BeginSingleTimeCommands(const VkDevice& device, const VkCommandPool& command_pool)
@@ -1088,17 +1203,12 @@ void VkHelper::CreateAttachmentImages(const VkDevice& device, const VkQueue& que
 			sampler_info.anisotropyEnable = VK_FALSE;
 		}
 		sampler_info.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-		VkResult create_sampler_result = vkCreateSampler(
-			device,
-			&sampler_info,
-			nullptr,
-			&attachment.sampler
-		);
-		assert(create_sampler_result == VK_SUCCESS);
+		// Every attachment uses the same state, so they all share one sampler from the cache
+		attachment.sampler = AcquireSampler(device, sampler_info);
 	}
-	// If the image is used for color. switch the images layout
-	if (usage & VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT)
-		TransitionImageLayout(device, queue, command_pool, attachment.image, format, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 });
+	// No layout transition is needed up front, the render passes the attachments are used in start them from
+	// VK_IMAGE_LAYOUT_UNDEFINED. Transitioning here would also wait on the queue, stalling any frames still in flight
+	// when the attachments are rebuilt along with the swapchain
 }
 
 VkFormat VkHelper::FindSupportedFormat(const VkPhysicalDevice & physical_device, const VkFormat * candidate_formats, const uint32_t candidate_format_count, VkImageTiling tiling, VkFormatFeatureFlags features)
@@ -1125,31 +1235,40 @@ VkFormat VkHelper::FindSupportedFormat(const VkPhysicalDevice & physical_device,
 }
 
 
-VkRenderPass VkHelper::CreateRenderPass(const VkPhysicalDevice & physical_device, const VkDevice& device, VkFormat present_format, VkFormat image_color_format, const uint32_t& swapchain_image_count,
-	const VkPhysicalDeviceMemoryProperties& physical_device_mem_properties, const VkPhysicalDeviceFeatures& physical_device_features, const VkPhysicalDeviceProperties& physical_device_properties,
-	const VkCommandPool& command_pool, const VkQueue& queue, uint32_t width, uint32_t height, std::unique_ptr<VkFramebuffer>& framebuffers, std::unique_ptr<VulkanAttachments>& framebuffer_attachments,
-	std::unique_ptr<VkImageView>& swapchain_image_views)
+namespace
 {
-	VkRenderPass renderpass = VK_NULL_HANDLE;
+	// Find the depth format the render pass and its depth attachments use
+	VkFormat FindDepthFormat(const VkPhysicalDevice& physical_device)
+	{
+		// How many formats are we considering for the depth image?
+		const uint32_t candidate_format_count = 3;
+		// What formats are we considering for the depth image
+		// Most modern day GPU's support between two and three of these, VK_FORMAT_D32_SFLOAT is out prefered choice, but the other two will surfice
+		const VkFormat candidate_formats[candidate_format_count] = {
+			VK_FORMAT_D32_SFLOAT,
+			VK_FORMAT_D32_SFLOAT_S8_UINT,
+			VK_FORMAT_D24_UNORM_S8_UINT
+		};
 
-	// How many formats are we considering for the depth image?
-	const uint32_t candidate_format_count = 3;
-	// What formats are we considering for the depth image
-	// Most modern day GPU's support between two and three of these, VK_FORMAT_D32_SFLOAT is out prefered choice, but the other two will surfice
-	const VkFormat candidate_formats[candidate_format_count] = {
-		VK_FORMAT_D32_SFLOAT,
-		VK_FORMAT_D32_SFLOAT_S8_UINT,
-		VK_FORMAT_D24_UNORM_S8_UINT
-	};
+		// Out of the formats we defines, which one is supported by the gpu
+		VkFormat depth_image_format = VkHelper::FindSupportedFormat(
+			physical_device,
+			candidate_formats,
+			candidate_format_count,
+			VK_IMAGE_TILING_OPTIMAL,
+			VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT
+		);
+
+		return depth_image_format;
+	}
+}
+
+VkRenderPass VkHelper::CreateRenderPass(const VkPhysicalDevice & physical_device, const VkDevice& device, VkFormat present_format, VkFormat image_color_format)
+{
+	VkRenderPass renderpass = VK_NULL_HANDLE;
 
 	// Out of the formats we defines, which one is supported by the gpu
-	VkFormat depth_image_format = FindSupportedFormat(
-		physical_device,
-		candidate_formats,
-		candidate_format_count,
-		VK_IMAGE_TILING_OPTIMAL,
-		VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT
-	);
+	VkFormat depth_image_format = FindDepthFormat(physical_device);
 
 
 	VkAttachmentDescription present_attachment = {};
@@ -1259,6 +1378,16 @@ VkRenderPass VkHelper::CreateRenderPass(const VkPhysicalDevice & physical_device
 	// Validate the render pass creation
 	assert(create_render_pass_result == VK_SUCCESS);
 
+	return renderpass;
+}
+
+void VkHelper::CreateFramebuffers(const VkPhysicalDevice & physical_device, const VkDevice& device, const VkRenderPass& renderpass, VkFormat image_color_format, const uint32_t& swapchain_image_count,
+	const VkPhysicalDeviceMemoryProperties& physical_device_mem_properties, const VkPhysicalDeviceFeatures& physical_device_features, const VkPhysicalDeviceProperties& physical_device_properties,
+	const VkCommandPool& command_pool, const VkQueue& queue, uint32_t width, uint32_t height, std::unique_ptr<VkFramebuffer>& framebuffers, std::unique_ptr<VulkanAttachments>& framebuffer_attachments,
+	std::unique_ptr<VkImageView>& swapchain_image_views)
+{
+	VkFormat depth_image_format = FindDepthFormat(physical_device);
+
 	// Create a framebuffer for each swapchain
 	framebuffers = std::unique_ptr<VkFramebuffer>(new VkFramebuffer[swapchain_image_count]);
 	framebuffer_attachments = std::unique_ptr<VulkanAttachments>(new VulkanAttachments[swapchain_image_count]);
@@ -1300,8 +1429,67 @@ VkRenderPass VkHelper::CreateRenderPass(const VkPhysicalDevice & physical_device
 			&framebuffers.get()[i]
 		);
 		// Validate the framebuffer
-		assert(create_render_pass_result == VK_SUCCESS);
+		assert(create_frame_buffer_result == VK_SUCCESS);
 	}
+}
+
+void VkHelper::DestroyFramebuffers(const VkDevice& device, uint32_t swapchain_image_count, VkFramebuffer* framebuffers, VulkanAttachments* framebuffer_attachments,
+	VkImageView* swapchain_image_views)
+{
+	for (uint32_t i = 0; i < swapchain_image_count; i++)
+	{
+		vkDestroyImageView(
+			device,
+			swapchain_image_views[i],
+			nullptr
+		);
+
+		vkDestroyFramebuffer(
+			device,
+			framebuffers[i],
+			nullptr
+		);
+
+		FrameBufferAttachment* attachments[2] = { &framebuffer_attachments[i].color, &framebuffer_attachments[i].depth };
+		for (FrameBufferAttachment* attachment : attachments)
+		{
+			vkDestroyImageView(
+				device,
+				attachment->view,
+				nullptr
+			);
+			vkDestroyImage(
+				device,
+				attachment->image,
+				nullptr
+			);
+			vkFreeMemory(
+				device,
+				attachment->memory,
+				nullptr
+			);
+			VkHelper::ReleaseSampler(
+				device,
+				attachment->sampler
+			);
+		}
+	}
+}
+
+VkRenderPass VkHelper::CreateRenderPass(const VkPhysicalDevice & physical_device, const VkDevice& device, VkFormat present_format, VkFormat image_color_format, const uint32_t& swapchain_image_count,
+	const VkPhysicalDeviceMemoryProperties& physical_device_mem_properties, const VkPhysicalDeviceFeatures& physical_device_features, const VkPhysicalDeviceProperties& physical_device_properties,
+	const VkCommandPool& command_pool, const VkQueue& queue, uint32_t width, uint32_t height, std::unique_ptr<VkFramebuffer>& framebuffers, std::unique_ptr<VulkanAttachments>& framebuffer_attachments,
+	std::unique_ptr<VkImageView>& swapchain_image_views)
+{
+	VkRenderPass renderpass = CreateRenderPass(
+		physical_device,
+		device,
+		present_format,
+		image_color_format
+	);
+
+	CreateFramebuffers(physical_device, device, renderpass, image_color_format, swapchain_image_count, physical_device_mem_properties, physical_device_features,
+		physical_device_properties, command_pool, queue, width, height, framebuffers, framebuffer_attachments, swapchain_image_views);
 
 	return renderpass;
 }
@@ -1521,7 +1709,7 @@ VkPipeline VkHelper::CreateGraphicsPipeline(const VkPhysicalDevice & physical_de
 	// Create the pipeline
 	VkResult create_graphics_pipeline_result = vkCreateGraphicsPipelines(
 		device,
-		VK_NULL_HANDLE,
+		VkHelper::GetPipelineCache(),                                   // Reuse any previously compiled shaders
 		1,
 		&pipeline_info,
 		nullptr,
@@ -1579,7 +1767,7 @@ VkPipeline VkHelper::CreateComputePipeline(const VkDevice& device, VkPipelineLay
 	// Create the compute pipeline
 	VkResult create_compute_pipeline = vkCreateComputePipelines(
 		device,
-		0,
+		VkHelper::GetPipelineCache(),                                   // Reuse any previously compiled shaders
 		1,
 		&compute_pipeline_create_info,
 		nullptr,
@@ -1591,6 +1779,37 @@ VkPipeline VkHelper::CreateComputePipeline(const VkDevice& device, VkPipelineLay
 	return compute_pipeline;
 }
 
+VkPipeline VkHelper::CreateRayTracingPipeline(const VkDevice& device, const VkPipelineLayout& raytracing_pipeline_layout, uint32_t shader_stage_count, const VkPipelineShaderStageCreateInfo* shader_stages,
+	uint32_t shader_group_count, const VkRayTracingShaderGroupCreateInfoNV* shader_groups, uint32_t max_recursion_depth)
+{
+	VkPipeline raytracing_pipeline = VK_NULL_HANDLE;
+
+	VkRayTracingPipelineCreateInfoNV pipeline_create_info = {};
+	pipeline_create_info.sType = VK_STRUCTURE_TYPE_RAY_TRACING_PIPELINE_CREATE_INFO_NV;
+	pipeline_create_info.pNext = nullptr;
+	pipeline_create_info.flags = 0;
+	pipeline_create_info.stageCount = shader_stage_count;                   // How many shaders are in the pipeline
+	pipeline_create_info.pStages = shader_stages;
+	pipeline_create_info.groupCount = shader_group_count;                   // How the shaders are grouped into raygen, miss and hit groups
+	pipeline_create_info.pGroups = shader_groups;
+	pipeline_create_info.maxRecursionDepth = max_recursion_depth;           // How many times a ray can be traced from within a hit shader
+	pipeline_create_info.layout = raytracing_pipeline_layout;
+	pipeline_create_info.basePipelineHandle = VK_NULL_HANDLE;
+	pipeline_create_info.basePipelineIndex = 0;
+
+	VkResult create_pipeline_result = vkCreateRayTracingPipelinesNV(
+		device,
+		VkHelper::GetPipelineCache(),                                   // Reuse any previously compiled shaders
+		1,
+		&pipeline_create_info,
+		nullptr,
+		&raytracing_pipeline
+	);
+	assert(create_pipeline_result == VK_SUCCESS);
+
+	return raytracing_pipeline;
+}
+
 VkShaderModule VkHelper::LoadShader(const VkDevice& device, const char* path)
 {
 	VkShaderModule shader_module = VK_NULL_HANDLE;
@@ -1629,18 +1848,17 @@ VkShaderModule VkHelper::LoadShader(const VkDevice& device, const char* path)
 	return shader_module;
 }
 
-void VkHelper::CreateImageSampler(const VkDevice& device, const VkImage& image, VkFormat format, VkImageView& imageView, VkSampler& sampler)
+void VkHelper::CreateImageSampler(const VkDevice& device, const VkImage& image, VkFormat format, VkImageView& imageView, VkSampler& sampler, uint32_t mip_levels)
 {
 	VkSamplerCreateInfo sampler_info = SamplerCreateInfo();
-	vkCreateSampler(
-		device,
-		&sampler_info,
-		nullptr,
-		&sampler
-	);
+	// Don't clamp the LOD, the image view already stops the sampler at the textures smallest mip level. Keeping mip_levels
+	// out of the sampler state lets every texture share the same cached sampler
+	sampler_info.maxLod = VK_LOD_CLAMP_NONE;
+	// Samplers come from the cache, give them back with ReleaseSampler
+	sampler = AcquireSampler(device, sampler_info);
 
 	VkImageViewCreateInfo view_info = ImageViewCreate(image, format, VK_IMAGE_ASPECT_COLOR_BIT);
-	view_info.subresourceRange.levelCount = 1;
+	view_info.subresourceRange.levelCount = mip_levels;
 
 	vkCreateImageView(
 		device,
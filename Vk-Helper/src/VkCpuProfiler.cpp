@@ -0,0 +1,112 @@
+#include <VkCpuProfiler.hpp>
+
+#ifdef VK_HELPER_CPU_PROFILE
+
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+	// Every threads buffer, kept until the program exits so a trace can still be written after a thread has finished
+	struct ThreadBufferRegistry
+	{
+		std::mutex lock;
+		std::vector<std::unique_ptr<VkHelper::CpuThreadBuffer>> buffers;
+	};
+
+	ThreadBufferRegistry& Registry()
+	{
+		static ThreadBufferRegistry registry;
+		return registry;
+	}
+
+	thread_local VkHelper::CpuThreadBuffer* thread_buffer = nullptr;
+
+	// Thread names are written into the trace as JSON strings
+	std::string EscapeJson(const std::string& text)
+	{
+		std::string escaped;
+		for (char c : text)
+		{
+			if (c == '"' || c == '\\') escaped += '\\';
+			escaped += c;
+		}
+		return escaped;
+	}
+}
+
+uint64_t VkHelper::CpuProfilerNow()
+{
+	static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count());
+}
+
+VkHelper::CpuThreadBuffer& VkHelper::CpuProfilerThreadBuffer()
+{
+	if (thread_buffer != nullptr) return *thread_buffer;
+
+	// Only taken the first time a thread records a zone
+	ThreadBufferRegistry& registry = Registry();
+	std::lock_guard<std::mutex> guard(registry.lock);
+
+	std::unique_ptr<CpuThreadBuffer> buffer(new CpuThreadBuffer());
+	buffer->thread_index = static_cast<uint32_t>(registry.buffers.size());
+	buffer->thread_name = "Thread " + std::to_string(buffer->thread_index);
+	buffer->events = std::unique_ptr<CpuZoneEvent[]>(new CpuZoneEvent[CpuThreadBuffer::capacity]);
+	buffer->count = 0;
+	buffer->dropped = 0;
+
+	thread_buffer = buffer.get();
+	registry.buffers.push_back(std::move(buffer));
+	return *thread_buffer;
+}
+
+void VkHelper::SetCpuThreadName(const std::string& name)
+{
+	CpuThreadBuffer& buffer = CpuProfilerThreadBuffer();
+	// The name is read when the trace is written, which can happen on another thread
+	std::lock_guard<std::mutex> guard(Registry().lock);
+	buffer.thread_name = name;
+}
+
+bool VkHelper::WriteCpuTrace(const char* path)
+{
+	std::ofstream file(path, std::ios::trunc);
+	if (!file.is_open()) return false;
+
+	ThreadBufferRegistry& registry = Registry();
+	std::lock_guard<std::mutex> guard(registry.lock);
+
+	uint64_t dropped = 0;
+	bool first_event = true;
+
+	file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	for (const std::unique_ptr<CpuThreadBuffer>& buffer : registry.buffers)
+	{
+		// Metadata event that names the thread
+		if (!first_event) file << ",";
+		first_event = false;
+		file << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << buffer->thread_index
+			<< ",\"args\":{\"name\":\"" << EscapeJson(buffer->thread_name) << "\"}}";
+
+		// Everything before count has been fully written, the thread may still be adding more after it
+		uint32_t count = buffer->count.load(std::memory_order_acquire);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			const CpuZoneEvent& zone_event = buffer->events[i];
+			// Complete events, a start time and a duration in microseconds
+			file << ",\n{\"name\":\"" << EscapeJson(zone_event.name) << "\",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":0,\"tid\":" << buffer->thread_index
+				<< ",\"ts\":" << zone_event.start_ns / 1000.0
+				<< ",\"dur\":" << (zone_event.end_ns - zone_event.start_ns) / 1000.0 << "}";
+		}
+
+		dropped += buffer->dropped.load(std::memory_order_relaxed);
+	}
+	file << "\n],\"otherData\":{\"dropped_zones\":" << dropped << "}}\n";
+
+	return file.good();
+}
+
+#endif
@@ -0,0 +1,160 @@
+#include <VkDescriptorAllocator.hpp>
+#include <VkInitializers.hpp>
+#include <assert.h>
+
+namespace
+{
+	// New pools grow by half again each time, up to this many sets
+	const uint32_t max_sets_per_pool = 4096;
+
+	VkDescriptorPool CreatePool(VkHelper::DescriptorAllocator& descriptor_allocator)
+	{
+		const uint32_t set_count = descriptor_allocator.sets_per_pool;
+
+		std::vector<VkDescriptorPoolSize> pool_sizes;
+		for (const VkHelper::DescriptorPoolRatio& ratio : descriptor_allocator.ratios)
+		{
+			uint32_t descriptor_count = static_cast<uint32_t>(ratio.ratio * set_count);
+			if (descriptor_count == 0) descriptor_count = 1;
+			pool_sizes.push_back(VkHelper::DescriptorPoolSize(ratio.type, descriptor_count));
+		}
+
+		VkDescriptorPoolCreateInfo create_info = VkHelper::DescriptorPoolCreateInfo(pool_sizes.data(), static_cast<uint32_t>(pool_sizes.size()), set_count);
+		create_info.flags = descriptor_allocator.flags;
+
+		VkDescriptorPool descriptor_pool = VK_NULL_HANDLE;
+		VkResult create_descriptor_pool = vkCreateDescriptorPool(
+			descriptor_allocator.device,
+			&create_info,
+			nullptr,
+			&descriptor_pool
+		);
+		assert(create_descriptor_pool == VK_SUCCESS);
+
+		// The next pool we need to make will be bigger
+		descriptor_allocator.sets_per_pool = set_count + set_count / 2;
+		if (descriptor_allocator.sets_per_pool > descriptor_allocator.max_sets_per_pool) descriptor_allocator.sets_per_pool = descriptor_allocator.max_sets_per_pool;
+
+		return descriptor_pool;
+	}
+
+	// Use a pool that has been reset if there is one, otherwise make a new one
+	VkDescriptorPool GrabPool(VkHelper::DescriptorAllocator& descriptor_allocator)
+	{
+		if (!descriptor_allocator.free_pools.empty())
+		{
+			VkDescriptorPool descriptor_pool = descriptor_allocator.free_pools.back();
+			descriptor_allocator.free_pools.pop_back();
+			return descriptor_pool;
+		}
+		return CreatePool(descriptor_allocator);
+	}
+
+	VkResult TryAllocate(VkHelper::DescriptorAllocator& descriptor_allocator, const VkDescriptorSetLayout& descriptor_set_layout, VkDescriptorSet& descriptor_set)
+	{
+		VkDescriptorSetAllocateInfo allocate_info = VkHelper::DescriptorSetAllocateInfo(descriptor_allocator.current_pool, descriptor_set_layout, 1);
+
+		return vkAllocateDescriptorSets(
+			descriptor_allocator.device,
+			&allocate_info,
+			&descriptor_set
+		);
+	}
+}
+
+std::vector<VkHelper::DescriptorPoolRatio> VkHelper::DefaultDescriptorPoolRatios()
+{
+	std::vector<DescriptorPoolRatio> ratios = {
+		{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4.0f },
+		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2.0f },
+		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.0f },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2.0f },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1.0f }
+	};
+	return ratios;
+}
+
+void VkHelper::CreateDescriptorAllocator(const VkDevice& device, const DescriptorPoolRatio* ratios, uint32_t ratio_count, uint32_t sets_per_pool,
+	VkDescriptorPoolCreateFlags flags, DescriptorAllocator& descriptor_allocator)
+{
+	assert(sets_per_pool > 0);
+
+	descriptor_allocator.device = device;
+	descriptor_allocator.ratios.assign(ratios, ratios + ratio_count);
+	descriptor_allocator.flags = flags;
+	descriptor_allocator.max_sets_per_pool = sets_per_pool > max_sets_per_pool ? sets_per_pool : max_sets_per_pool;
+	descriptor_allocator.sets_per_pool = sets_per_pool;
+	descriptor_allocator.used_pools.clear();
+	descriptor_allocator.free_pools.clear();
+
+	// Pools are made as they are needed
+	descriptor_allocator.current_pool = VK_NULL_HANDLE;
+}
+
+void VkHelper::DestroyDescriptorAllocator(DescriptorAllocator& descriptor_allocator)
+{
+	// Destroying a pool frees all of the sets that came from it
+	if (descriptor_allocator.current_pool != VK_NULL_HANDLE) descriptor_allocator.used_pools.push_back(descriptor_allocator.current_pool);
+	descriptor_allocator.current_pool = VK_NULL_HANDLE;
+
+	for (VkDescriptorPool descriptor_pool : descriptor_allocator.used_pools)
+	{
+		vkDestroyDescriptorPool(
+			descriptor_allocator.device,
+			descriptor_pool,
+			nullptr
+		);
+	}
+	for (VkDescriptorPool descriptor_pool : descriptor_allocator.free_pools)
+	{
+		vkDestroyDescriptorPool(
+			descriptor_allocator.device,
+			descriptor_pool,
+			nullptr
+		);
+	}
+	descriptor_allocator.used_pools.clear();
+	descriptor_allocator.free_pools.clear();
+}
+
+bool VkHelper::AllocateDescriptorSet(DescriptorAllocator& descriptor_allocator, const VkDescriptorSetLayout& descriptor_set_layout, VkDescriptorSet& descriptor_set)
+{
+	if (descriptor_allocator.current_pool == VK_NULL_HANDLE)
+	{
+		descriptor_allocator.current_pool = GrabPool(descriptor_allocator);
+	}
+
+	VkResult allocate_result = TryAllocate(descriptor_allocator, descriptor_set_layout, descriptor_set);
+	if (allocate_result == VK_SUCCESS) return true;
+
+	// Any other error is a real problem rather than the pool being full
+	assert(allocate_result == VK_ERROR_OUT_OF_POOL_MEMORY || allocate_result == VK_ERROR_FRAGMENTED_POOL);
+
+	// The pool is full, keep it until the next reset and move on to another one
+	descriptor_allocator.used_pools.push_back(descriptor_allocator.current_pool);
+	descriptor_allocator.current_pool = GrabPool(descriptor_allocator);
+
+	allocate_result = TryAllocate(descriptor_allocator, descriptor_set_layout, descriptor_set);
+
+	// If a set doesn't fit in an empty pool the ratios don't cover its layout
+	return allocate_result == VK_SUCCESS;
+}
+
+void VkHelper::ResetDescriptorAllocator(DescriptorAllocator& descriptor_allocator)
+{
+	if (descriptor_allocator.current_pool != VK_NULL_HANDLE) descriptor_allocator.used_pools.push_back(descriptor_allocator.current_pool);
+	descriptor_allocator.current_pool = VK_NULL_HANDLE;
+
+	// Resetting a pool frees all of its sets in one call, much cheaper than freeing them one by one
+	for (VkDescriptorPool descriptor_pool : descriptor_allocator.used_pools)
+	{
+		VkResult reset_result = vkResetDescriptorPool(
+			descriptor_allocator.device,
+			descriptor_pool,
+			0
+		);
+		assert(reset_result == VK_SUCCESS);
+		descriptor_allocator.free_pools.push_back(descriptor_pool);
+	}
+	descriptor_allocator.used_pools.clear();
+}
@@ -0,0 +1,109 @@
+#include <VkDescriptorTemplate.hpp>
+#include <VkInitializers.hpp>
+#include <VkCore.hpp>
+#include <assert.h>
+#include <vector>
+
+VkHelper::DescriptorTemplateBinding VkHelper::TemplateBinding(uint32_t binding, VkDescriptorType type, VkShaderStageFlags stage_flags, size_t offset, uint32_t count, size_t stride)
+{
+	DescriptorTemplateBinding template_binding = {};
+	template_binding.binding = binding;                 // Which binding in the shader
+	template_binding.type = type;                       // What type of descriptor is it
+	template_binding.count = count;                     // How many array elements
+	template_binding.stage_flags = stage_flags;         // What shader stages can see it
+	template_binding.offset = offset;                   // Where the first descriptor info is in the update struct
+	template_binding.stride = stride;                   // How far apart the array elements are in the update struct
+	return template_binding;
+}
+
+void VkHelper::CreateDescriptorTemplate(const VkDevice& device, const DescriptorTemplateBinding* bindings, uint32_t binding_count, DescriptorTemplate& descriptor_template)
+{
+	descriptor_template.device = device;
+
+	std::vector<VkDescriptorSetLayoutBinding> layout_bindings(binding_count);
+	std::vector<VkDescriptorUpdateTemplateEntry> template_entries(binding_count);
+
+	for (uint32_t i = 0; i < binding_count; i++)
+	{
+		const DescriptorTemplateBinding& binding = bindings[i];
+
+		layout_bindings[i] = VkHelper::DescriptorSetLayoutBinding(binding.binding, binding.type, binding.count, binding.stage_flags);
+
+		VkDescriptorUpdateTemplateEntry& entry = template_entries[i];
+		entry.dstBinding = binding.binding;
+		entry.dstArrayElement = 0;
+		entry.descriptorCount = binding.count;
+		entry.descriptorType = binding.type;
+		entry.offset = binding.offset;
+		// A stride of 0 is only valid for a single descriptor, so fall back to the size of the descriptor info
+		entry.stride = binding.stride;
+		if (entry.stride == 0)
+		{
+			switch (binding.type)
+			{
+			case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+			case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+			case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
+			case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC:
+				entry.stride = sizeof(VkDescriptorBufferInfo);
+				break;
+			case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER:
+			case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER:
+				entry.stride = sizeof(VkBufferView);
+				break;
+			default:
+				entry.stride = sizeof(VkDescriptorImageInfo);
+				break;
+			}
+		}
+	}
+
+	descriptor_template.descriptor_set_layout = VkHelper::CreateDescriptorSetLayout(
+		device,
+		layout_bindings.data(),
+		binding_count
+	);
+
+	VkDescriptorUpdateTemplateCreateInfo create_info = {};
+	create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO;
+	create_info.descriptorUpdateEntryCount = binding_count;
+	create_info.pDescriptorUpdateEntries = template_entries.data();
+	create_info.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET;    // Writes a descriptor set, rather than push descriptors
+	create_info.descriptorSetLayout = descriptor_template.descriptor_set_layout;
+
+	VkResult create_update_template = vkCreateDescriptorUpdateTemplate(
+		device,
+		&create_info,
+		nullptr,
+		&descriptor_template.update_template
+	);
+	assert(create_update_template == VK_SUCCESS);
+}
+
+void VkHelper::DestroyDescriptorTemplate(DescriptorTemplate& descriptor_template)
+{
+	vkDestroyDescriptorUpdateTemplate(
+		descriptor_template.device,
+		descriptor_template.update_template,
+		nullptr
+	);
+
+	vkDestroyDescriptorSetLayout(
+		descriptor_template.device,
+		descriptor_template.descriptor_set_layout,
+		nullptr
+	);
+
+	descriptor_template.update_template = VK_NULL_HANDLE;
+	descriptor_template.descriptor_set_layout = VK_NULL_HANDLE;
+}
+
+void VkHelper::UpdateDescriptorSet(const DescriptorTemplate& descriptor_template, const VkDescriptorSet& descriptor_set, const void* data)
+{
+	vkUpdateDescriptorSetWithTemplate(
+		descriptor_template.device,
+		descriptor_set,
+		descriptor_template.update_template,
+		data
+	);
+}
@@ -0,0 +1,129 @@
+#include <VkDispatch.hpp>
+#include <assert.h>
+#include <atomic>
+#include <mutex>
+
+namespace
+{
+	// More devices than any of the samples will have alive at once. The tables are never moved, so references to them
+	// stay valid until the device is unregistered
+	const uint32_t max_devices = 16;
+
+	struct DispatchRegistry
+	{
+		VkHelper::DeviceDispatch tables[max_devices];
+		// Which device owns each table, VK_NULL_HANDLE once the device has been unregistered and the slot is free. Lookups
+		// match against these rather than the tables, a table is filled in before its device is stored
+		std::atomic<VkDevice> devices[max_devices];
+		// How many slots have ever been used, lookups only need to check the slots below the count
+		std::atomic<uint32_t> table_count;
+		// Only taken to add, reload or remove a table
+		std::mutex lock;
+	};
+
+	DispatchRegistry& Registry()
+	{
+		static DispatchRegistry registry;
+		return registry;
+	}
+
+	VkHelper::DeviceDispatch* FindDispatch(DispatchRegistry& registry, const VkDevice& device)
+	{
+		uint32_t table_count = registry.table_count.load(std::memory_order_acquire);
+		for (uint32_t i = 0; i < table_count; i++)
+		{
+			if (registry.devices[i].load(std::memory_order_acquire) == device) return &registry.tables[i];
+		}
+		return nullptr;
+	}
+
+	// Called with the registry locked
+	VkHelper::DeviceDispatch& AddDispatch(DispatchRegistry& registry, const VkDevice& device)
+	{
+		uint32_t table_count = registry.table_count.load(std::memory_order_relaxed);
+
+		// Reuse the slot of a device that has been unregistered before taking a new one
+		uint32_t slot = table_count;
+		for (uint32_t i = 0; i < table_count; i++)
+		{
+			if (registry.devices[i].load(std::memory_order_relaxed) == VK_NULL_HANDLE)
+			{
+				slot = i;
+				break;
+			}
+		}
+		assert(slot < max_devices && "Too many devices for the dispatch registry");
+
+		VkHelper::DeviceDispatch& dispatch = registry.tables[slot];
+		VkHelper::LoadDeviceDispatch(device, dispatch);
+		registry.devices[slot].store(device, std::memory_order_release);
+		if (slot == table_count) registry.table_count.store(table_count + 1, std::memory_order_release);
+		return dispatch;
+	}
+}
+
+void VkHelper::LoadDeviceDispatch(const VkDevice& device, DeviceDispatch& dispatch)
+{
+	assert(device != VK_NULL_HANDLE);
+	dispatch.device = device;
+
+#define VK_HELPER_LOAD_CORE_FUNCTION(name) \
+	dispatch.name = reinterpret_cast<PFN_##name>(vkGetDeviceProcAddr(device, #name));
+#define VK_HELPER_LOAD_EXTENSION_FUNCTION(name) \
+	dispatch.name = reinterpret_cast<PFN_##name>(vkGetDeviceProcAddr(device, #name));
+
+	VK_HELPER_DEVICE_CORE_FUNCTIONS(VK_HELPER_LOAD_CORE_FUNCTION)
+	VK_HELPER_DEVICE_EXTENSION_FUNCTIONS(VK_HELPER_LOAD_EXTENSION_FUNCTION)
+
+#undef VK_HELPER_LOAD_CORE_FUNCTION
+#undef VK_HELPER_LOAD_EXTENSION_FUNCTION
+
+	// The 1.0 functions are always there, a device made with an older API version only misses the 1.1 ones
+	assert(dispatch.vkQueueSubmit != nullptr && dispatch.vkCmdDraw != nullptr);
+}
+
+const VkHelper::DeviceDispatch& VkHelper::GetDeviceDispatch(const VkDevice& device)
+{
+	// A null device would match the free slots
+	assert(device != VK_NULL_HANDLE);
+	DispatchRegistry& registry = Registry();
+
+	DeviceDispatch* dispatch = FindDispatch(registry, device);
+	if (dispatch != nullptr) return *dispatch;
+
+	// First time this device has been seen, check again under the lock in case another thread is adding it
+	std::lock_guard<std::mutex> guard(registry.lock);
+	dispatch = FindDispatch(registry, device);
+	if (dispatch != nullptr) return *dispatch;
+	return AddDispatch(registry, device);
+}
+
+const VkHelper::DeviceDispatch& VkHelper::ReloadDeviceDispatch(const VkDevice& device)
+{
+	DispatchRegistry& registry = Registry();
+	std::lock_guard<std::mutex> guard(registry.lock);
+
+	DeviceDispatch* dispatch = FindDispatch(registry, device);
+	if (dispatch == nullptr) return AddDispatch(registry, device);
+
+	LoadDeviceDispatch(device, *dispatch);
+	return *dispatch;
+}
+
+void VkHelper::UnregisterDeviceDispatch(const VkDevice& device)
+{
+	assert(device != VK_NULL_HANDLE);
+	DispatchRegistry& registry = Registry();
+	std::lock_guard<std::mutex> guard(registry.lock);
+
+	uint32_t table_count = registry.table_count.load(std::memory_order_relaxed);
+	for (uint32_t i = 0; i < table_count; i++)
+	{
+		if (registry.devices[i].load(std::memory_order_relaxed) != device) continue;
+
+		// Free the slot first so no new lookup can find the table, then clear the table itself
+		registry.devices[i].store(VK_NULL_HANDLE, std::memory_order_release);
+		registry.tables[i] = DeviceDispatch();
+		return;
+	}
+}
@@ -0,0 +1,385 @@
+#include <VkFrameLoop.hpp>
+#include <VkHeadless.hpp>
+#include <VkCpuProfiler.hpp>
+#include <VkCore.hpp>
+#include <VkDispatch.hpp>
+#include <VkInitializers.hpp>
+#include <assert.h>
+
+namespace
+{
+	// Destroy the retired resources that no frame in flight can still be using
+	void DestroyRetiredResources(VkHelper::FrameLoop& frame_loop, bool everything)
+	{
+		while (!frame_loop.retired_resources.empty())
+		{
+			VkHelper::FrameLoop::RetiredResource& retired = frame_loop.retired_resources.front();
+			if (!everything && retired.destroy_frame > frame_loop.frame_number) break;
+			retired.destroy();
+			frame_loop.retired_resources.pop_front();
+		}
+	}
+}
+
+void VkHelper::CreateFrameLoop(const VkDevice& device, const VkCommandPool& command_pool, uint32_t swapchain_image_count, uint32_t frames_in_flight, FrameLoop& frame_loop)
+{
+	assert(frames_in_flight > 0);
+
+	frame_loop.dispatch = &VkHelper::GetDeviceDispatch(device);
+	frame_loop.frames_in_flight = frames_in_flight;
+	frame_loop.frame_index = 0;
+	frame_loop.image_index = 0;
+	frame_loop.frame_number = 0;
+
+	// The fences start signaled so the first wait on each frame returns straight away
+	VkHelper::CreateFence(device, frame_loop.frame_fences, frames_in_flight);
+
+	frame_loop.image_available_semaphores = std::unique_ptr<VkSemaphore>(new VkSemaphore[frames_in_flight]);
+	frame_loop.render_finished_semaphores = std::unique_ptr<VkSemaphore>(new VkSemaphore[frames_in_flight]);
+	for (uint32_t i = 0; i < frames_in_flight; i++)
+	{
+		VkHelper::CreateVkSemaphore(device, frame_loop.image_available_semaphores.get()[i]);
+		VkHelper::CreateVkSemaphore(device, frame_loop.render_finished_semaphores.get()[i]);
+	}
+
+	VkCommandBufferAllocateInfo command_buffer_allocate_info = VkHelper::CommandBufferAllocateInfo(
+		command_pool,                                                   // What pool are we allocating the command buffers from
+		frames_in_flight                                                // One command buffer per frame in flight
+	);
+
+	frame_loop.command_buffers = std::unique_ptr<VkCommandBuffer>(new VkCommandBuffer[frames_in_flight]);
+
+	VkResult allocate_command_buffer_resut = vkAllocateCommandBuffers(
+		device,
+		&command_buffer_allocate_info,
+		frame_loop.command_buffers.get()
+	);
+	assert(allocate_command_buffer_resut == VK_SUCCESS);
+
+	ResetFrameLoopImages(frame_loop, swapchain_image_count);
+}
+
+void VkHelper::DestroyFrameLoop(const VkDevice& device, const VkCommandPool& command_pool, FrameLoop& frame_loop)
+{
+	// Make sure none of the frames are still being worked on
+	VkResult wait_for_fences = vkWaitForFences(
+		device,
+		frame_loop.frames_in_flight,
+		frame_loop.frame_fences.get(),
+		VK_TRUE,
+		UINT64_MAX
+	);
+	assert(wait_for_fences == VK_SUCCESS);
+
+	// Nothing is in flight any more
+	DestroyRetiredResources(frame_loop, true);
+
+	vkFreeCommandBuffers(
+		device,
+		command_pool,
+		frame_loop.frames_in_flight,
+		frame_loop.command_buffers.get()
+	);
+
+	for (uint32_t i = 0; i < frame_loop.frames_in_flight; i++)
+	{
+		vkDestroyFence(
+			device,
+			frame_loop.frame_fences.get()[i],
+			nullptr
+		);
+
+		vkDestroySemaphore(
+			device,
+			frame_loop.image_available_semaphores.get()[i],
+			nullptr
+		);
+
+		vkDestroySemaphore(
+			device,
+			frame_loop.render_finished_semaphores.get()[i],
+			nullptr
+		);
+	}
+
+	frame_loop.command_buffers.reset();
+	frame_loop.frame_fences.reset();
+	frame_loop.image_fences.reset();
+	frame_loop.image_available_semaphores.reset();
+	frame_loop.render_finished_semaphores.reset();
+	frame_loop.frames_in_flight = 0;
+}
+
+void VkHelper::ResetFrameLoopImages(FrameLoop& frame_loop, uint32_t swapchain_image_count)
+{
+	std::unique_ptr<VkFence> old_image_fences = std::move(frame_loop.image_fences);
+	uint32_t old_swapchain_image_count = old_image_fences ? frame_loop.swapchain_image_count : 0;
+
+	frame_loop.swapchain_image_count = swapchain_image_count;
+	frame_loop.image_fences = std::unique_ptr<VkFence>(new VkFence[swapchain_image_count]);
+	for (uint32_t i = 0; i < swapchain_image_count; i++)
+	{
+		// Anything the caller keeps per image index (command buffers, ring buffer regions) may still be in use by the frame
+		// that last rendered to that index of the old swapchain, so keep waiting on it. No frame has used the new indices yet
+		frame_loop.image_fences.get()[i] = i < old_swapchain_image_count ? old_image_fences.get()[i] : VK_NULL_HANDLE;
+	}
+}
+
+VkResult VkHelper::BeginFrame(const VkDevice& device, const VkSwapchainKHR& swapchain, FrameLoop& frame_loop)
+{
+	VK_HELPER_CPU_ZONE("BeginFrame");
+
+	// Wait for the GPU to finish the last frame that used this frames semaphores and command buffer
+	VkResult wait_for_fences = VK_SUCCESS;
+	{
+		VK_HELPER_CPU_ZONE("Wait for frame fence");
+		wait_for_fences = frame_loop.dispatch->vkWaitForFences(
+			device,
+			1,
+			&frame_loop.frame_fences.get()[frame_loop.frame_index],
+			VK_TRUE,
+			UINT64_MAX
+		);
+	}
+	assert(wait_for_fences == VK_SUCCESS);
+
+	// Every frame up to and including the one that last used this fence has now finished
+	DestroyRetiredResources(frame_loop, false);
+
+	VkResult acquire_next_image_result = VK_SUCCESS;
+	if (frame_loop.headless_swapchain != nullptr)
+	{
+		frame_loop.image_index = AcquireHeadlessImage(*frame_loop.headless_swapchain);
+	}
+	else
+	{
+		VK_HELPER_CPU_ZONE("vkAcquireNextImageKHR");
+		acquire_next_image_result = frame_loop.dispatch->vkAcquireNextImageKHR(
+			device,
+			swapchain,
+			UINT64_MAX,
+			frame_loop.image_available_semaphores.get()[frame_loop.frame_index],
+			VK_NULL_HANDLE,
+			&frame_loop.image_index
+		);
+	}
+	// The swapchain no longer matches the surface, the caller needs to rebuild it before we can render
+	if (acquire_next_image_result == VK_ERROR_OUT_OF_DATE_KHR) return acquire_next_image_result;
+	assert(acquire_next_image_result == VK_SUCCESS || acquire_next_image_result == VK_SUBOPTIMAL_KHR);
+
+	// The swapchain can hand back images out of order, so a older frame in flight may still be rendering to this image
+	VkFence& image_fence = frame_loop.image_fences.get()[frame_loop.image_index];
+	if (image_fence != VK_NULL_HANDLE && image_fence != frame_loop.frame_fences.get()[frame_loop.frame_index])
+	{
+		VK_HELPER_CPU_ZONE("Wait for image fence");
+		wait_for_fences = frame_loop.dispatch->vkWaitForFences(
+			device,
+			1,
+			&image_fence,
+			VK_TRUE,
+			UINT64_MAX
+		);
+		assert(wait_for_fences == VK_SUCCESS);
+	}
+	// This image now belongs to the current frame
+	image_fence = frame_loop.frame_fences.get()[frame_loop.frame_index];
+
+	return acquire_next_image_result;
+}
+
+VkResult VkHelper::EndFrame(const VkDevice& device, const VkQueue& graphics_queue, const VkQueue& present_queue, VkSwapchainKHR& swapchain, FrameLoop& frame_loop,
+	const VkCommandBuffer* command_buffers, uint32_t command_buffer_count, VkPipelineStageFlags wait_stage)
+{
+	VK_HELPER_CPU_ZONE("EndFrame");
+
+	VkFence& frame_fence = frame_loop.frame_fences.get()[frame_loop.frame_index];
+
+	// Only reset the fence once we know we are going to submit work that will signal it
+	VkResult reset_fences_result = frame_loop.dispatch->vkResetFences(
+		device,
+		1,
+		&frame_fence
+	);
+	assert(reset_fences_result == VK_SUCCESS);
+
+	VkSubmitInfo submit_info = VkHelper::SubmitInfo(
+		1,                                                                       // Wait for the image to be acquired
+		&frame_loop.image_available_semaphores.get()[frame_loop.frame_index],
+		1,                                                                       // Let the present know we are done
+		&frame_loop.render_finished_semaphores.get()[frame_loop.frame_index],
+		wait_stage,                                                              // What stage needs to wait for the image
+		command_buffer_count
+	);
+	submit_info.pCommandBuffers = command_buffers;
+	// Nothing signals or waits on the image semaphores without a presentation engine, queue order is all we need
+	if (frame_loop.headless_swapchain != nullptr)
+	{
+		submit_info.waitSemaphoreCount = 0;
+		submit_info.signalSemaphoreCount = 0;
+	}
+
+	VkResult queue_submit_result = VK_SUCCESS;
+	{
+		VK_HELPER_CPU_ZONE("vkQueueSubmit");
+		queue_submit_result = frame_loop.dispatch->vkQueueSubmit(
+			graphics_queue,
+			1,
+			&submit_info,
+			frame_fence
+		);
+	}
+	assert(queue_submit_result == VK_SUCCESS);
+
+
+	VkResult queue_present_result = VK_SUCCESS;
+	if (frame_loop.headless_swapchain != nullptr)
+	{
+		PresentHeadlessImage(*frame_loop.headless_swapchain, frame_loop.image_index);
+	}
+	else
+	{
+		VkPresentInfoKHR present_info = VkHelper::PresentInfoKHR(
+			1,
+			&frame_loop.render_finished_semaphores.get()[frame_loop.frame_index],
+			swapchain
+		);
+		present_info.pImageIndices = &frame_loop.image_index;
+
+		VK_HELPER_CPU_ZONE("vkQueuePresentKHR");
+		queue_present_result = frame_loop.dispatch->vkQueuePresentKHR(
+			present_queue,
+			&present_info
+		);
+		assert(queue_present_result == VK_SUCCESS || queue_present_result == VK_SUBOPTIMAL_KHR || queue_present_result == VK_ERROR_OUT_OF_DATE_KHR);
+	}
+
+	// Move on to the next frame, the CPU can now start on it while the GPU works on this one
+	frame_loop.frame_index = (frame_loop.frame_index + 1) % frame_loop.frames_in_flight;
+	frame_loop.frame_number++;
+
+	return queue_present_result;
+}
+
+const VkFence& VkHelper::CurrentFrameFence(const FrameLoop& frame_loop)
+{
+	return frame_loop.frame_fences.get()[frame_loop.frame_index];
+}
+
+void VkHelper::RetireResource(FrameLoop& frame_loop, const std::function<void()>& destroy)
+{
+	// Frames 0 to frame_number - 1 may be using the resource. BeginFrame for frame n has waited on frame n - frames_in_flight,
+	// so the last of them is done once BeginFrame reaches frame_number - 1 + frames_in_flight
+	FrameLoop::RetiredResource retired;
+	retired.destroy_frame = frame_loop.frame_number + frame_loop.frames_in_flight - 1;
+	retired.destroy = destroy;
+	frame_loop.retired_resources.push_back(retired);
+}
+
+void VkHelper::CreateFrameCommands(const VkDevice& device, uint32_t queue_family, uint32_t frames_in_flight, FrameCommands& frame_commands)
+{
+	assert(frames_in_flight > 0);
+
+	frame_commands.dispatch = &VkHelper::GetDeviceDispatch(device);
+	frame_commands.frames_in_flight = frames_in_flight;
+	frame_commands.command_pools = std::unique_ptr<VkCommandPool>(new VkCommandPool[frames_in_flight]);
+	frame_commands.command_buffers = std::unique_ptr<VkCommandBuffer>(new VkCommandBuffer[frames_in_flight]);
+
+	for (uint32_t i = 0; i < frames_in_flight; i++)
+	{
+		// No RESET_COMMAND_BUFFER_BIT, the whole pool is reset at once which lets the driver recycle its memory cheaply
+		frame_commands.command_pools.get()[i] = VkHelper::CreateCommandPool(
+			device,
+			queue_family,
+			VK_COMMAND_POOL_CREATE_TRANSIENT_BIT
+		);
+
+		VkCommandBufferAllocateInfo command_buffer_allocate_info = VkHelper::CommandBufferAllocateInfo(
+			frame_commands.command_pools.get()[i],
+			1
+		);
+
+		VkResult allocate_command_buffer_resut = vkAllocateCommandBuffers(
+			device,
+			&command_buffer_allocate_info,
+			&frame_commands.command_buffers.get()[i]
+		);
+		assert(allocate_command_buffer_resut == VK_SUCCESS);
+	}
+
+	TakeFrameRecordingStats(frame_commands);
+}
+
+void VkHelper::DestroyFrameCommands(const VkDevice& device, FrameCommands& frame_commands)
+{
+	// Destroying the pools frees their command buffers
+	for (uint32_t i = 0; i < frame_commands.frames_in_flight; i++)
+	{
+		vkDestroyCommandPool(
+			device,
+			frame_commands.command_pools.get()[i],
+			nullptr
+		);
+	}
+
+	frame_commands.command_pools.reset();
+	frame_commands.command_buffers.reset();
+	frame_commands.frames_in_flight = 0;
+}
+
+VkCommandBuffer VkHelper::BeginFrameCommands(const VkDevice& device, const FrameLoop& frame_loop, FrameCommands& frame_commands)
+{
+	assert(frame_loop.frames_in_flight == frame_commands.frames_in_flight);
+
+	frame_commands.record_start = std::chrono::high_resolution_clock::now();
+
+	// BeginFrame has waited on this frames fence, so the GPU is done with everything recorded from the pool
+	VkResult reset_command_pool_result = frame_commands.dispatch->vkResetCommandPool(
+		device,
+		frame_commands.command_pools.get()[frame_loop.frame_index],
+		0
+	);
+	assert(reset_command_pool_result == VK_SUCCESS);
+
+	VkCommandBuffer command_buffer = frame_commands.command_buffers.get()[frame_loop.frame_index];
+
+	// The command buffer is submitted once then thrown away, so the driver doesn't need to keep it reusable
+	VkCommandBufferBeginInfo command_buffer_begin_info = VkHelper::CommandBufferBeginInfo(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+
+	VkResult begin_command_buffer_result = frame_commands.dispatch->vkBeginCommandBuffer(
+		command_buffer,
+		&command_buffer_begin_info
+	);
+	assert(begin_command_buffer_result == VK_SUCCESS);
+
+	return command_buffer;
+}
+
+void VkHelper::EndFrameCommands(const FrameLoop& frame_loop, FrameCommands& frame_commands)
+{
+	VkResult end_command_buffer_result = frame_commands.dispatch->vkEndCommandBuffer(
+		frame_commands.command_buffers.get()[frame_loop.frame_index]
+	);
+	assert(end_command_buffer_result == VK_SUCCESS);
+
+	std::chrono::high_resolution_clock::time_point record_end = std::chrono::high_resolution_clock::now();
+	float record_ms = std::chrono::duration_cast<std::chrono::microseconds>(record_end - frame_commands.record_start).count() / 1000.0f;
+
+	frame_commands.last_record_ms = record_ms;
+	frame_commands.total_record_ms += record_ms;
+	if (record_ms > frame_commands.max_record_ms) frame_commands.max_record_ms = record_ms;
+	frame_commands.recorded_frames++;
+}
+
+VkHelper::FrameRecordingStats VkHelper::TakeFrameRecordingStats(FrameCommands& frame_commands)
+{
+	FrameRecordingStats stats;
+	stats.frames = frame_commands.recorded_frames;
+	stats.average_ms = stats.frames > 0 ? frame_commands.total_record_ms / stats.frames : 0.0f;
+	stats.max_ms = frame_commands.max_record_ms;
+	stats.last_ms = frame_commands.last_record_ms;
+
+	frame_commands.recorded_frames = 0;
+	frame_commands.total_record_ms = 0.0f;
+	frame_commands.max_record_ms = 0.0f;
+	return stats;
+}
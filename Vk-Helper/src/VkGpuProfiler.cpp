@@ -0,0 +1,312 @@
+#include <VkGpuProfiler.hpp>
+#include <VkDispatch.hpp>
+#include <assert.h>
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <stdint.h>
+
+namespace
+{
+	// Each scope has a begin and end query in every slot
+	uint32_t QueryIndex(const VkHelper::GpuProfiler& profiler, uint32_t slot, uint32_t scope)
+	{
+		return (slot * profiler.max_scopes + scope) * 2;
+	}
+
+	float Percentile(const std::vector<float>& sorted, float percentile)
+	{
+		size_t index = static_cast<size_t>(percentile * (sorted.size() - 1) + 0.5f);
+		return sorted[std::min(index, sorted.size() - 1)];
+	}
+
+	// Scope names are written into the trace as JSON strings
+	std::string EscapeJson(const std::string& text)
+	{
+		std::string escaped;
+		for (char c : text)
+		{
+			if (c == '"' || c == '\\') escaped += '\\';
+			escaped += c;
+		}
+		return escaped;
+	}
+}
+
+VkHelper::GpuScope::GpuScope(VkCommandBuffer command_buffer, GpuProfiler& profiler, uint32_t slot, uint32_t scope) :
+	command_buffer(command_buffer), profiler(profiler), slot(slot), scope(scope)
+{
+	BeginGpuScope(command_buffer, profiler, slot, scope);
+}
+
+VkHelper::GpuScope::~GpuScope()
+{
+	EndGpuScope(command_buffer, profiler, slot, scope);
+}
+
+bool VkHelper::CreateGpuProfiler(const VkPhysicalDevice& physical_device, const VkDevice& device, uint32_t queue_family, uint32_t slot_count, uint32_t max_scopes,
+	size_t max_trace_events, GpuProfiler& profiler)
+{
+	assert(slot_count > 0 && max_scopes > 0);
+
+	// Not every queue can write timestamps, timestampValidBits is 0 when it can't
+	uint32_t queue_family_count = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &queue_family_count, nullptr);
+	std::unique_ptr<VkQueueFamilyProperties[]> queue_families(new VkQueueFamilyProperties[queue_family_count]);
+	vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &queue_family_count, queue_families.get());
+	assert(queue_family < queue_family_count);
+
+	uint32_t valid_bits = queue_families[queue_family].timestampValidBits;
+	if (valid_bits == 0) return false;
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physical_device, &properties);
+
+	profiler.device = device;
+	profiler.dispatch = &VkHelper::GetDeviceDispatch(device);
+	profiler.slot_count = slot_count;
+	profiler.max_scopes = max_scopes;
+	profiler.timestamp_period = properties.limits.timestampPeriod;
+	profiler.timestamp_mask = valid_bits >= 64 ? ~0ull : ((1ull << valid_bits) - 1);
+	profiler.max_trace_events = max_trace_events;
+
+	profiler.scope_names.clear();
+	profiler.scope_written.assign(slot_count * max_scopes, 0);
+	profiler.slot_submitted.assign(slot_count, 0);
+	profiler.history.assign(max_scopes, std::vector<float>());
+	profiler.history_next.assign(max_scopes, 0);
+	profiler.last_ms.assign(max_scopes, 0.0f);
+	profiler.trace_events.clear();
+
+	VkQueryPoolCreateInfo create_info = {};
+	create_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	create_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	create_info.queryCount = slot_count * max_scopes * 2;                   // A begin and end query for each scope in each slot
+
+	VkResult create_query_pool_result = vkCreateQueryPool(
+		device,
+		&create_info,
+		nullptr,
+		&profiler.query_pool
+	);
+	assert(create_query_pool_result == VK_SUCCESS);
+
+	return true;
+}
+
+void VkHelper::DestroyGpuProfiler(GpuProfiler& profiler)
+{
+	if (profiler.query_pool == VK_NULL_HANDLE) return;
+
+	vkDestroyQueryPool(
+		profiler.device,
+		profiler.query_pool,
+		nullptr
+	);
+	profiler.query_pool = VK_NULL_HANDLE;
+}
+
+VkQueryPool VkHelper::GrowGpuProfiler(GpuProfiler& profiler, uint32_t slot_count)
+{
+	if (profiler.query_pool == VK_NULL_HANDLE || slot_count <= profiler.slot_count) return VK_NULL_HANDLE;
+
+	VkQueryPool old_query_pool = profiler.query_pool;
+
+	profiler.slot_count = slot_count;
+	// Nothing has been recorded into the new pool yet, so no slot has results to read back
+	profiler.scope_written.assign(slot_count * profiler.max_scopes, 0);
+	profiler.slot_submitted.assign(slot_count, 0);
+
+	VkQueryPoolCreateInfo create_info = {};
+	create_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	create_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	create_info.queryCount = slot_count * profiler.max_scopes * 2;          // A begin and end query for each scope in each slot
+
+	VkResult create_query_pool_result = vkCreateQueryPool(
+		profiler.device,
+		&create_info,
+		nullptr,
+		&profiler.query_pool
+	);
+	assert(create_query_pool_result == VK_SUCCESS);
+
+	return old_query_pool;
+}
+
+uint32_t VkHelper::RegisterGpuScope(GpuProfiler& profiler, const char* name)
+{
+	if (profiler.query_pool == VK_NULL_HANDLE) return 0;
+
+	// Registering the same name twice hands back the same scope
+	for (uint32_t i = 0; i < profiler.scope_names.size(); i++)
+	{
+		if (profiler.scope_names[i] == name) return i;
+	}
+	assert(profiler.scope_names.size() < profiler.max_scopes);
+	profiler.scope_names.push_back(name);
+	return static_cast<uint32_t>(profiler.scope_names.size() - 1);
+}
+
+void VkHelper::ResetGpuProfilerSlot(VkCommandBuffer command_buffer, GpuProfiler& profiler, uint32_t slot)
+{
+	if (profiler.query_pool == VK_NULL_HANDLE) return;
+	assert(slot < profiler.slot_count);
+
+	profiler.dispatch->vkCmdResetQueryPool(
+		command_buffer,
+		profiler.query_pool,
+		QueryIndex(profiler, slot, 0),
+		profiler.max_scopes * 2
+	);
+
+	// The command buffer is being recorded again, so forget which scopes the last recording wrote
+	std::fill(profiler.scope_written.begin() + slot * profiler.max_scopes, profiler.scope_written.begin() + (slot + 1) * profiler.max_scopes, 0);
+}
+
+void VkHelper::BeginGpuScope(VkCommandBuffer command_buffer, GpuProfiler& profiler, uint32_t slot, uint32_t scope)
+{
+	if (profiler.query_pool == VK_NULL_HANDLE) return;
+	assert(slot < profiler.slot_count && scope < profiler.scope_names.size());
+
+	// Top of pipe, so the scope starts as soon as the commands after it start
+	profiler.dispatch->vkCmdWriteTimestamp(
+		command_buffer,
+		VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+		profiler.query_pool,
+		QueryIndex(profiler, slot, scope)
+	);
+}
+
+void VkHelper::EndGpuScope(VkCommandBuffer command_buffer, GpuProfiler& profiler, uint32_t slot, uint32_t scope)
+{
+	if (profiler.query_pool == VK_NULL_HANDLE) return;
+	assert(slot < profiler.slot_count && scope < profiler.scope_names.size());
+
+	// Bottom of pipe, so the scope ends once every command before it has finished
+	profiler.dispatch->vkCmdWriteTimestamp(
+		command_buffer,
+		VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+		profiler.query_pool,
+		QueryIndex(profiler, slot, scope) + 1
+	);
+
+	profiler.scope_written[slot * profiler.max_scopes + scope] = 1;
+}
+
+void VkHelper::CollectGpuTimings(GpuProfiler& profiler, uint32_t slot)
+{
+	if (profiler.query_pool == VK_NULL_HANDLE) return;
+	assert(slot < profiler.slot_count);
+
+	if (profiler.slot_submitted[slot])
+	{
+		for (uint32_t scope = 0; scope < profiler.scope_names.size(); scope++)
+		{
+			if (!profiler.scope_written[slot * profiler.max_scopes + scope]) continue;
+
+			// The fence for the slots last submit has signaled, so the results are there and we don't ask to wait
+			uint64_t timestamps[2] = {};
+			VkResult get_query_results_result = profiler.dispatch->vkGetQueryPoolResults(
+				profiler.device,
+				profiler.query_pool,
+				QueryIndex(profiler, slot, scope),
+				2,
+				sizeof(timestamps),
+				timestamps,
+				sizeof(uint64_t),
+				VK_QUERY_RESULT_64_BIT
+			);
+			if (get_query_results_result != VK_SUCCESS) continue;
+
+			uint64_t start = timestamps[0] & profiler.timestamp_mask;
+			uint64_t end = timestamps[1] & profiler.timestamp_mask;
+			// The counter wraps at timestampValidBits
+			uint64_t ticks = (end - start) & profiler.timestamp_mask;
+			float duration_ms = static_cast<float>(static_cast<double>(ticks) * profiler.timestamp_period / 1000000.0);
+
+			std::vector<float>& history = profiler.history[scope];
+			if (history.size() < profiler.history_size)
+			{
+				history.push_back(duration_ms);
+			}
+			else
+			{
+				history[profiler.history_next[scope]] = duration_ms;
+			}
+			profiler.history_next[scope] = (profiler.history_next[scope] + 1) % profiler.history_size;
+			profiler.last_ms[scope] = duration_ms;
+
+			if (profiler.trace_events.size() < profiler.max_trace_events)
+			{
+				GpuProfiler::TraceEvent trace_event;
+				trace_event.scope = scope;
+				trace_event.start = start;
+				trace_event.end = start + ticks;
+				profiler.trace_events.push_back(trace_event);
+			}
+		}
+	}
+
+	profiler.slot_submitted[slot] = 1;
+}
+
+void VkHelper::ResetGpuScopeHistory(GpuProfiler& profiler, uint32_t history_size)
+{
+	assert(history_size > 0);
+	profiler.history_size = history_size;
+	for (std::vector<float>& history : profiler.history) history.clear();
+	std::fill(profiler.history_next.begin(), profiler.history_next.end(), 0);
+}
+
+std::vector<VkHelper::GpuScopeStats> VkHelper::GetGpuScopeStats(const GpuProfiler& profiler)
+{
+	std::vector<GpuScopeStats> all_stats;
+	if (profiler.query_pool == VK_NULL_HANDLE) return all_stats;
+
+	for (uint32_t scope = 0; scope < profiler.scope_names.size(); scope++)
+	{
+		const std::vector<float>& history = profiler.history[scope];
+		if (history.empty()) continue;
+
+		std::vector<float> sorted = history;
+		std::sort(sorted.begin(), sorted.end());
+
+		GpuScopeStats stats;
+		stats.name = profiler.scope_names[scope];
+		stats.samples = static_cast<uint32_t>(sorted.size());
+		stats.last_ms = profiler.last_ms[scope];
+		for (float duration_ms : sorted) stats.average_ms += duration_ms;
+		stats.average_ms /= sorted.size();
+		stats.p50_ms = Percentile(sorted, 0.50f);
+		stats.p95_ms = Percentile(sorted, 0.95f);
+		stats.p99_ms = Percentile(sorted, 0.99f);
+		stats.max_ms = sorted.back();
+		all_stats.push_back(stats);
+	}
+	return all_stats;
+}
+
+bool VkHelper::WriteGpuTrace(const GpuProfiler& profiler, const char* path)
+{
+	std::ofstream file(path, std::ios::trunc);
+	if (!file.is_open()) return false;
+
+	// Chrome traces are in microseconds, start them from the first scope so the numbers stay small
+	uint64_t first_tick = UINT64_MAX;
+	for (const GpuProfiler::TraceEvent& trace_event : profiler.trace_events) first_tick = std::min(first_tick, trace_event.start);
+	double us_per_tick = profiler.timestamp_period / 1000.0;
+
+	file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	for (size_t i = 0; i < profiler.trace_events.size(); i++)
+	{
+		const GpuProfiler::TraceEvent& trace_event = profiler.trace_events[i];
+		if (i > 0) file << ",";
+		// Complete events, a start time and a duration
+		file << "\n{\"name\":\"" << EscapeJson(profiler.scope_names[trace_event.scope]) << "\",\"cat\":\"gpu\",\"ph\":\"X\",\"pid\":0,\"tid\":0"
+			<< ",\"ts\":" << (trace_event.start - first_tick) * us_per_tick
+			<< ",\"dur\":" << (trace_event.end - trace_event.start) * us_per_tick << "}";
+	}
+	file << "\n]}\n";
+
+	return file.good();
+}
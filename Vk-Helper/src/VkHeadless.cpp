@@ -0,0 +1,122 @@
+#include <VkHeadless.hpp>
+#include <VkCore.hpp>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+VkHelper::HeadlessOptions VkHelper::ParseHeadlessOptions(int argc, char** argv)
+{
+	HeadlessOptions options;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--headless") != 0) continue;
+		options.enabled = true;
+		options.frame_count = 1000;
+		// The frame count is optional, only take the next argument if it is a number
+		if (i + 1 < argc && argv[i + 1][0] >= '0' && argv[i + 1][0] <= '9')
+		{
+			options.frame_count = static_cast<uint32_t>(atoi(argv[++i]));
+		}
+	}
+	return options;
+}
+
+void VkHelper::CreateHeadlessSwapchain(const VkDevice& device, const VkPhysicalDeviceMemoryProperties& physical_device_mem_properties, VkFormat format,
+	uint32_t width, uint32_t height, uint32_t image_count, HeadlessSwapchain& headless_swapchain, uint32_t& swapchain_image_count,
+	std::unique_ptr<VkImage>& swapchain_images, std::unique_ptr<VkImageView>& swapchain_image_views)
+{
+	assert(image_count > 0);
+
+	headless_swapchain.format = format;
+	headless_swapchain.width = width;
+	headless_swapchain.height = height;
+	headless_swapchain.image_count = image_count;
+	headless_swapchain.next_image = 0;
+	headless_swapchain.presented_images = 0;
+
+	headless_swapchain.images = std::unique_ptr<VkImage>(new VkImage[image_count]);
+	headless_swapchain.image_memory = std::unique_ptr<VkDeviceMemory>(new VkDeviceMemory[image_count]);
+
+	swapchain_image_count = image_count;
+	swapchain_images = std::unique_ptr<VkImage>(new VkImage[image_count]);
+	swapchain_image_views = std::unique_ptr<VkImageView>(new VkImageView[image_count]);
+
+	for (uint32_t i = 0; i < image_count; i++)
+	{
+		VkHelper::CreateImage(
+			device,
+			physical_device_mem_properties,
+			width,
+			height,
+			format,
+			VK_IMAGE_TILING_OPTIMAL,
+			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT |  // Rendered to or copied into like a swapchain image, and can be
+			VK_IMAGE_USAGE_TRANSFER_DST_BIT,                                         // read back
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			headless_swapchain.images.get()[i],
+			headless_swapchain.image_memory.get()[i],
+			VK_IMAGE_LAYOUT_UNDEFINED                                                // The render pass starts the image from undefined anyway
+		);
+
+		swapchain_images.get()[i] = headless_swapchain.images.get()[i];
+
+		// The same view as CreateSwapchain makes for its images
+		VkImageViewCreateInfo image_view_create_info = {};
+		image_view_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		image_view_create_info.image = swapchain_images.get()[i];
+		image_view_create_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		image_view_create_info.format = format;
+		image_view_create_info.components.r = VK_COMPONENT_SWIZZLE_R;
+		image_view_create_info.components.g = VK_COMPONENT_SWIZZLE_G;
+		image_view_create_info.components.b = VK_COMPONENT_SWIZZLE_B;
+		image_view_create_info.components.a = VK_COMPONENT_SWIZZLE_A;
+		image_view_create_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		image_view_create_info.subresourceRange.baseMipLevel = 0;
+		image_view_create_info.subresourceRange.levelCount = 1;
+		image_view_create_info.subresourceRange.baseArrayLayer = 0;
+		image_view_create_info.subresourceRange.layerCount = 1;
+
+		VkResult create_image_view_result = vkCreateImageView(
+			device,
+			&image_view_create_info,
+			nullptr,
+			&swapchain_image_views.get()[i]
+		);
+		assert(create_image_view_result == VK_SUCCESS);
+	}
+}
+
+void VkHelper::DestroyHeadlessSwapchain(const VkDevice& device, HeadlessSwapchain& headless_swapchain)
+{
+	for (uint32_t i = 0; i < headless_swapchain.image_count; i++)
+	{
+		vkDestroyImage(
+			device,
+			headless_swapchain.images.get()[i],
+			nullptr
+		);
+
+		vkFreeMemory(
+			device,
+			headless_swapchain.image_memory.get()[i],
+			nullptr
+		);
+	}
+
+	headless_swapchain.images.reset();
+	headless_swapchain.image_memory.reset();
+	headless_swapchain.image_count = 0;
+}
+
+uint32_t VkHelper::AcquireHeadlessImage(HeadlessSwapchain& headless_swapchain)
+{
+	uint32_t image_index = headless_swapchain.next_image;
+	headless_swapchain.next_image = (headless_swapchain.next_image + 1) % headless_swapchain.image_count;
+	return image_index;
+}
+
+void VkHelper::PresentHeadlessImage(HeadlessSwapchain& headless_swapchain, uint32_t image_index)
+{
+	assert(image_index < headless_swapchain.image_count);
+	headless_swapchain.presented_images++;
+}
@@ -80,6 +80,25 @@ VkMemoryAllocateInfo VkHelper::MemroyAllocateInfo(VkDeviceSize size, uint32_t me
 	return info;
 }
 
+VkImageCreateInfo VkHelper::ImageCreateInfo(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkImageLayout initial_layout)
+{
+	VkImageCreateInfo info = {};
+	info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;           // Define the create info type
+	info.imageType = VK_IMAGE_TYPE_2D;                          // What dimensions does the image have
+	info.extent.width = width;                                  // How wide is the image
+	info.extent.height = height;                                // How tall is the image
+	info.extent.depth = 1;                                      // 2D images only have one layer of depth
+	info.mipLevels = 1;                                         // How many mip levels does the image have
+	info.arrayLayers = 1;                                       // How many layers does the image have
+	info.format = format;                                       // What format is each pixel in
+	info.tiling = tiling;                                       // How is the image laid out in memory, linear or optimal for the GPU
+	info.initialLayout = initial_layout;                        // What layout will the image start in
+	info.usage = usage;                                         // How will the image be used
+	info.samples = VK_SAMPLE_COUNT_1_BIT;                       // No multi-sampling
+	info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;               // Only one queue family will use the image at a time
+	return info;
+}
+
 VkDescriptorPoolSize VkHelper::DescriptorPoolSize(VkDescriptorType type, uint32_t descriptorCount)
 {
 	VkDescriptorPoolSize info = {};
@@ -0,0 +1,348 @@
+#include <VkKtx.hpp>
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <fstream>
+
+namespace
+{
+	const unsigned char ktx2_identifier[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+
+	// Layout of the start of a KTX2 file, see the KTX 2.0 specification
+	struct Ktx2Header
+	{
+		unsigned char identifier[12];
+		uint32_t vk_format;
+		uint32_t type_size;
+		uint32_t pixel_width;
+		uint32_t pixel_height;
+		uint32_t pixel_depth;
+		uint32_t layer_count;
+		uint32_t face_count;
+		uint32_t level_count;
+		uint32_t supercompression_scheme;
+		uint32_t dfd_byte_offset;
+		uint32_t dfd_byte_length;
+		uint32_t kvd_byte_offset;
+		uint32_t kvd_byte_length;
+		uint64_t sgd_byte_offset;
+		uint64_t sgd_byte_length;
+	};
+	static_assert(sizeof(Ktx2Header) == 80, "KTX2 header must be tightly packed");
+
+	struct Ktx2LevelIndex
+	{
+		uint64_t byte_offset;
+		uint64_t byte_length;
+		uint64_t uncompressed_byte_length;
+	};
+
+	// Values from the Khronos data format specification used in the data format descriptor
+	const uint32_t khr_df_model_rgbsda = 1;
+	const uint32_t khr_df_model_bc1a = 128;
+	const uint32_t khr_df_model_bc3 = 130;
+	const uint32_t khr_df_model_bc4 = 131;
+	const uint32_t khr_df_model_bc5 = 132;
+	const uint32_t khr_df_model_bc7 = 134;
+	const uint32_t khr_df_primaries_bt709 = 1;
+	const uint32_t khr_df_transfer_linear = 1;
+	const uint32_t khr_df_transfer_srgb = 2;
+	const uint32_t khr_df_channel_alpha = 15;
+	const uint32_t khr_df_qualifier_linear = 0x10;
+
+	struct DfdSample
+	{
+		uint32_t bit_offset;
+		uint32_t bit_length;
+		uint32_t channel;
+		uint32_t upper;
+	};
+
+	bool IsSrgb(VkFormat format)
+	{
+		return format == VK_FORMAT_BC1_RGB_SRGB_BLOCK || format == VK_FORMAT_BC1_RGBA_SRGB_BLOCK ||
+			format == VK_FORMAT_BC3_SRGB_BLOCK || format == VK_FORMAT_BC7_SRGB_BLOCK || format == VK_FORMAT_R8G8B8A8_SRGB;
+	}
+
+	// Build the basic data format descriptor block the KTX2 specification requires for the format
+	std::vector<uint32_t> BuildDataFormatDescriptor(VkFormat format)
+	{
+		uint32_t model = 0;
+		std::vector<DfdSample> samples;
+		const bool srgb = IsSrgb(format);
+		const uint32_t alpha = khr_df_channel_alpha | (srgb ? khr_df_qualifier_linear : 0);
+
+		switch (format)
+		{
+		case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+			model = khr_df_model_bc1a;
+			samples.push_back({ 0, 64, 0, 0xFFFFFFFF });
+			break;
+		case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+			model = khr_df_model_bc1a;
+			samples.push_back({ 0, 64, 1, 0xFFFFFFFF });            // Color with a punch through alpha
+			break;
+		case VK_FORMAT_BC3_UNORM_BLOCK:
+		case VK_FORMAT_BC3_SRGB_BLOCK:
+			model = khr_df_model_bc3;
+			samples.push_back({ 0, 64, alpha, 0xFFFFFFFF });
+			samples.push_back({ 64, 64, 0, 0xFFFFFFFF });
+			break;
+		case VK_FORMAT_BC4_UNORM_BLOCK:
+			model = khr_df_model_bc4;
+			samples.push_back({ 0, 64, 0, 0xFFFFFFFF });
+			break;
+		case VK_FORMAT_BC5_UNORM_BLOCK:
+			model = khr_df_model_bc5;
+			samples.push_back({ 0, 64, 0, 0xFFFFFFFF });            // Red
+			samples.push_back({ 64, 64, 1, 0xFFFFFFFF });           // Green
+			break;
+		case VK_FORMAT_BC7_UNORM_BLOCK:
+		case VK_FORMAT_BC7_SRGB_BLOCK:
+			model = khr_df_model_bc7;
+			samples.push_back({ 0, 128, 0, 0xFFFFFFFF });
+			break;
+		case VK_FORMAT_R8G8B8A8_UNORM:
+		case VK_FORMAT_R8G8B8A8_SRGB:
+			model = khr_df_model_rgbsda;
+			samples.push_back({ 0, 8, 0, 255 });
+			samples.push_back({ 8, 8, 1, 255 });
+			samples.push_back({ 16, 8, 2, 255 });
+			samples.push_back({ 24, 8, alpha, 255 });
+			break;
+		default:
+			assert(0 && "Format has no data format descriptor");
+			break;
+		}
+
+		const uint32_t block_size = 24 + 16 * static_cast<uint32_t>(samples.size());
+		const uint32_t block_dimension = VkHelper::IsBlockCompressedFormat(format) ? 3 : 0;     // Stored as size - 1
+
+		std::vector<uint32_t> dfd;
+		dfd.push_back(4 + block_size);                                                      // Total size of the descriptor
+		dfd.push_back(0);                                                                   // Khronos vendor, basic descriptor type
+		dfd.push_back(2 | (block_size << 16));                                              // Version 1.3 of the descriptor, block size
+		dfd.push_back(model | (khr_df_primaries_bt709 << 8) |
+			((srgb ? khr_df_transfer_srgb : khr_df_transfer_linear) << 16));                // Model, primaries, transfer function, straight alpha
+		dfd.push_back(block_dimension | (block_dimension << 8));                            // Texel block dimensions
+		dfd.push_back(VkHelper::KtxFormatBlockSize(format));                               // Bytes in plane 0
+		dfd.push_back(0);                                                                   // Bytes in planes 4-7
+		for (const DfdSample& sample : samples)
+		{
+			dfd.push_back(sample.bit_offset | ((sample.bit_length - 1) << 16) | (sample.channel << 24));
+			dfd.push_back(0);                                                               // Sample position
+			dfd.push_back(0);                                                               // Lower
+			dfd.push_back(sample.upper);                                                    // Upper
+		}
+		return dfd;
+	}
+
+	uint64_t AlignUp(uint64_t value, uint64_t alignment)
+	{
+		return ((value + alignment - 1) / alignment) * alignment;
+	}
+
+	uint32_t LevelDimension(uint32_t size, uint32_t level)
+	{
+		uint32_t level_size = size >> level;
+		return level_size > 0 ? level_size : 1;
+	}
+
+	// A full mip chain halves the largest side down to 1, floor(log2(max(width, height))) + 1 levels
+	uint32_t MaxLevelCount(uint32_t width, uint32_t height)
+	{
+		uint32_t size = width > height ? width : height;
+		uint32_t count = 1;
+		while (size >>= 1) count++;
+		return count;
+	}
+}
+
+uint32_t VkHelper::KtxFormatBlockSize(VkFormat format)
+{
+	switch (format)
+	{
+	case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+	case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+	case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+	case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+	case VK_FORMAT_BC4_UNORM_BLOCK:
+		return 8;
+	case VK_FORMAT_BC3_UNORM_BLOCK:
+	case VK_FORMAT_BC3_SRGB_BLOCK:
+	case VK_FORMAT_BC5_UNORM_BLOCK:
+	case VK_FORMAT_BC7_UNORM_BLOCK:
+	case VK_FORMAT_BC7_SRGB_BLOCK:
+		return 16;
+	case VK_FORMAT_R8G8B8A8_UNORM:
+	case VK_FORMAT_R8G8B8A8_SRGB:
+		return 4;
+	default:
+		return 0;
+	}
+}
+
+bool VkHelper::IsBlockCompressedFormat(VkFormat format)
+{
+	return format >= VK_FORMAT_BC1_RGB_UNORM_BLOCK && format <= VK_FORMAT_BC7_SRGB_BLOCK;
+}
+
+VkDeviceSize VkHelper::KtxLevelSize(VkFormat format, uint32_t width, uint32_t height)
+{
+	if (IsBlockCompressedFormat(format))
+	{
+		// Partial blocks at the edges still take up a whole block
+		const VkDeviceSize blocks_x = (width + 3) / 4;
+		const VkDeviceSize blocks_y = (height + 3) / 4;
+		return blocks_x * blocks_y * KtxFormatBlockSize(format);
+	}
+	return static_cast<VkDeviceSize>(width) * height * KtxFormatBlockSize(format);
+}
+
+bool VkHelper::SupportsSampledFormat(const VkPhysicalDevice& physical_device, VkFormat format)
+{
+	VkFormatProperties format_properties;
+	vkGetPhysicalDeviceFormatProperties(
+		physical_device,
+		format,
+		&format_properties
+	);
+	return (format_properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+}
+
+bool VkHelper::LoadKtx2(const char* path, KtxTexture& texture)
+{
+	texture = KtxTexture();
+
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file.is_open()) return false;
+
+	const std::streamsize file_size = file.tellg();
+	if (file_size < static_cast<std::streamsize>(sizeof(Ktx2Header))) return false;
+
+	texture.data.resize(static_cast<size_t>(file_size));
+	file.seekg(0, std::ios::beg);
+	if (!file.read(reinterpret_cast<char*>(texture.data.data()), file_size)) return false;
+
+	Ktx2Header header;
+	memcpy(&header, texture.data.data(), sizeof(Ktx2Header));
+
+	if (memcmp(header.identifier, ktx2_identifier, sizeof(ktx2_identifier)) != 0) return false;
+
+	texture.format = static_cast<VkFormat>(header.vk_format);
+	texture.width = header.pixel_width;
+	texture.height = header.pixel_height;
+
+	// We only load plain 2D textures
+	if (KtxFormatBlockSize(texture.format) == 0 ||
+		header.supercompression_scheme != 0 ||
+		header.pixel_width == 0 || header.pixel_height == 0 || header.pixel_depth > 1 ||
+		header.layer_count > 1 || header.face_count != 1)
+	{
+		return false;
+	}
+
+	// A level count of 0 asks the loader to generate the mips, there is still one level in the file
+	const uint32_t level_count = header.level_count > 0 ? header.level_count : 1;
+	// Any more levels than a full mip chain would shift the size out past its bits, and can only come from a broken file
+	if (level_count > MaxLevelCount(texture.width, texture.height)) return false;
+	const uint64_t level_index_end = sizeof(Ktx2Header) + static_cast<uint64_t>(level_count) * sizeof(Ktx2LevelIndex);
+	if (level_index_end > texture.data.size()) return false;
+
+	for (uint32_t level = 0; level < level_count; level++)
+	{
+		Ktx2LevelIndex level_index;
+		memcpy(&level_index, texture.data.data() + sizeof(Ktx2Header) + level * sizeof(Ktx2LevelIndex), sizeof(Ktx2LevelIndex));
+
+		KtxLevel ktx_level;
+		ktx_level.width = LevelDimension(texture.width, level);
+		ktx_level.height = LevelDimension(texture.height, level);
+		ktx_level.offset = level_index.byte_offset;
+		ktx_level.size = KtxLevelSize(texture.format, ktx_level.width, ktx_level.height);
+
+		if (level_index.byte_length < ktx_level.size ||
+			level_index.byte_offset > texture.data.size() ||
+			level_index.byte_length > texture.data.size() - level_index.byte_offset)
+		{
+			return false;
+		}
+		texture.levels.push_back(ktx_level);
+	}
+	return true;
+}
+
+bool VkHelper::WriteKtx2(const char* path, VkFormat format, uint32_t width, uint32_t height, uint32_t level_count, const void* const* level_data)
+{
+	if (KtxFormatBlockSize(format) == 0 || level_count == 0) return false;
+
+	const std::vector<uint32_t> dfd = BuildDataFormatDescriptor(format);
+
+	Ktx2Header header = {};
+	memcpy(header.identifier, ktx2_identifier, sizeof(ktx2_identifier));
+	header.vk_format = static_cast<uint32_t>(format);
+	header.type_size = 1;
+	header.pixel_width = width;
+	header.pixel_height = height;
+	header.pixel_depth = 0;
+	header.layer_count = 0;
+	header.face_count = 1;
+	header.level_count = level_count;
+	header.supercompression_scheme = 0;
+	header.dfd_byte_offset = static_cast<uint32_t>(sizeof(Ktx2Header) + level_count * sizeof(Ktx2LevelIndex));
+	header.dfd_byte_length = static_cast<uint32_t>(dfd.size() * sizeof(uint32_t));
+
+	// Levels must start on a multiple of the block size and of 4 bytes, all our block sizes are multiples of 4
+	const uint64_t level_alignment = KtxFormatBlockSize(format);
+
+	// The smallest level is stored first so a streaming reader gets a low detail image early
+	std::vector<Ktx2LevelIndex> level_index(level_count);
+	uint64_t offset = header.dfd_byte_offset + header.dfd_byte_length;
+	for (uint32_t level = level_count; level-- > 0;)
+	{
+		offset = AlignUp(offset, level_alignment);
+		level_index[level].byte_offset = offset;
+		level_index[level].byte_length = KtxLevelSize(format, LevelDimension(width, level), LevelDimension(height, level));
+		level_index[level].uncompressed_byte_length = level_index[level].byte_length;
+		offset += level_index[level].byte_length;
+	}
+
+	// Write to a temporary file first so a failed write doesn't leave a broken texture behind
+	const std::string temp_path = std::string(path) + ".tmp";
+	{
+		std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+		if (!file.is_open()) return false;
+
+		file.write(reinterpret_cast<const char*>(&header), sizeof(Ktx2Header));
+		file.write(reinterpret_cast<const char*>(level_index.data()), level_index.size() * sizeof(Ktx2LevelIndex));
+		file.write(reinterpret_cast<const char*>(dfd.data()), dfd.size() * sizeof(uint32_t));
+
+		uint64_t written = header.dfd_byte_offset + header.dfd_byte_length;
+		const char zeros[16] = {};
+		for (uint32_t level = level_count; level-- > 0;)
+		{
+			file.write(zeros, level_index[level].byte_offset - written);
+			file.write(static_cast<const char*>(level_data[level]), level_index[level].byte_length);
+			written = level_index[level].byte_offset + level_index[level].byte_length;
+		}
+
+		file.flush();
+		if (!file.good())
+		{
+			file.close();
+			remove(temp_path.c_str());
+			return false;
+		}
+	}
+
+	// rename won't replace an existing file on windows
+	remove(path);
+	if (rename(temp_path.c_str(), path) != 0)
+	{
+		remove(temp_path.c_str());
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,265 @@
+#include <VkMeshCache.hpp>
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	// "VKMC"
+	const uint32_t mesh_cache_magic = 0x434D4B56;
+	// Bump this whenever the layout of the file changes
+	const uint32_t mesh_cache_version = 2;
+	const uint64_t stream_alignment = 16;
+
+	uint64_t AlignOffset(uint64_t offset)
+	{
+		return (offset + stream_alignment - 1) & ~(stream_alignment - 1);
+	}
+
+	bool GetSourceInfo(const char* path, uint64_t& modified_time, uint64_t& size)
+	{
+		struct stat file_info;
+		if (stat(path, &file_info) != 0) return false;
+		modified_time = static_cast<uint64_t>(file_info.st_mtime);
+		size = static_cast<uint64_t>(file_info.st_size);
+		return true;
+	}
+
+	// Replace the file at path with the temporary file in one step
+	bool ReplaceWithTempFile(const std::string& temp_path, const std::string& path)
+	{
+#ifdef _WIN32
+		return MoveFileExA(temp_path.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+		return rename(temp_path.c_str(), path.c_str()) == 0;
+#endif
+	}
+
+	bool MapFile(const char* path, VkHelper::MeshCache& mesh_cache)
+	{
+#ifdef _WIN32
+		HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE) return false;
+
+		LARGE_INTEGER file_size;
+		if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0)
+		{
+			CloseHandle(file);
+			return false;
+		}
+
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping == nullptr)
+		{
+			CloseHandle(file);
+			return false;
+		}
+
+		void* memory = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (memory == nullptr)
+		{
+			CloseHandle(mapping);
+			CloseHandle(file);
+			return false;
+		}
+
+		mesh_cache.file_handle = file;
+		mesh_cache.mapping_handle = mapping;
+		mesh_cache.mapped_memory = memory;
+		mesh_cache.mapped_size = static_cast<size_t>(file_size.QuadPart);
+#else
+		int file = open(path, O_RDONLY);
+		if (file < 0) return false;
+
+		struct stat file_info;
+		if (fstat(file, &file_info) != 0 || file_info.st_size == 0)
+		{
+			close(file);
+			return false;
+		}
+
+		void* memory = mmap(nullptr, static_cast<size_t>(file_info.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+		if (memory == MAP_FAILED)
+		{
+			close(file);
+			return false;
+		}
+
+		mesh_cache.file_descriptor = file;
+		mesh_cache.mapped_memory = memory;
+		mesh_cache.mapped_size = static_cast<size_t>(file_info.st_size);
+#endif
+		return true;
+	}
+
+	bool StreamFits(const VkHelper::MeshCache& mesh_cache, uint64_t offset, uint64_t size)
+	{
+		return offset <= mesh_cache.mapped_size && size <= mesh_cache.mapped_size - offset;
+	}
+}
+
+VkHelper::MeshBounds VkHelper::ComputeMeshBounds(const void* vertices, uint32_t vertex_count, uint32_t vertex_stride, uint32_t position_offset)
+{
+	MeshBounds bounds = {};
+	if (vertex_count == 0) return bounds;
+
+	const char* vertex_data = static_cast<const char*>(vertices);
+	float position[3];
+
+	memcpy(position, vertex_data + position_offset, sizeof(position));
+	for (int axis = 0; axis < 3; axis++)
+	{
+		bounds.min[axis] = position[axis];
+		bounds.max[axis] = position[axis];
+	}
+
+	for (uint32_t i = 1; i < vertex_count; i++)
+	{
+		memcpy(position, vertex_data + i * vertex_stride + position_offset, sizeof(position));
+		for (int axis = 0; axis < 3; axis++)
+		{
+			if (position[axis] < bounds.min[axis]) bounds.min[axis] = position[axis];
+			if (position[axis] > bounds.max[axis]) bounds.max[axis] = position[axis];
+		}
+	}
+
+	// The sphere is centered on the box, so its radius is the furthest vertex from the middle of the box
+	float center[3] = {
+		(bounds.min[0] + bounds.max[0]) * 0.5f,
+		(bounds.min[1] + bounds.max[1]) * 0.5f,
+		(bounds.min[2] + bounds.max[2]) * 0.5f
+	};
+	float radius_squared = 0.0f;
+	for (uint32_t i = 0; i < vertex_count; i++)
+	{
+		memcpy(position, vertex_data + i * vertex_stride + position_offset, sizeof(position));
+		float x = position[0] - center[0];
+		float y = position[1] - center[1];
+		float z = position[2] - center[2];
+		float distance_squared = x * x + y * y + z * z;
+		if (distance_squared > radius_squared) radius_squared = distance_squared;
+	}
+	bounds.radius = sqrtf(radius_squared);
+
+	return bounds;
+}
+
+bool VkHelper::WriteMeshCache(const char* cache_path, const char* source_path, const void* vertices, uint32_t vertex_count, uint32_t vertex_stride,
+	const uint32_t* indices, uint32_t index_count, const void* materials, uint32_t material_count, uint32_t material_stride, const MeshBounds& bounds)
+{
+	MeshCacheHeader header = {};
+	header.magic = mesh_cache_magic;
+	header.version = mesh_cache_version;
+	if (!GetSourceInfo(source_path, header.source_modified_time, header.source_size)) return false;
+	header.vertex_stride = vertex_stride;
+	header.vertex_count = vertex_count;
+	header.index_count = index_count;
+	header.material_stride = material_stride;
+	header.material_count = material_count;
+
+	const uint64_t vertex_size = static_cast<uint64_t>(vertex_count) * vertex_stride;
+	const uint64_t index_size = static_cast<uint64_t>(index_count) * sizeof(uint32_t);
+	const uint64_t material_size = static_cast<uint64_t>(material_count) * material_stride;
+
+	header.vertex_offset = AlignOffset(sizeof(MeshCacheHeader));
+	header.index_offset = AlignOffset(header.vertex_offset + vertex_size);
+	header.material_offset = AlignOffset(header.index_offset + index_size);
+	header.bounds = bounds;
+
+	const std::string temp_path = std::string(cache_path) + ".tmp";
+	{
+		std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+		if (!file.is_open()) return false;
+
+		const char zeros[stream_alignment] = {};
+		file.write(reinterpret_cast<const char*>(&header), sizeof(MeshCacheHeader));
+		file.write(zeros, header.vertex_offset - sizeof(MeshCacheHeader));
+		file.write(static_cast<const char*>(vertices), vertex_size);
+		file.write(zeros, header.index_offset - (header.vertex_offset + vertex_size));
+		file.write(reinterpret_cast<const char*>(indices), index_size);
+		file.write(zeros, header.material_offset - (header.index_offset + index_size));
+		file.write(static_cast<const char*>(materials), material_size);
+		file.flush();
+		if (!file.good())
+		{
+			file.close();
+			remove(temp_path.c_str());
+			return false;
+		}
+	}
+
+	if (!ReplaceWithTempFile(temp_path, cache_path))
+	{
+		remove(temp_path.c_str());
+		return false;
+	}
+	return true;
+}
+
+bool VkHelper::OpenMeshCache(const char* cache_path, const char* source_path, uint32_t vertex_stride, uint32_t material_stride, MeshCache& mesh_cache)
+{
+	mesh_cache = MeshCache();
+	if (!MapFile(cache_path, mesh_cache)) return false;
+
+	const MeshCacheHeader* header = static_cast<const MeshCacheHeader*>(mesh_cache.mapped_memory);
+
+	bool valid = mesh_cache.mapped_size >= sizeof(MeshCacheHeader) &&
+		header->magic == mesh_cache_magic &&
+		header->version == mesh_cache_version &&
+		header->vertex_stride == vertex_stride &&                   // Was the cache written with the same vertex layout
+		header->material_stride == material_stride &&               // And the same material layout
+		StreamFits(mesh_cache, header->vertex_offset, static_cast<uint64_t>(header->vertex_count) * header->vertex_stride) &&
+		StreamFits(mesh_cache, header->index_offset, static_cast<uint64_t>(header->index_count) * sizeof(uint32_t)) &&
+		StreamFits(mesh_cache, header->material_offset, static_cast<uint64_t>(header->material_count) * header->material_stride);
+
+	if (valid)
+	{
+		uint64_t modified_time = 0;
+		uint64_t size = 0;
+		// If the source is gone the cache is all we have, so use it. Otherwise any change to the source rebuilds the cache
+		if (GetSourceInfo(source_path, modified_time, size))
+		{
+			valid = modified_time == header->source_modified_time && size == header->source_size;
+		}
+	}
+
+	if (!valid)
+	{
+		CloseMeshCache(mesh_cache);
+		return false;
+	}
+
+	const char* memory = static_cast<const char*>(mesh_cache.mapped_memory);
+	mesh_cache.header = header;
+	mesh_cache.vertices = memory + header->vertex_offset;
+	mesh_cache.indices = reinterpret_cast<const uint32_t*>(memory + header->index_offset);
+	mesh_cache.materials = memory + header->material_offset;
+	return true;
+}
+
+void VkHelper::CloseMeshCache(MeshCache& mesh_cache)
+{
+#ifdef _WIN32
+	if (mesh_cache.mapped_memory != nullptr) UnmapViewOfFile(mesh_cache.mapped_memory);
+	if (mesh_cache.mapping_handle != nullptr) CloseHandle(mesh_cache.mapping_handle);
+	if (mesh_cache.file_handle != nullptr) CloseHandle(mesh_cache.file_handle);
+#else
+	if (mesh_cache.mapped_memory != nullptr) munmap(mesh_cache.mapped_memory, mesh_cache.mapped_size);
+	if (mesh_cache.file_descriptor >= 0) close(mesh_cache.file_descriptor);
+#endif
+	mesh_cache = MeshCache();
+}
@@ -0,0 +1,382 @@
+#include <VkMipmaps.hpp>
+#include <VkCore.hpp>
+#include <VkInitializers.hpp>
+#include <assert.h>
+
+namespace
+{
+	// Work group size of the downsample compute shader
+	const uint32_t downsample_group_size = 8;
+
+	uint32_t LevelSize(uint32_t size, uint32_t level)
+	{
+		uint32_t level_size = size >> level;
+		return level_size > 0 ? level_size : 1;
+	}
+
+	VkImageMemoryBarrier LevelBarrier(VkImage image, uint32_t base_level, uint32_t level_count, VkImageLayout old_layout, VkImageLayout new_layout,
+		VkAccessFlags src_access, VkAccessFlags dst_access)
+	{
+		VkImageMemoryBarrier barrier = VkHelper::ImageMemoryBarrier();
+		barrier.image = image;
+		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		barrier.subresourceRange.baseMipLevel = base_level;
+		barrier.subresourceRange.levelCount = level_count;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = 1;
+		barrier.oldLayout = old_layout;
+		barrier.newLayout = new_layout;
+		barrier.srcAccessMask = src_access;
+		barrier.dstAccessMask = dst_access;
+		return barrier;
+	}
+
+	void RecordBarriers(VkCommandBuffer command_buffer, VkPipelineStageFlags src_stage, VkPipelineStageFlags dst_stage, uint32_t barrier_count, const VkImageMemoryBarrier* barriers)
+	{
+		vkCmdPipelineBarrier(
+			command_buffer,
+			src_stage,
+			dst_stage,
+			0,
+			0, nullptr,
+			0, nullptr,
+			barrier_count, barriers
+		);
+	}
+
+	// Each level is made by a linear filtered blit of the level above it
+	void RecordBlitMipmaps(VkCommandBuffer command_buffer, VkImage image, uint32_t width, uint32_t height, uint32_t mip_levels,
+		VkImageLayout final_layout, VkAccessFlags dst_access, VkPipelineStageFlags dst_stage)
+	{
+		for (uint32_t level = 1; level < mip_levels; level++)
+		{
+			// The level above becomes the blit source, this level becomes the blit destination
+			VkImageMemoryBarrier barriers[2] = {
+				LevelBarrier(image, level - 1, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+					VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT),
+				LevelBarrier(image, level, 1, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+					0, VK_ACCESS_TRANSFER_WRITE_BIT)
+			};
+			RecordBarriers(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 2, barriers);
+
+			VkImageBlit blit = {};
+			blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			blit.srcSubresource.mipLevel = level - 1;
+			blit.srcSubresource.baseArrayLayer = 0;
+			blit.srcSubresource.layerCount = 1;
+			blit.srcOffsets[1] = { static_cast<int32_t>(LevelSize(width, level - 1)), static_cast<int32_t>(LevelSize(height, level - 1)), 1 };
+			blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			blit.dstSubresource.mipLevel = level;
+			blit.dstSubresource.baseArrayLayer = 0;
+			blit.dstSubresource.layerCount = 1;
+			blit.dstOffsets[1] = { static_cast<int32_t>(LevelSize(width, level)), static_cast<int32_t>(LevelSize(height, level)), 1 };
+
+			vkCmdBlitImage(
+				command_buffer,
+				image,
+				VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+				image,
+				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				1,
+				&blit,
+				VK_FILTER_LINEAR                                            // Averages the 2x2 texels of the level above
+			);
+		}
+
+		// Every level but the last was read as a blit source, the last was only written
+		VkImageMemoryBarrier barriers[2] = {
+			LevelBarrier(image, 0, mip_levels - 1, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, final_layout,
+				VK_ACCESS_TRANSFER_READ_BIT, dst_access),
+			LevelBarrier(image, mip_levels - 1, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, final_layout,
+				VK_ACCESS_TRANSFER_WRITE_BIT, dst_access)
+		};
+		RecordBarriers(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, dst_stage, 2, barriers);
+	}
+
+	void CreateComputeDownsample(VkHelper::MipmapGenerator& mipmap_generator)
+	{
+		if (mipmap_generator.pipeline != VK_NULL_HANDLE) return;
+
+		const uint32_t layout_binding_count = 2;
+		VkDescriptorSetLayoutBinding layout_bindings[layout_binding_count] = {
+			VkHelper::DescriptorSetLayoutBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_COMPUTE_BIT),   // The level above
+			VkHelper::DescriptorSetLayoutBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT)             // The level being written
+		};
+
+		mipmap_generator.descriptor_set_layout = VkHelper::CreateDescriptorSetLayout(
+			mipmap_generator.device,
+			layout_bindings,
+			layout_binding_count
+		);
+
+		mipmap_generator.pipeline = VkHelper::CreateComputePipeline(
+			mipmap_generator.device,
+			mipmap_generator.pipeline_layout,
+			mipmap_generator.compute_shader_path.c_str(),
+			mipmap_generator.shader_module,
+			1,
+			&mipmap_generator.descriptor_set_layout
+		);
+
+		// Sampling between the 2x2 source texels with a linear filter averages them
+		VkSamplerCreateInfo sampler_info = VkHelper::SamplerCreateInfo();
+		sampler_info.magFilter = VK_FILTER_LINEAR;
+		sampler_info.minFilter = VK_FILTER_LINEAR;
+		sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		sampler_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		sampler_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		sampler_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		sampler_info.maxLod = 0.0f;
+
+		mipmap_generator.sampler = VkHelper::AcquireSampler(mipmap_generator.device, sampler_info);
+	}
+
+	VkImageView CreateLevelView(VkHelper::MipmapGenerator& mipmap_generator, VkImage image, VkFormat format, uint32_t level)
+	{
+		VkImageViewCreateInfo view_info = VkHelper::ImageViewCreate(image, format, VK_IMAGE_ASPECT_COLOR_BIT);
+		view_info.subresourceRange.baseMipLevel = level;
+		view_info.subresourceRange.levelCount = 1;
+
+		VkImageView view = VK_NULL_HANDLE;
+		VkResult create_image_view_result = vkCreateImageView(
+			mipmap_generator.device,
+			&view_info,
+			nullptr,
+			&view
+		);
+		assert(create_image_view_result == VK_SUCCESS);
+
+		mipmap_generator.level_views.push_back(view);
+		return view;
+	}
+
+	// Each level is written by a compute shader that reads the level above it
+	void RecordComputeMipmaps(VkHelper::MipmapGenerator& mipmap_generator, VkCommandBuffer command_buffer, VkImage image, VkFormat format, uint32_t width, uint32_t height,
+		uint32_t mip_levels, VkImageLayout final_layout, VkAccessFlags dst_access, VkPipelineStageFlags dst_stage)
+	{
+		CreateComputeDownsample(mipmap_generator);
+
+		// One descriptor set per level we write
+		const uint32_t set_count = mip_levels - 1;
+		const uint32_t pool_size_count = 2;
+		VkDescriptorPoolSize pool_sizes[pool_size_count] = {
+			VkHelper::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, set_count),
+			VkHelper::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, set_count)
+		};
+		VkDescriptorPool descriptor_pool = VkHelper::CreateDescriptorPool(
+			mipmap_generator.device,
+			pool_sizes,
+			pool_size_count,
+			set_count
+		);
+		mipmap_generator.descriptor_pools.push_back(descriptor_pool);
+
+		// The first level is read by the shader
+		VkImageMemoryBarrier source_barrier = LevelBarrier(image, 0, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT);
+		RecordBarriers(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 1, &source_barrier);
+
+		vkCmdBindPipeline(
+			command_buffer,
+			VK_PIPELINE_BIND_POINT_COMPUTE,
+			mipmap_generator.pipeline
+		);
+
+		for (uint32_t level = 1; level < mip_levels; level++)
+		{
+			VkImageMemoryBarrier destination_barrier = LevelBarrier(image, level, 1, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+				0, VK_ACCESS_SHADER_WRITE_BIT);
+			RecordBarriers(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 1, &destination_barrier);
+
+			VkDescriptorSet descriptor_set = VkHelper::AllocateDescriptorSet(
+				mipmap_generator.device,
+				descriptor_pool,
+				mipmap_generator.descriptor_set_layout,
+				1
+			);
+
+			VkDescriptorImageInfo source_info = VkHelper::DescriptorImageInfo(
+				mipmap_generator.sampler,
+				CreateLevelView(mipmap_generator, image, format, level - 1),
+				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+			);
+			VkDescriptorImageInfo destination_info = VkHelper::DescriptorImageInfo(
+				VK_NULL_HANDLE,
+				CreateLevelView(mipmap_generator, image, format, level),
+				VK_IMAGE_LAYOUT_GENERAL
+			);
+
+			VkWriteDescriptorSet descriptor_writes[2] = {
+				VkHelper::WriteDescriptorSet(descriptor_set, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, source_info, 0),
+				VkHelper::WriteDescriptorSet(descriptor_set, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, destination_info, 1)
+			};
+
+			vkUpdateDescriptorSets(
+				mipmap_generator.device,
+				2,
+				descriptor_writes,
+				0,
+				NULL
+			);
+
+			vkCmdBindDescriptorSets(
+				command_buffer,
+				VK_PIPELINE_BIND_POINT_COMPUTE,
+				mipmap_generator.pipeline_layout,
+				0,
+				1,
+				&descriptor_set,
+				0,
+				NULL
+			);
+
+			vkCmdDispatch(
+				command_buffer,
+				(LevelSize(width, level) + downsample_group_size - 1) / downsample_group_size,      // X axis
+				(LevelSize(height, level) + downsample_group_size - 1) / downsample_group_size,     // Y axis
+				1                                                                                   // Z axis
+			);
+
+			// The level we just wrote is the source of the next one
+			VkImageMemoryBarrier written_barrier = LevelBarrier(image, level, 1, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+				VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT);
+			RecordBarriers(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 1, &written_barrier);
+		}
+
+		VkImageMemoryBarrier final_barrier = LevelBarrier(image, 0, mip_levels, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, final_layout,
+			VK_ACCESS_SHADER_WRITE_BIT, dst_access);
+		RecordBarriers(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, dst_stage, 1, &final_barrier);
+	}
+}
+
+uint32_t VkHelper::MipLevelCount(uint32_t width, uint32_t height)
+{
+	uint32_t largest = width > height ? width : height;
+	uint32_t levels = 1;
+	while (largest > 1)
+	{
+		largest >>= 1;
+		levels++;
+	}
+	return levels;
+}
+
+bool VkHelper::SupportsBlitMipmaps(const VkPhysicalDevice& physical_device, VkFormat format)
+{
+	VkFormatProperties format_properties;
+	vkGetPhysicalDeviceFormatProperties(
+		physical_device,
+		format,
+		&format_properties
+	);
+
+	const VkFormatFeatureFlags required = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+	return (format_properties.optimalTilingFeatures & required) == required;
+}
+
+void VkHelper::CreateMipmapGenerator(const VkDevice& device, const VkPhysicalDevice& physical_device, const char* compute_shader_path, MipmapGenerator& mipmap_generator)
+{
+	mipmap_generator.device = device;
+	mipmap_generator.physical_device = physical_device;
+	mipmap_generator.compute_shader_path = compute_shader_path;
+}
+
+void VkHelper::DestroyMipmapGenerator(MipmapGenerator& mipmap_generator)
+{
+	ReleaseMipmapResources(mipmap_generator);
+
+	// The compute fallback may never have been needed
+	if (mipmap_generator.pipeline == VK_NULL_HANDLE) return;
+
+	VkHelper::ReleaseSampler(
+		mipmap_generator.device,
+		mipmap_generator.sampler
+	);
+
+	vkDestroyPipeline(
+		mipmap_generator.device,
+		mipmap_generator.pipeline,
+		nullptr
+	);
+
+	vkDestroyPipelineLayout(
+		mipmap_generator.device,
+		mipmap_generator.pipeline_layout,
+		nullptr
+	);
+
+	vkDestroyShaderModule(
+		mipmap_generator.device,
+		mipmap_generator.shader_module,
+		nullptr
+	);
+
+	vkDestroyDescriptorSetLayout(
+		mipmap_generator.device,
+		mipmap_generator.descriptor_set_layout,
+		nullptr
+	);
+
+	mipmap_generator.pipeline = VK_NULL_HANDLE;
+}
+
+VkImageUsageFlags VkHelper::MipmapImageUsage(const MipmapGenerator& mipmap_generator, VkFormat format)
+{
+	if (SupportsBlitMipmaps(mipmap_generator.physical_device, format))
+	{
+		return VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	}
+	// The compute path reads each level through a sampler and writes the next as a storage image
+	return VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+}
+
+void VkHelper::RecordGenerateMipmaps(MipmapGenerator& mipmap_generator, VkCommandBuffer command_buffer, VkImage image, VkFormat format, uint32_t width, uint32_t height,
+	uint32_t mip_levels, VkImageLayout final_layout, VkAccessFlags dst_access, VkPipelineStageFlags dst_stage)
+{
+	if (mip_levels <= 1)
+	{
+		// Nothing to generate, just move the image into its final layout
+		VkImageMemoryBarrier barrier = LevelBarrier(image, 0, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, final_layout,
+			VK_ACCESS_TRANSFER_WRITE_BIT, dst_access);
+		RecordBarriers(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, dst_stage, 1, &barrier);
+		return;
+	}
+
+	if (SupportsBlitMipmaps(mipmap_generator.physical_device, format))
+	{
+		RecordBlitMipmaps(command_buffer, image, width, height, mip_levels, final_layout, dst_access, dst_stage);
+	}
+	else
+	{
+#ifndef NDEBUG
+		VkFormatProperties format_properties;
+		vkGetPhysicalDeviceFormatProperties(mipmap_generator.physical_device, format, &format_properties);
+		assert((format_properties.optimalTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT) && "Format can't be blitted or used as a storage image");
+#endif
+		RecordComputeMipmaps(mipmap_generator, command_buffer, image, format, width, height, mip_levels, final_layout, dst_access, dst_stage);
+	}
+}
+
+void VkHelper::ReleaseMipmapResources(MipmapGenerator& mipmap_generator)
+{
+	for (VkImageView view : mipmap_generator.level_views)
+	{
+		vkDestroyImageView(
+			mipmap_generator.device,
+			view,
+			nullptr
+		);
+	}
+	mipmap_generator.level_views.clear();
+
+	// Destroying the pools frees the descriptor sets that came from them
+	for (VkDescriptorPool descriptor_pool : mipmap_generator.descriptor_pools)
+	{
+		vkDestroyDescriptorPool(
+			mipmap_generator.device,
+			descriptor_pool,
+			nullptr
+		);
+	}
+	mipmap_generator.descriptor_pools.clear();
+}
@@ -0,0 +1,161 @@
+#include <VkPipelineBuildQueue.hpp>
+#include <VkCore.hpp>
+#include <VkCpuProfiler.hpp>
+#include <assert.h>
+#include <memory>
+
+namespace
+{
+	void WorkerLoop(VkHelper::PipelineBuildQueue* build_queue)
+	{
+		VK_HELPER_CPU_THREAD_NAME("Pipeline builder");
+
+		while (true)
+		{
+			std::function<void()> job;
+			{
+				std::unique_lock<std::mutex> guard(build_queue->lock);
+				build_queue->job_available.wait(guard, [build_queue] { return build_queue->stopping || !build_queue->jobs.empty(); });
+
+				// Only stop once all the queued pipelines have been built
+				if (build_queue->jobs.empty()) return;
+
+				job = std::move(build_queue->jobs.front());
+				build_queue->jobs.pop_front();
+			}
+			VK_HELPER_CPU_ZONE("Build pipeline");
+			job();
+		}
+	}
+
+	std::shared_future<VkPipeline> PushJob(VkHelper::PipelineBuildQueue& build_queue, std::function<VkPipeline()> build)
+	{
+		// std::function needs to be copyable, so the task is shared between the queue and the job
+		std::shared_ptr<std::packaged_task<VkPipeline()>> task = std::make_shared<std::packaged_task<VkPipeline()>>(build);
+		std::shared_future<VkPipeline> pipeline = task->get_future().share();
+		{
+			std::lock_guard<std::mutex> guard(build_queue.lock);
+			assert(!build_queue.stopping && "Pipeline queued after the build queue was destroyed");
+			build_queue.jobs.push_back([task] { (*task)(); });
+		}
+		build_queue.job_available.notify_one();
+		return pipeline;
+	}
+}
+
+void VkHelper::CreatePipelineBuildQueue(const VkDevice& device, uint32_t thread_count, PipelineBuildQueue& build_queue)
+{
+	build_queue.device = device;
+	build_queue.stopping = false;
+
+	if (thread_count == 0)
+	{
+		uint32_t hardware_threads = std::thread::hardware_concurrency();
+		thread_count = hardware_threads > 1 ? hardware_threads - 1 : 1;
+	}
+
+	for (uint32_t i = 0; i < thread_count; i++)
+	{
+		build_queue.workers.push_back(std::thread(WorkerLoop, &build_queue));
+	}
+}
+
+void VkHelper::DestroyPipelineBuildQueue(PipelineBuildQueue& build_queue)
+{
+	{
+		std::lock_guard<std::mutex> guard(build_queue.lock);
+		build_queue.stopping = true;
+	}
+	build_queue.job_available.notify_all();
+
+	for (std::thread& worker : build_queue.workers)
+	{
+		worker.join();
+	}
+	build_queue.workers.clear();
+}
+
+std::shared_future<VkPipeline> VkHelper::QueueGraphicsPipeline(PipelineBuildQueue& build_queue, const GraphicsPipelineDescription& description)
+{
+	assert(description.pipeline_layout != nullptr && description.shader_modules != nullptr);
+	assert(description.shader_paths.size() == description.shader_stages.size());
+
+	VkDevice device = build_queue.device;
+	// Take a non const copy, CreateGraphicsPipeline takes some of its arrays as non const pointers
+	GraphicsPipelineDescription job_description = description;
+	return PushJob(build_queue, [device, job_description]() mutable
+	{
+		GraphicsPipelineDescription& description = job_description;
+
+		std::vector<const char*> shader_paths;
+		for (const std::string& path : description.shader_paths)
+		{
+			shader_paths.push_back(path.c_str());
+		}
+
+		return VkHelper::CreateGraphicsPipeline(
+			description.physical_device,
+			device,
+			description.renderpass,
+			*description.pipeline_layout,
+			static_cast<uint32_t>(shader_paths.size()),
+			shader_paths.data(),
+			description.shader_stages.data(),
+			description.shader_modules,
+			static_cast<uint32_t>(description.descriptor_set_layouts.size()),
+			description.descriptor_set_layouts.data(),
+			static_cast<uint32_t>(description.vertex_input_attribute_descriptions.size()),
+			description.vertex_input_attribute_descriptions.data(),
+			static_cast<uint32_t>(description.vertex_input_binding_descriptions.size()),
+			description.vertex_input_binding_descriptions.data(),
+			static_cast<uint32_t>(description.dynamic_states.size()),
+			description.dynamic_states.data(),
+			description.topology,
+			description.polygon_mode,
+			description.line_width,
+			description.cull_mode,
+			description.depth_write_enable,
+			description.depth_test_enable
+		);
+	});
+}
+
+std::shared_future<VkPipeline> VkHelper::QueueComputePipeline(PipelineBuildQueue& build_queue, const ComputePipelineDescription& description)
+{
+	assert(description.pipeline_layout != nullptr && description.shader_module != nullptr);
+
+	VkDevice device = build_queue.device;
+	return PushJob(build_queue, [device, description]()
+	{
+		return VkHelper::CreateComputePipeline(
+			device,
+			*description.pipeline_layout,
+			description.shader_path.c_str(),
+			*description.shader_module,
+			static_cast<uint32_t>(description.descriptor_set_layouts.size()),
+			description.descriptor_set_layouts.data()
+		);
+	});
+}
+
+std::shared_future<VkPipeline> VkHelper::QueueRayTracingPipeline(PipelineBuildQueue& build_queue, const RayTracingPipelineDescription& description)
+{
+	VkDevice device = build_queue.device;
+	return PushJob(build_queue, [device, description]()
+	{
+		return VkHelper::CreateRayTracingPipeline(
+			device,
+			description.pipeline_layout,
+			static_cast<uint32_t>(description.shader_stages.size()),
+			description.shader_stages.data(),
+			static_cast<uint32_t>(description.shader_groups.size()),
+			description.shader_groups.data(),
+			description.max_recursion_depth
+		);
+	});
+}
+
+bool VkHelper::IsPipelineReady(const std::shared_future<VkPipeline>& pipeline)
+{
+	return pipeline.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
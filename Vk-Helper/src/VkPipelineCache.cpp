@@ -0,0 +1,181 @@
+#include <VkPipelineCache.hpp>
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <fstream>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+namespace
+{
+	// Vk-Helper owns a single pipeline cache that every pipeline creation helper uses
+	VkPipelineCache pipeline_cache = VK_NULL_HANDLE;
+	std::string pipeline_cache_path;
+	bool pipeline_cache_loaded_from_disk = false;
+	// Only one save can be writing the file at a time
+	std::mutex pipeline_cache_save_lock;
+
+	bool ReadCacheFile(const char* path, std::vector<char>& data)
+	{
+		std::ifstream file(path, std::ios::ate | std::ios::binary);
+		if (!file.is_open()) return false;
+
+		std::streamoff size = file.tellg();
+		if (size <= 0) return false;
+
+		data.resize(static_cast<size_t>(size));
+		file.seekg(0);
+		file.read(data.data(), size);
+		return file.good();
+	}
+
+	// Replace the file at path with the temporary file in one step
+	bool ReplaceFile(const std::string& temp_path, const std::string& path)
+	{
+#ifdef _WIN32
+		return MoveFileExA(temp_path.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+		// rename is atomic on POSIX, readers either see the old file or the new one
+		return rename(temp_path.c_str(), path.c_str()) == 0;
+#endif
+	}
+}
+
+bool VkHelper::IsPipelineCacheDataValid(const void* data, size_t size, const VkPhysicalDeviceProperties& physical_device_properties)
+{
+	if (data == nullptr || size < sizeof(PipelineCacheHeader)) return false;
+
+	// The data may not be aligned, so copy the header out before reading it
+	PipelineCacheHeader header;
+	memcpy(&header, data, sizeof(PipelineCacheHeader));
+
+	if (header.header_size < sizeof(PipelineCacheHeader)) return false;
+	if (header.header_version != VK_PIPELINE_CACHE_HEADER_VERSION_ONE) return false;
+	// Was the cache made on this GPU
+	if (header.vendor_id != physical_device_properties.vendorID) return false;
+	if (header.device_id != physical_device_properties.deviceID) return false;
+	// The UUID changes whenever the driver changes in a way that makes old caches unusable
+	if (memcmp(header.pipeline_cache_uuid, physical_device_properties.pipelineCacheUUID, VK_UUID_SIZE) != 0) return false;
+
+	return true;
+}
+
+void VkHelper::LoadPipelineCache(const VkDevice& device, const VkPhysicalDeviceProperties& physical_device_properties, const char* path)
+{
+	assert(pipeline_cache == VK_NULL_HANDLE && "Pipeline cache has already been loaded");
+
+	pipeline_cache_path = path;
+	pipeline_cache_loaded_from_disk = false;
+
+	std::vector<char> data;
+	if (ReadCacheFile(path, data))
+	{
+		pipeline_cache_loaded_from_disk = IsPipelineCacheDataValid(data.data(), data.size(), physical_device_properties);
+	}
+
+	VkPipelineCacheCreateInfo pipeline_cache_create_info = {};
+	pipeline_cache_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	// If the file was missing or from another device, we start with a empty cache
+	pipeline_cache_create_info.initialDataSize = pipeline_cache_loaded_from_disk ? data.size() : 0;
+	pipeline_cache_create_info.pInitialData = pipeline_cache_loaded_from_disk ? data.data() : nullptr;
+
+	VkResult create_pipeline_cache_result = vkCreatePipelineCache(
+		device,
+		&pipeline_cache_create_info,
+		nullptr,
+		&pipeline_cache
+	);
+
+	// The driver can still reject data that passed the header check, in that case fall back to a empty cache
+	if (create_pipeline_cache_result != VK_SUCCESS && pipeline_cache_loaded_from_disk)
+	{
+		pipeline_cache_loaded_from_disk = false;
+		pipeline_cache_create_info.initialDataSize = 0;
+		pipeline_cache_create_info.pInitialData = nullptr;
+
+		create_pipeline_cache_result = vkCreatePipelineCache(
+			device,
+			&pipeline_cache_create_info,
+			nullptr,
+			&pipeline_cache
+		);
+	}
+	assert(create_pipeline_cache_result == VK_SUCCESS);
+}
+
+bool VkHelper::SavePipelineCache(const VkDevice& device)
+{
+	if (pipeline_cache == VK_NULL_HANDLE) return false;
+
+	std::lock_guard<std::mutex> guard(pipeline_cache_save_lock);
+
+	// First find out how much data there is, then get the data itself
+	size_t size = 0;
+	VkResult get_pipeline_cache_data_result = vkGetPipelineCacheData(
+		device,
+		pipeline_cache,
+		&size,
+		nullptr
+	);
+	if (get_pipeline_cache_data_result != VK_SUCCESS || size == 0) return false;
+
+	std::vector<char> data(size);
+	get_pipeline_cache_data_result = vkGetPipelineCacheData(
+		device,
+		pipeline_cache,
+		&size,
+		data.data()
+	);
+	if (get_pipeline_cache_data_result != VK_SUCCESS) return false;
+
+	const std::string temp_path = pipeline_cache_path + ".tmp";
+	{
+		std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+		if (!file.is_open()) return false;
+		file.write(data.data(), size);
+		file.flush();
+		if (!file.good())
+		{
+			file.close();
+			remove(temp_path.c_str());
+			return false;
+		}
+	}
+
+	if (!ReplaceFile(temp_path, pipeline_cache_path))
+	{
+		remove(temp_path.c_str());
+		return false;
+	}
+	return true;
+}
+
+void VkHelper::DestroyPipelineCache(const VkDevice& device)
+{
+	if (pipeline_cache == VK_NULL_HANDLE) return;
+
+	SavePipelineCache(device);
+
+	vkDestroyPipelineCache(
+		device,
+		pipeline_cache,
+		nullptr
+	);
+	pipeline_cache = VK_NULL_HANDLE;
+	pipeline_cache_loaded_from_disk = false;
+}
+
+VkPipelineCache VkHelper::GetPipelineCache()
+{
+	return pipeline_cache;
+}
+
+bool VkHelper::PipelineCacheLoadedFromDisk()
+{
+	return pipeline_cache_loaded_from_disk;
+}
@@ -0,0 +1,84 @@
+#include <VkRingBuffer.hpp>
+#include <VkCore.hpp>
+#include <assert.h>
+
+void VkHelper::CreateRingBuffer(const VkDevice& device, Allocator& allocator, const VkPhysicalDeviceProperties& physical_device_properties, VkDeviceSize region_size,
+	uint32_t region_count, VkBufferUsageFlags usage, RingBuffer& ring_buffer)
+{
+	// Find the strictest offset alignment for the ways the buffer will be bound
+	ring_buffer.alignment = 1;
+	if ((usage & VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT) && physical_device_properties.limits.minUniformBufferOffsetAlignment > ring_buffer.alignment)
+	{
+		ring_buffer.alignment = physical_device_properties.limits.minUniformBufferOffsetAlignment;
+	}
+	if ((usage & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT) && physical_device_properties.limits.minStorageBufferOffsetAlignment > ring_buffer.alignment)
+	{
+		ring_buffer.alignment = physical_device_properties.limits.minStorageBufferOffsetAlignment;
+	}
+
+	// Each region needs to start on the alignment too
+	ring_buffer.region_size = (region_size + ring_buffer.alignment - 1) & ~(ring_buffer.alignment - 1);
+	ring_buffer.region_count = region_count;
+	ring_buffer.current_region = 0;
+	ring_buffer.head = 0;
+
+	bool created = VkHelper::CreateBuffer(
+		device,                                                          // What device are we going to use to create the buffer
+		allocator,                                                       // What allocator are we getting the memory from
+		ring_buffer.buffer,                                              // What buffer are we going to be creating
+		ring_buffer.allocation,                                          // The output for the buffer allocation
+		ring_buffer.region_size * region_count,                          // One region per frame in flight
+		usage,                                                           // How will the sub ranges be used
+		VK_SHARING_MODE_EXCLUSIVE,                                       // Only the graphics queue will read from the buffer
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+	);
+	assert(created);
+	assert(ring_buffer.allocation.mapped_memory != nullptr);
+}
+
+void VkHelper::DestroyRingBuffer(const VkDevice& device, Allocator& allocator, RingBuffer& ring_buffer)
+{
+	VkHelper::DestroyBuffer(
+		device,
+		allocator,
+		ring_buffer.buffer,
+		ring_buffer.allocation
+	);
+	ring_buffer.region_count = 0;
+}
+
+void VkHelper::BeginRingBufferFrame(const VkDevice& device, RingBuffer& ring_buffer, uint32_t frame_index, const VkFence& frame_fence)
+{
+	// The last time this region was used, it was by the submit that signals this fence. Until then the GPU may still be reading it
+	VkResult wait_for_fences = vkWaitForFences(
+		device,
+		1,
+		&frame_fence,
+		VK_TRUE,
+		UINT64_MAX
+	);
+	assert(wait_for_fences == VK_SUCCESS);
+
+	ring_buffer.current_region = frame_index % ring_buffer.region_count;
+	ring_buffer.head = 0;
+}
+
+bool VkHelper::RingBufferAllocate(RingBuffer& ring_buffer, VkDeviceSize size, uint32_t& dynamic_offset, void*& mapped_memory)
+{
+	VkDeviceSize aligned_head = (ring_buffer.head + ring_buffer.alignment - 1) & ~(ring_buffer.alignment - 1);
+
+	// Out of room for this frame, the region needs to be made bigger
+	if (aligned_head + size > ring_buffer.region_size) return false;
+
+	VkDeviceSize offset = RingBufferRegionOffset(ring_buffer, ring_buffer.current_region) + aligned_head;
+	ring_buffer.head = aligned_head + size;
+
+	dynamic_offset = static_cast<uint32_t>(offset);
+	mapped_memory = static_cast<char*>(ring_buffer.allocation.mapped_memory) + offset;
+	return true;
+}
+
+VkDeviceSize VkHelper::RingBufferRegionOffset(const RingBuffer& ring_buffer, uint32_t frame_index)
+{
+	return ring_buffer.region_size * (frame_index % ring_buffer.region_count);
+}
@@ -0,0 +1,204 @@
+#include <VkSamplerCache.hpp>
+#include <assert.h>
+#include <functional>
+#include <unordered_map>
+#include <mutex>
+
+namespace
+{
+	// Everything in VkSamplerCreateInfo that changes how the sampler behaves, plus the device that owns it
+	struct SamplerKey
+	{
+		VkDevice device;
+		VkSamplerCreateFlags flags;
+		VkFilter mag_filter;
+		VkFilter min_filter;
+		VkSamplerMipmapMode mipmap_mode;
+		VkSamplerAddressMode address_mode_u;
+		VkSamplerAddressMode address_mode_v;
+		VkSamplerAddressMode address_mode_w;
+		float mip_lod_bias;
+		VkBool32 anisotropy_enable;
+		float max_anisotropy;
+		VkBool32 compare_enable;
+		VkCompareOp compare_op;
+		float min_lod;
+		float max_lod;
+		VkBorderColor border_color;
+		VkBool32 unnormalized_coordinates;
+
+		bool operator==(const SamplerKey& other) const
+		{
+			return device == other.device && flags == other.flags && mag_filter == other.mag_filter && min_filter == other.min_filter &&
+				mipmap_mode == other.mipmap_mode && address_mode_u == other.address_mode_u && address_mode_v == other.address_mode_v &&
+				address_mode_w == other.address_mode_w && mip_lod_bias == other.mip_lod_bias && anisotropy_enable == other.anisotropy_enable &&
+				max_anisotropy == other.max_anisotropy && compare_enable == other.compare_enable && compare_op == other.compare_op &&
+				min_lod == other.min_lod && max_lod == other.max_lod && border_color == other.border_color &&
+				unnormalized_coordinates == other.unnormalized_coordinates;
+		}
+	};
+
+	struct SamplerKeyHash
+	{
+		size_t operator()(const SamplerKey& key) const
+		{
+			size_t seed = std::hash<VkDevice>()(key.device);
+			HashCombine(seed, std::hash<uint32_t>()(key.flags));
+			HashCombine(seed, std::hash<uint32_t>()(key.mag_filter));
+			HashCombine(seed, std::hash<uint32_t>()(key.min_filter));
+			HashCombine(seed, std::hash<uint32_t>()(key.mipmap_mode));
+			HashCombine(seed, std::hash<uint32_t>()(key.address_mode_u));
+			HashCombine(seed, std::hash<uint32_t>()(key.address_mode_v));
+			HashCombine(seed, std::hash<uint32_t>()(key.address_mode_w));
+			HashCombine(seed, std::hash<float>()(key.mip_lod_bias));
+			HashCombine(seed, std::hash<uint32_t>()(key.anisotropy_enable));
+			HashCombine(seed, std::hash<float>()(key.max_anisotropy));
+			HashCombine(seed, std::hash<uint32_t>()(key.compare_enable));
+			HashCombine(seed, std::hash<uint32_t>()(key.compare_op));
+			HashCombine(seed, std::hash<float>()(key.min_lod));
+			HashCombine(seed, std::hash<float>()(key.max_lod));
+			HashCombine(seed, std::hash<uint32_t>()(key.border_color));
+			HashCombine(seed, std::hash<uint32_t>()(key.unnormalized_coordinates));
+			return seed;
+		}
+
+		static void HashCombine(size_t& seed, size_t hash)
+		{
+			seed ^= hash + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+		}
+	};
+
+	struct CachedSampler
+	{
+		VkSampler sampler;
+		uint32_t references;
+	};
+
+	// Vk-Helper owns a single sampler cache shared by every texture helper. Textures can be created from the
+	// loader threads, so the cache is locked while it is being looked at
+	std::unordered_map<SamplerKey, CachedSampler, SamplerKeyHash> samplers;
+	// Lets ReleaseSampler find the cache entry from the handle alone
+	std::unordered_map<VkSampler, SamplerKey> sampler_keys;
+	uint32_t sampler_references = 0;
+	std::mutex sampler_cache_lock;
+
+	SamplerKey MakeSamplerKey(const VkDevice& device, const VkSamplerCreateInfo& create_info)
+	{
+		SamplerKey key;
+		key.device = device;
+		key.flags = create_info.flags;
+		key.mag_filter = create_info.magFilter;
+		key.min_filter = create_info.minFilter;
+		key.mipmap_mode = create_info.mipmapMode;
+		key.address_mode_u = create_info.addressModeU;
+		key.address_mode_v = create_info.addressModeV;
+		key.address_mode_w = create_info.addressModeW;
+		key.mip_lod_bias = create_info.mipLodBias;
+		key.anisotropy_enable = create_info.anisotropyEnable;
+		// Fields that are ignored by Vulkan are zeroed so they don't split otherwise matching samplers
+		key.max_anisotropy = create_info.anisotropyEnable ? create_info.maxAnisotropy : 0.0f;
+		key.compare_enable = create_info.compareEnable;
+		key.compare_op = create_info.compareEnable ? create_info.compareOp : VK_COMPARE_OP_NEVER;
+		key.min_lod = create_info.minLod;
+		key.max_lod = create_info.maxLod;
+		key.border_color = create_info.borderColor;
+		key.unnormalized_coordinates = create_info.unnormalizedCoordinates;
+		return key;
+	}
+}
+
+VkSampler VkHelper::AcquireSampler(const VkDevice& device, const VkSamplerCreateInfo& create_info)
+{
+	// Chained structs such as sampler YCbCr conversion can't be hashed generically
+	assert(create_info.pNext == nullptr);
+
+	const SamplerKey key = MakeSamplerKey(device, create_info);
+
+	std::lock_guard<std::mutex> lock(sampler_cache_lock);
+
+	sampler_references++;
+
+	auto it = samplers.find(key);
+	if (it != samplers.end())
+	{
+		it->second.references++;
+		return it->second.sampler;
+	}
+
+	// First time this state has been asked for
+	CachedSampler cached;
+	cached.references = 1;
+	VkResult create_sampler_result = vkCreateSampler(
+		device,
+		&create_info,
+		nullptr,
+		&cached.sampler
+	);
+	assert(create_sampler_result == VK_SUCCESS);
+
+	samplers[key] = cached;
+	sampler_keys[cached.sampler] = key;
+	return cached.sampler;
+}
+
+void VkHelper::ReleaseSampler(const VkDevice& device, VkSampler sampler)
+{
+	if (sampler == VK_NULL_HANDLE) return;
+
+	std::lock_guard<std::mutex> lock(sampler_cache_lock);
+
+	auto key_it = sampler_keys.find(sampler);
+	// The sampler was not made by the cache, or has already been released too many times
+	assert(key_it != sampler_keys.end());
+	if (key_it == sampler_keys.end()) return;
+
+	auto it = samplers.find(key_it->second);
+	assert(it != samplers.end() && it->second.references > 0);
+
+	sampler_references--;
+	it->second.references--;
+	if (it->second.references > 0) return;
+
+	// Nothing uses this state any more
+	vkDestroySampler(
+		device,
+		sampler,
+		nullptr
+	);
+	samplers.erase(it);
+	sampler_keys.erase(key_it);
+}
+
+void VkHelper::DestroySamplerCache(const VkDevice& device)
+{
+	std::lock_guard<std::mutex> lock(sampler_cache_lock);
+
+	for (auto it = samplers.begin(); it != samplers.end();)
+	{
+		if (it->first.device != device)
+		{
+			++it;
+			continue;
+		}
+		vkDestroySampler(
+			device,
+			it->second.sampler,
+			nullptr
+		);
+		sampler_references -= it->second.references;
+		sampler_keys.erase(it->second.sampler);
+		it = samplers.erase(it);
+	}
+}
+
+uint32_t VkHelper::SamplerCacheSize()
+{
+	std::lock_guard<std::mutex> lock(sampler_cache_lock);
+	return static_cast<uint32_t>(samplers.size());
+}
+
+uint32_t VkHelper::SamplerCacheReferenceCount()
+{
+	std::lock_guard<std::mutex> lock(sampler_cache_lock);
+	return sampler_references;
+}
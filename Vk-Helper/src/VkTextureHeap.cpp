@@ -0,0 +1,169 @@
+#include <VkTextureHeap.hpp>
+#include <VkInitializers.hpp>
+#include <assert.h>
+
+const char* VkHelper::TextureHeapExtension()
+{
+	return VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME;
+}
+
+VkPhysicalDeviceDescriptorIndexingFeaturesEXT VkHelper::TextureHeapFeatures()
+{
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT features = {};
+	features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+	features.runtimeDescriptorArray = VK_TRUE;                                  // sampler2D textures[] with no size in the shader
+	features.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;               // The index can differ between invocations, it comes from the material
+	features.descriptorBindingPartiallyBound = VK_TRUE;                         // Slots that are never read can be left empty
+	features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;            // Textures can be added after the set is bound
+	return features;
+}
+
+bool VkHelper::SupportsTextureHeap(const VkPhysicalDevice& physical_device)
+{
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT supported = {};
+	supported.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+
+	VkPhysicalDeviceFeatures2 features2 = {};
+	features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	features2.pNext = &supported;
+
+	vkGetPhysicalDeviceFeatures2(
+		physical_device,
+		&features2
+	);
+
+	return supported.runtimeDescriptorArray && supported.shaderSampledImageArrayNonUniformIndexing &&
+		supported.descriptorBindingPartiallyBound && supported.descriptorBindingSampledImageUpdateAfterBind;
+}
+
+void VkHelper::CreateTextureHeap(const VkDevice& device, const VkPhysicalDevice& physical_device, uint32_t capacity, VkShaderStageFlags stage_flags, TextureHeap& heap)
+{
+	// Update after bind sets have their own, usually much higher, limit on how many images they can hold
+	VkPhysicalDeviceDescriptorIndexingPropertiesEXT indexing_properties = {};
+	indexing_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+
+	VkPhysicalDeviceProperties2 properties2 = {};
+	properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+	properties2.pNext = &indexing_properties;
+
+	vkGetPhysicalDeviceProperties2(
+		physical_device,
+		&properties2
+	);
+
+	if (capacity > indexing_properties.maxDescriptorSetUpdateAfterBindSampledImages) capacity = indexing_properties.maxDescriptorSetUpdateAfterBindSampledImages;
+	if (capacity > indexing_properties.maxPerStageDescriptorUpdateAfterBindSampledImages) capacity = indexing_properties.maxPerStageDescriptorUpdateAfterBindSampledImages;
+	assert(capacity > 0);
+
+	heap.device = device;
+	heap.capacity = capacity;
+	heap.free_slots.clear();
+	heap.next_slot = 0;
+
+	VkDescriptorPoolSize pool_size = VkHelper::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, capacity);
+
+	VkDescriptorPoolCreateInfo pool_info = VkHelper::DescriptorPoolCreateInfo(&pool_size, 1, 1);
+	pool_info.flags |= VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;       // Sets from this pool may be written while bound
+
+	VkResult create_descriptor_pool = vkCreateDescriptorPool(
+		device,
+		&pool_info,
+		nullptr,
+		&heap.descriptor_pool
+	);
+	assert(create_descriptor_pool == VK_SUCCESS);
+
+	// One binding holding the whole texture array
+	VkDescriptorSetLayoutBinding layout_binding = VkHelper::DescriptorSetLayoutBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, capacity, stage_flags);
+
+	VkDescriptorBindingFlagsEXT binding_flags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT;
+
+	VkDescriptorSetLayoutBindingFlagsCreateInfoEXT binding_flags_info = {};
+	binding_flags_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+	binding_flags_info.bindingCount = 1;
+	binding_flags_info.pBindingFlags = &binding_flags;
+
+	VkDescriptorSetLayoutCreateInfo layout_info = VkHelper::DescriptorSetLayoutCreateInfo(&layout_binding, 1);
+	layout_info.flags |= VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+	layout_info.pNext = &binding_flags_info;
+
+	VkResult create_descriptor_set_layout = vkCreateDescriptorSetLayout(
+		device,
+		&layout_info,
+		nullptr,
+		&heap.descriptor_set_layout
+	);
+	assert(create_descriptor_set_layout == VK_SUCCESS);
+
+	VkDescriptorSetAllocateInfo allocate_info = VkHelper::DescriptorSetAllocateInfo(heap.descriptor_pool, heap.descriptor_set_layout, 1);
+
+	VkResult allocate_descriptor_set = vkAllocateDescriptorSets(
+		device,
+		&allocate_info,
+		&heap.descriptor_set
+	);
+	assert(allocate_descriptor_set == VK_SUCCESS);
+}
+
+void VkHelper::DestroyTextureHeap(TextureHeap& heap)
+{
+	// Destroying the pool frees the set with it
+	vkDestroyDescriptorPool(
+		heap.device,
+		heap.descriptor_pool,
+		nullptr
+	);
+
+	vkDestroyDescriptorSetLayout(
+		heap.device,
+		heap.descriptor_set_layout,
+		nullptr
+	);
+
+	heap.descriptor_pool = VK_NULL_HANDLE;
+	heap.descriptor_set_layout = VK_NULL_HANDLE;
+	heap.descriptor_set = VK_NULL_HANDLE;
+	heap.free_slots.clear();
+	heap.next_slot = 0;
+}
+
+uint32_t VkHelper::AddHeapTexture(TextureHeap& heap, VkSampler sampler, VkImageView view, VkImageLayout layout)
+{
+	uint32_t index;
+	if (!heap.free_slots.empty())
+	{
+		index = heap.free_slots.back();
+		heap.free_slots.pop_back();
+	}
+	else
+	{
+		// The heap is full, create it with a larger capacity
+		assert(heap.next_slot < heap.capacity);
+		index = heap.next_slot++;
+	}
+
+	VkDescriptorImageInfo image_info = VkHelper::DescriptorImageInfo(
+		sampler,
+		view,
+		layout
+	);
+
+	VkWriteDescriptorSet descriptor_write = VkHelper::WriteDescriptorSet(heap.descriptor_set, image_info, 0);
+	descriptor_write.dstArrayElement = index;                          // Which slot of the array to write
+
+	vkUpdateDescriptorSets(
+		heap.device,
+		1,
+		&descriptor_write,
+		0,
+		NULL
+	);
+
+	return index;
+}
+
+void VkHelper::RemoveHeapTexture(TextureHeap& heap, uint32_t index)
+{
+	assert(index < heap.next_slot);
+	heap.free_slots.push_back(index);
+}
@@ -0,0 +1,146 @@
+#include <VkTextureLoader.hpp>
+#include <lodepng.h>
+#include <VkCpuProfiler.hpp>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+
+void VkHelper::DecodeImages(const std::vector<std::string>& paths, uint32_t thread_count, const DecodedImageCallback& callback)
+{
+	if (paths.empty()) return;
+
+	if (thread_count == 0) thread_count = std::thread::hardware_concurrency();
+	if (thread_count == 0) thread_count = 1;
+	// No point starting threads that would have nothing to decode
+	if (thread_count > paths.size()) thread_count = static_cast<uint32_t>(paths.size());
+
+	std::vector<DecodedImage> images(paths.size());
+	std::atomic<uint32_t> next_image(0);
+
+	// Images that have been decoded but not handed to the callback yet
+	std::deque<uint32_t> decoded_images;
+	std::mutex lock;
+	std::condition_variable image_decoded;
+
+	// lodepng keeps no global state, so any number of images can be decoded at once
+	std::function<void()> worker = [&]()
+	{
+		VK_HELPER_CPU_THREAD_NAME("Image decoder");
+
+		while (true)
+		{
+			const uint32_t index = next_image++;
+			if (index >= paths.size()) return;
+
+			VK_HELPER_CPU_ZONE("Decode image");
+
+			DecodedImage& image = images[index];
+			image.path = paths[index];
+			image.error = lodepng::decode(
+				image.pixels,
+				image.width,
+				image.height,
+				image.path
+			);
+
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				decoded_images.push_back(index);
+			}
+			image_decoded.notify_one();
+		}
+	};
+
+	std::vector<std::thread> workers;
+	for (uint32_t i = 0; i < thread_count; i++)
+	{
+		workers.push_back(std::thread(worker));
+	}
+
+	for (size_t handled = 0; handled < paths.size(); handled++)
+	{
+		uint32_t index = 0;
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			image_decoded.wait(guard, [&]() { return !decoded_images.empty(); });
+			index = decoded_images.front();
+			decoded_images.pop_front();
+		}
+
+		callback(index, images[index]);
+
+		// The pixels have been copied out by now, don't hold on to them while the rest decode
+		std::vector<unsigned char>().swap(images[index].pixels);
+	}
+
+	for (std::thread& thread : workers)
+	{
+		thread.join();
+	}
+}
+
+bool VkHelper::DecodePackedImage(const ChannelSource sources[4], uint32_t thread_count, DecodedImage& packed)
+{
+	packed = DecodedImage();
+
+	// Only decode the channels that have a source
+	std::vector<std::string> paths;
+	std::vector<uint32_t> path_channels;
+	for (uint32_t channel = 0; channel < 4; channel++)
+	{
+		if (sources[channel].path.empty()) continue;
+		paths.push_back(sources[channel].path);
+		path_channels.push_back(channel);
+	}
+
+	bool sized = false;
+	bool valid = true;
+	DecodeImages(
+		paths,
+		thread_count,
+		[&](uint32_t index, DecodedImage& image)
+		{
+			if (!valid) return;
+			if (image.error)
+			{
+				packed.path = image.path;
+				packed.error = image.error;
+				valid = false;
+				return;
+			}
+
+			// The first image to finish decides the size, the rest have to match it
+			if (!sized)
+			{
+				packed.width = image.width;
+				packed.height = image.height;
+				packed.pixels.resize(static_cast<size_t>(packed.width) * packed.height * 4);
+				for (size_t texel = 0; texel < packed.pixels.size(); texel += 4)
+				{
+					for (uint32_t channel = 0; channel < 4; channel++) packed.pixels[texel + channel] = sources[channel].default_value;
+				}
+				sized = true;
+			}
+			else if (image.width != packed.width || image.height != packed.height)
+			{
+				// The channels would not line up
+				packed.path = image.path;
+				valid = false;
+				return;
+			}
+
+			// Decoded images are always RGBA8
+			const uint32_t destination_channel = path_channels[index];
+			const uint32_t source_channel = sources[destination_channel].channel;
+			const size_t texel_count = static_cast<size_t>(image.width) * image.height;
+			for (size_t texel = 0; texel < texel_count; texel++)
+			{
+				packed.pixels[texel * 4 + destination_channel] = image.pixels[texel * 4 + source_channel];
+			}
+		}
+	);
+
+	return valid && sized;
+}
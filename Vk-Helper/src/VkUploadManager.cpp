@@ -0,0 +1,693 @@
+#include <VkUploadManager.hpp>
+#include <VkCore.hpp>
+#include <VkDispatch.hpp>
+#include <VkInitializers.hpp>
+#include <VkCpuProfiler.hpp>
+#include <assert.h>
+#include <string.h>
+#include <memory>
+
+namespace
+{
+	// Staging offsets are kept on 16 bytes, this covers the texel size of all the formats we upload
+	// as well as the 4 byte alignment vkCmdCopyBufferToImage requires
+	const VkDeviceSize staging_alignment = 16;
+
+	VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	bool SharedQueueFamily(const VkHelper::UploadManager& upload_manager)
+	{
+		return upload_manager.transfer_queue_family == upload_manager.graphics_queue_family;
+	}
+
+	VkCommandBuffer AllocateCommandBuffer(const VkDevice& device, const VkCommandPool& command_pool)
+	{
+		VkCommandBufferAllocateInfo alloc_info = VkHelper::CommandBufferAllocateInfo(
+			command_pool,
+			1
+		);
+		VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+		VkResult allocate_command_buffer_result = vkAllocateCommandBuffers(
+			device,
+			&alloc_info,
+			&command_buffer
+		);
+		assert(allocate_command_buffer_result == VK_SUCCESS);
+
+		VkCommandBufferBeginInfo begin_info = VkHelper::CommandBufferBeginInfo(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+		VkResult begin_command_buffer = vkBeginCommandBuffer(
+			command_buffer,
+			&begin_info
+		);
+		assert(begin_command_buffer == VK_SUCCESS);
+		return command_buffer;
+	}
+
+	// Release everything from batches the GPU has finished with
+	void RetireBatches(VkHelper::UploadManager& upload_manager)
+	{
+		while (!upload_manager.in_flight_batches.empty())
+		{
+			VkHelper::UploadBatch& batch = upload_manager.in_flight_batches.front();
+
+			if (upload_manager.dispatch->vkGetFenceStatus(upload_manager.device, batch.fence) != VK_SUCCESS) break;
+
+			upload_manager.dispatch->vkFreeCommandBuffers(
+				upload_manager.device,
+				upload_manager.transfer_command_pool,
+				1,
+				&batch.transfer_command_buffer
+			);
+
+			if (batch.acquire_command_buffer != VK_NULL_HANDLE)
+			{
+				upload_manager.dispatch->vkFreeCommandBuffers(
+					upload_manager.device,
+					upload_manager.graphics_command_pool,
+					1,
+					&batch.acquire_command_buffer
+				);
+			}
+
+			VkResult reset_fences_result = upload_manager.dispatch->vkResetFences(
+				upload_manager.device,
+				1,
+				&batch.fence
+			);
+			assert(reset_fences_result == VK_SUCCESS);
+
+			upload_manager.free_fences.push_back(batch.fence);
+			if (batch.semaphore != VK_NULL_HANDLE) upload_manager.free_semaphores.push_back(batch.semaphore);
+
+			upload_manager.completed_batch_id = batch.id;
+			upload_manager.in_flight_batches.pop_front();
+		}
+	}
+
+	// Find room in the staging ring, submitting and waiting on older uploads if it is full
+	VkDeviceSize ReserveStaging(VkHelper::UploadManager& upload_manager, VkDeviceSize size)
+	{
+		assert(size <= upload_manager.staging_size && "Upload is larger then the staging ring");
+
+		while (true)
+		{
+			RetireBatches(upload_manager);
+
+			// The oldest data the GPU may still be reading from
+			bool live = upload_manager.recording || !upload_manager.in_flight_batches.empty();
+			VkDeviceSize tail = 0;
+			if (!upload_manager.in_flight_batches.empty())
+			{
+				tail = upload_manager.in_flight_batches.front().staging_begin;
+			}
+			else if (upload_manager.recording)
+			{
+				tail = upload_manager.recording_batch.staging_begin;
+			}
+			else
+			{
+				// Nothing is using the ring, so start from the beginning again
+				upload_manager.staging_head = 0;
+			}
+
+			VkDeviceSize offset = AlignUp(upload_manager.staging_head, staging_alignment);
+
+			if (!live || upload_manager.staging_head >= tail)
+			{
+				// Room at the end of the ring
+				if (offset + size <= upload_manager.staging_size)
+				{
+					upload_manager.staging_head = offset + size;
+					return offset;
+				}
+				// Wrap around to the start of the ring
+				if (size < tail)
+				{
+					upload_manager.staging_head = size;
+					return 0;
+				}
+			}
+			else if (offset + size < tail)
+			{
+				// We have wrapped already, so we can only grow up to the oldest live data
+				upload_manager.staging_head = offset + size;
+				return offset;
+			}
+
+			// There is no room, so push what we have to the GPU and wait for the oldest batch to free its space
+			if (upload_manager.recording) VkHelper::SubmitUploads(upload_manager);
+			VkHelper::WaitForUpload(upload_manager, upload_manager.in_flight_batches.front().id);
+		}
+	}
+
+	void BeginBatch(VkHelper::UploadManager& upload_manager, VkDeviceSize staging_offset)
+	{
+		if (upload_manager.recording) return;
+
+		upload_manager.recording_batch = VkHelper::UploadBatch();
+		upload_manager.recording_batch.staging_begin = staging_offset;
+		upload_manager.recording_batch.transfer_command_buffer = AllocateCommandBuffer(upload_manager.device, upload_manager.transfer_command_pool);
+		upload_manager.recording = true;
+	}
+
+	// Stage the pixels and record the copy into the first level_count mips, leaving them in VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL
+	void RecordImageCopy(VkHelper::UploadManager& upload_manager, const VkHelper::ImageLevel* levels, uint32_t level_count, VkImage dst_image)
+	{
+		// Every level starts on a aligned offset so block compressed copies meet the block size alignment
+		VkDeviceSize size = 0;
+		for (uint32_t level = 0; level < level_count; level++)
+		{
+			size = AlignUp(size, staging_alignment) + levels[level].size;
+		}
+
+		VkDeviceSize staging_offset = ReserveStaging(upload_manager, size);
+		BeginBatch(upload_manager, staging_offset);
+
+		std::vector<VkBufferImageCopy> copy_regions(level_count);
+		VkDeviceSize level_offset = staging_offset;
+		for (uint32_t level = 0; level < level_count; level++)
+		{
+			level_offset = AlignUp(level_offset, staging_alignment);
+
+			memcpy(
+				static_cast<char*>(upload_manager.staging_allocation.mapped_memory) + level_offset,
+				levels[level].data,
+				levels[level].size
+			);
+
+			VkBufferImageCopy& copy_region = copy_regions[level];
+			copy_region = {};
+			copy_region.bufferOffset = level_offset;
+			copy_region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			copy_region.imageSubresource.mipLevel = level;
+			copy_region.imageSubresource.baseArrayLayer = 0;
+			copy_region.imageSubresource.layerCount = 1;
+			copy_region.imageExtent.width = levels[level].width;
+			copy_region.imageExtent.height = levels[level].height;
+			copy_region.imageExtent.depth = 1;
+
+			level_offset += levels[level].size;
+		}
+
+		VkImageSubresourceRange subresource_range = {};
+		subresource_range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		subresource_range.baseMipLevel = 0;
+		subresource_range.levelCount = level_count;
+		subresource_range.layerCount = 1;
+
+		// Get the image ready to be copied into
+		VkImageMemoryBarrier barrier = VkHelper::ImageMemoryBarrier();
+		barrier.image = dst_image;
+		barrier.subresourceRange = subresource_range;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+
+		upload_manager.dispatch->vkCmdPipelineBarrier(
+			upload_manager.recording_batch.transfer_command_buffer,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			0,
+			0, nullptr,
+			0, nullptr,
+			1, &barrier
+		);
+
+		// One copy call for every level
+		upload_manager.dispatch->vkCmdCopyBufferToImage(
+			upload_manager.recording_batch.transfer_command_buffer,
+			upload_manager.staging_buffer,
+			dst_image,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			level_count,
+			copy_regions.data()
+		);
+	}
+
+	VkHelper::ImageLevel SingleLevel(const void* data, VkDeviceSize size, uint32_t width, uint32_t height)
+	{
+		VkHelper::ImageLevel level;
+		level.data = data;
+		level.size = size;
+		level.width = width;
+		level.height = height;
+		return level;
+	}
+
+	VkImageMemoryBarrier FirstMipsBarrier(VkImage image, uint32_t level_count)
+	{
+		VkImageMemoryBarrier barrier = VkHelper::ImageMemoryBarrier();
+		barrier.image = image;
+		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		barrier.subresourceRange.baseMipLevel = 0;
+		barrier.subresourceRange.levelCount = level_count;
+		barrier.subresourceRange.layerCount = 1;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		return barrier;
+	}
+}
+
+bool VkHelper::FindTransferQueueFamily(const VkPhysicalDevice& physical_device, uint32_t& queue_family_index)
+{
+	uint32_t queue_family_count = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(
+		physical_device,
+		&queue_family_count,
+		nullptr
+	);
+
+	std::unique_ptr<VkQueueFamilyProperties[]> queue_families(new VkQueueFamilyProperties[queue_family_count]());
+	vkGetPhysicalDeviceQueueFamilyProperties(
+		physical_device,
+		&queue_family_count,
+		queue_families.get()
+	);
+
+	for (uint32_t i = 0; i < queue_family_count; ++i)
+	{
+		if (queue_families[i].queueCount == 0) continue;
+		// We want a family that can transfer but can't do graphics or compute work
+		if ((queue_families[i].queueFlags & VK_QUEUE_TRANSFER_BIT) &&
+			!(queue_families[i].queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)))
+		{
+			queue_family_index = i;
+			return true;
+		}
+	}
+	return false;
+}
+
+void VkHelper::CreateUploadManager(const VkDevice& device, Allocator& allocator, const VkQueue& transfer_queue, uint32_t transfer_queue_family,
+	const VkQueue& graphics_queue, uint32_t graphics_queue_family, VkDeviceSize staging_size, UploadManager& upload_manager)
+{
+	upload_manager.device = device;
+	upload_manager.dispatch = &VkHelper::GetDeviceDispatch(device);
+	upload_manager.transfer_queue = transfer_queue;
+	upload_manager.transfer_queue_family = transfer_queue_family;
+	upload_manager.graphics_queue = graphics_queue;
+	upload_manager.graphics_queue_family = graphics_queue_family;
+	upload_manager.staging_size = staging_size;
+	upload_manager.staging_head = 0;
+
+	// Command buffers are recorded once and thrown away, so let the driver know they are short lived
+	upload_manager.transfer_command_pool = VkHelper::CreateCommandPool(
+		device,
+		transfer_queue_family,
+		VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT
+	);
+
+	if (!SharedQueueFamily(upload_manager))
+	{
+		upload_manager.graphics_command_pool = VkHelper::CreateCommandPool(
+			device,
+			graphics_queue_family,
+			VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT
+		);
+	}
+
+	bool created = VkHelper::CreateBuffer(
+		device,                                                          // What device are we going to use to create the buffer
+		allocator,                                                       // What allocator are we getting the memory from
+		upload_manager.staging_buffer,                                   // What buffer are we going to be creating
+		upload_manager.staging_allocation,                               // The output for the buffer allocation
+		staging_size,                                                    // How big is the staging ring
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,                                // The buffer is only ever copied from
+		VK_SHARING_MODE_EXCLUSIVE,                                       // Only the transfer queue reads from it
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+	);
+	assert(created);
+}
+
+void VkHelper::DestroyUploadManager(Allocator& allocator, UploadManager& upload_manager)
+{
+	// Make sure nothing is still reading from the staging ring
+	uint64_t last_batch = SubmitUploads(upload_manager);
+	WaitForUpload(upload_manager, last_batch);
+
+	for (VkFence fence : upload_manager.free_fences)
+	{
+		vkDestroyFence(
+			upload_manager.device,
+			fence,
+			nullptr
+		);
+	}
+	upload_manager.free_fences.clear();
+
+	for (VkSemaphore semaphore : upload_manager.free_semaphores)
+	{
+		vkDestroySemaphore(
+			upload_manager.device,
+			semaphore,
+			nullptr
+		);
+	}
+	upload_manager.free_semaphores.clear();
+
+	VkHelper::DestroyBuffer(
+		upload_manager.device,
+		allocator,
+		upload_manager.staging_buffer,
+		upload_manager.staging_allocation
+	);
+
+	vkDestroyCommandPool(
+		upload_manager.device,
+		upload_manager.transfer_command_pool,
+		nullptr
+	);
+
+	if (upload_manager.graphics_command_pool != VK_NULL_HANDLE)
+	{
+		vkDestroyCommandPool(
+			upload_manager.device,
+			upload_manager.graphics_command_pool,
+			nullptr
+		);
+	}
+}
+
+void VkHelper::UploadBuffer(UploadManager& upload_manager, const void* data, VkDeviceSize size, VkBuffer dst_buffer, VkDeviceSize dst_offset,
+	VkAccessFlags dst_access, VkPipelineStageFlags dst_stage)
+{
+	VkDeviceSize staging_offset = ReserveStaging(upload_manager, size);
+	BeginBatch(upload_manager, staging_offset);
+
+	// Transfer data over to the staging ring
+	memcpy(
+		static_cast<char*>(upload_manager.staging_allocation.mapped_memory) + staging_offset,   // The destination for our memory (GPU)
+		data,                                                                                  // Source for the memory (CPU-Ram)
+		size                                                                                   // How much data we are transferring
+	);
+
+	VkBufferCopy copy_region = {};
+	copy_region.srcOffset = staging_offset;
+	copy_region.dstOffset = dst_offset;
+	copy_region.size = size;
+
+	upload_manager.dispatch->vkCmdCopyBuffer(
+		upload_manager.recording_batch.transfer_command_buffer,
+		upload_manager.staging_buffer,
+		dst_buffer,
+		1,
+		&copy_region
+	);
+
+	VkBufferMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.buffer = dst_buffer;
+	barrier.offset = dst_offset;
+	barrier.size = size;
+
+	if (SharedQueueFamily(upload_manager))
+	{
+		// Same queue family, so a normal barrier makes the copy visible to the later reads
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = dst_access;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		upload_manager.buffer_release_barriers.push_back(barrier);
+	}
+	else
+	{
+		// Release ownership from the transfer queue, the dst access is ignored on a release
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = 0;
+		barrier.srcQueueFamilyIndex = upload_manager.transfer_queue_family;
+		barrier.dstQueueFamilyIndex = upload_manager.graphics_queue_family;
+		upload_manager.buffer_release_barriers.push_back(barrier);
+
+		// Then acquire it on the graphics queue, the src access is ignored on an acquire
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = dst_access;
+		upload_manager.buffer_acquire_barriers.push_back(barrier);
+	}
+	upload_manager.acquire_stages |= dst_stage;
+}
+
+void VkHelper::UploadImage(UploadManager& upload_manager, const void* data, VkDeviceSize size, VkImage dst_image, uint32_t width, uint32_t height,
+	VkImageLayout final_layout, VkAccessFlags dst_access, VkPipelineStageFlags dst_stage)
+{
+	ImageLevel level = SingleLevel(data, size, width, height);
+	UploadImageLevels(upload_manager, &level, 1, dst_image, final_layout, dst_access, dst_stage);
+}
+
+void VkHelper::UploadImageLevels(UploadManager& upload_manager, const ImageLevel* levels, uint32_t level_count, VkImage dst_image,
+	VkImageLayout final_layout, VkAccessFlags dst_access, VkPipelineStageFlags dst_stage)
+{
+	RecordImageCopy(upload_manager, levels, level_count, dst_image);
+
+	// Move the image into its final layout. When the queue families differ the release and acquire
+	// barriers both describe the same layout transition, it is only performed once
+	VkImageMemoryBarrier barrier = FirstMipsBarrier(dst_image, level_count);
+	barrier.newLayout = final_layout;
+
+	if (SharedQueueFamily(upload_manager))
+	{
+		barrier.dstAccessMask = dst_access;
+		upload_manager.image_release_barriers.push_back(barrier);
+	}
+	else
+	{
+		barrier.dstAccessMask = 0;
+		barrier.srcQueueFamilyIndex = upload_manager.transfer_queue_family;
+		barrier.dstQueueFamilyIndex = upload_manager.graphics_queue_family;
+		upload_manager.image_release_barriers.push_back(barrier);
+
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = dst_access;
+		upload_manager.image_acquire_barriers.push_back(barrier);
+	}
+	upload_manager.acquire_stages |= dst_stage;
+}
+
+void VkHelper::UploadImageMipmapped(UploadManager& upload_manager, const void* data, VkDeviceSize size, VkImage dst_image, VkFormat format,
+	uint32_t width, uint32_t height, uint32_t mip_levels, VkImageLayout final_layout, VkAccessFlags dst_access, VkPipelineStageFlags dst_stage)
+{
+	assert(upload_manager.mipmap_generator != nullptr && "The upload manager needs a mipmap generator to upload mipmapped images");
+
+	ImageLevel level = SingleLevel(data, size, width, height);
+	RecordImageCopy(upload_manager, &level, 1, dst_image);
+
+	if (SharedQueueFamily(upload_manager))
+	{
+		// The transfer queue is the graphics queue, so the mips can be made straight after the copy. The
+		// generator leaves every level in its final layout, so the image needs no barrier at submit time
+		VkHelper::RecordGenerateMipmaps(
+			*upload_manager.mipmap_generator,
+			upload_manager.recording_batch.transfer_command_buffer,
+			dst_image,
+			format,
+			width,
+			height,
+			mip_levels,
+			final_layout,
+			dst_access,
+			dst_stage
+		);
+	}
+	else
+	{
+		// Hand the first mip over to the graphics queue without changing its layout, the mips are then
+		// generated on the graphics queue straight after it takes ownership
+		VkImageMemoryBarrier barrier = FirstMipsBarrier(dst_image, 1);
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.dstAccessMask = 0;
+		barrier.srcQueueFamilyIndex = upload_manager.transfer_queue_family;
+		barrier.dstQueueFamilyIndex = upload_manager.graphics_queue_family;
+		upload_manager.image_release_barriers.push_back(barrier);
+
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+		upload_manager.image_acquire_barriers.push_back(barrier);
+		upload_manager.acquire_stages |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+
+		PendingMipmaps pending;
+		pending.image = dst_image;
+		pending.format = format;
+		pending.width = width;
+		pending.height = height;
+		pending.mip_levels = mip_levels;
+		pending.final_layout = final_layout;
+		pending.dst_access = dst_access;
+		pending.dst_stage = dst_stage;
+		upload_manager.pending_mipmaps.push_back(pending);
+	}
+	upload_manager.acquire_stages |= dst_stage;
+}
+
+uint64_t VkHelper::SubmitUploads(UploadManager& upload_manager)
+{
+	// Nothing new was recorded, so the last submitted batch is the one to wait on
+	if (!upload_manager.recording) return upload_manager.next_batch_id - 1;
+
+	VK_HELPER_CPU_ZONE("SubmitUploads");
+
+	UploadBatch batch = upload_manager.recording_batch;
+	batch.id = upload_manager.next_batch_id++;
+	batch.staging_end = upload_manager.staging_head;
+
+	const bool shared_queue_family = SharedQueueFamily(upload_manager);
+
+	// One barrier call for all the uploads in the batch
+	upload_manager.dispatch->vkCmdPipelineBarrier(
+		batch.transfer_command_buffer,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		shared_queue_family ? upload_manager.acquire_stages : static_cast<VkPipelineStageFlags>(VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT),
+		0,
+		0, nullptr,
+		static_cast<uint32_t>(upload_manager.buffer_release_barriers.size()), upload_manager.buffer_release_barriers.data(),
+		static_cast<uint32_t>(upload_manager.image_release_barriers.size()), upload_manager.image_release_barriers.data()
+	);
+
+	VkResult end_result = upload_manager.dispatch->vkEndCommandBuffer(batch.transfer_command_buffer);
+	assert(end_result == VK_SUCCESS);
+
+	// Reuse a fence from an old batch if we can
+	if (upload_manager.free_fences.empty())
+	{
+		std::unique_ptr<VkFence> fence;
+		VkHelper::CreateFence(upload_manager.device, fence, 1);
+		// CreateFence makes signaled fences, the batch needs to start unsignaled
+		VkResult reset_fences_result = upload_manager.dispatch->vkResetFences(upload_manager.device, 1, fence.get());
+		assert(reset_fences_result == VK_SUCCESS);
+		batch.fence = fence.get()[0];
+	}
+	else
+	{
+		batch.fence = upload_manager.free_fences.back();
+		upload_manager.free_fences.pop_back();
+	}
+
+	if (shared_queue_family)
+	{
+		VkSubmitInfo submit_info = VkHelper::SubmitInfo(batch.transfer_command_buffer);
+		VkResult queue_submit_result = upload_manager.dispatch->vkQueueSubmit(
+			upload_manager.transfer_queue,
+			1,
+			&submit_info,
+			batch.fence
+		);
+		assert(queue_submit_result == VK_SUCCESS);
+	}
+	else
+	{
+		if (upload_manager.free_semaphores.empty())
+		{
+			VkHelper::CreateVkSemaphore(upload_manager.device, batch.semaphore);
+		}
+		else
+		{
+			batch.semaphore = upload_manager.free_semaphores.back();
+			upload_manager.free_semaphores.pop_back();
+		}
+
+		// The transfer queue does the copies then signals the semaphore
+		VkSubmitInfo transfer_submit_info = VkHelper::SubmitInfo(batch.transfer_command_buffer);
+		transfer_submit_info.signalSemaphoreCount = 1;
+		transfer_submit_info.pSignalSemaphores = &batch.semaphore;
+
+		VkResult transfer_submit_result = upload_manager.dispatch->vkQueueSubmit(
+			upload_manager.transfer_queue,
+			1,
+			&transfer_submit_info,
+			VK_NULL_HANDLE
+		);
+		assert(transfer_submit_result == VK_SUCCESS);
+
+		// The graphics queue waits on the semaphore then takes ownership of the resources
+		batch.acquire_command_buffer = AllocateCommandBuffer(upload_manager.device, upload_manager.graphics_command_pool);
+
+		upload_manager.dispatch->vkCmdPipelineBarrier(
+			batch.acquire_command_buffer,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+			upload_manager.acquire_stages,
+			0,
+			0, nullptr,
+			static_cast<uint32_t>(upload_manager.buffer_acquire_barriers.size()), upload_manager.buffer_acquire_barriers.data(),
+			static_cast<uint32_t>(upload_manager.image_acquire_barriers.size()), upload_manager.image_acquire_barriers.data()
+		);
+
+		for (const PendingMipmaps& pending : upload_manager.pending_mipmaps)
+		{
+			VkHelper::RecordGenerateMipmaps(
+				*upload_manager.mipmap_generator,
+				batch.acquire_command_buffer,
+				pending.image,
+				pending.format,
+				pending.width,
+				pending.height,
+				pending.mip_levels,
+				pending.final_layout,
+				pending.dst_access,
+				pending.dst_stage
+			);
+		}
+
+		end_result = upload_manager.dispatch->vkEndCommandBuffer(batch.acquire_command_buffer);
+		assert(end_result == VK_SUCCESS);
+
+		VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+		VkSubmitInfo acquire_submit_info = VkHelper::SubmitInfo(batch.acquire_command_buffer);
+		acquire_submit_info.waitSemaphoreCount = 1;
+		acquire_submit_info.pWaitSemaphores = &batch.semaphore;
+		acquire_submit_info.pWaitDstStageMask = &wait_stage;
+
+		VkResult acquire_submit_result = upload_manager.dispatch->vkQueueSubmit(
+			upload_manager.graphics_queue,
+			1,
+			&acquire_submit_info,
+			batch.fence
+		);
+		assert(acquire_submit_result == VK_SUCCESS);
+	}
+
+	upload_manager.in_flight_batches.push_back(batch);
+
+	upload_manager.buffer_release_barriers.clear();
+	upload_manager.image_release_barriers.clear();
+	upload_manager.buffer_acquire_barriers.clear();
+	upload_manager.image_acquire_barriers.clear();
+	upload_manager.pending_mipmaps.clear();
+	upload_manager.acquire_stages = 0;
+	upload_manager.recording = false;
+
+	return batch.id;
+}
+
+bool VkHelper::IsUploadComplete(UploadManager& upload_manager, uint64_t batch_id)
+{
+	RetireBatches(upload_manager);
+	return batch_id <= upload_manager.completed_batch_id;
+}
+
+void VkHelper::WaitForUpload(UploadManager& upload_manager, uint64_t batch_id)
+{
+	VK_HELPER_CPU_ZONE("WaitForUpload");
+
+	// Make sure the batch has actually been submitted
+	if (upload_manager.recording && batch_id >= upload_manager.next_batch_id) SubmitUploads(upload_manager);
+
+	for (const UploadBatch& batch : upload_manager.in_flight_batches)
+	{
+		if (batch.id > batch_id) break;
+
+		VkResult wait_for_fences = upload_manager.dispatch->vkWaitForFences(
+			upload_manager.device,
+			1,
+			&batch.fence,
+			VK_TRUE,
+			UINT64_MAX
+		);
+		assert(wait_for_fences == VK_SUCCESS);
+	}
+
+	RetireBatches(upload_manager);
+}
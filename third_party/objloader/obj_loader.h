@@ -35,16 +35,74 @@ struct MatrialObj
   int n[2];//Padding
 };
 
+// The greyscale PBR maps of a material are packed into the channels of one texture. aoTextureID,
+// roughnessTextureID, metalicTextureID and heightTextureID all point at the same packed texture
+// and each map is read from its own channel
+enum PackedChannel
+{
+  PACKED_AO        = 0,  // R
+  PACKED_ROUGHNESS = 1,  // G
+  PACKED_METALLIC  = 2,  // B
+  PACKED_HEIGHT    = 3   // A
+};
+
+// The source maps for one packed texture, indexed by PackedChannel. Empty when the material has no such map
+struct PackedTextureObj
+{
+  std::string channels[4];
+};
+
 template <class TVert>
 class ObjLoader
 {
 public:
-  void loadModel(const std::string& filename);
+  // When deduplicate is set, vertices that share every attribute are merged and m_indices
+  // references the unique vertices, otherwise each index gets its own vertex
+  void loadModel(const std::string& filename, bool deduplicate = false);
 
   std::vector<TVert>       m_vertices;
   std::vector<uint32_t>    m_indices;
   std::vector<MatrialObj>  m_materials;
   std::vector<std::string> m_textures;
+  // Packed PBR textures, the packed texture IDs in MatrialObj index into this rather than m_textures
+  std::vector<PackedTextureObj> m_packedTextures;
+  // How many vertices the model had before deduplication
+  size_t                   m_sourceVertexCount = 0;
+
+private:
+  void deduplicateVertices();
+};
+
+//-----------------------------------------------------------------------------
+// Hash and compare every attribute the loader fills in, used to find duplicate vertices
+//
+template <class TVert>
+struct ObjVertexHash
+{
+  size_t operator()(const TVert& v) const
+  {
+    size_t seed = 0;
+    hashCombine(seed, std::hash<glm::vec3>()(v.pos));
+    hashCombine(seed, std::hash<glm::vec3>()(v.nrm));
+    hashCombine(seed, std::hash<glm::vec3>()(v.color));
+    hashCombine(seed, std::hash<glm::vec2>()(v.texCoord));
+    hashCombine(seed, std::hash<uint32_t>()(static_cast<uint32_t>(v.matID)));
+    return seed;
+  }
+
+  static void hashCombine(size_t& seed, size_t hash)
+  {
+    seed ^= hash + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+  }
+};
+
+template <class TVert>
+struct ObjVertexEqual
+{
+  bool operator()(const TVert& a, const TVert& b) const
+  {
+    return a.pos == b.pos && a.nrm == b.nrm && a.color == b.color && a.texCoord == b.texCoord && a.matID == b.matID;
+  }
 };
 
 //-----------------------------------------------------------------------------
@@ -72,7 +130,7 @@ static inline std::string get_path(const std::string& file)
 }
 
 template <class TVert>
-void ObjLoader<TVert>::loadModel(const std::string& filename)
+void ObjLoader<TVert>::loadModel(const std::string& filename, bool deduplicate)
 {
   tinyobj::attrib_t                attrib;
   std::vector<tinyobj::shape_t>    shapes;
@@ -117,20 +175,28 @@ void ObjLoader<TVert>::loadModel(const std::string& filename)
       m_textures.push_back(material.diffuse_texname);
       m.textureID = static_cast<int>(m_textures.size()) - 1;
     }
-	if (!material.reflection_texname.empty())
-	{
-		m_textures.push_back(material.reflection_texname);
-		m.metalicTextureID = static_cast<int>(m_textures.size()) - 1;
-	}
 	if (!material.normal_texname.empty())
 	{
 		m_textures.push_back(material.normal_texname);
 		m.normalTextureID = static_cast<int>(m_textures.size()) - 1;
 	}
-	if (!material.specular_highlight_texname.empty())
+
+	// Gather the greyscale maps into one packed texture. Older materials store roughness and metallic in the
+	// specular highlight and reflection slots, so fall back to those
+	PackedTextureObj packed;
+	packed.channels[PACKED_AO] = material.ambient_texname;
+	packed.channels[PACKED_ROUGHNESS] = !material.roughness_texname.empty() ? material.roughness_texname : material.specular_highlight_texname;
+	packed.channels[PACKED_METALLIC] = !material.metallic_texname.empty() ? material.metallic_texname : material.reflection_texname;
+	packed.channels[PACKED_HEIGHT] = material.displacement_texname;
+	if (!packed.channels[PACKED_AO].empty() || !packed.channels[PACKED_ROUGHNESS].empty() ||
+		!packed.channels[PACKED_METALLIC].empty() || !packed.channels[PACKED_HEIGHT].empty())
 	{
-		m_textures.push_back(material.specular_highlight_texname);
-		m.roughnessTextureID = static_cast<int>(m_textures.size()) - 1;
+		m_packedTextures.push_back(packed);
+		const int packedID = static_cast<int>(m_packedTextures.size()) - 1;
+		if (!packed.channels[PACKED_AO].empty()) m.aoTextureID = packedID;
+		if (!packed.channels[PACKED_ROUGHNESS].empty()) m.roughnessTextureID = packedID;
+		if (!packed.channels[PACKED_METALLIC].empty()) m.metalicTextureID = packedID;
+		if (!packed.channels[PACKED_HEIGHT].empty()) m.heightTextureID = packedID;
 	}
 
     m_materials.emplace_back(m);
@@ -202,4 +268,35 @@ void ObjLoader<TVert>::loadModel(const std::string& filename)
       v2.nrm      = n;
     }
   }
+
+  m_sourceVertexCount = m_vertices.size();
+
+  // Done after the normals are generated, so only vertices of faces with the same normal get merged
+  if(deduplicate)
+    deduplicateVertices();
+}
+
+template <class TVert>
+void ObjLoader<TVert>::deduplicateVertices()
+{
+  std::unordered_map<TVert, uint32_t, ObjVertexHash<TVert>, ObjVertexEqual<TVert>> uniqueVertices;
+  uniqueVertices.reserve(m_vertices.size());
+
+  std::vector<TVert> vertices;
+  vertices.reserve(m_vertices.size());
+
+  for(uint32_t& index : m_indices)
+  {
+    const TVert& vertex = m_vertices[index];
+    auto         found  = uniqueVertices.find(vertex);
+    if(found == uniqueVertices.end())
+    {
+      found = uniqueVertices.emplace(vertex, static_cast<uint32_t>(vertices.size())).first;
+      vertices.push_back(vertex);
+    }
+    index = found->second;
+  }
+
+  vertices.shrink_to_fit();
+  m_vertices.swap(vertices);
 }